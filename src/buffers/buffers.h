@@ -29,11 +29,8 @@ extern struct SaveBuffer gSaveBuffer;
 
 extern u8 gGfxSPTaskStack[];
 
-#ifdef TARGET_N64
+// Two pools so that one frame can be built while the previous one is rendered
 #define GFX_NUM_POOLS 2
-#else
-#define GFX_NUM_POOLS 1
-#endif
 extern struct GfxPool gGfxPools[GFX_NUM_POOLS];
 
 #endif // BUFFERS_H
@@ -1,4 +1,7 @@
 #include <ultra64.h>
+#ifdef USE_SYSTEM_MALLOC
+#include <stdlib.h>
+#endif
 
 #include "sm64.h"
 #include "behavior_data.h"
@@ -902,6 +905,430 @@ static BhvCommandProc BehaviorCmdTable[] = {
     bhv_cmd_spawn_water_droplet,
 };
 
+#ifdef USE_SYSTEM_MALLOC
+/**
+ * Pre-decoded behavior scripts. The first time a command runs, it is decoded
+ * into a BhvDecodedCmd that holds its operands ready to use and a handler that
+ * reads them from there, and each command remembers the decoded command that
+ * ran after it. Objects still keep their script position and behavior stack as
+ * addresses in the original script, so the decoded commands are looked up by
+ * address and nothing outside this file can tell the two ways of running a
+ * script apart. Scripts and their jump targets never move without segmented
+ * memory, so the decoded commands are kept for the rest of the game.
+ *
+ * A run of CALL_NATIVE commands is decoded as one command, together with the
+ * END_LOOP after it if there is one, which is how most scripts spend their
+ * frames. Commands that mostly run once per object go through their bhv_cmd
+ * function.
+ */
+struct BhvDecodedCmd;
+typedef struct BhvDecodedCmd *(*BhvDecodedProc)(struct BhvDecodedCmd *cmd);
+
+struct BhvDecodedCmd {
+    BhvDecodedProc proc;
+    const BehaviorScript *addr;
+    // The command that runs next, or the one that ran next last time for
+    // commands that go to an address from the behavior stack
+    const BehaviorScript *nextAddr;
+    struct BhvDecodedCmd *next; // NULL until it is needed
+    union {
+        s32 asS32;
+        f32 asF32;
+        BhvCommandProc cmdProc;
+    } arg;
+    s32 field;
+};
+
+#define BHV_DECODED_CHUNK_SIZE 256
+#define BHV_DECODED_TABLE_FIRST_BITS 10
+
+static s32 sBhvDecodingEnabled;
+
+// Where each object in the pool stopped last frame, if known, to save looking it up
+static struct BhvDecodedCmd *sBhvObjectStops[OBJECT_POOL_CAPACITY];
+static struct BhvDecodedCmd *sBhvDecodedStop;
+
+static struct BhvDecodedCmd *sBhvDecodedChunk;
+static s32 sBhvDecodedChunkUsed = BHV_DECODED_CHUNK_SIZE;
+
+// Open addressed table of the decoded commands, by their address in the script
+static struct BhvDecodedCmd **sBhvDecodedTable;
+static u32 sBhvDecodedTableBits;
+static u32 sBhvDecodedCount;
+
+static struct BhvDecodedCmd *decode_behavior_command(const BehaviorScript *addr);
+
+/**
+ * Enable or disable running behavior scripts from their pre-decoded form.
+ */
+void set_behavior_script_decoding(s32 enable) {
+    sBhvDecodingEnabled = enable;
+}
+
+static u32 bhv_decoded_table_slot(const BehaviorScript *addr, u32 bits) {
+    return ((u32)((uintptr_t) addr / sizeof(BehaviorScript)) * 2654435761u) >> (32 - bits);
+}
+
+static void insert_decoded_behavior_command(struct BhvDecodedCmd *cmd) {
+    u32 mask = (1 << sBhvDecodedTableBits) - 1;
+    u32 slot = bhv_decoded_table_slot(cmd->addr, sBhvDecodedTableBits);
+
+    while (sBhvDecodedTable[slot] != NULL) {
+        slot = (slot + 1) & mask;
+    }
+    sBhvDecodedTable[slot] = cmd;
+}
+
+/**
+ * Double the size of the table, or create it.
+ */
+static void grow_decoded_behavior_table(void) {
+    struct BhvDecodedCmd **oldTable = sBhvDecodedTable;
+    u32 oldSize = oldTable != NULL ? 1 << sBhvDecodedTableBits : 0;
+    u32 i;
+
+    sBhvDecodedTableBits = oldTable != NULL ? sBhvDecodedTableBits + 1 : BHV_DECODED_TABLE_FIRST_BITS;
+    sBhvDecodedTable = calloc(1 << sBhvDecodedTableBits, sizeof(struct BhvDecodedCmd *));
+    if (sBhvDecodedTable == NULL) {
+        abort();
+    }
+    for (i = 0; i < oldSize; i++) {
+        if (oldTable[i] != NULL) {
+            insert_decoded_behavior_command(oldTable[i]);
+        }
+    }
+    free(oldTable);
+}
+
+/**
+ * Get the decoded command at an address in a script, decoding it if this is
+ * the first time it runs.
+ */
+static struct BhvDecodedCmd *get_decoded_behavior_command(const BehaviorScript *addr) {
+    struct BhvDecodedCmd *cmd;
+    u32 mask;
+    u32 slot;
+
+    if (sBhvDecodedTable != NULL) {
+        mask = (1 << sBhvDecodedTableBits) - 1;
+        slot = bhv_decoded_table_slot(addr, sBhvDecodedTableBits);
+
+        while ((cmd = sBhvDecodedTable[slot]) != NULL) {
+            if (cmd->addr == addr) {
+                return cmd;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    if (sBhvDecodedChunkUsed == BHV_DECODED_CHUNK_SIZE) {
+        sBhvDecodedChunk = malloc(BHV_DECODED_CHUNK_SIZE * sizeof(struct BhvDecodedCmd));
+        if (sBhvDecodedChunk == NULL) {
+            abort();
+        }
+        sBhvDecodedChunkUsed = 0;
+    }
+    if (sBhvDecodedTable == NULL || (sBhvDecodedCount + 1) * 2 > (u32) 1 << sBhvDecodedTableBits) {
+        grow_decoded_behavior_table();
+    }
+
+    cmd = decode_behavior_command(addr);
+    insert_decoded_behavior_command(cmd);
+    sBhvDecodedCount++;
+    return cmd;
+}
+
+/**
+ * Get the decoded command that runs after cmd, which is at addr.
+ */
+static struct BhvDecodedCmd *follow_decoded_behavior_command(struct BhvDecodedCmd *cmd,
+                                                             const BehaviorScript *addr) {
+    if (cmd->next == NULL || cmd->nextAddr != addr) {
+        cmd->nextAddr = addr;
+        cmd->next = get_decoded_behavior_command(addr);
+    }
+    return cmd->next;
+}
+
+#define BHV_DECODED_NEXT(cmd) ((cmd)->next != NULL ? (cmd)->next : follow_decoded_behavior_command(cmd, (cmd)->nextAddr))
+
+// The handlers below do what the bhv_cmd function of the same name does. They
+// return the command to run next, or set gCurBhvCommand and return NULL where
+// the bhv_cmd function breaks, along with sBhvDecodedStop if they know the
+// decoded command there.
+
+static struct BhvDecodedCmd *bhv_decoded_generic(struct BhvDecodedCmd *cmd) {
+    gCurBhvCommand = cmd->addr;
+    if (cmd->arg.cmdProc() != BHV_PROC_CONTINUE) {
+        sBhvDecodedStop = cmd->nextAddr == gCurBhvCommand ? cmd->next : NULL;
+        return NULL;
+    }
+    return follow_decoded_behavior_command(cmd, gCurBhvCommand);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_delay(struct BhvDecodedCmd *cmd) {
+    if (gCurrentObject->bhvDelayTimer < cmd->arg.asS32 - 1) {
+        gCurrentObject->bhvDelayTimer++;
+        gCurBhvCommand = cmd->addr;
+        sBhvDecodedStop = cmd;
+    } else {
+        gCurrentObject->bhvDelayTimer = 0;
+        gCurBhvCommand = cmd->addr + 1;
+        sBhvDecodedStop = cmd->next;
+    }
+    return NULL;
+}
+
+static struct BhvDecodedCmd *bhv_decoded_call(struct BhvDecodedCmd *cmd) {
+    cur_obj_bhv_stack_push((uintptr_t)(cmd->addr + 2));
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_return(struct BhvDecodedCmd *cmd) {
+    return follow_decoded_behavior_command(cmd, (const BehaviorScript *) cur_obj_bhv_stack_pop());
+}
+
+static struct BhvDecodedCmd *bhv_decoded_goto(struct BhvDecodedCmd *cmd) {
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_begin_repeat(struct BhvDecodedCmd *cmd) {
+    cur_obj_bhv_stack_push((uintptr_t)(cmd->addr + 1));
+    cur_obj_bhv_stack_push(cmd->arg.asS32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static const BehaviorScript *bhv_decoded_repeat(struct BhvDecodedCmd *cmd) {
+    const BehaviorScript *loopStart;
+    u32 count = cur_obj_bhv_stack_pop();
+    count--;
+
+    if (count != 0) {
+        loopStart = (const BehaviorScript *) cur_obj_bhv_stack_pop();
+        cur_obj_bhv_stack_push((uintptr_t) loopStart);
+        cur_obj_bhv_stack_push(count);
+        return loopStart;
+    } else {
+        cur_obj_bhv_stack_pop();
+        return cmd->addr + 1;
+    }
+}
+
+static struct BhvDecodedCmd *bhv_decoded_end_repeat(struct BhvDecodedCmd *cmd) {
+    gCurBhvCommand = bhv_decoded_repeat(cmd);
+    sBhvDecodedStop = cmd->nextAddr == gCurBhvCommand ? cmd->next : NULL;
+    return NULL;
+}
+
+static struct BhvDecodedCmd *bhv_decoded_end_repeat_continue(struct BhvDecodedCmd *cmd) {
+    return follow_decoded_behavior_command(cmd, bhv_decoded_repeat(cmd));
+}
+
+static struct BhvDecodedCmd *bhv_decoded_begin_loop(struct BhvDecodedCmd *cmd) {
+    cur_obj_bhv_stack_push((uintptr_t)(cmd->addr + 1));
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_end_loop(struct BhvDecodedCmd *cmd) {
+    gCurBhvCommand = (const BehaviorScript *) cur_obj_bhv_stack_pop();
+    cur_obj_bhv_stack_push((uintptr_t) gCurBhvCommand);
+    // The start of the loop has run before, so it is safe to decode
+    sBhvDecodedStop = follow_decoded_behavior_command(cmd, gCurBhvCommand);
+    return NULL;
+}
+
+static struct BhvDecodedCmd *bhv_decoded_break(struct BhvDecodedCmd *cmd) {
+    gCurBhvCommand = cmd->addr;
+    sBhvDecodedStop = cmd;
+    return NULL;
+}
+
+// A run of CALL_NATIVE commands, arg holds how many
+static struct BhvDecodedCmd *bhv_decoded_call_natives(struct BhvDecodedCmd *cmd) {
+    const BehaviorScript *native = cmd->addr + 1;
+    s32 i;
+
+    for (i = 0; i < cmd->arg.asS32; i++, native += 2) {
+        ((NativeBhvFunc) native[0])();
+    }
+    return BHV_DECODED_NEXT(cmd);
+}
+
+// A run of CALL_NATIVE commands followed by END_LOOP
+static struct BhvDecodedCmd *bhv_decoded_call_natives_end_loop(struct BhvDecodedCmd *cmd) {
+    const BehaviorScript *native = cmd->addr + 1;
+    s32 i;
+
+    for (i = 0; i < cmd->arg.asS32; i++, native += 2) {
+        ((NativeBhvFunc) native[0])();
+    }
+    return bhv_decoded_end_loop(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_add_float(struct BhvDecodedCmd *cmd) {
+    cur_obj_add_float(cmd->field, cmd->arg.asF32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_set_float(struct BhvDecodedCmd *cmd) {
+    cur_obj_set_float(cmd->field, cmd->arg.asF32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_add_int(struct BhvDecodedCmd *cmd) {
+    cur_obj_add_int(cmd->field, cmd->arg.asS32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_set_int(struct BhvDecodedCmd *cmd) {
+    cur_obj_set_int(cmd->field, cmd->arg.asS32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_or_int(struct BhvDecodedCmd *cmd) {
+    cur_obj_or_int(cmd->field, cmd->arg.asS32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_bit_clear(struct BhvDecodedCmd *cmd) {
+    cur_obj_and_int(cmd->field, cmd->arg.asS32);
+    return BHV_DECODED_NEXT(cmd);
+}
+
+static struct BhvDecodedCmd *bhv_decoded_animate_texture(struct BhvDecodedCmd *cmd) {
+    s16 rate = cmd->arg.asS32;
+
+    if ((gGlobalTimer % rate) == 0) {
+        cur_obj_add_int(cmd->field, 1);
+    }
+    return BHV_DECODED_NEXT(cmd);
+}
+
+/**
+ * Decode the command at addr into the next free BhvDecodedCmd.
+ */
+static struct BhvDecodedCmd *decode_behavior_command(const BehaviorScript *addr) {
+    struct BhvDecodedCmd *cmd = &sBhvDecodedChunk[sBhvDecodedChunkUsed++];
+    const BehaviorScript *gCurBhvCommand = addr; // for the BHV_CMD_GET macros
+
+    cmd->addr = addr;
+    cmd->nextAddr = addr + 1;
+    cmd->next = NULL;
+    cmd->field = BHV_CMD_GET_2ND_U8(0);
+
+    switch (*addr >> 24) {
+        case 0x01:
+            cmd->proc = bhv_decoded_delay;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x02:
+            cmd->proc = bhv_decoded_call;
+            cmd->nextAddr = segmented_to_virtual(BHV_CMD_GET_VPTR(1));
+            break;
+        case 0x03:
+            cmd->proc = bhv_decoded_return;
+            break;
+        case 0x04:
+            cmd->proc = bhv_decoded_goto;
+            cmd->nextAddr = segmented_to_virtual(BHV_CMD_GET_VPTR(1));
+            break;
+        case 0x05:
+            cmd->proc = bhv_decoded_begin_repeat;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x06:
+            cmd->proc = bhv_decoded_end_repeat;
+            break;
+        case 0x07:
+            cmd->proc = bhv_decoded_end_repeat_continue;
+            break;
+        case 0x08:
+            cmd->proc = bhv_decoded_begin_loop;
+            break;
+        case 0x09:
+            cmd->proc = bhv_decoded_end_loop;
+            break;
+        case 0x0A:
+        case 0x0B:
+            cmd->proc = bhv_decoded_break;
+            break;
+        case 0x0C:
+            // Always followed by another command, so reading ahead is safe
+            cmd->arg.asS32 = 0;
+            cmd->nextAddr = addr;
+            do {
+                cmd->arg.asS32++;
+                cmd->nextAddr += 2;
+            } while ((*cmd->nextAddr >> 24) == 0x0C);
+
+            if ((*cmd->nextAddr >> 24) == 0x09) {
+                cmd->proc = bhv_decoded_call_natives_end_loop;
+                cmd->nextAddr = NULL;
+            } else {
+                cmd->proc = bhv_decoded_call_natives;
+            }
+            break;
+        case 0x0D:
+            cmd->proc = bhv_decoded_add_float;
+            cmd->arg.asF32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x0E:
+            cmd->proc = bhv_decoded_set_float;
+            cmd->arg.asF32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x0F:
+            cmd->proc = bhv_decoded_add_int;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x10:
+            cmd->proc = bhv_decoded_set_int;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x11:
+            cmd->proc = bhv_decoded_or_int;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0) & 0xFFFF;
+            break;
+        case 0x12:
+            cmd->proc = bhv_decoded_bit_clear;
+            cmd->arg.asS32 = (BHV_CMD_GET_2ND_S16(0) & 0xFFFF) ^ 0xFFFF;
+            break;
+        case 0x34:
+            cmd->proc = bhv_decoded_animate_texture;
+            cmd->arg.asS32 = BHV_CMD_GET_2ND_S16(0);
+            break;
+        default:
+            cmd->proc = bhv_decoded_generic;
+            cmd->arg.cmdProc = BehaviorCmdTable[*addr >> 24];
+            break;
+    }
+    return cmd;
+}
+
+/**
+ * Run the current object's script from gCurBhvCommand until a command breaks.
+ */
+static void cur_obj_run_decoded_script(void) {
+    s32 poolIndex = get_object_pool_index(gCurrentObject);
+    struct BhvDecodedCmd *cmd = NULL;
+
+    if (poolIndex >= 0) {
+        cmd = sBhvObjectStops[poolIndex];
+    }
+    if (cmd == NULL || cmd->addr != gCurBhvCommand) {
+        cmd = get_decoded_behavior_command(gCurBhvCommand);
+    }
+
+    sBhvDecodedStop = NULL;
+    do {
+        cmd = cmd->proc(cmd);
+    } while (cmd != NULL);
+
+    if (poolIndex >= 0) {
+        sBhvObjectStops[poolIndex] = sBhvDecodedStop;
+    }
+}
+#endif
+
 // Execute the behavior script of the current object, process the object flags, and other miscellaneous code for updating objects.
 void cur_obj_update(void) {
     UNUSED u32 unused;
@@ -933,6 +1360,11 @@ void cur_obj_update(void) {
     // Execute the behavior script.
     gCurBhvCommand = gCurrentObject->curBhvCommand;
 
+#ifdef USE_SYSTEM_MALLOC
+    if (sBhvDecodingEnabled) {
+        cur_obj_run_decoded_script();
+    } else
+#endif
     do {
         bhvCmdProc = BehaviorCmdTable[*gCurBhvCommand >> 24];
         bhvProcResult = bhvCmdProc();
@@ -27,4 +27,8 @@ void stub_behavior_script_2(void);
 
 void cur_obj_update(void);
 
+#ifdef USE_SYSTEM_MALLOC
+void set_behavior_script_decoding(s32 enable);
+#endif
+
 #endif // BEHAVIOR_SCRIPT_H
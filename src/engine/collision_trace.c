@@ -0,0 +1,144 @@
+#ifndef TARGET_N64
+#include <stdio.h>
+#include <string.h>
+
+#include <PR/ultratypes.h>
+
+#include "sm64.h"
+#include "game/object_list_processor.h"
+#include "collision_trace.h"
+
+#define MAX_TRACED_MODELS 1024
+
+u8 gCollisionTraceEnabled;
+
+static FILE *sCollisionTrace;
+
+/**
+ * The collision data written so far, a model's id is its index.
+ */
+static const s16 *sTracedModels[MAX_TRACED_MODELS];
+static s32 sNumTracedModels;
+
+static void write_trace(const void *data, size_t size) {
+    if (sCollisionTrace != NULL && fwrite(data, size, 1, sCollisionTrace) != 1) {
+        fprintf(stderr, "Could not write the collision trace, stopping it\n");
+        close_collision_trace();
+    }
+}
+
+static void write_trace_record(u8 type) {
+    write_trace(&type, sizeof(type));
+}
+
+/**
+ * Start writing a collision trace, replacing the file. Returns FALSE if it
+ * couldn't be created.
+ */
+s32 open_collision_trace(const char *filename) {
+    u32 version = COLLISION_TRACE_VERSION;
+
+    close_collision_trace();
+
+    sCollisionTrace = fopen(filename, "wb");
+    if (sCollisionTrace == NULL) {
+        fprintf(stderr, "Could not create the collision trace %s\n", filename);
+        return FALSE;
+    }
+
+    sNumTracedModels = 0;
+    gCollisionTraceEnabled = TRUE;
+    write_trace(COLLISION_TRACE_MAGIC, strlen(COLLISION_TRACE_MAGIC));
+    write_trace(&version, sizeof(version));
+    return sCollisionTrace != NULL;
+}
+
+void close_collision_trace(void) {
+    gCollisionTraceEnabled = FALSE;
+
+    if (sCollisionTrace != NULL) {
+        fclose(sCollisionTrace);
+        sCollisionTrace = NULL;
+    }
+}
+
+void trace_area_load(s16 level, s16 area) {
+    write_trace_record(COLLISION_TRACE_AREA);
+    write_trace(&level, sizeof(level));
+    write_trace(&area, sizeof(area));
+}
+
+void trace_frame(void) {
+    write_trace_record(COLLISION_TRACE_FRAME);
+}
+
+/**
+ * Get the id of an object's collision data, writing it the first time it is seen.
+ */
+static s32 get_traced_model(s16 *collisionData, s32 length) {
+    u32 numWords = length;
+    u16 id;
+    s32 i;
+
+    for (i = 0; i < sNumTracedModels; i++) {
+        if (sTracedModels[i] == collisionData) {
+            return i;
+        }
+    }
+
+    if (sNumTracedModels == MAX_TRACED_MODELS) {
+        fprintf(stderr, "More than %d collision models in the collision trace, stopping it\n",
+                MAX_TRACED_MODELS);
+        close_collision_trace();
+        return -1;
+    }
+
+    id = sNumTracedModels;
+    sTracedModels[sNumTracedModels++] = collisionData;
+
+    write_trace_record(COLLISION_TRACE_MODEL);
+    write_trace(&id, sizeof(id));
+    write_trace(&numWords, sizeof(numWords));
+    write_trace(collisionData, length * sizeof(s16));
+    return id;
+}
+
+/**
+ * Record an object loading its collision, from the data after its collision
+ * type and the matrix its vertices are transformed by.
+ */
+void trace_object_load(struct Object *obj, s16 *collisionData, s32 length, Mat4 transform) {
+    s32 model = get_traced_model(collisionData, length);
+    s16 index = obj >= gObjectPool && obj < gObjectPool + OBJECT_POOL_CAPACITY ? obj - gObjectPool : -1;
+    u16 id = model;
+
+    if (model < 0) {
+        return;
+    }
+
+    write_trace_record(COLLISION_TRACE_OBJECT);
+    write_trace(&index, sizeof(index));
+    write_trace(&id, sizeof(id));
+    write_trace(transform, sizeof(Mat4));
+}
+
+/**
+ * Record a query, with one of the query record types.
+ */
+void trace_collision_query(s32 type, f32 x, f32 y, f32 z, f32 offsetY, f32 radius) {
+    u8 camera = gCheckingSurfaceCollisionsForCamera != 0;
+    u8 intangible = type == COLLISION_TRACE_FLOOR && gFindFloorIncludeSurfaceIntangible != 0;
+    f32 values[5];
+
+    values[0] = x;
+    values[1] = y;
+    values[2] = z;
+    values[3] = offsetY;
+    values[4] = radius;
+
+    write_trace_record(type);
+    write_trace(&camera, sizeof(camera));
+    write_trace(&intangible, sizeof(intangible));
+    write_trace(values, sizeof(values));
+}
+#endif
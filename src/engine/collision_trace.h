@@ -0,0 +1,47 @@
+#ifndef COLLISION_TRACE_H
+#define COLLISION_TRACE_H
+
+#include <PR/ultratypes.h>
+
+#include "types.h"
+
+#ifndef TARGET_N64
+/**
+ * A collision trace records what the collision queries of a play session saw,
+ * so tools/collision_bench can replay them against the same surfaces. It is a
+ * header followed by records in host byte order, each starting with its type:
+ *   AREA   s16 level, s16 area         load_area_terrain loaded an area
+ *   FRAME                              clear_dynamic_surfaces started a frame
+ *   MODEL  u16 id, u32 length, s16[]   an object's collision data from its vertex count
+ *                                      to its TERRAIN_LOAD_CONTINUE, before its first OBJECT
+ *   OBJECT s16 pool index, u16 model, f32[4][4] vertex transform
+ *                                      load_object_collision_model loaded an object
+ *   FLOOR, CEIL, WALLS, WATER
+ *          u8 camera, u8 intangible, f32 x, y, z, offsetY, radius
+ *                                      a query, with the flags that change its result
+ */
+#define COLLISION_TRACE_MAGIC "SM64COLT"
+#define COLLISION_TRACE_VERSION 1
+
+enum CollisionTraceRecord {
+    COLLISION_TRACE_AREA,
+    COLLISION_TRACE_FRAME,
+    COLLISION_TRACE_MODEL,
+    COLLISION_TRACE_OBJECT,
+    COLLISION_TRACE_FLOOR,
+    COLLISION_TRACE_CEIL,
+    COLLISION_TRACE_WALLS,
+    COLLISION_TRACE_WATER
+};
+
+extern u8 gCollisionTraceEnabled;
+
+s32 open_collision_trace(const char *filename);
+void close_collision_trace(void);
+void trace_area_load(s16 level, s16 area);
+void trace_frame(void);
+void trace_object_load(struct Object *obj, s16 *collisionData, s32 length, Mat4 transform);
+void trace_collision_query(s32 type, f32 x, f32 y, f32 z, f32 offsetY, f32 radius);
+#endif
+
+#endif // COLLISION_TRACE_H
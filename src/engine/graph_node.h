@@ -119,6 +119,9 @@ struct DisplayListNode
     Mtx *transform;
     void *displayList;
     struct DisplayListNode *next;
+#ifndef TARGET_N64
+    const void *interpId; // object drawing the display list, for render-rate interpolation
+#endif
 };
 
 /** GraphNode that manages the 8 top-level display lists that will be drawn
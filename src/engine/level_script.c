@@ -9,6 +9,7 @@
 #include "buffers/zbuffer.h"
 #include "game/area.h"
 #include "game/game_init.h"
+#include "game/main.h"
 #include "game/mario.h"
 #include "game/memory.h"
 #include "game/object_helpers.h"
@@ -290,6 +291,9 @@ static void *alloc_for_goddard(u32 size) {
 }
 
 static void free_for_goddard(void *ptr) {
+    // The Mario head's display lists and vertices live in this pool, and the
+    // previous frame may still be rendering from them
+    wait_for_display_list();
     mem_pool_free(sMemPoolForGoddard, ptr);
 }
 #endif
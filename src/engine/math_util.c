@@ -3,6 +3,7 @@
 #include "sm64.h"
 #include "engine/graph_node.h"
 #include "math_util.h"
+#include "mtxf_simd.h"
 #include "surface_collision.h"
 
 #include "trig_tables.inc.c"
@@ -604,6 +605,151 @@ void mtxf_rotate_xy(Mtx *mtx, s16 angle) {
     mtxf_to_mtx(mtx, temp);
 }
 
+#ifndef TARGET_N64
+#ifdef MTXF_SIMD
+/*
+ * SIMD versions of the matrix stack kernels. Each lane does the operations of
+ * the scalar kernel in the same order, so with fused = FALSE the results are
+ * bit-identical to it. They have to stay in this file for that: where the
+ * compiler contracts the scalar multiplies and adds into fused multiply-adds,
+ * it contracts these the same way.
+ * mtxf_rotate_zxy_and_translate stays scalar, gathering its sines and cosines
+ * into vectors costs more than the few multiplies it would save.
+ */
+
+#define MTXF_SIMD_MADD(fused, a, b, c) ((fused) ? mtxf_simd_madd(a, b, c) : mtxf_simd_add(mtxf_simd_mul(a, b), c))
+
+static inline void mtxf_mul_simd(Mat4 dest, Mat4 a, Mat4 b, const s32 fused) {
+    mtxf_simd_t b0 = mtxf_simd_load(b[0]);
+    mtxf_simd_t b1 = mtxf_simd_load(b[1]);
+    mtxf_simd_t b2 = mtxf_simd_load(b[2]);
+    mtxf_simd_t b3 = mtxf_simd_load(b[3]);
+    mtxf_simd_t rows[4];
+    s32 i;
+
+    // All rows are computed before storing, dest may be a or b
+    for (i = 0; i < 4; i++) {
+        rows[i] = mtxf_simd_mul(mtxf_simd_set1(a[i][0]), b0);
+        rows[i] = MTXF_SIMD_MADD(fused, mtxf_simd_set1(a[i][1]), b1, rows[i]);
+        rows[i] = MTXF_SIMD_MADD(fused, mtxf_simd_set1(a[i][2]), b2, rows[i]);
+    }
+    rows[3] = mtxf_simd_add(rows[3], b3);
+
+    mtxf_simd_store(dest[0], mtxf_simd_clear_w(rows[0]));
+    mtxf_simd_store(dest[1], mtxf_simd_clear_w(rows[1]));
+    mtxf_simd_store(dest[2], mtxf_simd_clear_w(rows[2]));
+    mtxf_simd_store(dest[3], mtxf_simd_set_w1(rows[3]));
+}
+
+static inline void mtxf_billboard_simd(Mat4 dest, Mat4 mtx, Vec3f position, s16 angle, const s32 fused) {
+    f32 s = sins(angle);
+    f32 c = coss(angle);
+    mtxf_simd_t row3 = mtxf_simd_mul(mtxf_simd_set1(position[0]), mtxf_simd_load(mtx[0]));
+
+    row3 = MTXF_SIMD_MADD(fused, mtxf_simd_set1(position[1]), mtxf_simd_load(mtx[1]), row3);
+    row3 = MTXF_SIMD_MADD(fused, mtxf_simd_set1(position[2]), mtxf_simd_load(mtx[2]), row3);
+    row3 = mtxf_simd_add(row3, mtxf_simd_load(mtx[3]));
+
+    mtxf_simd_store(dest[0], mtxf_simd_set(c, s, 0.0f, 0.0f));
+    mtxf_simd_store(dest[1], mtxf_simd_set(-s, c, 0.0f, 0.0f));
+    mtxf_simd_store(dest[2], mtxf_simd_set(0.0f, 0.0f, 1.0f, 0.0f));
+    mtxf_simd_store(dest[3], mtxf_simd_set_w1(row3));
+}
+
+static inline void mtxf_mul_vec3s_simd(Mat4 mtx, Vec3s b, const s32 fused) {
+    mtxf_simd_t v = mtxf_simd_mul(mtxf_simd_set1(b[0]), mtxf_simd_load(mtx[0]));
+    s32 result[4];
+
+    v = MTXF_SIMD_MADD(fused, mtxf_simd_set1(b[1]), mtxf_simd_load(mtx[1]), v);
+    v = MTXF_SIMD_MADD(fused, mtxf_simd_set1(b[2]), mtxf_simd_load(mtx[2]), v);
+    v = mtxf_simd_add(v, mtxf_simd_load(mtx[3]));
+    mtxf_simd_to_s32(v, result);
+
+    b[0] = result[0];
+    b[1] = result[1];
+    b[2] = result[2];
+}
+
+static void mtxf_to_mtx_simd(Mtx *dest, Mat4 src) {
+#ifdef GBI_FLOATS
+    s32 i;
+
+    for (i = 0; i < 4; i++) {
+        mtxf_simd_store(dest->m[i], mtxf_simd_load(src[i]));
+    }
+#else
+    // The same fixed point layout as guMtxF2L
+    s32 *intPart = &dest->m[0][0];
+    s32 *fracPart = &dest->m[2][0];
+    s32 row[4];
+    s32 i, j;
+
+    for (i = 0; i < 4; i++) {
+        mtxf_simd_to_s32(mtxf_simd_mul(mtxf_simd_load(src[i]), mtxf_simd_set1(65536.0f)), row);
+        for (j = 0; j < 4; j += 2) {
+            *intPart++ = (row[j] & 0xFFFF0000) | ((row[j + 1] >> 16) & 0xFFFF);
+            *fracPart++ = ((row[j] << 16) & 0xFFFF0000) | (row[j + 1] & 0xFFFF);
+        }
+    }
+#endif
+}
+
+static void mtxf_mul_strict_simd(Mat4 dest, Mat4 a, Mat4 b) {
+    mtxf_mul_simd(dest, a, b, FALSE);
+}
+
+static void mtxf_billboard_strict_simd(Mat4 dest, Mat4 mtx, Vec3f position, s16 angle) {
+    mtxf_billboard_simd(dest, mtx, position, angle, FALSE);
+}
+
+static void mtxf_mul_vec3s_strict_simd(Mat4 mtx, Vec3s b) {
+    mtxf_mul_vec3s_simd(mtx, b, FALSE);
+}
+
+static void mtxf_mul_fast_simd(Mat4 dest, Mat4 a, Mat4 b) {
+    mtxf_mul_simd(dest, a, b, TRUE);
+}
+
+static void mtxf_billboard_fast_simd(Mat4 dest, Mat4 mtx, Vec3f position, s16 angle) {
+    mtxf_billboard_simd(dest, mtx, position, angle, TRUE);
+}
+
+static void mtxf_mul_vec3s_fast_simd(Mat4 mtx, Vec3s b) {
+    mtxf_mul_vec3s_simd(mtx, b, TRUE);
+}
+
+const struct MtxfKernels gMtxfStrictSimdKernels = {
+    "strict simd",
+    mtxf_mul_strict_simd,
+    mtxf_rotate_zxy_and_translate,
+    mtxf_billboard_strict_simd,
+    mtxf_to_mtx_simd,
+    mtxf_mul_vec3s_strict_simd,
+};
+
+const struct MtxfKernels gMtxfFastSimdKernels = {
+    "fast simd",
+    mtxf_mul_fast_simd,
+    mtxf_rotate_zxy_and_translate,
+    mtxf_billboard_fast_simd,
+    mtxf_to_mtx_simd,
+    mtxf_mul_vec3s_fast_simd,
+};
+#else
+const struct MtxfKernels gMtxfStrictSimdKernels = {
+    "scalar", mtxf_mul, mtxf_rotate_zxy_and_translate, mtxf_billboard, mtxf_to_mtx, mtxf_mul_vec3s,
+};
+
+const struct MtxfKernels gMtxfFastSimdKernels = {
+    "scalar", mtxf_mul, mtxf_rotate_zxy_and_translate, mtxf_billboard, mtxf_to_mtx, mtxf_mul_vec3s,
+};
+#endif
+
+const struct MtxfKernels gMtxfScalarKernels = {
+    "scalar", mtxf_mul, mtxf_rotate_zxy_and_translate, mtxf_billboard, mtxf_to_mtx, mtxf_mul_vec3s,
+};
+#endif
+
 /**
  * Extract a position given an object's transformation matrix and a camera matrix.
  * This is used for determining the world position of the held object: since objMtx
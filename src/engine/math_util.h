@@ -60,6 +60,25 @@ void mtxf_scale_vec3f(Mat4 dest, Mat4 mtx, Vec3f s);
 void mtxf_mul_vec3s(Mat4 mtx, Vec3s b);
 void mtxf_to_mtx(Mtx *dest, Mat4 src);
 void mtxf_rotate_xy(Mtx *mtx, s16 angle);
+#ifndef TARGET_N64
+/**
+ * The matrix kernels used by the graph node matrix stack. The strict SIMD
+ * kernels give the same bits as the scalar ones, the fast ones may fuse
+ * multiply-adds and differ from them in the last bits.
+ */
+struct MtxfKernels {
+    const char *name;
+    void (*mul)(Mat4 dest, Mat4 a, Mat4 b);
+    void (*rotate_zxy_and_translate)(Mat4 dest, Vec3f translate, Vec3s rotate);
+    void (*billboard)(Mat4 dest, Mat4 mtx, Vec3f position, s16 angle);
+    void (*to_mtx)(Mtx *dest, Mat4 src);
+    void (*mul_vec3s)(Mat4 mtx, Vec3s b);
+};
+
+extern const struct MtxfKernels gMtxfScalarKernels;
+extern const struct MtxfKernels gMtxfStrictSimdKernels;
+extern const struct MtxfKernels gMtxfFastSimdKernels;
+#endif
 void get_pos_from_transform_mtx(Vec3f dest, Mat4 objMtx, Mat4 camMtx);
 void vec3f_get_dist_and_angle(Vec3f from, Vec3f to, f32 *dist, s16 *pitch, s16 *yaw);
 void vec3f_set_dist_and_angle(Vec3f from, Vec3f to, f32  dist, s16  pitch, s16  yaw);
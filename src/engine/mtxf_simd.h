@@ -0,0 +1,67 @@
+#ifndef MTXF_SIMD_H
+#define MTXF_SIMD_H
+
+// Four lane float vectors for the matrix kernels in math_util.c, one lane per
+// matrix column. mtxf_simd_mul and mtxf_simd_add round like the scalar single
+// precision operations, and get contracted wherever those are. mtxf_simd_madd
+// rounds once where a fused multiply-add instruction is available, and only
+// the fast kernels use it.
+// MTXF_SIMD is left undefined when no supported instruction set is available
+// and the SIMD kernels are the scalar ones.
+
+#if defined(TARGET_N64)
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#ifdef __FMA__
+#include <immintrin.h>
+#endif
+
+#define MTXF_SIMD
+
+typedef __m128 mtxf_simd_t;
+
+#define mtxf_simd_load(p) _mm_loadu_ps(p)
+#define mtxf_simd_store(p, a) _mm_storeu_ps(p, a)
+#define mtxf_simd_set(x, y, z, w) _mm_setr_ps(x, y, z, w)
+#define mtxf_simd_set1(f) _mm_set1_ps(f)
+#define mtxf_simd_add(a, b) _mm_add_ps(a, b)
+#define mtxf_simd_mul(a, b) _mm_mul_ps(a, b)
+#ifdef __FMA__
+#define mtxf_simd_madd(a, b, c) _mm_fmadd_ps(a, b, c)
+#else
+#define mtxf_simd_madd(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#endif
+// Set the w lane to 0, or to 1 for the translation row
+#define mtxf_simd_clear_w(a) _mm_and_ps(a, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)))
+#define mtxf_simd_set_w1(a) _mm_or_ps(mtxf_simd_clear_w(a), _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f))
+// Truncate each lane to an integer, like a float to int cast
+#define mtxf_simd_to_s32(a, p) _mm_storeu_si128((__m128i *) (p), _mm_cvttps_epi32(a))
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define MTXF_SIMD
+
+typedef float32x4_t mtxf_simd_t;
+
+static inline float32x4_t mtxf_simd_set(float x, float y, float z, float w) {
+    float v[4] = { x, y, z, w };
+    return vld1q_f32(v);
+}
+
+#define mtxf_simd_load(p) vld1q_f32(p)
+#define mtxf_simd_store(p, a) vst1q_f32(p, a)
+#define mtxf_simd_set1(f) vdupq_n_f32(f)
+#define mtxf_simd_add(a, b) vaddq_f32(a, b)
+#define mtxf_simd_mul(a, b) vmulq_f32(a, b)
+#define mtxf_simd_madd(a, b, c) vfmaq_f32(c, a, b)
+#define mtxf_simd_clear_w(a) vsetq_lane_f32(0.0f, a, 3)
+#define mtxf_simd_set_w1(a) vsetq_lane_f32(1.0f, a, 3)
+#define mtxf_simd_to_s32(a, p) vst1q_s32(p, vcvtq_s32_f32(a))
+
+#endif
+
+#endif // MTXF_SIMD_H
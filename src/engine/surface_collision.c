@@ -1,157 +1,617 @@
 #include <PR/ultratypes.h>
 
+#define NO_COLLISION_QUERY_SITES
+
 #include "sm64.h"
 #include "game/debug.h"
 #include "game/level_update.h"
 #include "game/mario.h"
 #include "game/object_list_processor.h"
+#include "collision_trace.h"
 #include "surface_collision.h"
 #include "surface_load.h"
+#include "surface_simd.h"
+
+#ifdef SURFACE_SIMD_WIDTH
+#include <stdlib.h>
+#endif
+#ifndef TARGET_N64
+#include <string.h>
+#endif
+
+/**************************************************
+ *                 SURFACE MIRRORS                *
+ **************************************************/
+
+#ifdef SURFACE_SIMD_WIDTH
+
+/**
+ * A packed copy of one spatial partition list, one array per field, in the
+ * exact order of the list so the queries keep their first hit behavior. The
+ * queries test SURFACE_SIMD_WIDTH surfaces at a time against the fields a
+ * surface is most often rejected by, and only look at the candidates left.
+ * Floors and ceilings store the edges of their triangle (the vertex and the
+ * step to the next vertex), walls store their height range and plane.
+ */
+struct SurfaceListMirror {
+    struct Surface **surfaces;
+    s32 *edges;
+    f32 *planes;
+    s32 count;
+    s32 capacity;
+    u8 valid;
+};
+
+enum MirrorEdgeField {
+    EDGE_X1, EDGE_Z1, EDGE_DX1, EDGE_DZ1,
+    EDGE_X2, EDGE_Z2, EDGE_DX2, EDGE_DZ2,
+    EDGE_X3, EDGE_Z3, EDGE_DX3, EDGE_DZ3,
+    NUM_EDGE_FIELDS
+};
+
+enum MirrorPlaneField {
+    PLANE_LOWER_Y, PLANE_UPPER_Y,
+    PLANE_NX, PLANE_NY, PLANE_NZ, PLANE_ORIGIN_OFFSET,
+    NUM_PLANE_FIELDS
+};
+
+#define MIRROR_EDGES(mirror, field) (&(mirror)->edges[(field) * (mirror)->capacity])
+#define MIRROR_PLANES(mirror, field) (&(mirror)->planes[(field) * (mirror)->capacity])
+
+// Bits of the lanes that hold a surface in the step starting at i
+#define MIRROR_LANES(mirror, i) \
+    ((mirror)->count - (i) >= SURFACE_SIMD_WIDTH ? (1 << SURFACE_SIMD_WIDTH) - 1 \
+                                                 : (1 << ((mirror)->count - (i))) - 1)
+
+static struct SurfaceListMirror sSurfaceListMirrors[2][NUM_CELLS][NUM_CELLS][3];
+
+/**
+ * Copy a surface list into its mirror, growing the arrays if needed.
+ * Returns FALSE if there wasn't enough memory, the list is used directly then.
+ */
+static s32 build_surface_list_mirror(struct SurfaceListMirror *mirror, struct SurfaceNode *list,
+                                     s16 listIndex) {
+    struct SurfaceNode *node;
+    struct Surface *surf;
+    s32 count = 0;
+    s32 i;
+
+    for (node = list; node != NULL; node = node->next) {
+        count++;
+    }
+
+    if (count > mirror->capacity) {
+        s32 capacity = (count + SURFACE_SIMD_WIDTH - 1) & ~(SURFACE_SIMD_WIDTH - 1);
+
+        free(mirror->surfaces);
+        free(mirror->edges);
+        free(mirror->planes);
+        mirror->surfaces = calloc(capacity, sizeof(struct Surface *));
+        mirror->edges = NULL;
+        mirror->planes = NULL;
+        if (listIndex == SPATIAL_PARTITION_WALLS) {
+            mirror->planes = calloc(capacity * NUM_PLANE_FIELDS, sizeof(f32));
+        } else {
+            mirror->edges = calloc(capacity * NUM_EDGE_FIELDS, sizeof(s32));
+        }
+        mirror->capacity = capacity;
+
+        if (mirror->surfaces == NULL || (mirror->edges == NULL && mirror->planes == NULL)) {
+            free(mirror->surfaces);
+            free(mirror->edges);
+            free(mirror->planes);
+            mirror->surfaces = NULL;
+            mirror->edges = NULL;
+            mirror->planes = NULL;
+            mirror->capacity = 0;
+            return FALSE;
+        }
+    }
+
+    for (node = list, i = 0; node != NULL; node = node->next, i++) {
+        surf = node->surface;
+        mirror->surfaces[i] = surf;
+
+        if (listIndex == SPATIAL_PARTITION_WALLS) {
+            MIRROR_PLANES(mirror, PLANE_LOWER_Y)[i] = surf->lowerY;
+            MIRROR_PLANES(mirror, PLANE_UPPER_Y)[i] = surf->upperY;
+            MIRROR_PLANES(mirror, PLANE_NX)[i] = surf->normal.x;
+            MIRROR_PLANES(mirror, PLANE_NY)[i] = surf->normal.y;
+            MIRROR_PLANES(mirror, PLANE_NZ)[i] = surf->normal.z;
+            MIRROR_PLANES(mirror, PLANE_ORIGIN_OFFSET)[i] = surf->originOffset;
+        } else {
+            MIRROR_EDGES(mirror, EDGE_X1)[i] = surf->vertex1[0];
+            MIRROR_EDGES(mirror, EDGE_Z1)[i] = surf->vertex1[2];
+            MIRROR_EDGES(mirror, EDGE_DX1)[i] = surf->vertex2[0] - surf->vertex1[0];
+            MIRROR_EDGES(mirror, EDGE_DZ1)[i] = surf->vertex2[2] - surf->vertex1[2];
+            MIRROR_EDGES(mirror, EDGE_X2)[i] = surf->vertex2[0];
+            MIRROR_EDGES(mirror, EDGE_Z2)[i] = surf->vertex2[2];
+            MIRROR_EDGES(mirror, EDGE_DX2)[i] = surf->vertex3[0] - surf->vertex2[0];
+            MIRROR_EDGES(mirror, EDGE_DZ2)[i] = surf->vertex3[2] - surf->vertex2[2];
+            MIRROR_EDGES(mirror, EDGE_X3)[i] = surf->vertex3[0];
+            MIRROR_EDGES(mirror, EDGE_Z3)[i] = surf->vertex3[2];
+            MIRROR_EDGES(mirror, EDGE_DX3)[i] = surf->vertex1[0] - surf->vertex3[0];
+            MIRROR_EDGES(mirror, EDGE_DZ3)[i] = surf->vertex1[2] - surf->vertex3[2];
+        }
+    }
+
+    mirror->count = count;
+    mirror->valid = TRUE;
+    return TRUE;
+}
+
+/**
+ * Get the up to date mirror of a cell's surface list, or NULL if it couldn't be built.
+ */
+static struct SurfaceListMirror *get_surface_list_mirror(s32 dynamic, s16 cellX, s16 cellZ,
+                                                         s16 listIndex) {
+    struct SurfaceListMirror *mirror = &sSurfaceListMirrors[dynamic != 0][cellZ][cellX][listIndex];
+    struct SurfaceNode *list;
+
+    if (!mirror->valid) {
+        if (dynamic) {
+            list = gDynamicSurfacePartition[cellZ][cellX][listIndex].next;
+        } else {
+            list = gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+        }
+
+        if (!build_surface_list_mirror(mirror, list, listIndex)) {
+            return NULL;
+        }
+    }
+
+    return mirror;
+}
+
+/**
+ * Find which triangles of a floor or ceiling mirror contain a point laterally,
+ * for the SURFACE_SIMD_WIDTH surfaces starting at i. The edge tests are the
+ * same s32 math as find_floor_from_list and find_ceil_from_list.
+ */
+static s32 find_mirror_triangles_over_point(struct SurfaceListMirror *mirror, s32 i, s32 x, s32 z,
+                                            s16 listIndex) {
+    surface_simd_int_t px = surface_simd_set1_int(x);
+    surface_simd_int_t pz = surface_simd_set1_int(z);
+    surface_simd_int_t zero = surface_simd_set1_int(0);
+    surface_simd_int_t cross;
+    s32 outside = 0;
+    s32 edge;
+
+    for (edge = 0; edge < 3; edge++) {
+        s32 field = edge * 4;
+
+        cross = surface_simd_sub_int(
+            surface_simd_mul_int(surface_simd_sub_int(surface_simd_load_int(&MIRROR_EDGES(mirror, field + EDGE_Z1)[i]), pz),
+                                 surface_simd_load_int(&MIRROR_EDGES(mirror, field + EDGE_DX1)[i])),
+            surface_simd_mul_int(surface_simd_sub_int(surface_simd_load_int(&MIRROR_EDGES(mirror, field + EDGE_X1)[i]), px),
+                                 surface_simd_load_int(&MIRROR_EDGES(mirror, field + EDGE_DZ1)[i])));
+
+        if (listIndex == SPATIAL_PARTITION_FLOORS) {
+            outside |= surface_simd_cmpgt_int(zero, cross);
+        } else {
+            outside |= surface_simd_cmpgt_int(cross, zero);
+        }
+    }
+
+    return ~outside & MIRROR_LANES(mirror, i);
+}
+
+#endif
+
+/**************************************************
+ *                   QUERY CACHE                  *
+ **************************************************/
+
+#ifndef TARGET_N64
+
+#define QUERY_CACHE_SIZE 512
+#define MAX_QUERY_SITES  256
+
+enum CollisionQueryType {
+    QUERY_CEIL,
+    QUERY_FLOOR,
+    QUERY_FLOOR_INTANGIBLE
+};
+
+/**
+ * The result of a find_floor or find_ceil call. Those only depend on the
+ * position truncated to s16, the camera and intangible floor flags and the
+ * floor or ceiling lists of the position's cell, so an entry made since those
+ * lists last changed is exactly what the query would find again.
+ */
+struct CollisionQueryEntry {
+    u32 generation;
+    u32 listGeneration;
+    s16 x, y, z;
+    u8 type;
+    u8 camera;
+    u8 floorMiss; // no level floor was found, counted in gNumFindFloorMisses
+    struct Surface *surface;
+    f32 height;
+};
+
+/**
+ * Where the current query was made from, set by the find_floor and find_ceil
+ * macros in surface_collision.h.
+ */
+const char *gCollisionQueryFile;
+s32 gCollisionQueryLine;
+
+u8 gCollisionQueryCacheEnabled;
+
+/**
+ * Changes whenever a partition is cleared.
+ */
+static u32 sSurfaceGeneration = 1;
+
+/**
+ * Changes whenever a surface is added to one of a cell's lists, static or dynamic.
+ * A query only depends on the list of its own cell, so adding an object's
+ * surfaces elsewhere keeps it cached.
+ */
+static u32 sSurfaceListGenerations[NUM_CELLS][NUM_CELLS][3];
+
+static struct CollisionQueryEntry sCollisionQueryCache[QUERY_CACHE_SIZE];
+static struct CollisionQuerySite sCollisionQuerySites[MAX_QUERY_SITES];
+
+/**
+ * Enable or disable reusing find_floor and find_ceil results until the surfaces change.
+ */
+void set_collision_query_cache(s32 enable) {
+    gCollisionQueryCacheEnabled = enable;
+}
+
+/**
+ * Get the table of call sites the cache counts queries for, and return its size.
+ * Unused entries have a NULL file.
+ */
+s32 get_collision_query_sites(const struct CollisionQuerySite **sites) {
+    *sites = sCollisionQuerySites;
+    return MAX_QUERY_SITES;
+}
+
+/**
+ * Find the counters of the current query's call site, or add them.
+ * Queries made without a call site are counted together.
+ */
+static struct CollisionQuerySite *get_collision_query_site(void) {
+    const char *file = gCollisionQueryFile != NULL ? gCollisionQueryFile : "(unknown)";
+    s32 line = gCollisionQueryFile != NULL ? gCollisionQueryLine : 0;
+    u32 hash = (u32) line * 2654435761u;
+    s32 i;
+
+    gCollisionQueryFile = NULL;
+
+    for (i = 0; i < MAX_QUERY_SITES; i++) {
+        struct CollisionQuerySite *site = &sCollisionQuerySites[(hash + i) % MAX_QUERY_SITES];
+
+        if (site->file == NULL) {
+            site->file = file;
+            site->line = line;
+            return site;
+        }
+        if (site->line == line && (site->file == file || strcmp(site->file, file) == 0)) {
+            return site;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the cache entry of a query. Returns NULL if the cache is disabled,
+ * otherwise sets hit if the entry holds the query's result, and if it doesn't
+ * the caller stores the result in it.
+ */
+static struct CollisionQueryEntry *find_collision_query_entry(s32 type, s16 x, s16 y, s16 z, s32 *hit) {
+    struct CollisionQueryEntry *entry;
+    struct CollisionQuerySite *site;
+    s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    u32 listGeneration =
+        sSurfaceListGenerations[cellZ][cellX][type == QUERY_CEIL ? SPATIAL_PARTITION_CEILS
+                                                                 : SPATIAL_PARTITION_FLOORS];
+    u32 hash;
+
+    if (!gCollisionQueryCacheEnabled) {
+        return NULL;
+    }
+
+    hash = ((u16) x * 73856093u) ^ ((u16) y * 19349663u) ^ ((u16) z * 83492791u)
+           ^ (type * 2 + (gCheckingSurfaceCollisionsForCamera != 0));
+    entry = &sCollisionQueryCache[(hash ^ (hash >> 16)) % QUERY_CACHE_SIZE];
+
+    *hit = entry->generation == sSurfaceGeneration && entry->listGeneration == listGeneration
+           && entry->x == x && entry->y == y && entry->z == z
+           && entry->type == type && entry->camera == (gCheckingSurfaceCollisionsForCamera != 0);
+
+    site = get_collision_query_site();
+    if (site != NULL) {
+        site->calls++;
+        site->hits += *hit;
+    }
+
+    if (!*hit) {
+        entry->generation = sSurfaceGeneration;
+        entry->listGeneration = listGeneration;
+        entry->x = x;
+        entry->y = y;
+        entry->z = z;
+        entry->type = type;
+        entry->camera = gCheckingSurfaceCollisionsForCamera != 0;
+    }
+
+    return entry;
+}
+
+#endif
+
+/**
+ * Mark a surface list as changed so its mirror is rebuilt on the next query,
+ * and cached queries are made again.
+ */
+void surface_list_changed(UNUSED s32 dynamic, s16 cellX, s16 cellZ, s16 listIndex) {
+#ifndef TARGET_N64
+    sSurfaceListGenerations[cellZ][cellX][listIndex]++;
+#endif
+#ifdef SURFACE_SIMD_WIDTH
+    sSurfaceListMirrors[dynamic != 0][cellZ][cellX][listIndex].valid = FALSE;
+#endif
+}
+
+/**
+ * Mark every surface list of a spatial partition as changed.
+ */
+void surface_partition_changed(UNUSED s32 dynamic) {
+#ifdef SURFACE_SIMD_WIDTH
+    struct SurfaceListMirror *mirror = &sSurfaceListMirrors[dynamic != 0][0][0][0];
+    s32 i;
+
+    for (i = 0; i < NUM_CELLS * NUM_CELLS * 3; i++) {
+        mirror[i].valid = FALSE;
+    }
+#endif
+#ifndef TARGET_N64
+    sSurfaceGeneration++;
+#endif
+}
 
 /**************************************************
  *                      WALLS                     *
  **************************************************/
 
 /**
- * Iterate through the list of walls until all walls are checked and
- * have given their wall push.
+ * Check a wall against a point and, if they collide, give its wall push.
+ * Returns TRUE if the wall was collided with.
  */
-static s32 find_wall_collisions_from_list(struct SurfaceNode *surfaceNode,
-                                          struct WallCollisionData *data) {
-    register struct Surface *surf;
+static s32 check_wall_collision(register struct Surface *surf, struct WallCollisionData *data,
+                                register f32 x, register f32 y, register f32 z, register f32 radius) {
     register f32 offset;
-    register f32 radius = data->radius;
-    register f32 x = data->x;
-    register f32 y = data->y + data->offsetY;
-    register f32 z = data->z;
     register f32 px, pz;
     register f32 w1, w2, w3;
     register f32 y1, y2, y3;
-    s32 numCols = 0;
 
-    // Max collision radius = 200
-    if (radius > 200.0f) {
-        radius = 200.0f;
+    // Exclude a large number of walls immediately to optimize.
+    if (y < surf->lowerY || y > surf->upperY) {
+        return FALSE;
     }
 
-    // Stay in this loop until out of walls.
-    while (surfaceNode != NULL) {
-        surf = surfaceNode->surface;
-        surfaceNode = surfaceNode->next;
+    offset = surf->normal.x * x + surf->normal.y * y + surf->normal.z * z + surf->originOffset;
 
-        // Exclude a large number of walls immediately to optimize.
-        if (y < surf->lowerY || y > surf->upperY) {
-            continue;
-        }
-
-        offset = surf->normal.x * x + surf->normal.y * y + surf->normal.z * z + surf->originOffset;
-
-        if (offset < -radius || offset > radius) {
-            continue;
-        }
+    if (offset < -radius || offset > radius) {
+        return FALSE;
+    }
 
-        px = x;
-        pz = z;
+    px = x;
+    pz = z;
 
-        //! (Quantum Tunneling) Due to issues with the vertices walls choose and
-        //  the fact they are floating point, certain floating point positions
-        //  along the seam of two walls may collide with neither wall or both walls.
-        if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
-            w1 = -surf->vertex1[2];            w2 = -surf->vertex2[2];            w3 = -surf->vertex3[2];
-            y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
+    //! (Quantum Tunneling) Due to issues with the vertices walls choose and
+    //  the fact they are floating point, certain floating point positions
+    //  along the seam of two walls may collide with neither wall or both walls.
+    if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
+        w1 = -surf->vertex1[2];            w2 = -surf->vertex2[2];            w3 = -surf->vertex3[2];
+        y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
 
-            if (surf->normal.x > 0.0f) {
-                if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) > 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) > 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) > 0.0f) {
-                    continue;
-                }
-            } else {
-                if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) < 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) < 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) < 0.0f) {
-                    continue;
-                }
+        if (surf->normal.x > 0.0f) {
+            if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) > 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) > 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) > 0.0f) {
+                return FALSE;
             }
         } else {
-            w1 = surf->vertex1[0];            w2 = surf->vertex2[0];            w3 = surf->vertex3[0];
-            y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
-
-            if (surf->normal.z > 0.0f) {
-                if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) > 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) > 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) > 0.0f) {
-                    continue;
-                }
-            } else {
-                if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) < 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) < 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) < 0.0f) {
-                    continue;
-                }
+            if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) < 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) < 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) < 0.0f) {
+                return FALSE;
             }
         }
+    } else {
+        w1 = surf->vertex1[0];            w2 = surf->vertex2[0];            w3 = surf->vertex3[0];
+        y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
 
-        // Determine if checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
+        if (surf->normal.z > 0.0f) {
+            if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) > 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) > 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) > 0.0f) {
+                return FALSE;
             }
         } else {
-            // Ignore camera only surfaces.
-            if (surf->type == SURFACE_CAMERA_BOUNDARY) {
-                continue;
+            if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) < 0.0f) {
+                return FALSE;
             }
+            if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) < 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) < 0.0f) {
+                return FALSE;
+            }
+        }
+    }
+
+    // Determine if checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    } else {
+        // Ignore camera only surfaces.
+        if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+            return FALSE;
+        }
 
+        // If an object can pass through a vanish cap wall, pass through.
+        if (surf->type == SURFACE_VANISH_CAP_WALLS) {
             // If an object can pass through a vanish cap wall, pass through.
-            if (surf->type == SURFACE_VANISH_CAP_WALLS) {
-                // If an object can pass through a vanish cap wall, pass through.
-                if (gCurrentObject != NULL
-                    && (gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)) {
-                    continue;
-                }
+            if (gCurrentObject != NULL
+                && (gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)) {
+                return FALSE;
+            }
 
-                // If Mario has a vanish cap, pass through the vanish cap wall.
-                if (gCurrentObject != NULL && gCurrentObject == gMarioObject
-                    && (gMarioState->flags & MARIO_VANISH_CAP)) {
-                    continue;
-                }
+            // If Mario has a vanish cap, pass through the vanish cap wall.
+            if (gCurrentObject != NULL && gCurrentObject == gMarioObject
+                && (gMarioState->flags & MARIO_VANISH_CAP)) {
+                return FALSE;
             }
         }
+    }
 
-        //! (Wall Overlaps) Because this doesn't update the x and z local variables,
-        //  multiple walls can push mario more than is required.
-        data->x += surf->normal.x * (radius - offset);
-        data->z += surf->normal.z * (radius - offset);
+    //! (Wall Overlaps) Because this doesn't update the x and z local variables,
+    //  multiple walls can push mario more than is required.
+    data->x += surf->normal.x * (radius - offset);
+    data->z += surf->normal.z * (radius - offset);
 
-        //! (Unreferenced Walls) Since this only returns the first four walls,
-        //  this can lead to wall interaction being missed. Typically unreferenced walls
-        //  come from only using one wall, however.
-        if (data->numWalls < 4) {
-            data->walls[data->numWalls++] = surf;
-        }
+    //! (Unreferenced Walls) Since this only returns the first four walls,
+    //  this can lead to wall interaction being missed. Typically unreferenced walls
+    //  come from only using one wall, however.
+    if (data->numWalls < 4) {
+        data->walls[data->numWalls++] = surf;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Iterate through the list of walls until all walls are checked and
+ * have given their wall push.
+ */
+static s32 find_wall_collisions_from_list(struct SurfaceNode *surfaceNode,
+                                          struct WallCollisionData *data) {
+    register f32 radius = data->radius;
+    register f32 x = data->x;
+    register f32 y = data->y + data->offsetY;
+    register f32 z = data->z;
+    s32 numCols = 0;
 
-        numCols++;
+    // Max collision radius = 200
+    if (radius > 200.0f) {
+        radius = 200.0f;
+    }
+
+    // Stay in this loop until out of walls.
+    while (surfaceNode != NULL) {
+        numCols += check_wall_collision(surfaceNode->surface, data, x, y, z, radius);
+        surfaceNode = surfaceNode->next;
+    }
+
+    return numCols;
+}
+
+#ifdef SURFACE_SIMD_WIDTH
+/**
+ * find_wall_collisions_from_list over a mirror. The height range and plane
+ * distance are checked for several walls at once. The distance bound is
+ * widened by a tiny fraction of the magnitudes involved, so a different
+ * rounding of the plane equation never drops a wall that check_wall_collision
+ * would have pushed from.
+ */
+static s32 find_wall_collisions_from_mirror(struct SurfaceListMirror *mirror,
+                                            struct WallCollisionData *data) {
+    f32 radius = data->radius;
+    f32 x = data->x;
+    f32 y = data->y + data->offsetY;
+    f32 z = data->z;
+    s32 numCols = 0;
+    s32 i, lane, hits;
+
+    surface_simd_t px, py, pz, magnitude, tolerance, bound;
+    surface_simd_t nx, ny, nz, oo, offset;
+
+    // Max collision radius = 200
+    if (radius > 200.0f) {
+        radius = 200.0f;
+    }
+
+    px = surface_simd_set1(x);
+    py = surface_simd_set1(y);
+    pz = surface_simd_set1(z);
+    magnitude = surface_simd_set1((x < 0.0f ? -x : x) + (y < 0.0f ? -y : y) + (z < 0.0f ? -z : z));
+    tolerance = surface_simd_set1(1.0f / 65536.0f);
+    bound = surface_simd_set1(radius);
+
+    for (i = 0; i < mirror->count; i += SURFACE_SIMD_WIDTH) {
+        hits = surface_simd_cmplt(py, surface_simd_load(&MIRROR_PLANES(mirror, PLANE_LOWER_Y)[i]))
+             | surface_simd_cmpgt(py, surface_simd_load(&MIRROR_PLANES(mirror, PLANE_UPPER_Y)[i]));
+
+        nx = surface_simd_load(&MIRROR_PLANES(mirror, PLANE_NX)[i]);
+        ny = surface_simd_load(&MIRROR_PLANES(mirror, PLANE_NY)[i]);
+        nz = surface_simd_load(&MIRROR_PLANES(mirror, PLANE_NZ)[i]);
+        oo = surface_simd_load(&MIRROR_PLANES(mirror, PLANE_ORIGIN_OFFSET)[i]);
+
+        offset = surface_simd_add(surface_simd_add(surface_simd_add(surface_simd_mul(nx, px),
+                                                                    surface_simd_mul(ny, py)),
+                                                   surface_simd_mul(nz, pz)),
+                                  oo);
+        hits |= surface_simd_cmpgt(
+            surface_simd_abs(offset),
+            surface_simd_add(bound, surface_simd_mul(surface_simd_add(magnitude, surface_simd_abs(oo)), tolerance)));
+
+        // Walls that weren't excluded get the full check, in list order
+        hits = ~hits & MIRROR_LANES(mirror, i);
+        while (hits != 0) {
+            lane = __builtin_ctz(hits);
+            hits &= hits - 1;
+            numCols += check_wall_collision(mirror->surfaces[i + lane], data, x, y, z, radius);
+        }
     }
 
     return numCols;
 }
+#endif
+
+/**
+ * Find the wall collisions in one cell of a spatial partition.
+ */
+static s32 find_wall_collisions_in_cell(s32 dynamic, s16 cellX, s16 cellZ,
+                                        struct WallCollisionData *data) {
+    struct SurfaceNode *node;
+#ifdef SURFACE_SIMD_WIDTH
+    struct SurfaceListMirror *mirror = get_surface_list_mirror(dynamic, cellX, cellZ, SPATIAL_PARTITION_WALLS);
+
+    if (mirror != NULL) {
+        return find_wall_collisions_from_mirror(mirror, data);
+    }
+#endif
+
+    if (dynamic) {
+        node = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
+    } else {
+        node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
+    }
+
+    return find_wall_collisions_from_list(node, data);
+}
 
 /**
  * Formats the position and wall search for find_wall_collisions.
@@ -182,12 +642,18 @@ s32 f32_find_wall_collision(f32 *xPtr, f32 *yPtr, f32 *zPtr, f32 offsetY, f32 ra
  * Find wall collisions and receive their push.
  */
 s32 find_wall_collisions(struct WallCollisionData *colData) {
-    struct SurfaceNode *node;
     s16 cellX, cellZ;
     s32 numCollisions = 0;
     s16 x = colData->x;
     s16 z = colData->z;
 
+#ifndef TARGET_N64
+    if (gCollisionTraceEnabled) {
+        trace_collision_query(COLLISION_TRACE_WALLS, colData->x, colData->y, colData->z, colData->offsetY,
+                              colData->radius);
+    }
+#endif
+
     colData->numWalls = 0;
 
     if (x <= -LEVEL_BOUNDARY_MAX || x >= LEVEL_BOUNDARY_MAX) {
@@ -203,12 +669,10 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
     cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
-    node = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
-    numCollisions += find_wall_collisions_from_list(node, colData);
+    numCollisions += find_wall_collisions_in_cell(TRUE, cellX, cellZ, colData);
 
     // Check for surfaces that are a part of level geometry.
-    node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
-    numCollisions += find_wall_collisions_from_list(node, colData);
+    numCollisions += find_wall_collisions_in_cell(FALSE, cellX, cellZ, colData);
 
     // Increment the debug tracker.
     gNumCalls.wall += 1;
@@ -220,6 +684,50 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
  *                     CEILINGS                   *
  **************************************************/
 
+/**
+ * Check whether a ceiling that is laterally over a point should be collided with,
+ * and find its height at that point.
+ */
+static s32 check_ceil_height(struct Surface *surf, s32 x, s32 y, s32 z, f32 *pheight) {
+    f32 nx, ny, nz, oo;
+    f32 height;
+
+    // Determine if checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera != 0) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    }
+    // Ignore camera only surfaces.
+    else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+        return FALSE;
+    }
+
+    nx = surf->normal.x;
+    ny = surf->normal.y;
+    nz = surf->normal.z;
+    oo = surf->originOffset;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (ny == 0.0f) {
+        return FALSE;
+    }
+
+    // Find the ceil height at the specific point.
+    height = -(x * nx + nz * z + oo) / ny;
+
+    // Checks for ceiling interaction with a 78 unit buffer.
+    //! (Exposed Ceilings) Because any point above a ceiling counts
+    //  as interacting with a ceiling, ceilings far below can cause
+    // "invisible walls" that are really just exposed ceilings.
+    if (y - (height - -78.0f) > 0.0f) {
+        return FALSE;
+    }
+
+    *pheight = height;
+    return TRUE;
+}
+
 /**
  * Iterate through the list of ceilings and find the first ceiling over a given point.
  */
@@ -255,49 +763,62 @@ static struct Surface *find_ceil_from_list(struct SurfaceNode *surfaceNode, s32
             continue;
         }
 
-        // Determine if checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera != 0) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
-            }
-        }
-        // Ignore camera only surfaces.
-        else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
-            continue;
+        if (check_ceil_height(surf, x, y, z, pheight)) {
+            ceil = surf;
+            break;
         }
+    }
 
-        {
-            f32 nx = surf->normal.x;
-            f32 ny = surf->normal.y;
-            f32 nz = surf->normal.z;
-            f32 oo = surf->originOffset;
-            f32 height;
+    //! (Surface Cucking) Since only the first ceil is returned and not the lowest,
+    //  lower ceilings can be "cucked" by higher ceilings.
+    return ceil;
+}
 
-            // If a wall, ignore it. Likely a remnant, should never occur.
-            if (ny == 0.0f) {
-                continue;
+#ifdef SURFACE_SIMD_WIDTH
+/**
+ * find_ceil_from_list over a mirror.
+ */
+static struct Surface *find_ceil_from_mirror(struct SurfaceListMirror *mirror, s32 x, s32 y, s32 z,
+                                          f32 *pheight) {
+    s32 i, lane, hits;
+
+    for (i = 0; i < mirror->count; i += SURFACE_SIMD_WIDTH) {
+        hits = find_mirror_triangles_over_point(mirror, i, x, z, SPATIAL_PARTITION_CEILS);
+
+        while (hits != 0) {
+            lane = __builtin_ctz(hits);
+            hits &= hits - 1;
+            if (check_ceil_height(mirror->surfaces[i + lane], x, y, z, pheight)) {
+                return mirror->surfaces[i + lane];
             }
+        }
+    }
 
-            // Find the ceil height at the specific point.
-            height = -(x * nx + nz * z + oo) / ny;
+    return NULL;
+}
+#endif
 
-            // Checks for ceiling interaction with a 78 unit buffer.
-            //! (Exposed Ceilings) Because any point above a ceiling counts
-            //  as interacting with a ceiling, ceilings far below can cause
-            // "invisible walls" that are really just exposed ceilings.
-            if (y - (height - -78.0f) > 0.0f) {
-                continue;
-            }
+/**
+ * Find the first ceiling over a point in one cell of a spatial partition.
+ */
+static struct Surface *find_ceil_in_cell(s32 dynamic, s16 cellX, s16 cellZ, s32 x, s32 y, s32 z,
+                                        f32 *pheight) {
+    struct SurfaceNode *surfaceList;
+#ifdef SURFACE_SIMD_WIDTH
+    struct SurfaceListMirror *mirror = get_surface_list_mirror(dynamic, cellX, cellZ, SPATIAL_PARTITION_CEILS);
 
-            *pheight = height;
-            ceil = surf;
-            break;
-        }
+    if (mirror != NULL) {
+        return find_ceil_from_mirror(mirror, x, y, z, pheight);
     }
+#endif
 
-    //! (Surface Cucking) Since only the first ceil is returned and not the lowest,
-    //  lower ceilings can be "cucked" by higher ceilings.
-    return ceil;
+    if (dynamic) {
+        surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
+    } else {
+        surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
+    }
+
+    return find_ceil_from_list(surfaceList, x, y, z, pheight);
 }
 
 /**
@@ -306,10 +827,17 @@ static struct Surface *find_ceil_from_list(struct SurfaceNode *surfaceNode, s32
 f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil) {
     s16 cellZ, cellX;
     struct Surface *ceil, *dynamicCeil;
-    struct SurfaceNode *surfaceList;
     f32 height = CELL_HEIGHT_LIMIT;
     f32 dynamicHeight = CELL_HEIGHT_LIMIT;
     s16 x, y, z;
+#ifndef TARGET_N64
+    struct CollisionQueryEntry *entry;
+    s32 hit;
+
+    if (gCollisionTraceEnabled) {
+        trace_collision_query(COLLISION_TRACE_CEIL, posX, posY, posZ, 0.0f, 0.0f);
+    }
+#endif
 
     //! (Parallel Universes) Because position is casted to an s16, reaching higher
     // float locations  can return ceilings despite them not existing there.
@@ -326,17 +854,24 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil) {
         return height;
     }
 
+#ifndef TARGET_N64
+    entry = find_collision_query_entry(QUERY_CEIL, x, y, z, &hit);
+    if (entry != NULL && hit) {
+        *pceil = entry->surface;
+        gNumCalls.ceil += 1;
+        return entry->height;
+    }
+#endif
+
     // Each level is split into cells to limit load, find the appropriate cell.
     cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
     cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
-    surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
-    dynamicCeil = find_ceil_from_list(surfaceList, x, y, z, &dynamicHeight);
+    dynamicCeil = find_ceil_in_cell(TRUE, cellX, cellZ, x, y, z, &dynamicHeight);
 
     // Check for surfaces that are a part of level geometry.
-    surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
-    ceil = find_ceil_from_list(surfaceList, x, y, z, &height);
+    ceil = find_ceil_in_cell(FALSE, cellX, cellZ, x, y, z, &height);
 
     if (dynamicHeight < height) {
         ceil = dynamicCeil;
@@ -345,6 +880,13 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil) {
 
     *pceil = ceil;
 
+#ifndef TARGET_N64
+    if (entry != NULL) {
+        entry->surface = ceil;
+        entry->height = height;
+    }
+#endif
+
     // Increment the debug tracker.
     gNumCalls.ceil += 1;
 
@@ -393,15 +935,53 @@ f32 find_floor_height_and_data(f32 xPos, f32 yPos, f32 zPos, struct FloorGeometr
     return floorHeight;
 }
 
+/**
+ * Check whether a floor that is laterally under a point should be collided with,
+ * and find its height at that point.
+ */
+static s32 check_floor_height(struct Surface *surf, s32 x, s32 y, s32 z, f32 *pheight) {
+    f32 nx, ny, nz;
+    f32 oo;
+    f32 height;
+
+    // Determine if we are checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera != 0) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    }
+    // If we are not checking for the camera, ignore camera only floors.
+    else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+        return FALSE;
+    }
+
+    nx = surf->normal.x;
+    ny = surf->normal.y;
+    nz = surf->normal.z;
+    oo = surf->originOffset;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (ny == 0.0f) {
+        return FALSE;
+    }
+
+    // Find the height of the floor at a given location.
+    height = -(x * nx + nz * z + oo) / ny;
+    // Checks for floor interaction with a 78 unit buffer.
+    if (y - (height + -78.0f) < 0.0f) {
+        return FALSE;
+    }
+
+    *pheight = height;
+    return TRUE;
+}
+
 /**
  * Iterate through the list of floors and find the first floor under a given point.
  */
 static struct Surface *find_floor_from_list(struct SurfaceNode *surfaceNode, s32 x, s32 y, s32 z, f32 *pheight) {
     register struct Surface *surf;
     register s32 x1, z1, x2, z2, x3, z3;
-    f32 nx, ny, nz;
-    f32 oo;
-    f32 height;
     struct Surface *floor = NULL;
 
     // Iterate through the list of floors until there are no more floors.
@@ -430,42 +1010,62 @@ static struct Surface *find_floor_from_list(struct SurfaceNode *surfaceNode, s32
             continue;
         }
 
-        // Determine if we are checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera != 0) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
-            }
-        }
-        // If we are not checking for the camera, ignore camera only floors.
-        else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
-            continue;
+        if (check_floor_height(surf, x, y, z, pheight)) {
+            floor = surf;
+            break;
         }
+    }
 
-        nx = surf->normal.x;
-        ny = surf->normal.y;
-        nz = surf->normal.z;
-        oo = surf->originOffset;
+    //! (Surface Cucking) Since only the first floor is returned and not the highest,
+    //  higher floors can be "cucked" by lower floors.
+    return floor;
+}
 
-        // If a wall, ignore it. Likely a remnant, should never occur.
-        if (ny == 0.0f) {
-            continue;
+#ifdef SURFACE_SIMD_WIDTH
+/**
+ * find_floor_from_list over a mirror.
+ */
+static struct Surface *find_floor_from_mirror(struct SurfaceListMirror *mirror, s32 x, s32 y, s32 z,
+                                          f32 *pheight) {
+    s32 i, lane, hits;
+
+    for (i = 0; i < mirror->count; i += SURFACE_SIMD_WIDTH) {
+        hits = find_mirror_triangles_over_point(mirror, i, x, z, SPATIAL_PARTITION_FLOORS);
+
+        while (hits != 0) {
+            lane = __builtin_ctz(hits);
+            hits &= hits - 1;
+            if (check_floor_height(mirror->surfaces[i + lane], x, y, z, pheight)) {
+                return mirror->surfaces[i + lane];
+            }
         }
+    }
 
-        // Find the height of the floor at a given location.
-        height = -(x * nx + nz * z + oo) / ny;
-        // Checks for floor interaction with a 78 unit buffer.
-        if (y - (height + -78.0f) < 0.0f) {
-            continue;
-        }
+    return NULL;
+}
+#endif
+
+/**
+ * Find the first floor under a point in one cell of a spatial partition.
+ */
+static struct Surface *find_floor_in_cell(s32 dynamic, s16 cellX, s16 cellZ, s32 x, s32 y, s32 z,
+                                        f32 *pheight) {
+    struct SurfaceNode *surfaceList;
+#ifdef SURFACE_SIMD_WIDTH
+    struct SurfaceListMirror *mirror = get_surface_list_mirror(dynamic, cellX, cellZ, SPATIAL_PARTITION_FLOORS);
 
-        *pheight = height;
-        floor = surf;
-        break;
+    if (mirror != NULL) {
+        return find_floor_from_mirror(mirror, x, y, z, pheight);
     }
+#endif
 
-    //! (Surface Cucking) Since only the first floor is returned and not the highest,
-    //  higher floors can be "cucked" by lower floors.
-    return floor;
+    if (dynamic) {
+        surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+    } else {
+        surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+    }
+
+    return find_floor_from_list(surfaceList, x, y, z, pheight);
 }
 
 /**
@@ -484,7 +1084,6 @@ f32 find_floor_height(f32 x, f32 y, f32 z) {
  * and dynamic floors were checked separately.
  */
 f32 unused_find_dynamic_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
-    struct SurfaceNode *surfaceList;
     struct Surface *floor;
     f32 floorHeight = FLOOR_LOWER_LIMIT;
 
@@ -497,8 +1096,7 @@ f32 unused_find_dynamic_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfl
     s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
     s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
-    surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
-    floor = find_floor_from_list(surfaceList, x, y, z, &floorHeight);
+    floor = find_floor_in_cell(TRUE, cellX, cellZ, x, y, z, &floorHeight);
 
     *pfloor = floor;
 
@@ -512,7 +1110,6 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
     s16 cellZ, cellX;
 
     struct Surface *floor, *dynamicFloor;
-    struct SurfaceNode *surfaceList;
 
     f32 height = FLOOR_LOWER_LIMIT;
     f32 dynamicHeight = FLOOR_LOWER_LIMIT;
@@ -524,6 +1121,15 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
     s16 y = (s16) yPos;
     s16 z = (s16) zPos;
 
+#ifndef TARGET_N64
+    struct CollisionQueryEntry *entry;
+    s32 hit;
+
+    if (gCollisionTraceEnabled) {
+        trace_collision_query(COLLISION_TRACE_FLOOR, xPos, yPos, zPos, 0.0f, 0.0f);
+    }
+#endif
+
     *pfloor = NULL;
 
     if (x <= -LEVEL_BOUNDARY_MAX || x >= LEVEL_BOUNDARY_MAX) {
@@ -533,17 +1139,29 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
         return height;
     }
 
+#ifndef TARGET_N64
+    entry = find_collision_query_entry(gFindFloorIncludeSurfaceIntangible ? QUERY_FLOOR_INTANGIBLE : QUERY_FLOOR,
+                                       x, y, z, &hit);
+    if (entry != NULL && hit) {
+        gFindFloorIncludeSurfaceIntangible = FALSE;
+        if (entry->floorMiss) {
+            gNumFindFloorMisses += 1;
+        }
+        *pfloor = entry->surface;
+        gNumCalls.floor += 1;
+        return entry->height;
+    }
+#endif
+
     // Each level is split into cells to limit load, find the appropriate cell.
     cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
     cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
-    surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
-    dynamicFloor = find_floor_from_list(surfaceList, x, y, z, &dynamicHeight);
+    dynamicFloor = find_floor_in_cell(TRUE, cellX, cellZ, x, y, z, &dynamicHeight);
 
     // Check for surfaces that are a part of level geometry.
-    surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
-    floor = find_floor_from_list(surfaceList, x, y, z, &height);
+    floor = find_floor_in_cell(FALSE, cellX, cellZ, x, y, z, &height);
 
     // To prevent the Merry-Go-Round room from loading when Mario passes above the hole that leads
     // there, SURFACE_INTANGIBLE is used. This prevent the wrong room from loading, but can also allow
@@ -554,7 +1172,7 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
         //  (happens when there is no floor under the SURFACE_INTANGIBLE floor) but returns the height
         //  of the SURFACE_INTANGIBLE floor instead of the typical -11000 returned for a NULL floor.
         if (floor != NULL && floor->type == SURFACE_INTANGIBLE) {
-            floor = find_floor_from_list(surfaceList, x, (s32)(height - 200.0f), z, &height);
+            floor = find_floor_in_cell(FALSE, cellX, cellZ, x, (s32)(height - 200.0f), z, &height);
         }
     } else {
         // To prevent accidentally leaving the floor tangible, stop checking for it.
@@ -566,6 +1184,12 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
         gNumFindFloorMisses += 1;
     }
 
+#ifndef TARGET_N64
+    if (entry != NULL) {
+        entry->floorMiss = floor == NULL;
+    }
+#endif
+
     if (dynamicHeight > height) {
         floor = dynamicFloor;
         height = dynamicHeight;
@@ -573,6 +1197,13 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
 
     *pfloor = floor;
 
+#ifndef TARGET_N64
+    if (entry != NULL) {
+        entry->surface = floor;
+        entry->height = height;
+    }
+#endif
+
     // Increment the debug tracker.
     gNumCalls.floor += 1;
 
@@ -594,6 +1225,12 @@ f32 find_water_level(f32 x, f32 z) {
     f32 waterLevel = FLOOR_LOWER_LIMIT;
     s16 *p = gEnvironmentRegions;
 
+#ifndef TARGET_N64
+    if (gCollisionTraceEnabled) {
+        trace_collision_query(COLLISION_TRACE_WATER, x, 0.0f, z, 0.0f, 0.0f);
+    }
+#endif
+
     if (p != NULL) {
         numRegions = *p++;
 
@@ -45,5 +45,40 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor);
 f32 find_water_level(f32 x, f32 z);
 f32 find_poison_gas_level(f32 x, f32 z);
 void debug_surface_list_info(f32 xPos, f32 zPos);
+void surface_list_changed(s32 dynamic, s16 cellX, s16 cellZ, s16 listIndex);
+void surface_partition_changed(s32 dynamic);
+
+#ifndef TARGET_N64
+/**
+ * Counters of the floor and ceiling queries made from one place in the code.
+ */
+struct CollisionQuerySite {
+    const char *file;
+    s32 line;
+    u32 calls;
+    u32 hits;
+};
+
+extern u8 gCollisionQueryCacheEnabled;
+extern const char *gCollisionQueryFile;
+extern s32 gCollisionQueryLine;
+
+void set_collision_query_cache(s32 enable);
+s32 get_collision_query_sites(const struct CollisionQuerySite **sites);
+
+// Record where each query is made from, for the query cache's counters
+#define COLLISION_QUERY_SITE                                                                \
+    (gCollisionQueryCacheEnabled                                                            \
+         ? (void) (gCollisionQueryFile = __FILE__, gCollisionQueryLine = __LINE__)          \
+         : (void) 0)
+
+#ifndef NO_COLLISION_QUERY_SITES
+#define find_ceil(posX, posY, posZ, pceil) (COLLISION_QUERY_SITE, find_ceil(posX, posY, posZ, pceil))
+#define find_floor(xPos, yPos, zPos, pfloor) (COLLISION_QUERY_SITE, find_floor(xPos, yPos, zPos, pfloor))
+#define find_floor_height(x, y, z) (COLLISION_QUERY_SITE, find_floor_height(x, y, z))
+#define find_floor_height_and_data(xPos, yPos, zPos, floorGeo) \
+    (COLLISION_QUERY_SITE, find_floor_height_and_data(xPos, yPos, zPos, floorGeo))
+#endif
+#endif
 
 #endif // SURFACE_COLLISION_H
@@ -1,8 +1,14 @@
 #include <PR/ultratypes.h>
+#ifdef USE_SYSTEM_MALLOC
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 #include "prevent_bss_reordering.h"
 
 #include "sm64.h"
+#include "game/area.h"
 #include "game/ingame_menu.h"
 #include "graph_node.h"
 #include "behavior_script.h"
@@ -13,6 +19,7 @@
 #include "surface_collision.h"
 #include "game/mario.h"
 #include "game/object_list_processor.h"
+#include "collision_trace.h"
 #include "surface_load.h"
 
 s32 unused8038BE90;
@@ -24,15 +31,86 @@ s32 unused8038BE90;
 SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
 SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
 
+/**
+ * The number of surfaces and surface nodes the original fixed pools hold.
+ */
+#define SURFACE_POOL_SIZE 2300
+#define SURFACE_NODE_POOL_SIZE 7000
+
 /**
  * Pools of data to contain either surface nodes or surfaces.
  */
 #ifdef USE_SYSTEM_MALLOC
-static struct AllocOnlyPool *sStaticSurfaceNodePool;
-static struct AllocOnlyPool *sStaticSurfacePool;
-static struct AllocOnlyPool *sDynamicSurfaceNodePool;
-static struct AllocOnlyPool *sDynamicSurfacePool;
+/**
+ * A pool of same sized items, kept in malloc'd chunks that are each twice as
+ * big as the one before. Clearing the pool only rewinds it to the first chunk
+ * and keeps the memory, so once the dynamic pools have grown to fit the busiest
+ * frame they are reset every frame without calling malloc or free.
+ */
+struct SurfacePoolChunk {
+    struct SurfacePoolChunk *next;
+    s32 capacity;
+};
+
+struct SurfacePool {
+    struct SurfacePoolChunk *firstChunk;
+    struct SurfacePoolChunk *chunk;
+    s32 itemSize;
+    s32 used;
+};
+
+#define SURFACE_POOL_FIRST_CHUNK 256
+
+static struct SurfacePool sStaticSurfaceNodePool = { NULL, NULL, sizeof(struct SurfaceNode), 0 };
+static struct SurfacePool sStaticSurfacePool = { NULL, NULL, sizeof(struct Surface), 0 };
+static struct SurfacePool sDynamicSurfaceNodePool = { NULL, NULL, sizeof(struct SurfaceNode), 0 };
+static struct SurfacePool sDynamicSurfacePool = { NULL, NULL, sizeof(struct Surface), 0 };
 static u8 sStaticSurfaceLoadComplete;
+
+/**
+ * The most surfaces and surface nodes loaded at once in the current level,
+ * static and dynamic together, and the most static ones in any of its areas.
+ */
+static struct {
+    s16 level;
+    s32 staticSurfaces;
+    s32 staticNodes;
+    s32 surfaces;
+    s32 nodes;
+} sSurfacePoolPeaks;
+
+static s32 sSurfacePoolStats;
+
+/**
+ * The surfaces last loaded by each object slot, kept between frames. An object
+ * whose transform hasn't changed adds them to the partition again instead of
+ * transforming its vertices and rebuilding them, and one that moved rebuilds
+ * them in place. The partition itself is still rebuilt every frame in object
+ * order, so list order and collision results are the same as before.
+ */
+struct ObjectSurfaceCache {
+    const BehaviorScript *behavior;
+    s16 *collisionData;
+    Mat4 transform;
+    struct Surface *surfaces;
+    s32 numSurfaces;
+    s32 capacity;
+    u32 loadedFrame;
+};
+
+static struct ObjectSurfaceCache sObjectSurfaceCaches[OBJECT_POOL_CAPACITY];
+static u8 sObjectSurfaceCacheEnabled = TRUE;
+
+/**
+ * The cache that alloc_surface takes surfaces from while an object is loaded.
+ */
+static struct ObjectSurfaceCache *sLoadingSurfaceCache;
+
+/**
+ * Counts the dynamic partition clears, to tell if an object already loaded its
+ * surfaces since the last one.
+ */
+static u32 sDynamicSurfaceFrame = 1;
 #else
 struct SurfaceNode *sSurfaceNodePool;
 struct Surface *sSurfacePool;
@@ -46,16 +124,121 @@ s16 sSurfacePoolSize;
 
 u8 unused8038EEA8[0x30];
 
+#ifdef USE_SYSTEM_MALLOC
+/**
+ * Take an item from a pool, moving on to the next chunk when the current one
+ * is full and adding a chunk when there is no next one.
+ */
+static void *surface_pool_alloc(struct SurfacePool *pool) {
+    struct SurfacePoolChunk *chunk = pool->chunk;
+    s32 capacity;
+
+    if (chunk == NULL || pool->used == chunk->capacity) {
+        if (chunk != NULL && chunk->next != NULL) {
+            chunk = chunk->next;
+        } else {
+            capacity = chunk != NULL ? chunk->capacity * 2 : SURFACE_POOL_FIRST_CHUNK;
+            chunk = malloc(sizeof(struct SurfacePoolChunk) + capacity * pool->itemSize);
+            if (chunk == NULL) {
+                abort();
+            }
+            chunk->next = NULL;
+            chunk->capacity = capacity;
+
+            if (pool->chunk != NULL) {
+                pool->chunk->next = chunk;
+            } else {
+                pool->firstChunk = chunk;
+            }
+        }
+        pool->chunk = chunk;
+        pool->used = 0;
+    }
+
+    return (u8 *) (chunk + 1) + pool->itemSize * pool->used++;
+}
+
+/**
+ * Give back everything taken from a pool, keeping its chunks for reuse.
+ */
+static void surface_pool_clear(struct SurfacePool *pool) {
+    pool->chunk = pool->firstChunk;
+    pool->used = 0;
+}
+
+/**
+ * Print the peak surface counts of the level that is being left. Levels that
+ * would have overflowed the original fixed pools are always reported.
+ */
+static void report_surface_pool_peaks(void) {
+    if (sSurfacePoolPeaks.surfaces == 0) {
+        return;
+    }
+
+    if (sSurfacePoolStats) {
+        fprintf(stderr, "Surface pools for level %d: %d static surfaces, %d static nodes, "
+                        "peak %d surfaces, %d nodes\n",
+                sSurfacePoolPeaks.level, sSurfacePoolPeaks.staticSurfaces,
+                sSurfacePoolPeaks.staticNodes, sSurfacePoolPeaks.surfaces, sSurfacePoolPeaks.nodes);
+    }
+    if (sSurfacePoolPeaks.surfaces > SURFACE_POOL_SIZE || sSurfacePoolPeaks.nodes > SURFACE_NODE_POOL_SIZE) {
+        fprintf(stderr, "Level %d used %d surfaces and %d surface nodes, more than the %d and %d "
+                        "the original pools hold\n",
+                sSurfacePoolPeaks.level, sSurfacePoolPeaks.surfaces, sSurfacePoolPeaks.nodes,
+                SURFACE_POOL_SIZE, SURFACE_NODE_POOL_SIZE);
+    }
+
+    memset(&sSurfacePoolPeaks, 0, sizeof(sSurfacePoolPeaks));
+}
+
+/**
+ * Record the surfaces allocated right now in the level's peaks.
+ */
+static void update_surface_pool_peaks(void) {
+    if (gSurfacesAllocated > sSurfacePoolPeaks.surfaces) {
+        sSurfacePoolPeaks.surfaces = gSurfacesAllocated;
+    }
+    if (gSurfaceNodesAllocated > sSurfacePoolPeaks.nodes) {
+        sSurfacePoolPeaks.nodes = gSurfaceNodesAllocated;
+    }
+}
+
+/**
+ * Print the peak surface counts of every level as it is left, and of the last
+ * one at exit.
+ */
+void set_surface_pool_stats(s32 enable) {
+    if (enable && !sSurfacePoolStats) {
+        atexit(report_surface_pool_peaks);
+    }
+    sSurfacePoolStats = enable;
+}
+
+/**
+ * Enable or disable keeping object surfaces between frames. It is on by default.
+ */
+void set_object_surface_cache(s32 enable) {
+    sObjectSurfaceCacheEnabled = enable;
+}
+#endif
+
 /**
  * Allocate the part of the surface node pool to contain a surface node.
  */
 static struct SurfaceNode *alloc_surface_node(void) {
 #ifdef USE_SYSTEM_MALLOC
-    struct AllocOnlyPool *pool = !sStaticSurfaceLoadComplete ?
-                                 sStaticSurfaceNodePool : sDynamicSurfaceNodePool;
-    struct SurfaceNode *node = alloc_only_pool_alloc(pool, sizeof(struct SurfaceNode));
+    struct SurfaceNode *node = surface_pool_alloc(!sStaticSurfaceLoadComplete ?
+                                                  &sStaticSurfaceNodePool : &sDynamicSurfaceNodePool);
 #else
-    struct SurfaceNode *node = &sSurfaceNodePool[gSurfaceNodesAllocated];
+    struct SurfaceNode *node;
+
+#ifdef AVOID_UB
+    // The pool can't grow, so once it is full no more nodes are handed out
+    if (gSurfaceNodesAllocated >= SURFACE_NODE_POOL_SIZE) {
+        return NULL;
+    }
+#endif
+    node = &sSurfaceNodePool[gSurfaceNodesAllocated];
 #endif
     gSurfaceNodesAllocated++;
 
@@ -65,7 +248,7 @@ static struct SurfaceNode *alloc_surface_node(void) {
     //! A bounds check! If there's more surface nodes than 7000 allowed,
     //  we, um...
     // Perhaps originally just debug feedback?
-    if (gSurfaceNodesAllocated >= 7000) {
+    if (gSurfaceNodesAllocated >= SURFACE_NODE_POOL_SIZE) {
     }
 #endif
 
@@ -78,11 +261,24 @@ static struct SurfaceNode *alloc_surface_node(void) {
  */
 static struct Surface *alloc_surface(void) {
 #ifdef USE_SYSTEM_MALLOC
-    struct AllocOnlyPool *pool = !sStaticSurfaceLoadComplete ?
-                                 sStaticSurfacePool : sDynamicSurfacePool;
-    struct Surface *surface = alloc_only_pool_alloc(pool, sizeof(struct Surface));
+    struct Surface *surface;
+
+    if (sLoadingSurfaceCache != NULL) {
+        surface = &sLoadingSurfaceCache->surfaces[sLoadingSurfaceCache->numSurfaces++];
+    } else {
+        surface = surface_pool_alloc(!sStaticSurfaceLoadComplete ?
+                                     &sStaticSurfacePool : &sDynamicSurfacePool);
+    }
 #else
-    struct Surface *surface = &sSurfacePool[gSurfacesAllocated];
+    struct Surface *surface;
+
+#ifdef AVOID_UB
+    // The pool can't grow, so once it is full no more surfaces are loaded
+    if (gSurfacesAllocated >= sSurfacePoolSize) {
+        return NULL;
+    }
+#endif
+    surface = &sSurfacePool[gSurfacesAllocated];
 #endif
     gSurfacesAllocated++;
 
@@ -123,6 +319,7 @@ static void clear_spatial_partition(SpatialPartitionCell *cells) {
  */
 static void clear_static_surfaces(void) {
     clear_spatial_partition(&gStaticSurfacePartition[0][0]);
+    surface_partition_changed(FALSE);
 }
 
 /**
@@ -140,6 +337,13 @@ static void add_surface_to_cell(s16 dynamic, s16 cellX, s16 cellZ, struct Surfac
     s16 sortDir;
     s16 listIndex;
 
+#ifdef AVOID_UB
+    // Out of surface nodes, the surface is left out of this cell
+    if (newNode == NULL) {
+        return;
+    }
+#endif
+
     if (surface->normal.y > 0.01) {
         listIndex = SPATIAL_PARTITION_FLOORS;
         sortDir = 1; // highest to lowest, then insertion order
@@ -184,6 +388,8 @@ static void add_surface_to_cell(s16 dynamic, s16 cellX, s16 cellZ, struct Surfac
 
     newNode->next = list->next;
     list->next = newNode;
+
+    surface_list_changed(dynamic, cellX, cellZ, listIndex);
 }
 
 /**
@@ -382,6 +588,12 @@ static struct Surface *read_surface_data(s16 *vertexData, s16 **vertexIndices) {
     nz *= mag;
 
     surface = alloc_surface();
+#ifdef AVOID_UB
+    // Out of surfaces, the caller skips it like a degenerate one
+    if (surface == NULL) {
+        return NULL;
+    }
+#endif
 
     surface->vertex1[0] = x1;
     surface->vertex2[0] = x2;
@@ -549,13 +761,11 @@ static void load_environmental_regions(s16 **data) {
  */
 void alloc_surface_pools(void) {
 #ifdef USE_SYSTEM_MALLOC
-    sStaticSurfaceNodePool = alloc_only_pool_init();
-    sStaticSurfacePool = alloc_only_pool_init();
-    sDynamicSurfaceNodePool = alloc_only_pool_init();
-    sDynamicSurfacePool = alloc_only_pool_init();
+    // The pools outlive levels, a new level only starts its peak counts over
+    report_surface_pool_peaks();
 #else
-    sSurfacePoolSize = 2300;
-    sSurfaceNodePool = main_pool_alloc(7000 * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
+    sSurfacePoolSize = SURFACE_POOL_SIZE;
+    sSurfaceNodePool = main_pool_alloc(SURFACE_NODE_POOL_SIZE * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
     sSurfacePool = main_pool_alloc(sSurfacePoolSize * sizeof(struct Surface), MEMORY_POOL_LEFT);
 #endif
 
@@ -623,18 +833,27 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
     s16 *vertexData;
     UNUSED s32 unused;
 
+#ifndef TARGET_N64
+    if (gCollisionTraceEnabled) {
+        trace_area_load(gCurrLevelNum, index);
+    }
+#endif
+
     // Initialize the data for this.
     gEnvironmentRegions = NULL;
     unused8038BE90 = 0;
     gSurfaceNodesAllocated = 0;
     gSurfacesAllocated = 0;
 #ifdef USE_SYSTEM_MALLOC
-    alloc_only_pool_clear(sStaticSurfaceNodePool);
-    alloc_only_pool_clear(sStaticSurfacePool);
-    alloc_only_pool_clear(sDynamicSurfaceNodePool);
-    alloc_only_pool_clear(sDynamicSurfacePool);
+    surface_pool_clear(&sStaticSurfaceNodePool);
+    surface_pool_clear(&sStaticSurfacePool);
     sStaticSurfaceLoadComplete = FALSE;
 
+    // Clearing the dynamic surfaces resets the counts to the static ones,
+    // which belong to the previous area
+    gNumStaticSurfaceNodes = 0;
+    gNumStaticSurfaces = 0;
+
     // Originally they forgot to clear this matrix,
     // results in segfaults if this is not done.
     clear_dynamic_surfaces();
@@ -684,6 +903,15 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 
 #ifdef USE_SYSTEM_MALLOC
     sStaticSurfaceLoadComplete = TRUE;
+
+    sSurfacePoolPeaks.level = gCurrLevelNum;
+    if (gNumStaticSurfaces > sSurfacePoolPeaks.staticSurfaces) {
+        sSurfacePoolPeaks.staticSurfaces = gNumStaticSurfaces;
+    }
+    if (gNumStaticSurfaceNodes > sSurfacePoolPeaks.staticNodes) {
+        sSurfacePoolPeaks.staticNodes = gNumStaticSurfaceNodes;
+    }
+    update_surface_pool_peaks();
 #endif
 }
 
@@ -693,24 +921,46 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 void clear_dynamic_surfaces(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE)) {
 #ifdef USE_SYSTEM_MALLOC
-        if (gSurfacesAllocated > gNumStaticSurfaces) {
-            alloc_only_pool_clear(sDynamicSurfacePool);
-        }
-        if (gSurfaceNodesAllocated > gNumStaticSurfaceNodes) {
-            alloc_only_pool_clear(sDynamicSurfaceNodePool);
-        }
+        update_surface_pool_peaks();
+        surface_pool_clear(&sDynamicSurfacePool);
+        surface_pool_clear(&sDynamicSurfaceNodePool);
 #endif
 
         gSurfacesAllocated = gNumStaticSurfaces;
         gSurfaceNodesAllocated = gNumStaticSurfaceNodes;
 
         clear_spatial_partition(&gDynamicSurfacePartition[0][0]);
+        surface_partition_changed(TRUE);
+
+#ifndef TARGET_N64
+        if (gCollisionTraceEnabled) {
+            trace_frame();
+        }
+#endif
+
+#ifdef USE_SYSTEM_MALLOC
+        sDynamicSurfaceFrame++;
+#endif
     }
 }
 
 UNUSED static void unused_80383604(void) {
 }
 
+/**
+ * Get the scaled transformation that is applied to the gCurrentObject's vertices.
+ */
+static void get_object_vertex_transform(Mat4 m) {
+    Mat4 *objectTransform = &gCurrentObject->transform;
+
+    if (gCurrentObject->header.gfx.throwMatrix == NULL) {
+        gCurrentObject->header.gfx.throwMatrix = objectTransform;
+        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
+    }
+
+    obj_apply_scale_to_matrix(gCurrentObject, m, *objectTransform);
+}
+
 /**
  * Applies an object's transformation to the object's vertices.
  */
@@ -719,22 +969,14 @@ void transform_object_vertices(s16 **data, s16 *vertexData) {
     register f32 vx, vy, vz;
     register s32 numVertices;
 
-    Mat4 *objectTransform;
     Mat4 m;
 
-    objectTransform = &gCurrentObject->transform;
-
     numVertices = *(*data);
     (*data)++;
 
     vertices = *data;
 
-    if (gCurrentObject->header.gfx.throwMatrix == NULL) {
-        gCurrentObject->header.gfx.throwMatrix = objectTransform;
-        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
-    }
-
-    obj_apply_scale_to_matrix(gCurrentObject, m, *objectTransform);
+    get_object_vertex_transform(m);
 
     // Go through all vertices, rotating and translating them to transform the object.
     while (numVertices--) {
@@ -807,6 +1049,101 @@ void load_object_surfaces(s16 **data, s16 *vertexData) {
     }
 }
 
+#ifdef USE_SYSTEM_MALLOC
+/**
+ * Count the surfaces in an object's collision data, starting at its vertices.
+ * Surfaces too small to have a normal are included.
+ */
+static s32 count_object_surfaces(s16 *data) {
+    s32 count = 0;
+    s32 numSurfaces;
+
+    data += 1 + 3 * data[0];
+
+    while (*data != TERRAIN_LOAD_CONTINUE) {
+        numSurfaces = data[1];
+        count += numSurfaces;
+        data += 2 + (3 + surface_has_force(data[0])) * numSurfaces;
+    }
+
+    return count;
+}
+
+/**
+ * Add the gCurrentObject's surfaces from its cache if it hasn't moved since they
+ * were built. Otherwise, point alloc_surface at the cache so they are rebuilt in
+ * place, and return FALSE.
+ */
+static s32 load_cached_object_surfaces(s16 *collisionData) {
+    struct ObjectSurfaceCache *cache;
+    s32 index = get_object_pool_index(gCurrentObject);
+    s32 capacity;
+    s32 i;
+    Mat4 m;
+
+    if (index < 0 || !sObjectSurfaceCacheEnabled) {
+        return FALSE;
+    }
+
+    // An object that loads its collision twice in a frame gets new surfaces the
+    // second time, the ones in the partition must not change under it.
+    cache = &sObjectSurfaceCaches[index];
+    if (cache->loadedFrame == sDynamicSurfaceFrame) {
+        return FALSE;
+    }
+    cache->loadedFrame = sDynamicSurfaceFrame;
+
+    get_object_vertex_transform(m);
+
+    if (cache->collisionData == collisionData && cache->behavior == gCurrentObject->behavior
+        && memcmp(cache->transform, m, sizeof(Mat4)) == 0) {
+        for (i = 0; i < cache->numSurfaces; i++) {
+            add_surface(&cache->surfaces[i], TRUE);
+        }
+        gSurfacesAllocated += cache->numSurfaces;
+        return TRUE;
+    }
+
+    capacity = count_object_surfaces(collisionData);
+    if (capacity > cache->capacity) {
+        free(cache->surfaces);
+        cache->surfaces = malloc(capacity * sizeof(struct Surface));
+        cache->capacity = cache->surfaces != NULL ? capacity : 0;
+    }
+
+    if (cache->surfaces == NULL) {
+        cache->collisionData = NULL;
+        return FALSE;
+    }
+
+    cache->behavior = gCurrentObject->behavior;
+    cache->collisionData = collisionData;
+    memcpy(cache->transform, m, sizeof(Mat4));
+    cache->numSurfaces = 0;
+
+    sLoadingSurfaceCache = cache;
+    return FALSE;
+}
+#endif
+
+#ifndef TARGET_N64
+/**
+ * Record the gCurrentObject loading its collision in the collision trace,
+ * with its data from the vertex count up to the TERRAIN_LOAD_CONTINUE.
+ */
+static void trace_object_collision(s16 *collisionData) {
+    s16 *data = collisionData + 1 + 3 * collisionData[0];
+    Mat4 m;
+
+    while (*data != TERRAIN_LOAD_CONTINUE) {
+        data += 2 + (3 + surface_has_force(data[0])) * data[1];
+    }
+
+    get_object_vertex_transform(m);
+    trace_object_load(gCurrentObject, collisionData, data + 1 - collisionData, m);
+}
+#endif
+
 /**
  * Transform an object's vertices, reload them, and render the object.
  */
@@ -834,12 +1171,28 @@ void load_object_collision_model(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE) && marioDist < tangibleDist
         && !(gCurrentObject->activeFlags & ACTIVE_FLAG_IN_DIFFERENT_ROOM)) {
         collisionData++;
-        transform_object_vertices(&collisionData, vertexData);
 
-        // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
-        while (*collisionData != TERRAIN_LOAD_CONTINUE) {
-            load_object_surfaces(&collisionData, vertexData);
+#ifndef TARGET_N64
+        if (gCollisionTraceEnabled) {
+            trace_object_collision(collisionData);
         }
+#endif
+
+#ifdef USE_SYSTEM_MALLOC
+        if (!load_cached_object_surfaces(collisionData))
+#endif
+        {
+            transform_object_vertices(&collisionData, vertexData);
+
+            // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
+            while (*collisionData != TERRAIN_LOAD_CONTINUE) {
+                load_object_surfaces(&collisionData, vertexData);
+            }
+        }
+
+#ifdef USE_SYSTEM_MALLOC
+        sLoadingSurfaceCache = NULL;
+#endif
     }
 
     if (marioDist < gCurrentObject->oDrawingDistance) {
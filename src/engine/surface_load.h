@@ -40,5 +40,9 @@ u32 get_area_terrain_size(s16 *data);
 void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects);
 void clear_dynamic_surfaces(void);
 void load_object_collision_model(void);
+#ifdef USE_SYSTEM_MALLOC
+void set_surface_pool_stats(s32 enable);
+void set_object_surface_cache(s32 enable);
+#endif
 
 #endif // SURFACE_LOAD_H
@@ -0,0 +1,104 @@
+#ifndef SURFACE_SIMD_H
+#define SURFACE_SIMD_H
+
+// Small vector layer for the collision queries. Integer operations wrap like
+// the scalar s32 math (the PC build uses -fwrapv) and float operations are
+// single IEEE-exact instructions, so a lane computes what the scalar code
+// would. Comparisons are turned into a bit mask with one bit per lane.
+// SURFACE_SIMD_WIDTH is left undefined when no supported instruction set is
+// available, or NO_SURFACE_SIMD is defined, and the queries walk the surface
+// lists one node at a time.
+
+#if defined(TARGET_N64) || defined(NO_SURFACE_SIMD)
+
+#elif defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define SURFACE_SIMD_WIDTH 8
+
+typedef __m256i surface_simd_int_t;
+typedef __m256 surface_simd_t;
+
+#define surface_simd_load_int(p) _mm256_loadu_si256((const __m256i *) (p))
+#define surface_simd_set1_int(i) _mm256_set1_epi32(i)
+#define surface_simd_sub_int(a, b) _mm256_sub_epi32(a, b)
+#define surface_simd_mul_int(a, b) _mm256_mullo_epi32(a, b)
+#define surface_simd_cmpgt_int(a, b) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)))
+
+#define surface_simd_load(p) _mm256_loadu_ps(p)
+#define surface_simd_set1(f) _mm256_set1_ps(f)
+#define surface_simd_add(a, b) _mm256_add_ps(a, b)
+#define surface_simd_mul(a, b) _mm256_mul_ps(a, b)
+#define surface_simd_abs(a) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a)
+#define surface_simd_cmplt(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))
+#define surface_simd_cmpgt(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#define SURFACE_SIMD_WIDTH 4
+
+typedef __m128i surface_simd_int_t;
+typedef __m128 surface_simd_t;
+
+#ifdef __SSE4_1__
+#define surface_simd_mul_int(a, b) _mm_mullo_epi32(a, b)
+#else
+// SSE2 only multiplies even lanes, do the odd ones separately and interleave the low halves
+static inline __m128i surface_simd_mul_int(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+#define surface_simd_load_int(p) _mm_loadu_si128((const __m128i *) (p))
+#define surface_simd_set1_int(i) _mm_set1_epi32(i)
+#define surface_simd_sub_int(a, b) _mm_sub_epi32(a, b)
+#define surface_simd_cmpgt_int(a, b) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b)))
+
+#define surface_simd_load(p) _mm_loadu_ps(p)
+#define surface_simd_set1(f) _mm_set1_ps(f)
+#define surface_simd_add(a, b) _mm_add_ps(a, b)
+#define surface_simd_mul(a, b) _mm_mul_ps(a, b)
+#define surface_simd_abs(a) _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+#define surface_simd_cmplt(a, b) _mm_movemask_ps(_mm_cmplt_ps(a, b))
+#define surface_simd_cmpgt(a, b) _mm_movemask_ps(_mm_cmpgt_ps(a, b))
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define SURFACE_SIMD_WIDTH 4
+
+typedef int32x4_t surface_simd_int_t;
+typedef float32x4_t surface_simd_t;
+
+static inline int surface_simd_mask(uint32x4_t m) {
+    static const uint32_t bits[4] = { 1, 2, 4, 8 };
+    return vaddvq_u32(vandq_u32(m, vld1q_u32(bits)));
+}
+
+#define surface_simd_load_int(p) vld1q_s32(p)
+#define surface_simd_set1_int(i) vdupq_n_s32(i)
+#define surface_simd_sub_int(a, b) vsubq_s32(a, b)
+#define surface_simd_mul_int(a, b) vmulq_s32(a, b)
+#define surface_simd_cmpgt_int(a, b) surface_simd_mask(vcgtq_s32(a, b))
+
+#define surface_simd_load(p) vld1q_f32(p)
+#define surface_simd_set1(f) vdupq_n_f32(f)
+#define surface_simd_add(a, b) vaddq_f32(a, b)
+#define surface_simd_mul(a, b) vmulq_f32(a, b)
+#define surface_simd_abs(a) vabsq_f32(a)
+#define surface_simd_cmplt(a, b) surface_simd_mask(vcltq_f32(a, b))
+#define surface_simd_cmpgt(a, b) surface_simd_mask(vcgtq_f32(a, b))
+
+#endif
+
+#endif // SURFACE_SIMD_H
@@ -22,6 +22,9 @@
 #include "save_file.h"
 #include "level_table.h"
 #include "dialog_ids.h"
+#ifndef TARGET_N64
+#include "pc/gfx/gfx_pc.h"
+#endif
 
 struct SpawnInfo gPlayerSpawnInfos[1];
 struct GraphNode *D_8033A160[0x100];
@@ -242,6 +245,9 @@ void load_area(s32 index) {
 
         load_obj_warp_nodes();
         geo_call_global_function_nodes(&gCurrentArea->unk04->node, GEO_CONTEXT_AREA_LOAD);
+#ifndef TARGET_N64
+        geo_register_static_geometry(&gCurrentArea->unk04->node);
+#endif
     }
 }
 
@@ -249,6 +255,10 @@ void unload_area(void) {
     if (gCurrentArea != NULL) {
         unload_objects_from_area(0, gCurrentArea->index);
         geo_call_global_function_nodes(&gCurrentArea->unk04->node, GEO_CONTEXT_AREA_UNLOAD);
+#ifndef TARGET_N64
+        // The area's display lists are about to be released
+        gfx_invalidate_static_geometry();
+#endif
 
         gCurrentArea->flags = 0;
         gCurrentArea = NULL;
@@ -368,6 +378,9 @@ void play_transition_after_delay(s16 transType, s16 time, u8 red, u8 green, u8 b
 void render_game(void) {
     if (gCurrentArea != NULL && !gWarpTransition.pauseRendering) {
         geo_process_root(gCurrentArea->unk04, D_8032CE74, D_8032CE78, gFBSetColor);
+#ifndef TARGET_N64
+        gDPNoOpTag(gDisplayListHead++, GFX_NOOP_TAG_SCENE_END);
+#endif
 
         gSPViewport(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(&D_8032CF00));
 
@@ -28,6 +28,7 @@ struct Controller gControllers[3];
 struct SPTask *gGfxSPTask;
 #ifdef USE_SYSTEM_MALLOC
 struct AllocOnlyPool *gGfxAllocOnlyPool;
+struct AllocOnlyPool *gGfxAllocOnlyPools[GFX_NUM_POOLS];
 Gfx *gDisplayListHeadInChunk;
 Gfx *gDisplayListEndInChunk;
 #else
@@ -374,6 +375,7 @@ void select_gfx_pool(void) {
 #ifdef USE_SYSTEM_MALLOC
     gDisplayListHeadInChunk = gGfxPool->buffer;
     gDisplayListEndInChunk = gDisplayListHeadInChunk + 1;
+    gGfxAllocOnlyPool = gGfxAllocOnlyPools[gGlobalTimer % ARRAY_COUNT(gGfxPools)];
     alloc_only_pool_clear(gGfxAllocOnlyPool);
 #else
     gDisplayListHead = gGfxPool->buffer;
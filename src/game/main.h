@@ -70,5 +70,8 @@ extern s8 gShowDebugText;
 void set_vblank_handler(s32 index, struct VblankHandler *handler, OSMesgQueue *queue, OSMesg *msg);
 void dispatch_audio_sptask(struct SPTask *spTask);
 void exec_display_list(struct SPTask *spTask);
+#ifndef TARGET_N64
+void wait_for_display_list(void);
+#endif
 
 #endif // MAIN_H
@@ -198,6 +198,8 @@ void *main_pool_alloc(u32 size, void (*releaseHandler)(void *addr)) {
 u32 main_pool_free(void *addr) {
     struct MainPoolBlock *block = ((struct MainPoolBlock *) addr) - 1;
     void *toFree;
+    // The previous frame may still be rendering from this memory
+    wait_for_display_list();
     do {
         if (sPoolListHeadL == NULL) {
             abort();
@@ -273,6 +275,10 @@ u32 main_pool_free(void *addr) {
     struct MainPoolBlock *block = (struct MainPoolBlock *) ((u8 *) addr - 16);
     struct MainPoolBlock *oldListHead = (struct MainPoolBlock *) ((u8 *) addr - 16);
 
+#ifndef TARGET_N64
+    // The previous frame may still be rendering from this memory
+    wait_for_display_list();
+#endif
     if (oldListHead < sPoolListHeadL) {
         while (oldListHead->next != NULL) {
             oldListHead = oldListHead->next;
@@ -339,6 +345,9 @@ u32 main_pool_push_state(void) {
  * amount of free space left in the pool.
  */
 u32 main_pool_pop_state(void) {
+#ifndef TARGET_N64
+    wait_for_display_list();
+#endif
     sPoolFreeSpace = gMainPoolState->freeSpace;
     sPoolListHeadL = gMainPoolState->listHeadL;
     sPoolListHeadR = gMainPoolState->listHeadR;
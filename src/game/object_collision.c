@@ -1,4 +1,7 @@
 #include <PR/ultratypes.h>
+#ifndef TARGET_N64
+#include <string.h>
+#endif
 
 #include "sm64.h"
 #include "debug.h"
@@ -110,8 +113,228 @@ void clear_object_collision(struct Object *a) {
     }
 }
 
+#ifndef TARGET_N64
+/**
+ * Broadphase for the object collision checks. Once per frame, every object in
+ * the lists that get checked is numbered in list order and entered into the
+ * cells of a grid over the level that its hitbox circle's bounding square
+ * touches. Two hitboxes can only overlap if their squares share a cell, and a
+ * pair that doesn't overlap has no effect at all, so check_collision_in_list
+ * only needs to test the objects in the cells around the first object. They
+ * are tested in the order of their numbers, which is the order the list would
+ * have visited them in, so the collision slots fill up exactly as before.
+ */
+#define COLLISION_GRID_CELL_SIZE 512
+#define COLLISION_GRID_SIZE (2 * 0x2000 / COLLISION_GRID_CELL_SIZE)
+
+// Objects with a square over more cells than this are checked with everything
+#define COLLISION_GRID_MAX_OBJECT_CELLS 16
+
+// Added to the radii so that rounding can't split an overlapping pair
+#define COLLISION_GRID_MARGIN 1.0f
+
+struct CollisionGridRange {
+    s16 x0, z0, x1, z1;
+};
+
+#define COLLISION_GRID_CELLS (COLLISION_GRID_SIZE * COLLISION_GRID_SIZE)
+
+static struct {
+    s32 valid;
+    s32 numObjects;
+    s32 numLarge;
+    s16 listEnd[NUM_OBJ_LISTS];
+    s16 objectNumbers[OBJECT_POOL_CAPACITY];
+    struct Object *objects[OBJECT_POOL_CAPACITY];
+    struct CollisionGridRange ranges[OBJECT_POOL_CAPACITY];
+    s16 large[OBJECT_POOL_CAPACITY];
+    s16 cellStart[COLLISION_GRID_CELLS + 1];
+    s16 cellFill[COLLISION_GRID_CELLS];
+    s16 entries[OBJECT_POOL_CAPACITY * COLLISION_GRID_MAX_OBJECT_CELLS];
+} sCollisionGrid;
+
+/**
+ * The lists the collision checks go through, in the order objects are numbered.
+ */
+static const s32 sCollisionGridLists[] = {
+    OBJ_LIST_PLAYER,  OBJ_LIST_DESTRUCTIVE, OBJ_LIST_GENACTOR, OBJ_LIST_PUSHABLE,
+    OBJ_LIST_LEVEL,   OBJ_LIST_SURFACE,     OBJ_LIST_POLELIKE,
+};
+
+static s16 collision_grid_cell(f32 coord) {
+    f32 cell = (coord + 0x2000) / COLLISION_GRID_CELL_SIZE;
+
+    // Clamping keeps overlapping ranges overlapping, and catches NaN
+    if (!(cell >= 0.0f)) {
+        return 0;
+    }
+    if (!(cell < COLLISION_GRID_SIZE - 1)) {
+        return COLLISION_GRID_SIZE - 1;
+    }
+    return (s16) cell;
+}
+
+/**
+ * Find the cells the bounding square of an object's hitbox touches, returning
+ * how many there are.
+ */
+static s32 get_collision_grid_range(struct Object *obj, struct CollisionGridRange *range) {
+    f32 reach = (obj->hitboxRadius > 0.0f ? obj->hitboxRadius : 0.0f) + COLLISION_GRID_MARGIN;
+
+    range->x0 = collision_grid_cell(obj->oPosX - reach);
+    range->x1 = collision_grid_cell(obj->oPosX + reach);
+    range->z0 = collision_grid_cell(obj->oPosZ - reach);
+    range->z1 = collision_grid_cell(obj->oPosZ + reach);
+    return (range->x1 - range->x0 + 1) * (range->z1 - range->z0 + 1);
+}
+
+/**
+ * Number the objects in list order and sort them into the grid cells. Nothing
+ * that the grid depends on changes until the collision checks are done.
+ */
+static void build_collision_grid(void) {
+    struct ObjectNode *listHead;
+    struct ObjectNode *node;
+    struct CollisionGridRange *range;
+    s16 *cellFill = sCollisionGrid.cellFill;
+    s32 index;
+    s32 i, x, z;
+
+    sCollisionGrid.valid = FALSE;
+    sCollisionGrid.numObjects = 0;
+    sCollisionGrid.numLarge = 0;
+
+    for (i = 0; i < (s32) ARRAY_COUNT(sCollisionGridLists); i++) {
+        listHead = &gObjectLists[sCollisionGridLists[i]];
+
+        for (node = listHead->next; node != listHead; node = node->next) {
+            index = get_object_pool_index((struct Object *) node);
+            if (index < 0 || sCollisionGrid.numObjects == OBJECT_POOL_CAPACITY) {
+                return;
+            }
+            sCollisionGrid.objectNumbers[index] = sCollisionGrid.numObjects;
+            sCollisionGrid.objects[sCollisionGrid.numObjects++] = (struct Object *) node;
+        }
+        sCollisionGrid.listEnd[sCollisionGridLists[i]] = sCollisionGrid.numObjects;
+    }
+
+    // Count the objects in each cell
+    memset(cellFill, 0, sizeof(sCollisionGrid.cellFill));
+    for (i = 0; i < sCollisionGrid.numObjects; i++) {
+        range = &sCollisionGrid.ranges[i];
+        if (get_collision_grid_range(sCollisionGrid.objects[i], range) > COLLISION_GRID_MAX_OBJECT_CELLS) {
+            sCollisionGrid.large[sCollisionGrid.numLarge++] = i;
+            continue;
+        }
+        for (z = range->z0; z <= range->z1; z++) {
+            for (x = range->x0; x <= range->x1; x++) {
+                cellFill[z * COLLISION_GRID_SIZE + x]++;
+            }
+        }
+    }
+
+    sCollisionGrid.cellStart[0] = 0;
+    for (i = 0; i < COLLISION_GRID_CELLS; i++) {
+        sCollisionGrid.cellStart[i + 1] = sCollisionGrid.cellStart[i] + cellFill[i];
+        cellFill[i] = sCollisionGrid.cellStart[i];
+    }
+
+    // Adding the objects in order keeps each cell sorted
+    for (i = 0; i < sCollisionGrid.numObjects; i++) {
+        range = &sCollisionGrid.ranges[i];
+        if ((range->x1 - range->x0 + 1) * (range->z1 - range->z0 + 1) > COLLISION_GRID_MAX_OBJECT_CELLS) {
+            continue;
+        }
+        for (z = range->z0; z <= range->z1; z++) {
+            for (x = range->x0; x <= range->x1; x++) {
+                sCollisionGrid.entries[cellFill[z * COLLISION_GRID_SIZE + x]++] = i;
+            }
+        }
+    }
+
+    sCollisionGrid.valid = TRUE;
+}
+
+/**
+ * Run the checks of check_collision_in_list on the objects near a, in list
+ * order. Returns FALSE if the grid can't narrow the list down.
+ */
+static s32 check_collision_in_grid(struct Object *a, struct Object *b, struct Object *c) {
+    static s16 candidates[OBJECT_POOL_CAPACITY * COLLISION_GRID_MAX_OBJECT_CELLS];
+    struct CollisionGridRange range;
+    s32 numCandidates = 0;
+    s32 first, end;
+    s32 index;
+    s32 i, j, x, z;
+    s16 number;
+
+    if (!sCollisionGrid.valid) {
+        return FALSE;
+    }
+
+    index = get_object_pool_index(a);
+    if (index < 0) {
+        return FALSE;
+    }
+    if (get_collision_grid_range(a, &range) > COLLISION_GRID_MAX_OBJECT_CELLS) {
+        return FALSE;
+    }
+
+    // The objects from b to the end of its list have consecutive numbers, and
+    // all of them are in the pool since the grid is valid
+    end = sCollisionGrid.listEnd[(struct ObjectNode *) c - gObjectLists];
+    first = b != c ? sCollisionGrid.objectNumbers[get_object_pool_index(b)] : end;
+
+    for (z = range.z0; z <= range.z1; z++) {
+        for (x = range.x0; x <= range.x1; x++) {
+            for (i = sCollisionGrid.cellStart[z * COLLISION_GRID_SIZE + x];
+                 i < sCollisionGrid.cellStart[z * COLLISION_GRID_SIZE + x + 1]; i++) {
+                number = sCollisionGrid.entries[i];
+                if (number >= first && number < end) {
+                    candidates[numCandidates++] = number;
+                }
+            }
+        }
+    }
+    for (i = 0; i < sCollisionGrid.numLarge; i++) {
+        number = sCollisionGrid.large[i];
+        if (number >= first && number < end) {
+            candidates[numCandidates++] = number;
+        }
+    }
+
+    // Put the candidates back in list order, an object can be in several cells
+    for (i = 1; i < numCandidates; i++) {
+        number = candidates[i];
+        for (j = i; j > 0 && candidates[j - 1] > number; j--) {
+            candidates[j] = candidates[j - 1];
+        }
+        candidates[j] = number;
+    }
+
+    for (i = 0; i < numCandidates; i++) {
+        if (i > 0 && candidates[i] == candidates[i - 1]) {
+            continue;
+        }
+        b = sCollisionGrid.objects[candidates[i]];
+        if (b->oIntangibleTimer == 0) {
+            if (detect_object_hitbox_overlap(a, b) && b->hurtboxRadius != 0.0f) {
+                detect_object_hurtbox_overlap(a, b);
+            }
+        }
+    }
+
+    return TRUE;
+}
+#endif
+
 void check_collision_in_list(struct Object *a, struct Object *b, struct Object *c) {
     if (a->oIntangibleTimer == 0) {
+#ifndef TARGET_N64
+        if (check_collision_in_grid(a, b, c)) {
+            return;
+        }
+#endif
         while (b != c) {
             if (b->oIntangibleTimer == 0) {
                 if (detect_object_hitbox_overlap(a, b) && b->hurtboxRadius != 0.0f) {
@@ -181,7 +404,14 @@ void detect_object_collisions(void) {
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_LEVEL]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_SURFACE]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_DESTRUCTIVE]);
+#ifndef TARGET_N64
+    build_collision_grid();
+#endif
     check_player_object_collision();
     check_destructive_object_collision();
     check_pushable_object_collision();
+#ifndef TARGET_N64
+    // Objects spawned or unloaded before the next build aren't in the grid
+    sCollisionGrid.valid = FALSE;
+#endif
 }
@@ -1,4 +1,9 @@
 #include <PR/ultratypes.h>
+#ifdef OBJECT_FIELD_PROFILE
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
 
 #include "sm64.h"
 #include "area.h"
@@ -63,11 +68,43 @@ s16 gDebugInfoOverwrite[16][8];
  */
 u32 gTimeStopState;
 
-#ifndef USE_SYSTEM_MALLOC
 /**
- * The pool that objects are allocated from.
+ * The pool that objects are allocated from. With USE_SYSTEM_MALLOC, objects
+ * beyond the pool are malloc'd.
  */
 struct Object gObjectPool[OBJECT_POOL_CAPACITY];
+
+#ifndef TARGET_N64
+/**
+ * Incremented whenever an object is removed from an object list.
+ */
+u32 gObjectListGeneration;
+
+/**
+ * The pool indices of the objects in each list, in list order, gathered while
+ * the deactivated objects are unloaded at the end of the frame. The next
+ * frame's update walks this array and prefetches the object ahead instead of
+ * waiting on each object's list link. Objects spawned since then are at the
+ * end of their list and are reached through the link of the last gathered
+ * object. Once an object is removed from a list the array is stale and the
+ * walk goes back to following the links.
+ */
+static s16 sActiveObjectIndices[OBJECT_POOL_CAPACITY];
+static s32 sNumActiveObjects;
+static s32 sActiveObjectsOverflowed;
+static u32 sActiveObjectGeneration;
+
+struct ActiveObjectRun {
+    s16 start;
+    s16 count; // -1 if the list has objects outside the pool
+};
+
+static struct ActiveObjectRun sActiveObjectRuns[NUM_OBJ_LISTS];
+
+struct ActiveObjectCursor {
+    s16 *next;
+    s16 *end;
+};
 #endif
 
 /**
@@ -288,20 +325,309 @@ void bhv_mario_update(void) {
     }
 }
 
+#ifndef TARGET_N64
+static void prefetch_object(struct Object *obj) {
+#ifdef __GNUC__
+    __builtin_prefetch(&obj->header);
+    __builtin_prefetch(&obj->rawData);
+#endif
+}
+
+/**
+ * Add an object that stays loaded to the indices walked next frame.
+ */
+static void gather_active_object(struct Object *obj) {
+    s32 index = get_object_pool_index(obj);
+
+    if (index < 0 || sNumActiveObjects >= OBJECT_POOL_CAPACITY) {
+        sActiveObjectsOverflowed = TRUE;
+    } else {
+        sActiveObjectIndices[sNumActiveObjects++] = index;
+    }
+}
+
+/**
+ * Start walking the gathered indices of objList, whose first object is firstObj.
+ */
+static void init_active_object_cursor(struct ActiveObjectCursor *cursor, struct ObjectNode *objList,
+                                      struct ObjectNode *firstObj) {
+    struct ActiveObjectRun *run = &sActiveObjectRuns[objList - gObjectListArray];
+
+    cursor->next = cursor->end = NULL;
+    if (sActiveObjectGeneration == gObjectListGeneration && run->count > 0
+        && &gObjectPool[sActiveObjectIndices[run->start]].header == firstObj) {
+        cursor->next = &sActiveObjectIndices[run->start + 1];
+        cursor->end = &sActiveObjectIndices[run->start + run->count];
+        if (cursor->next < cursor->end) {
+            prefetch_object(&gObjectPool[*cursor->next]);
+        }
+    }
+}
+
+/**
+ * Return the object after obj in its list, the same one obj->next points to.
+ */
+static struct ObjectNode *next_active_object(struct ActiveObjectCursor *cursor, struct ObjectNode *obj) {
+    struct Object *next;
+
+    if (cursor->next < cursor->end) {
+        if (sActiveObjectGeneration == gObjectListGeneration) {
+            next = &gObjectPool[*cursor->next++];
+            if (cursor->next < cursor->end) {
+                prefetch_object(&gObjectPool[*cursor->next]);
+            }
+            return &next->header;
+        }
+        cursor->next = cursor->end;
+    }
+
+    return obj->next;
+}
+#endif
+
+#ifdef OBJECT_FIELD_PROFILE
+#define OBJECT_FIELD_PROFILE_FIELDS 0xA0
+#define OBJECT_FIELD_PROFILE_BEHAVIORS 1024
+
+/**
+ * The fields touched by the updates of the objects with one behavior. Fields
+ * 0x50 and up are the slots of ptrData on 64-bit builds.
+ */
+struct ObjectFieldProfile {
+    const BehaviorScript *behavior;
+    u32 updates;
+    u32 accesses;
+    u32 linesTouched;
+    u32 updatesTouching[OBJECT_FIELD_PROFILE_FIELDS];
+};
+
+static struct ObjectFieldProfile sObjectFieldProfiles[OBJECT_FIELD_PROFILE_BEHAVIORS];
+static struct ObjectFieldProfile *sCurrentFieldProfile;
+static u32 sTouchedFields[OBJECT_FIELD_PROFILE_FIELDS / 32];
+
+#define BEHAVIOR_NAME(bhv) extern const BehaviorScript bhv[];
+#include "behavior_names.inc.c"
+#undef BEHAVIOR_NAME
+
+static const struct {
+    const BehaviorScript *behavior;
+    const char *name;
+} sBehaviorNames[] = {
+#define BEHAVIOR_NAME(bhv) { bhv, #bhv },
+#include "behavior_names.inc.c"
+#undef BEHAVIOR_NAME
+};
+
+/**
+ * Record the loads and stores that land in the fields of the object being
+ * updated. Loads and stores to other objects, such as Mario's position, don't
+ * count towards the behavior.
+ */
+__attribute__((no_sanitize_address))
+static void profile_object_field(uintptr_t addr, size_t size) {
+    uintptr_t offset;
+    s32 first, last;
+    s32 i;
+
+    if (sCurrentFieldProfile == NULL || size == 0) {
+        return;
+    }
+
+    offset = addr - (uintptr_t) gCurrentObject->rawData.asU32;
+    if (offset < sizeof(gCurrentObject->rawData)) {
+        first = offset / sizeof(u32);
+        last = (offset + size - 1) / sizeof(u32);
+    } else {
+#if IS_64_BIT
+        offset = addr - (uintptr_t) gCurrentObject->ptrData.asVoidPtr;
+        if (offset >= sizeof(gCurrentObject->ptrData)) {
+            return;
+        }
+        first = 0x50 + offset / sizeof(void *);
+        last = 0x50 + (offset + size - 1) / sizeof(void *);
+#else
+        return;
+#endif
+    }
+
+    for (i = first; i <= last && i < OBJECT_FIELD_PROFILE_FIELDS; i++) {
+        sTouchedFields[i / 32] |= 1U << (i % 32);
+    }
+    sCurrentFieldProfile->accesses++;
+}
+
+// The game and engine code is built with GCC's -fsanitize=kernel-address for
+// the profile, which passes the address of each load and store to these. The
+// objects the benches link are built without it, so accesses from the
+// collision and matrix code aren't counted.
+#define OBJECT_FIELD_ACCESS_HOOK(name, size)                         \
+    __attribute__((no_sanitize_address)) void name(void *addr) {     \
+        profile_object_field((uintptr_t) addr, size);                \
+    }
+
+OBJECT_FIELD_ACCESS_HOOK(__asan_load1_noabort, 1)
+OBJECT_FIELD_ACCESS_HOOK(__asan_load2_noabort, 2)
+OBJECT_FIELD_ACCESS_HOOK(__asan_load4_noabort, 4)
+OBJECT_FIELD_ACCESS_HOOK(__asan_load8_noabort, 8)
+OBJECT_FIELD_ACCESS_HOOK(__asan_load16_noabort, 16)
+OBJECT_FIELD_ACCESS_HOOK(__asan_store1_noabort, 1)
+OBJECT_FIELD_ACCESS_HOOK(__asan_store2_noabort, 2)
+OBJECT_FIELD_ACCESS_HOOK(__asan_store4_noabort, 4)
+OBJECT_FIELD_ACCESS_HOOK(__asan_store8_noabort, 8)
+OBJECT_FIELD_ACCESS_HOOK(__asan_store16_noabort, 16)
+#undef OBJECT_FIELD_ACCESS_HOOK
+
+__attribute__((no_sanitize_address)) void __asan_loadN_noabort(void *addr, size_t size) {
+    profile_object_field((uintptr_t) addr, size);
+}
+
+__attribute__((no_sanitize_address)) void __asan_storeN_noabort(void *addr, size_t size) {
+    profile_object_field((uintptr_t) addr, size);
+}
+
+void __asan_handle_no_return(void) {
+}
+
+static size_t get_object_field_offset(s32 field) {
+#if IS_64_BIT
+    if (field >= 0x50) {
+        return offsetof(struct Object, ptrData) + (field - 0x50) * sizeof(void *);
+    }
+#endif
+    return offsetof(struct Object, rawData) + field * sizeof(u32);
+}
+
+static const char *get_behavior_name(const BehaviorScript *behavior) {
+    u32 i;
+
+    for (i = 0; i < ARRAY_COUNT(sBehaviorNames); i++) {
+        if (sBehaviorNames[i].behavior == behavior) {
+            return sBehaviorNames[i].name;
+        }
+    }
+    return "?";
+}
+
+static int compare_object_field_profiles(const void *a, const void *b) {
+    const struct ObjectFieldProfile *pa = a, *pb = b;
+    return pa->updates < pb->updates ? 1 : pa->updates > pb->updates ? -1 : 0;
+}
+
+/**
+ * Print the fields touched per update of each behavior, by the offsets used in
+ * object_fields.h. A '*' marks the ptrData slot of a pointer field. Lines are
+ * the 64 byte lines of the object the touched fields span.
+ */
+static void report_object_field_profile(void) {
+    struct ObjectFieldProfile total;
+    s32 i, j;
+
+    qsort(sObjectFieldProfiles, OBJECT_FIELD_PROFILE_BEHAVIORS, sizeof(sObjectFieldProfiles[0]),
+          compare_object_field_profiles);
+
+    bzero(&total, sizeof(total));
+    fprintf(stderr, "Object fields touched per update:\n");
+    fprintf(stderr, "%-36s %10s %9s %7s\n", "behavior", "updates", "accesses", "lines");
+    for (i = 0; i < OBJECT_FIELD_PROFILE_BEHAVIORS && sObjectFieldProfiles[i].updates != 0; i++) {
+        struct ObjectFieldProfile *profile = &sObjectFieldProfiles[i];
+
+        fprintf(stderr, "%-36s %10u %9.1f %7.2f\n ", get_behavior_name(profile->behavior), profile->updates,
+                (f64) profile->accesses / profile->updates, (f64) profile->linesTouched / profile->updates);
+        for (j = 0; j < OBJECT_FIELD_PROFILE_FIELDS; j++) {
+            if (profile->updatesTouching[j] != 0) {
+                fprintf(stderr, " 0x%03X%s %u%%", 0x88 + (j % 0x50) * 4, j >= 0x50 ? "*" : "",
+                        (u32)(100ULL * profile->updatesTouching[j] / profile->updates));
+            }
+            total.updatesTouching[j] += profile->updatesTouching[j];
+        }
+        fprintf(stderr, "\n");
+
+        total.updates += profile->updates;
+        total.accesses += profile->accesses;
+        total.linesTouched += profile->linesTouched;
+    }
+
+    if (total.updates != 0) {
+        fprintf(stderr, "%-36s %10u %9.1f %7.2f\n ", "all", total.updates, (f64) total.accesses / total.updates,
+                (f64) total.linesTouched / total.updates);
+        for (j = 0; j < OBJECT_FIELD_PROFILE_FIELDS; j++) {
+            if (total.updatesTouching[j] != 0) {
+                fprintf(stderr, " 0x%03X%s %u%%", 0x88 + (j % 0x50) * 4, j >= 0x50 ? "*" : "",
+                        (u32)(100ULL * total.updatesTouching[j] / total.updates));
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+/**
+ * Start recording the fields touched by the update of gCurrentObject.
+ */
+static void start_object_field_profile(void) {
+    const BehaviorScript *behavior = gCurrentObject->behavior;
+    u32 slot = ((uintptr_t) behavior >> 2) % OBJECT_FIELD_PROFILE_BEHAVIORS;
+    static s32 reportRegistered;
+
+    if (!reportRegistered) {
+        atexit(report_object_field_profile);
+        reportRegistered = TRUE;
+    }
+
+    while (sObjectFieldProfiles[slot].updates != 0 && sObjectFieldProfiles[slot].behavior != behavior) {
+        slot = (slot + 1) % OBJECT_FIELD_PROFILE_BEHAVIORS;
+    }
+    sCurrentFieldProfile = &sObjectFieldProfiles[slot];
+    sCurrentFieldProfile->behavior = behavior;
+    sCurrentFieldProfile->updates++;
+    bzero(sTouchedFields, sizeof(sTouchedFields));
+}
+
+static void finish_object_field_profile(void) {
+    u64 lines = 0;
+    s32 i;
+
+    for (i = 0; i < OBJECT_FIELD_PROFILE_FIELDS; i++) {
+        if (sTouchedFields[i / 32] & (1U << (i % 32))) {
+            sCurrentFieldProfile->updatesTouching[i]++;
+            lines |= 1ULL << (get_object_field_offset(i) / 64);
+        }
+    }
+    for (; lines != 0; lines &= lines - 1) {
+        sCurrentFieldProfile->linesTouched++;
+    }
+    sCurrentFieldProfile = NULL;
+}
+#endif
+
 /**
  * Update every object that occurs after firstObj in the given object list,
  * including firstObj itself. Return the number of objects that were updated.
  */
 s32 update_objects_starting_at(struct ObjectNode *objList, struct ObjectNode *firstObj) {
     s32 count = 0;
+#ifndef TARGET_N64
+    struct ActiveObjectCursor cursor;
+
+    init_active_object_cursor(&cursor, objList, firstObj);
+#endif
 
     while (objList != firstObj) {
         gCurrentObject = (struct Object *) firstObj;
 
         gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_HAS_ANIMATION;
+#ifdef OBJECT_FIELD_PROFILE
+        start_object_field_profile();
         cur_obj_update();
+        finish_object_field_profile();
+#else
+        cur_obj_update();
+#endif
 
+#ifndef TARGET_N64
+        firstObj = next_active_object(&cursor, firstObj);
+#else
         firstObj = firstObj->next;
+#endif
         count += 1;
     }
 
@@ -320,6 +646,11 @@ s32 update_objects_starting_at(struct ObjectNode *objList, struct ObjectNode *fi
 s32 update_objects_during_time_stop(struct ObjectNode *objList, struct ObjectNode *firstObj) {
     s32 count = 0;
     s32 unfrozen;
+#ifndef TARGET_N64
+    struct ActiveObjectCursor cursor;
+
+    init_active_object_cursor(&cursor, objList, firstObj);
+#endif
 
     while (objList != firstObj) {
         gCurrentObject = (struct Object *) firstObj;
@@ -346,12 +677,22 @@ s32 update_objects_during_time_stop(struct ObjectNode *objList, struct ObjectNod
         // Only update if unfrozen
         if (unfrozen) {
             gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_HAS_ANIMATION;
+#ifdef OBJECT_FIELD_PROFILE
+            start_object_field_profile();
+            cur_obj_update();
+            finish_object_field_profile();
+#else
             cur_obj_update();
+#endif
         } else {
             gCurrentObject->header.gfx.node.flags &= ~GRAPH_RENDER_HAS_ANIMATION;
         }
 
+#ifndef TARGET_N64
+        firstObj = next_active_object(&cursor, firstObj);
+#else
         firstObj = firstObj->next;
+#endif
         count++;
     }
 
@@ -395,6 +736,11 @@ s32 unload_deactivated_objects_in_list(struct ObjectNode *objList) {
 
             unload_object(gCurrentObject);
         }
+#ifndef TARGET_N64
+        else {
+            gather_active_object(gCurrentObject);
+        }
+#endif
     }
 
     return 0;
@@ -524,6 +870,10 @@ void spawn_objects_from_info(UNUSED s32 unused, struct SpawnInfo *spawnInfo) {
 void stub_obj_list_processor_1(void) {
 }
 
+#ifdef USE_SYSTEM_MALLOC
+static s32 sObjectPoolLinked;
+#endif
+
 /**
  * Clear objects, dynamic surfaces, and some miscellaneous level data used by objects.
  */
@@ -544,6 +894,14 @@ void clear_objects(void) {
 
 #ifndef USE_SYSTEM_MALLOC
     init_free_object_list();
+#else
+    // Objects come from the pool before any are malloc'd, so that they have a
+    // slot index. Every object is back in a free list after the lists are
+    // cleared, so the pool is only linked in once.
+    if (!sObjectPoolLinked) {
+        init_free_object_list();
+        sObjectPoolLinked = TRUE;
+    }
 #endif
     clear_object_lists(gObjectListArray);
 
@@ -595,10 +953,25 @@ void unload_deactivated_objects(void) {
     s32 listIndex;
 
     s32 i = 0;
+#ifndef TARGET_N64
+    bzero(sActiveObjectRuns, sizeof(sActiveObjectRuns));
+    sNumActiveObjects = 0;
+#endif
     while ((listIndex = sObjectListUpdateOrder[i]) != -1) {
+#ifndef TARGET_N64
+        sActiveObjectsOverflowed = FALSE;
+        sActiveObjectRuns[listIndex].start = sNumActiveObjects;
+#endif
         unload_deactivated_objects_in_list(&gObjectLists[listIndex]);
+#ifndef TARGET_N64
+        sActiveObjectRuns[listIndex].count =
+            sActiveObjectsOverflowed ? -1 : sNumActiveObjects - sActiveObjectRuns[listIndex].start;
+#endif
         i += 1;
     }
+#ifndef TARGET_N64
+    sActiveObjectGeneration = gObjectListGeneration;
+#endif
 
     // TIME_STOP_UNKNOWN_0 was most likely intended to be used to track whether
     // any objects had been deactivated
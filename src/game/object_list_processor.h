@@ -80,6 +80,18 @@ extern s16 gDebugInfoOverwrite[][8];
 
 extern u32 gTimeStopState;
 extern struct Object gObjectPool[];
+#ifndef TARGET_N64
+extern u32 gObjectListGeneration;
+
+/**
+ * Return the index of obj in gObjectPool, or -1 if it was malloc'd.
+ */
+static inline s32 get_object_pool_index(struct Object *obj) {
+    uintptr_t offset = (uintptr_t) obj - (uintptr_t) gObjectPool;
+
+    return offset < OBJECT_POOL_CAPACITY * sizeof(struct Object) ? (s32)(offset / sizeof(struct Object)) : -1;
+}
+#endif
 extern struct Object gMacroObjectDefaultParent;
 extern struct ObjectNode *gObjectLists;
 extern struct ObjectNode gFreeObjectList;
@@ -10,6 +10,11 @@
 #include "rendering_graph_node.h"
 #include "shadow.h"
 #include "sm64.h"
+#ifndef TARGET_N64
+#include <string.h>
+
+#include "pc/gfx/gfx_pc.h"
+#endif
 
 /**
  * This file contains the code that processes the scene graph for rendering.
@@ -52,6 +57,10 @@ struct GeoAnimState {
     /*0x04*/ f32 translationMultiplier;
     /*0x08*/ u16 *attribute;
     /*0x0C*/ s16 *data;
+#ifndef TARGET_N64
+    struct AnimCacheEntry *cacheEntry;
+    struct Animation *cacheAnim;
+#endif
 };
 
 // For some reason, this is a GeoAnimState struct, but the current state consists
@@ -125,6 +134,54 @@ struct GraphNodeObject *gCurGraphNodeObject = NULL;
 struct GraphNodeHeldObject *gCurGraphNodeHeldObject = NULL;
 u16 gAreaUpdateCounter = 0;
 
+#ifndef TARGET_N64
+// The kernels the matrix stack is built with, see set_matrix_stack_kernels
+static const struct MtxfKernels *sMatStackKernels = &gMtxfScalarKernels;
+
+#define stack_mtxf_mul sMatStackKernels->mul
+#define stack_mtxf_rotate_zxy_and_translate sMatStackKernels->rotate_zxy_and_translate
+#define stack_mtxf_billboard sMatStackKernels->billboard
+#define stack_mtxf_to_mtx sMatStackKernels->to_mtx
+
+/*
+ * Cache of the rotations of animated parts. The rotation of a part only depends on the
+ * animation, the frame and the part, so objects that share an animation and frame, such
+ * as a group of goombas or Mario and his reflection, build it once. The translation
+ * depends on the object's animYTrans and is added to each object's own copy.
+ * Mario's animations are all loaded into the same buffer, so an animation pointer only
+ * stands for one animation until the next one is loaded and the cache is emptied at the
+ * start of every pass over the scene graph.
+ */
+#define ANIM_CACHE_SIZE 64
+#define ANIM_CACHE_MAX_PARTS 48
+
+struct AnimCachePart {
+    u32 stamp; // the part is valid while this matches the entry's stamp
+    f32 rotation[3][4];
+};
+
+struct AnimCacheEntry {
+    struct Animation *anim;
+    u32 generation;
+    u32 stamp;
+    s16 frame;
+    u16 *attributes;
+    struct AnimCachePart parts[ANIM_CACHE_MAX_PARTS];
+};
+
+static s32 sAnimCacheEnabled = FALSE;
+static u32 sAnimCacheGeneration = 1;
+static u32 sAnimCacheStamp = 0;
+static struct AnimCacheEntry sAnimCache[ANIM_CACHE_SIZE];
+// Entry of the animation set by geo_set_animation_globals, NULL when not caching
+static struct AnimCacheEntry *sCurAnimCacheEntry = NULL;
+#else
+#define stack_mtxf_mul mtxf_mul
+#define stack_mtxf_rotate_zxy_and_translate mtxf_rotate_zxy_and_translate
+#define stack_mtxf_billboard mtxf_billboard
+#define stack_mtxf_to_mtx mtxf_to_mtx
+#endif
+
 #ifdef F3DEX_GBI_2
 LookAt lookAt;
 #endif
@@ -138,6 +195,9 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
     s32 enableZBuffer = (node->node.flags & GRAPH_RENDER_Z_BUFFER) != 0;
     struct RenderModeContainer *modeList = &renderModeTable_1Cycle[enableZBuffer];
     struct RenderModeContainer *mode2List = &renderModeTable_2Cycle[enableZBuffer];
+#ifndef TARGET_N64
+    const void *interpId = NULL;
+#endif
 
     // @bug This is where the LookAt values should be calculated but aren't.
     // As a result, environment mapping is broken on Fast3DEX2 without the
@@ -156,6 +216,12 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
         if ((currList = node->listHeads[i]) != NULL) {
             gDPSetRenderMode(gDisplayListHead++, modeList->modes[i], mode2List->modes[i]);
             while (currList != NULL) {
+#ifndef TARGET_N64
+                if (currList->interpId != interpId) {
+                    interpId = currList->interpId;
+                    gDPNoOpInterpId(gDisplayListHead++, interpId);
+                }
+#endif
                 gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(currList->transform),
                           G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH);
                 gSPDisplayList(gDisplayListHead++, currList->displayList);
@@ -163,6 +229,9 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
             }
         }
     }
+#ifndef TARGET_N64
+    gDPNoOpInterpId(gDisplayListHead++, NULL);
+#endif
     if (enableZBuffer != 0) {
         gDPPipeSync(gDisplayListHead++);
         gSPClearGeometryMode(gDisplayListHead++, G_ZBUFFER);
@@ -186,6 +255,16 @@ static void geo_append_display_list(void *displayList, s16 layer) {
         listNode->transform = gMatStackFixed[gMatStackIndex];
         listNode->displayList = displayList;
         listNode->next = 0;
+#ifndef TARGET_N64
+        // Held objects are drawn by their holder's graph node but move on their own
+        if (gCurGraphNodeHeldObject != NULL) {
+            listNode->interpId = gCurGraphNodeHeldObject->objNode;
+        } else if (gCurGraphNodeObject != NULL) {
+            listNode->interpId = gCurGraphNodeObject;
+        } else {
+            listNode->interpId = gCurGraphNodeMasterList;
+        }
+#endif
         if (gCurGraphNodeMasterList->listHeads[layer] == 0) {
             gCurGraphNodeMasterList->listHeads[layer] = listNode;
         } else {
@@ -252,6 +331,9 @@ static void geo_process_perspective(struct GraphNodePerspective *node) {
         guPerspective(mtx, &perspNorm, node->fov, aspect, node->near, node->far, 1.0f);
         gSPPerspNormalize(gDisplayListHead++, perspNorm);
 
+#ifndef TARGET_N64
+        gDPNoOpInterpId(gDisplayListHead++, node);
+#endif
         gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(mtx), G_MTX_PROJECTION | G_MTX_LOAD | G_MTX_NOPUSH);
 
         gCurGraphNodeCamFrustum = node;
@@ -322,12 +404,15 @@ static void geo_process_camera(struct GraphNodeCamera *node) {
     }
     mtxf_rotate_xy(rollMtx, node->rollScreen);
 
+#ifndef TARGET_N64
+    gDPNoOpInterpId(gDisplayListHead++, node);
+#endif
     gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(rollMtx), G_MTX_PROJECTION | G_MTX_MUL | G_MTX_NOPUSH);
 
     mtxf_lookat(cameraTransform, node->pos, node->focus, node->roll);
-    mtxf_mul(gMatStack[gMatStackIndex + 1], cameraTransform, gMatStack[gMatStackIndex]);
+    stack_mtxf_mul(gMatStack[gMatStackIndex + 1], cameraTransform, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->fnNode.node.children != 0) {
         gCurGraphNodeCamera = node;
@@ -350,10 +435,10 @@ static void geo_process_translation_rotation(struct GraphNodeTranslationRotation
     Mtx *mtx = alloc_display_list(sizeof(*mtx));
 
     vec3s_to_vec3f(translation, node->translation);
-    mtxf_rotate_zxy_and_translate(mtxf, translation, node->rotation);
-    mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
+    stack_mtxf_rotate_zxy_and_translate(mtxf, translation, node->rotation);
+    stack_mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -375,10 +460,10 @@ static void geo_process_translation(struct GraphNodeTranslation *node) {
     Mtx *mtx = alloc_display_list(sizeof(*mtx));
 
     vec3s_to_vec3f(translation, node->translation);
-    mtxf_rotate_zxy_and_translate(mtxf, translation, gVec3sZero);
-    mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
+    stack_mtxf_rotate_zxy_and_translate(mtxf, translation, gVec3sZero);
+    stack_mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -398,10 +483,10 @@ static void geo_process_rotation(struct GraphNodeRotation *node) {
     Mat4 mtxf;
     Mtx *mtx = alloc_display_list(sizeof(*mtx));
 
-    mtxf_rotate_zxy_and_translate(mtxf, gVec3fZero, node->rotation);
-    mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
+    stack_mtxf_rotate_zxy_and_translate(mtxf, gVec3fZero, node->rotation);
+    stack_mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -425,7 +510,7 @@ static void geo_process_scale(struct GraphNodeScale *node) {
     vec3f_set(scaleVec, node->scale, node->scale, node->scale);
     mtxf_scale_vec3f(gMatStack[gMatStackIndex + 1], gMatStack[gMatStackIndex], scaleVec);
     gMatStackIndex++;
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -448,7 +533,7 @@ static void geo_process_billboard(struct GraphNodeBillboard *node) {
 
     gMatStackIndex++;
     vec3s_to_vec3f(translation, node->translation);
-    mtxf_billboard(gMatStack[gMatStackIndex], gMatStack[gMatStackIndex - 1], translation,
+    stack_mtxf_billboard(gMatStack[gMatStackIndex], gMatStack[gMatStackIndex - 1], translation,
                    gCurGraphNodeCamera->roll);
     if (gCurGraphNodeHeldObject != NULL) {
         mtxf_scale_vec3f(gMatStack[gMatStackIndex], gMatStack[gMatStackIndex],
@@ -458,7 +543,7 @@ static void geo_process_billboard(struct GraphNodeBillboard *node) {
                          gCurGraphNodeObject->scale);
     }
 
-    mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = mtx;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -539,6 +624,68 @@ static void geo_process_background(struct GraphNodeBackground *node) {
     }
 }
 
+#ifndef TARGET_N64
+/**
+ * Return the cache entry of an animation on a frame, taking over the entry
+ * of another one if needed.
+ */
+static struct AnimCacheEntry *anim_cache_lookup(struct Animation *anim, s16 frame) {
+    uintptr_t hash = ((uintptr_t) anim >> 2) * 31 + (u16) frame;
+    struct AnimCacheEntry *entry = &sAnimCache[(hash ^ (hash >> 7)) % ANIM_CACHE_SIZE];
+    s32 i;
+
+    if (entry->generation != sAnimCacheGeneration || entry->anim != anim || entry->frame != frame) {
+        entry->anim = anim;
+        entry->generation = sAnimCacheGeneration;
+        entry->frame = frame;
+        entry->attributes = segmented_to_virtual((void *) anim->index);
+        // A new stamp invalidates the parts, they only need clearing when it wraps around
+        if (++sAnimCacheStamp == 0) {
+            for (i = 0; i < ANIM_CACHE_SIZE * ANIM_CACHE_MAX_PARTS; i++) {
+                sAnimCache[i / ANIM_CACHE_MAX_PARTS].parts[i % ANIM_CACHE_MAX_PARTS].stamp = 0;
+            }
+            sAnimCacheStamp = 1;
+        }
+        entry->stamp = sAnimCacheStamp;
+    }
+    return entry;
+}
+
+/**
+ * Build the transform of an animated part like mtxf_rotate_xyz_and_translate,
+ * taking the rotation from the cache if an object on the same frame of the
+ * same animation built it before.
+ */
+static void geo_build_cached_part_transform(Mat4 dest, Vec3f translation) {
+    struct AnimCachePart *part = NULL;
+    s32 offset = gCurrAnimAttribute - sCurAnimCacheEntry->attributes;
+    Vec3s rotation;
+
+    // Each part reads three attributes of two u16s, after the three of the root's translation
+    if (offset % 6 == 0 && offset / 6 < ANIM_CACHE_MAX_PARTS) {
+        part = &sCurAnimCacheEntry->parts[offset / 6];
+        if (part->stamp == sCurAnimCacheEntry->stamp) {
+            gCurrAnimAttribute += 6;
+            memcpy(dest, part->rotation, sizeof(part->rotation));
+            dest[3][0] = translation[0];
+            dest[3][1] = translation[1];
+            dest[3][2] = translation[2];
+            dest[3][3] = 1.0f;
+            return;
+        }
+    }
+
+    rotation[0] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+    rotation[1] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+    rotation[2] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+    mtxf_rotate_xyz_and_translate(dest, translation, rotation);
+    if (part != NULL) {
+        memcpy(part->rotation, dest, sizeof(part->rotation));
+        part->stamp = sCurAnimCacheEntry->stamp;
+    }
+}
+#endif
+
 /**
  * Render an animated part. The current animation state is not part of the node
  * but set in global variables. If an animated part is skipped, everything afterwards desyncs.
@@ -584,15 +731,22 @@ static void geo_process_animated_part(struct GraphNodeAnimatedPart *node) {
         }
     }
 
-    if (gCurAnimType == ANIM_TYPE_ROTATION) {
-        rotation[0] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
-        rotation[1] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
-        rotation[2] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+#ifndef TARGET_N64
+    if (gCurAnimType == ANIM_TYPE_ROTATION && sCurAnimCacheEntry != NULL) {
+        geo_build_cached_part_transform(matrix, translation);
+    } else
+#endif
+    {
+        if (gCurAnimType == ANIM_TYPE_ROTATION) {
+            rotation[0] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+            rotation[1] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+            rotation[2] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+        }
+        mtxf_rotate_xyz_and_translate(matrix, translation, rotation);
     }
-    mtxf_rotate_xyz_and_translate(matrix, translation, rotation);
-    mtxf_mul(gMatStack[gMatStackIndex + 1], matrix, gMatStack[gMatStackIndex]);
+    stack_mtxf_mul(gMatStack[gMatStackIndex + 1], matrix, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
-    mtxf_to_mtx(matrixPtr, gMatStack[gMatStackIndex]);
+    stack_mtxf_to_mtx(matrixPtr, gMatStack[gMatStackIndex]);
     gMatStackFixed[gMatStackIndex] = matrixPtr;
     if (node->displayList != NULL) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
@@ -634,6 +788,9 @@ void geo_set_animation_globals(struct AnimInfo *node, s32 hasAnimation) {
     } else {
         gCurAnimTranslationMultiplier = (f32) node->animYTrans / (f32) anim->animYTransDivisor;
     }
+#ifndef TARGET_N64
+    sCurAnimCacheEntry = sAnimCacheEnabled ? anim_cache_lookup(anim, gCurrAnimFrame) : NULL;
+#endif
 }
 
 /**
@@ -696,8 +853,8 @@ static void geo_process_shadow(struct GraphNodeShadow *node) {
             mtx = alloc_display_list(sizeof(*mtx));
             gMatStackIndex++;
             mtxf_translate(mtxf, shadowPos);
-            mtxf_mul(gMatStack[gMatStackIndex], mtxf, *gCurGraphNodeCamera->matrixPtr);
-            mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+            stack_mtxf_mul(gMatStack[gMatStackIndex], mtxf, *gCurGraphNodeCamera->matrixPtr);
+            stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
             gMatStackFixed[gMatStackIndex] = mtx;
             if (gShadowAboveWaterOrLava == TRUE) {
                 geo_append_display_list((void *) VIRTUAL_TO_PHYSICAL(shadowList), 4);
@@ -812,14 +969,14 @@ static void geo_process_object(struct Object *node) {
 
     if (node->header.gfx.areaIndex == gCurGraphNodeRoot->areaIndex) {
         if (node->header.gfx.throwMatrix != NULL) {
-            mtxf_mul(gMatStack[gMatStackIndex + 1], *node->header.gfx.throwMatrix,
+            stack_mtxf_mul(gMatStack[gMatStackIndex + 1], *node->header.gfx.throwMatrix,
                      gMatStack[gMatStackIndex]);
         } else if (node->header.gfx.node.flags & GRAPH_RENDER_BILLBOARD) {
-            mtxf_billboard(gMatStack[gMatStackIndex + 1], gMatStack[gMatStackIndex],
+            stack_mtxf_billboard(gMatStack[gMatStackIndex + 1], gMatStack[gMatStackIndex],
                            node->header.gfx.pos, gCurGraphNodeCamera->roll);
         } else {
-            mtxf_rotate_zxy_and_translate(mtxf, node->header.gfx.pos, node->header.gfx.angle);
-            mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
+            stack_mtxf_rotate_zxy_and_translate(mtxf, node->header.gfx.pos, node->header.gfx.angle);
+            stack_mtxf_mul(gMatStack[gMatStackIndex + 1], mtxf, gMatStack[gMatStackIndex]);
         }
 
         mtxf_scale_vec3f(gMatStack[gMatStackIndex + 1], gMatStack[gMatStackIndex + 1],
@@ -836,7 +993,7 @@ static void geo_process_object(struct Object *node) {
         if (obj_is_in_view(&node->header.gfx, gMatStack[gMatStackIndex])) {
             Mtx *mtx = alloc_display_list(sizeof(*mtx));
 
-            mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+            stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
             gMatStackFixed[gMatStackIndex] = mtx;
             if (node->header.gfx.sharedChild != NULL) {
                 gCurGraphNodeObject = (struct GraphNodeObject *) node;
@@ -899,7 +1056,7 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
         gMatStack[gMatStackIndex + 1][3][0] = gMatStack[gMatStackIndex][3][0];
         gMatStack[gMatStackIndex + 1][3][1] = gMatStack[gMatStackIndex][3][1];
         gMatStack[gMatStackIndex + 1][3][2] = gMatStack[gMatStackIndex][3][2];
-        mtxf_mul(gMatStack[gMatStackIndex + 1], mat, gMatStack[gMatStackIndex + 1]);
+        stack_mtxf_mul(gMatStack[gMatStackIndex + 1], mat, gMatStack[gMatStackIndex + 1]);
         mtxf_scale_vec3f(gMatStack[gMatStackIndex + 1], gMatStack[gMatStackIndex + 1],
                          node->objNode->header.gfx.scale);
         if (node->fnNode.func != NULL) {
@@ -907,7 +1064,7 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
                               (struct AllocOnlyPool *) gMatStack[gMatStackIndex + 1]);
         }
         gMatStackIndex++;
-        mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
+        stack_mtxf_to_mtx(mtx, gMatStack[gMatStackIndex]);
         gMatStackFixed[gMatStackIndex] = mtx;
         gGeoTempState.type = gCurAnimType;
         gGeoTempState.enabled = gCurAnimEnabled;
@@ -915,6 +1072,10 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
         gGeoTempState.translationMultiplier = gCurAnimTranslationMultiplier;
         gGeoTempState.attribute = gCurrAnimAttribute;
         gGeoTempState.data = gCurAnimData;
+#ifndef TARGET_N64
+        gGeoTempState.cacheEntry = sCurAnimCacheEntry;
+        gGeoTempState.cacheAnim = sCurAnimCacheEntry != NULL ? sCurAnimCacheEntry->anim : NULL;
+#endif
         gCurAnimType = 0;
         gCurGraphNodeHeldObject = (void *) node;
         if (node->objNode->header.gfx.animInfo.curAnim != NULL) {
@@ -929,6 +1090,15 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
         gCurAnimTranslationMultiplier = gGeoTempState.translationMultiplier;
         gCurrAnimAttribute = gGeoTempState.attribute;
         gCurAnimData = gGeoTempState.data;
+#ifndef TARGET_N64
+        // The held object's animation may have taken over the entry
+        sCurAnimCacheEntry = gGeoTempState.cacheEntry;
+        if (sCurAnimCacheEntry != NULL
+            && (sCurAnimCacheEntry->anim != gGeoTempState.cacheAnim
+                || sCurAnimCacheEntry->frame != gCurrAnimFrame)) {
+            sCurAnimCacheEntry = NULL;
+        }
+#endif
         gMatStackIndex--;
     }
 
@@ -1060,6 +1230,10 @@ void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor)
         initialMatrix = alloc_display_list(sizeof(*initialMatrix));
         gMatStackIndex = 0;
         gCurAnimType = 0;
+#ifndef TARGET_N64
+        sAnimCacheGeneration++;
+        sCurAnimCacheEntry = NULL;
+#endif
         vec3s_set(viewport->vp.vtrans, node->x * 4, node->y * 4, 511);
         vec3s_set(viewport->vp.vscale, node->width * 4, node->height * 4, 511);
         if (b != NULL) {
@@ -1074,7 +1248,7 @@ void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor)
         }
 
         mtxf_identity(gMatStack[gMatStackIndex]);
-        mtxf_to_mtx(initialMatrix, gMatStack[gMatStackIndex]);
+        stack_mtxf_to_mtx(initialMatrix, gMatStack[gMatStackIndex]);
         gMatStackFixed[gMatStackIndex] = initialMatrix;
         gSPViewport(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(viewport));
         gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(gMatStackFixed[gMatStackIndex]),
@@ -1093,3 +1267,63 @@ void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor)
         main_pool_free(gDisplayListHeap);
     }
 }
+
+#ifndef TARGET_N64
+/**
+ * Hand the display lists of an area's static geometry to the renderer, which splits them
+ * into chunks it can cull against the view frustum. Objects are culled by obj_is_in_view
+ * instead, so the object lists are not visited.
+ */
+void geo_register_static_geometry(struct GraphNode *firstNode) {
+    struct GraphNode *curNode = firstNode;
+    void *displayList;
+
+    do {
+        switch (curNode->type) {
+            case GRAPH_NODE_TYPE_DISPLAY_LIST:
+                displayList = ((struct GraphNodeDisplayList *) curNode)->displayList;
+                break;
+            case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+                displayList = ((struct GraphNodeTranslationRotation *) curNode)->displayList;
+                break;
+            case GRAPH_NODE_TYPE_TRANSLATION:
+                displayList = ((struct GraphNodeTranslation *) curNode)->displayList;
+                break;
+            case GRAPH_NODE_TYPE_ROTATION:
+                displayList = ((struct GraphNodeRotation *) curNode)->displayList;
+                break;
+            case GRAPH_NODE_TYPE_SCALE:
+                displayList = ((struct GraphNodeScale *) curNode)->displayList;
+                break;
+            default:
+                displayList = NULL;
+                break;
+        }
+        if (displayList != NULL) {
+            gfx_register_static_geometry(displayList);
+        }
+        if (curNode->children != NULL && curNode->type != GRAPH_NODE_TYPE_OBJECT_PARENT) {
+            geo_register_static_geometry(curNode->children);
+        }
+    } while ((curNode = curNode->next) != firstNode);
+}
+
+/**
+ * Set the kernels the matrix stack is built with. The matrices on the stack
+ * also feed gameplay, such as the held object position and projectiles that
+ * follow a model part, so kernels that don't give the scalar results should
+ * only be used where that is acceptable.
+ */
+void set_matrix_stack_kernels(const struct MtxfKernels *kernels) {
+    sMatStackKernels = kernels;
+}
+
+/**
+ * Enable or disable the cache of animated part rotations.
+ */
+void set_animation_cache(s32 enable) {
+    sAnimCacheEnabled = enable;
+    sAnimCacheGeneration++;
+    sCurAnimCacheEntry = NULL;
+}
+#endif
@@ -29,5 +29,12 @@ extern u16 gAreaUpdateCounter;
 
 void geo_process_node_and_siblings(struct GraphNode *firstNode);
 void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor);
+#ifndef TARGET_N64
+struct MtxfKernels;
+
+void geo_register_static_geometry(struct GraphNode *firstNode);
+void set_matrix_stack_kernels(const struct MtxfKernels *kernels);
+void set_animation_cache(s32 enable);
+#endif
 
 #endif // RENDERING_GRAPH_NODE_H
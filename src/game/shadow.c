@@ -15,7 +15,9 @@
 
 #ifndef TARGET_N64
 // Avoid Z-fighting
-#define find_floor_height_and_data 0.4 + find_floor_height_and_data
+#undef find_floor_height_and_data
+#define find_floor_height_and_data(xPos, yPos, zPos, floorGeo) \
+    0.4 + (COLLISION_QUERY_SITE, find_floor_height_and_data(xPos, yPos, zPos, floorGeo))
 #endif
 
 /**
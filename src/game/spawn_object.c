@@ -50,6 +50,15 @@ void unused_init_free_list(struct LinkedList *usedList, struct LinkedList **pFre
     pool->next = NULL;
 }
 
+#ifdef USE_SYSTEM_MALLOC
+/**
+ * Objects that were malloc'd once the pool ran out. They are kept apart from
+ * the pool slots so that they are only reused when no slot is free, and
+ * objects keep a pool index whenever they can.
+ */
+static struct ObjectNode sFreeMallocObjectList;
+#endif
+
 /**
  * Attempt to allocate a node from freeList (singly linked) and append it
  * to the end of destList (doubly linked). Return the object, or NULL if
@@ -93,9 +102,13 @@ struct Object *try_allocate_object(struct ObjectNode *destList, struct ObjectNod
         destList->prev = nextObj;
     } else {
 #ifdef USE_SYSTEM_MALLOC
-        nextObj = (struct ObjectNode *) malloc(sizeof(struct Object));
-        if (nextObj == NULL) {
-            abort();
+        if ((nextObj = sFreeMallocObjectList.next) != NULL) {
+            sFreeMallocObjectList.next = nextObj->next;
+        } else {
+            nextObj = (struct ObjectNode *) malloc(sizeof(struct Object));
+            if (nextObj == NULL) {
+                abort();
+            }
         }
         // Insert at end of destination list
         nextObj->prev = destList->prev;
@@ -141,12 +154,20 @@ static void deallocate_object(struct ObjectNode *freeList, struct ObjectNode *ob
     obj->next->prev = obj->prev;
     obj->prev->next = obj->next;
 
+#ifdef USE_SYSTEM_MALLOC
+    if (get_object_pool_index((struct Object *) obj) < 0) {
+        freeList = &sFreeMallocObjectList;
+    }
+#endif
+
     // Insert at beginning of free list
     obj->next = freeList->next;
     freeList->next = obj;
+#ifndef TARGET_N64
+    gObjectListGeneration++;
+#endif
 }
 
-#ifndef USE_SYSTEM_MALLOC
 /**
  * Add every object in the pool to the free object list.
  */
@@ -167,7 +188,6 @@ void init_free_object_list(void) {
     // End the list
     obj->header.next = NULL;
 }
-#endif
 
 /**
  * Clear each object list, without adding the objects back to the free list.
@@ -190,6 +210,9 @@ void clear_object_lists(struct ObjectNode *objLists) {
         objLists[i].next = &objLists[i];
         objLists[i].prev = &objLists[i];
     }
+#ifndef TARGET_N64
+    gObjectListGeneration++;
+#endif
 }
 
 /**
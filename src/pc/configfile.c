@@ -30,6 +30,26 @@ struct ConfigOption {
  *Config options and default values
  */
 bool configFullscreen            = false;
+bool configPipelinedRender       = false;
+unsigned int configRenderFps     = 0; // 0 renders once per game frame
+unsigned int configCaptureMode   = 0; // 0 off, 1 PNG sequence, 2 raw video on stdout
+bool configGfxStatsCsv           = false; // write per-frame renderer counters to gfx_stats.csv
+bool configDynamicResolution     = false;
+float configDynResMinScale       = 0.5f;
+float configDynResMaxScale       = 1.0f;
+float configDynResBudgetMs       = 0.0f; // GPU time per frame, 0 for the frame period
+bool configLowLatency            = false; // read input as late as possible before each present
+bool configSortOpaqueDraws       = false; // group opaque draws by shader and texture
+bool configSimdVertexTransform   = true;  // transform vertices with the SIMD vertex kernels
+bool configGpuVertexTransform    = false; // transform vertices in the vertex shader (OpenGL only)
+bool configStaticGeometryCache   = true;  // keep unchanged display lists on the GPU, needs gpu_vertex_transform
+bool configCollisionCache       = false; // reuse floor and ceiling queries until the surfaces change
+bool configCollisionTrace       = false; // write the collision queries to collision_trace.bin for collision_bench
+bool configSurfacePoolStats     = false; // print the peak surface counts of each level to stderr
+bool configDecodedBehaviors     = false; // run behavior scripts from a pre-decoded form
+bool configSimdMatrices         = false; // build the matrix stack with the SIMD matrix kernels
+bool configStrictMatrices       = true;  // keep the SIMD matrix kernels bit-identical to the scalar ones
+bool configAnimationCache       = false; // share animated part rotations between objects on the same frame
 // Keyboard mappings (scancode values)
 unsigned int configKeyA          = 0x26;
 unsigned int configKeyB          = 0x33;
@@ -48,6 +68,26 @@ unsigned int configKeyStickRight = 0x20;
 
 static const struct ConfigOption options[] = {
     {.name = "fullscreen",     .type = CONFIG_TYPE_BOOL, .boolValue = &configFullscreen},
+    {.name = "pipelined_render", .type = CONFIG_TYPE_BOOL, .boolValue = &configPipelinedRender},
+    {.name = "render_fps",     .type = CONFIG_TYPE_UINT, .uintValue = &configRenderFps},
+    {.name = "capture_mode",   .type = CONFIG_TYPE_UINT, .uintValue = &configCaptureMode},
+    {.name = "gfx_stats_csv",  .type = CONFIG_TYPE_BOOL, .boolValue = &configGfxStatsCsv},
+    {.name = "dynamic_resolution", .type = CONFIG_TYPE_BOOL, .boolValue = &configDynamicResolution},
+    {.name = "dynres_min_scale", .type = CONFIG_TYPE_FLOAT, .floatValue = &configDynResMinScale},
+    {.name = "dynres_max_scale", .type = CONFIG_TYPE_FLOAT, .floatValue = &configDynResMaxScale},
+    {.name = "dynres_budget_ms", .type = CONFIG_TYPE_FLOAT, .floatValue = &configDynResBudgetMs},
+    {.name = "low_latency",    .type = CONFIG_TYPE_BOOL, .boolValue = &configLowLatency},
+    {.name = "sort_opaque_draws", .type = CONFIG_TYPE_BOOL, .boolValue = &configSortOpaqueDraws},
+    {.name = "simd_vertex_transform", .type = CONFIG_TYPE_BOOL, .boolValue = &configSimdVertexTransform},
+    {.name = "gpu_vertex_transform", .type = CONFIG_TYPE_BOOL, .boolValue = &configGpuVertexTransform},
+    {.name = "static_geometry_cache", .type = CONFIG_TYPE_BOOL, .boolValue = &configStaticGeometryCache},
+    {.name = "collision_cache", .type = CONFIG_TYPE_BOOL, .boolValue = &configCollisionCache},
+    {.name = "collision_trace", .type = CONFIG_TYPE_BOOL, .boolValue = &configCollisionTrace},
+    {.name = "surface_pool_stats", .type = CONFIG_TYPE_BOOL, .boolValue = &configSurfacePoolStats},
+    {.name = "decoded_behaviors", .type = CONFIG_TYPE_BOOL, .boolValue = &configDecodedBehaviors},
+    {.name = "simd_matrices",  .type = CONFIG_TYPE_BOOL, .boolValue = &configSimdMatrices},
+    {.name = "strict_matrices", .type = CONFIG_TYPE_BOOL, .boolValue = &configStrictMatrices},
+    {.name = "animation_cache", .type = CONFIG_TYPE_BOOL, .boolValue = &configAnimationCache},
     {.name = "key_a",          .type = CONFIG_TYPE_UINT, .uintValue = &configKeyA},
     {.name = "key_b",          .type = CONFIG_TYPE_UINT, .uintValue = &configKeyB},
     {.name = "key_start",      .type = CONFIG_TYPE_UINT, .uintValue = &configKeyStart},
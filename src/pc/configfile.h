@@ -2,6 +2,26 @@
 #define CONFIGFILE_H
 
 extern bool         configFullscreen;
+extern bool         configPipelinedRender;
+extern unsigned int configRenderFps;
+extern unsigned int configCaptureMode;
+extern bool         configGfxStatsCsv;
+extern bool         configDynamicResolution;
+extern float        configDynResMinScale;
+extern float        configDynResMaxScale;
+extern float        configDynResBudgetMs;
+extern bool         configLowLatency;
+extern bool         configSortOpaqueDraws;
+extern bool         configSimdVertexTransform;
+extern bool         configGpuVertexTransform;
+extern bool         configStaticGeometryCache;
+extern bool         configCollisionCache;
+extern bool         configCollisionTrace;
+extern bool         configSurfacePoolStats;
+extern bool         configDecodedBehaviors;
+extern bool         configSimdMatrices;
+extern bool         configStrictMatrices;
+extern bool         configAnimationCache;
 extern unsigned int configKeyA;
 extern unsigned int configKeyB;
 extern unsigned int configKeyStart;
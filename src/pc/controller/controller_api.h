@@ -8,4 +8,8 @@ struct ControllerAPI {
     void (*read)(OSContPad *pad);
 };
 
+// Reads the controllers now, on the calling thread. osContGetReadData returns
+// this reading from then on, until the next call.
+void controller_latch_input(void);
+
 #endif
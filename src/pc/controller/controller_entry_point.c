@@ -41,7 +41,10 @@ s32 osContStartReadData(UNUSED OSMesgQueue *mesg) {
     return 0;
 }
 
-void osContGetReadData(OSContPad *pad) {
+static bool input_latched;
+static OSContPad latched_pad;
+
+static void controller_read_all(OSContPad *pad) {
     pad->button = 0;
     pad->stick_x = 0;
     pad->stick_y = 0;
@@ -51,3 +54,16 @@ void osContGetReadData(OSContPad *pad) {
         controller_implementations[i]->read(pad);
     }
 }
+
+void controller_latch_input(void) {
+    controller_read_all(&latched_pad);
+    input_latched = true;
+}
+
+void osContGetReadData(OSContPad *pad) {
+    if (input_latched) {
+        *pad = latched_pad;
+        return;
+    }
+    controller_read_all(pad);
+}
@@ -0,0 +1,243 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(TARGET_WEB)
+#define CAPTURE_THREADS 1
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_STATIC
+#include "tools/stb/stb_image_write.h"
+
+#include "gfx_rendering_api.h"
+#include "gfx_capture.h"
+
+// Frame capture. The rendering API reads frames back asynchronously, the main thread only
+// copies them into a queue, and encoder threads write them out. PNG frames are independent,
+// so several threads encode them at once. Raw frames must stay in order and use a single one.
+
+#define MAX_ENCODER_THREADS 4
+#define QUEUE_LEN (2 * MAX_ENCODER_THREADS + 2)
+
+enum {
+    SLOT_FREE,
+    SLOT_FILLED,
+    SLOT_ENCODING
+};
+
+struct CaptureSlot {
+    uint8_t *pixels; // RGBA8, top to bottom
+    size_t capacity;
+    uint32_t width, height;
+    uint32_t number;
+    int state;
+};
+
+static struct {
+    enum GfxCaptureMode mode;
+    struct GfxRenderingAPI *rapi;
+    uint32_t frame_number;
+    uint32_t raw_width, raw_height;
+    FILE *raw_file; // the original stdout
+    struct CaptureSlot slots[QUEUE_LEN];
+    int head; // next slot to fill
+    int tail; // next slot to encode
+#ifdef CAPTURE_THREADS
+    pthread_t threads[MAX_ENCODER_THREADS];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool quit;
+#endif
+} capture;
+
+static void gfx_capture_encode(struct CaptureSlot *slot) {
+    // Drop the alpha channel, which holds blending leftovers rather than coverage
+    size_t num_pixels = (size_t)slot->width * slot->height;
+    uint8_t *rgb = slot->pixels;
+    for (size_t i = 0; i < num_pixels; i++) {
+        rgb[i * 3 + 0] = slot->pixels[i * 4 + 0];
+        rgb[i * 3 + 1] = slot->pixels[i * 4 + 1];
+        rgb[i * 3 + 2] = slot->pixels[i * 4 + 2];
+    }
+
+    if (capture.mode == GFX_CAPTURE_PNG) {
+        char name[32];
+        sprintf(name, "frame_%06u.png", slot->number);
+        if (!stbi_write_png(name, slot->width, slot->height, 3, rgb, slot->width * 3)) {
+            fprintf(stderr, "Could not write %s\n", name);
+        }
+    } else {
+        if (slot->width != capture.raw_width || slot->height != capture.raw_height) {
+            // A raw stream can't change size, so frames after a resize are skipped
+            return;
+        }
+        fwrite(rgb, 3, num_pixels, capture.raw_file);
+        fflush(capture.raw_file);
+    }
+}
+
+#ifdef CAPTURE_THREADS
+static void *gfx_capture_thread_main(void *arg) {
+    pthread_mutex_lock(&capture.lock);
+    for (;;) {
+        struct CaptureSlot *slot = &capture.slots[capture.tail];
+        if (slot->state == SLOT_FILLED) {
+            slot->state = SLOT_ENCODING;
+            capture.tail = (capture.tail + 1) % QUEUE_LEN;
+            pthread_mutex_unlock(&capture.lock);
+
+            gfx_capture_encode(slot);
+
+            pthread_mutex_lock(&capture.lock);
+            slot->state = SLOT_FREE;
+            pthread_cond_broadcast(&capture.cond);
+        } else if (capture.quit) {
+            break;
+        } else {
+            pthread_cond_wait(&capture.cond, &capture.lock);
+        }
+    }
+    pthread_mutex_unlock(&capture.lock);
+    return NULL;
+}
+#endif
+
+bool gfx_capture_start(struct GfxRenderingAPI *rapi, enum GfxCaptureMode mode) {
+    if (mode == GFX_CAPTURE_OFF || capture.mode != GFX_CAPTURE_OFF) {
+        return false;
+    }
+    if (rapi->read_frame == NULL) {
+        fprintf(stderr, "Frame capture is not supported by this rendering API\n");
+        return false;
+    }
+    if (mode == GFX_CAPTURE_RAW) {
+        // Frames are written to a copy of stdout, and stdout itself goes to stderr, so that
+        // messages printed by the game don't end up in the middle of the stream
+        int fd = dup(fileno(stdout));
+        capture.raw_file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+        if (capture.raw_file == NULL) {
+            fprintf(stderr, "Could not open stdout for frame capture\n");
+            return false;
+        }
+#ifdef _WIN32
+        _setmode(fd, _O_BINARY);
+#endif
+        dup2(fileno(stderr), fileno(stdout));
+    } else {
+        // Fast settings, PNG encoding is what limits the capture rate
+        stbi_write_png_compression_level = 2;
+        stbi_write_force_png_filter = 4;
+    }
+    capture.mode = mode;
+    capture.rapi = rapi;
+
+#ifdef CAPTURE_THREADS
+    int num_threads = 1;
+    if (mode == GFX_CAPTURE_PNG) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus <= 2 ? 1 : (cpus - 1 > MAX_ENCODER_THREADS ? MAX_ENCODER_THREADS : cpus - 1);
+    }
+    pthread_mutex_init(&capture.lock, NULL);
+    pthread_cond_init(&capture.cond, NULL);
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&capture.threads[i], NULL, gfx_capture_thread_main, NULL) == 0) {
+            capture.num_threads++;
+        }
+    }
+#endif
+    atexit(gfx_capture_stop);
+    return true;
+}
+
+void gfx_capture_frame(struct GfxRenderingAPI *rapi, uint32_t width, uint32_t height) {
+    if (capture.mode == GFX_CAPTURE_OFF) {
+        return;
+    }
+    const uint8_t *pixels = rapi->read_frame(&width, &height);
+    if (pixels == NULL) {
+        return;
+    }
+    if (capture.mode == GFX_CAPTURE_RAW && capture.raw_width == 0) {
+        capture.raw_width = width;
+        capture.raw_height = height;
+        fprintf(stderr, "Capturing %ux%u rgb24 frames to stdout\n", width, height);
+    }
+
+    struct CaptureSlot *slot = &capture.slots[capture.head];
+#ifdef CAPTURE_THREADS
+    if (capture.num_threads > 0) {
+        // Wait for a free slot rather than drop the frame
+        pthread_mutex_lock(&capture.lock);
+        while (slot->state != SLOT_FREE) {
+            pthread_cond_wait(&capture.cond, &capture.lock);
+        }
+        pthread_mutex_unlock(&capture.lock);
+    }
+#endif
+
+    size_t size = (size_t)width * height * 4;
+    if (slot->capacity < size) {
+        free(slot->pixels);
+        slot->pixels = malloc(size);
+        slot->capacity = slot->pixels != NULL ? size : 0;
+        if (slot->pixels == NULL) {
+            return;
+        }
+    }
+    // The rendering API returns rows from bottom to top
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(slot->pixels + (size_t)y * width * 4, pixels + (size_t)(height - 1 - y) * width * 4, (size_t)width * 4);
+    }
+    slot->width = width;
+    slot->height = height;
+    slot->number = capture.frame_number++;
+    capture.head = (capture.head + 1) % QUEUE_LEN;
+
+#ifdef CAPTURE_THREADS
+    if (capture.num_threads > 0) {
+        pthread_mutex_lock(&capture.lock);
+        slot->state = SLOT_FILLED;
+        pthread_cond_broadcast(&capture.cond);
+        pthread_mutex_unlock(&capture.lock);
+        return;
+    }
+#endif
+    gfx_capture_encode(slot);
+}
+
+// Writes out the queued frames
+void gfx_capture_stop(void) {
+    if (capture.mode == GFX_CAPTURE_OFF) {
+        return;
+    }
+    // The rendering API still holds the last frame it read back
+    gfx_capture_frame(capture.rapi, 0, 0);
+#ifdef CAPTURE_THREADS
+    pthread_mutex_lock(&capture.lock);
+    capture.quit = true;
+    pthread_cond_broadcast(&capture.cond);
+    pthread_mutex_unlock(&capture.lock);
+    for (int i = 0; i < capture.num_threads; i++) {
+        pthread_join(capture.threads[i], NULL);
+    }
+    capture.num_threads = 0;
+    capture.quit = false;
+#endif
+    if (capture.raw_file != NULL) {
+        fclose(capture.raw_file);
+        capture.raw_file = NULL;
+    }
+    capture.mode = GFX_CAPTURE_OFF;
+}
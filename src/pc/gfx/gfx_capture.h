@@ -0,0 +1,27 @@
+#ifndef GFX_CAPTURE_H
+#define GFX_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct GfxRenderingAPI;
+
+enum GfxCaptureMode {
+    GFX_CAPTURE_OFF,
+    GFX_CAPTURE_PNG, // frame_000000.png, frame_000001.png, ... in the working directory
+    GFX_CAPTURE_RAW  // rgb24 frames on stdout, the size is printed to stderr
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool gfx_capture_start(struct GfxRenderingAPI *rapi, enum GfxCaptureMode mode);
+void gfx_capture_frame(struct GfxRenderingAPI *rapi, uint32_t width, uint32_t height);
+void gfx_capture_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,6 +30,7 @@ enum {
 #define SHADER_OPT_FOG (1 << 25)
 #define SHADER_OPT_TEXTURE_EDGE (1 << 26)
 #define SHADER_OPT_NOISE (1 << 27)
+#define SHADER_OPT_GPU_TRANSFORM (1 << 28)
 
 struct CCFeatures {
     uint8_t c[2][4];
@@ -37,6 +38,7 @@ struct CCFeatures {
     bool opt_fog;
     bool opt_texture_edge;
     bool opt_noise;
+    bool opt_gpu_transform;
     bool used_textures[2];
     int num_inputs;
     bool do_single[2];
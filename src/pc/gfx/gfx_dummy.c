@@ -1,9 +1,9 @@
 #ifdef ENABLE_GFX_DUMMY
-#include <time.h>
-#include <errno.h>
-
 #include "gfx_window_manager_api.h"
 #include "gfx_rendering_api.h"
+#include "gfx_frame_limiter.h"
+
+static double last_present; // when the last frame was due
 
 static void gfx_dummy_wm_init(const char *game_name, bool start_in_fullscreen) {
 }
@@ -38,44 +38,24 @@ static bool gfx_dummy_wm_start_frame(void) {
 static void gfx_dummy_wm_swap_buffers_begin(void) {
 }
 
-static struct timespec gfx_dummy_wm_timediff(struct timespec t1, struct timespec t2) {
-    t1.tv_sec -= t2.tv_sec;
-    t1.tv_nsec -= t2.tv_nsec;
-    if (t1.tv_nsec < 0) {
-        t1.tv_nsec += 1000000000;
-        t1.tv_sec -= 1;
-    }
-    return t1;
+static void gfx_dummy_wm_swap_buffers_end(void) {
+    last_present = gfx_frame_limiter_wait();
 }
 
-static struct timespec gfx_dummy_wm_timeadd(struct timespec t1, struct timespec t2) {
-    t1.tv_sec += t2.tv_sec;
-    t1.tv_nsec += t2.tv_nsec;
-    if (t1.tv_nsec > 1000000000) {
-        t1.tv_nsec -= 1000000000;
-        t1.tv_sec += 1;
-    }
-    return t1;
+static double gfx_dummy_wm_get_time(void) {
+    return gfx_frame_limiter_get_time();
 }
 
-static void gfx_dummy_wm_swap_buffers_end(void) {
-    static struct timespec prev;
-    struct timespec t;
-    clock_gettime(CLOCK_MONOTONIC, &t);
-    struct timespec diff = gfx_dummy_wm_timediff(t, prev);
-    if (diff.tv_sec == 0 && diff.tv_nsec < 1000000000 / 30) {
-        struct timespec add = {0, 1000000000 / 30};
-        struct timespec next = gfx_dummy_wm_timeadd(prev, add);
-        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
-        }
-        prev = next;
-    } else {
-        prev = t;
-    }
+static double gfx_dummy_wm_get_next_present_time(void) {
+    return gfx_frame_limiter_get_next_deadline();
 }
 
-static double gfx_dummy_wm_get_time(void) {
-    return 0.0;
+static double gfx_dummy_wm_get_last_present_time(void) {
+    return last_present;
+}
+
+static void gfx_dummy_wm_set_target_fps(uint32_t fps) {
+    gfx_frame_limiter_set_fps(fps);
 }
 
 static bool gfx_dummy_renderer_z_is_from_0_to_1(void) {
@@ -162,7 +142,10 @@ struct GfxWindowManagerAPI gfx_dummy_wm_api = {
     gfx_dummy_wm_start_frame,
     gfx_dummy_wm_swap_buffers_begin,
     gfx_dummy_wm_swap_buffers_end,
-    gfx_dummy_wm_get_time
+    gfx_dummy_wm_get_time,
+    gfx_dummy_wm_set_target_fps,
+    gfx_dummy_wm_get_next_present_time,
+    gfx_dummy_wm_get_last_present_time
 };
 
 struct GfxRenderingAPI gfx_dummy_renderer_api = {
@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+#include "gfx_frame_limiter.h"
+
+// Frame limiter for when vsync doesn't pace the frames. Sleeping alone wakes up late by up to
+// the scheduler's granularity, a millisecond or more, so it sleeps until a margin before the
+// deadline and spins on the clock for the rest. The margin follows how late sleeps wake up.
+// Deadlines lie on a fixed timeline, so a frame that is released late is made up by the next.
+
+#define NS_PER_SEC 1000000000LL
+#define MIN_SPIN_MARGIN 200000LL  // 0.2 ms
+#define MAX_SPIN_MARGIN 4000000LL // 4 ms
+
+static struct {
+    uint32_t fps;
+    int64_t base;  // start of the timeline
+    uint64_t frame; // frames since base
+    int64_t spin_margin;
+    bool started;
+} limiter = { 30, 0, 0, 2000000LL, false };
+
+static int64_t gfx_frame_limiter_now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&counter);
+    return (int64_t)(counter.QuadPart / freq.QuadPart) * NS_PER_SEC
+           + (int64_t)(counter.QuadPart % freq.QuadPart) * NS_PER_SEC / freq.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * NS_PER_SEC + t.tv_nsec;
+#endif
+}
+
+static void gfx_frame_limiter_sleep(int64_t ns) {
+#ifdef _WIN32
+    Sleep((DWORD)(ns / 1000000));
+#else
+    struct timespec t = { ns / NS_PER_SEC, ns % NS_PER_SEC };
+    while (nanosleep(&t, &t) == -1 && errno == EINTR) {
+    }
+#endif
+}
+
+static int64_t gfx_frame_limiter_deadline(uint64_t frame) {
+    return limiter.base + (int64_t)(frame * NS_PER_SEC / limiter.fps);
+}
+
+void gfx_frame_limiter_set_fps(uint32_t fps) {
+    if (fps == 0 || fps == limiter.fps) {
+        return;
+    }
+    // Continue the timeline from the last deadline at the new rate
+    if (limiter.started) {
+        limiter.base = gfx_frame_limiter_deadline(limiter.frame);
+        limiter.frame = 0;
+    }
+    limiter.fps = fps;
+}
+
+double gfx_frame_limiter_wait(void) {
+    int64_t now = gfx_frame_limiter_now();
+    if (!limiter.started) {
+#ifdef _WIN32
+        // Sleep() has a granularity of 15.6 ms otherwise
+        timeBeginPeriod(1);
+#endif
+        limiter.base = now;
+        limiter.frame = 0;
+        limiter.started = true;
+        return now / (double)NS_PER_SEC;
+    }
+
+    int64_t deadline = gfx_frame_limiter_deadline(limiter.frame + 1);
+    if (now - deadline > NS_PER_SEC / limiter.fps) {
+        // More than a frame late, a hitch. Start over rather than rush the following frames.
+        limiter.base = now;
+        limiter.frame = 0;
+        return now / (double)NS_PER_SEC;
+    }
+    limiter.frame++;
+
+    while (deadline - now > limiter.spin_margin) {
+        int64_t sleep_ns = deadline - now - limiter.spin_margin;
+        gfx_frame_limiter_sleep(sleep_ns);
+        int64_t woke = gfx_frame_limiter_now();
+        int64_t overshoot = woke - now - sleep_ns;
+        // Widen the margin at once when a sleep overshoots it, narrow it slowly otherwise
+        if (overshoot > limiter.spin_margin) {
+            limiter.spin_margin = overshoot < MAX_SPIN_MARGIN ? overshoot : MAX_SPIN_MARGIN;
+        } else {
+            limiter.spin_margin -= (limiter.spin_margin - overshoot) / 64;
+            if (limiter.spin_margin < MIN_SPIN_MARGIN) {
+                limiter.spin_margin = MIN_SPIN_MARGIN;
+            }
+        }
+        now = woke;
+    }
+    while (now < deadline) {
+        now = gfx_frame_limiter_now();
+    }
+    return deadline / (double)NS_PER_SEC;
+}
+
+double gfx_frame_limiter_get_next_deadline(void) {
+    if (!limiter.started) {
+        return (gfx_frame_limiter_now() + NS_PER_SEC / limiter.fps) / (double)NS_PER_SEC;
+    }
+    return gfx_frame_limiter_deadline(limiter.frame + 1) / (double)NS_PER_SEC;
+}
+
+double gfx_frame_limiter_get_time(void) {
+    return gfx_frame_limiter_now() / (double)NS_PER_SEC;
+}
@@ -0,0 +1,21 @@
+#ifndef GFX_FRAME_LIMITER_H
+#define GFX_FRAME_LIMITER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void gfx_frame_limiter_set_fps(uint32_t fps);
+// Blocks until the next frame is due, returns when it was due in seconds
+double gfx_frame_limiter_wait(void);
+double gfx_frame_limiter_get_next_deadline(void);
+// In seconds, from the monotonic clock the limiter uses
+double gfx_frame_limiter_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
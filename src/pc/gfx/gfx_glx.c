@@ -178,6 +178,7 @@ static struct {
     uint64_t ust0;
     int64_t last_msc;
     uint64_t wanted_ust; // multiplied by FRAME_INTERVAL_US_DENOMINATOR
+    uint64_t frame_interval; // multiplied by FRAME_INTERVAL_US_DENOMINATOR
     uint64_t vsync_interval;
     uint64_t last_ust;
     int64_t target_msc;
@@ -381,6 +382,7 @@ static void gfx_glx_init(const char *game_name, bool start_in_fullscreen) {
         }
     }
     glx.vsync_interval = 16666;
+    glx.frame_interval = FRAME_INTERVAL_US_NUMERATOR;
 }
 
 static void gfx_glx_set_fullscreen_changed_callback(void (*on_fullscreen_changed)(bool is_now_fullscreen)) {
@@ -453,7 +455,7 @@ static bool gfx_glx_start_frame(void) {
 }
 
 static void gfx_glx_swap_buffers_begin(void) {
-    glx.wanted_ust += FRAME_INTERVAL_US_NUMERATOR; // advance 1/30 seconds on JP/US or 1/25 seconds on EU
+    glx.wanted_ust += glx.frame_interval; // advance 1/30 seconds on JP/US or 1/25 seconds on EU, unless a frame rate is set
     
     if (!glx.has_oml_sync_control && !glx.has_sgi_video_sync) {
         glFlush();
@@ -467,8 +469,8 @@ static void gfx_glx_swap_buffers_begin(void) {
             }
         }
         
-        if (target + 2 * FRAME_INTERVAL_US_NUMERATOR / FRAME_INTERVAL_US_DENOMINATOR < now) {
-            if (target + 32 * FRAME_INTERVAL_US_NUMERATOR / FRAME_INTERVAL_US_DENOMINATOR >= now) {
+        if (target + 2 * glx.frame_interval / FRAME_INTERVAL_US_DENOMINATOR < now) {
+            if (target + 32 * glx.frame_interval / FRAME_INTERVAL_US_DENOMINATOR >= now) {
                 printf("Dropping frame\n");
                 glx.dropped_frame = true;
                 return;
@@ -479,6 +481,7 @@ static void gfx_glx_swap_buffers_begin(void) {
         }
         glXSwapBuffers(glx.dpy, glx.win);
         glx.dropped_frame = false;
+        glx.last_ust = (uint64_t)get_time() - glx.ust0;
         
         return;
     }
@@ -493,7 +496,7 @@ static void gfx_glx_swap_buffers_begin(void) {
     if (floor(vsyncs_to_wait) != vsyncs_to_wait) {
         uint64_t left_ust = glx.last_ust + floor(vsyncs_to_wait) * glx.vsync_interval;
         uint64_t right_ust = glx.last_ust + ceil(vsyncs_to_wait) * glx.vsync_interval;
-        uint64_t adjusted_wanted_ust = glx.wanted_ust / FRAME_INTERVAL_US_DENOMINATOR + (glx.last_ust + FRAME_INTERVAL_US_NUMERATOR / FRAME_INTERVAL_US_DENOMINATOR > glx.wanted_ust / FRAME_INTERVAL_US_DENOMINATOR ? 2000 : -2000);
+        uint64_t adjusted_wanted_ust = glx.wanted_ust / FRAME_INTERVAL_US_DENOMINATOR + (glx.last_ust + glx.frame_interval / FRAME_INTERVAL_US_DENOMINATOR > glx.wanted_ust / FRAME_INTERVAL_US_DENOMINATOR ? 2000 : -2000);
         int64_t diff_left = adjusted_wanted_ust - left_ust;
         int64_t diff_right = right_ust - adjusted_wanted_ust;
         if (diff_left < 0) {
@@ -599,8 +602,29 @@ static void gfx_glx_swap_buffers_end(void) {
     }
 }
 
+static void gfx_glx_set_target_fps(uint32_t fps) {
+    glx.frame_interval = 1000000ULL * FRAME_INTERVAL_US_DENOMINATOR / fps;
+}
+
 static double gfx_glx_get_time(void) {
-    return 0.0;
+    return (get_time() - (int64_t)glx.ust0) / 1000000.0;
+}
+
+// The vsync that the next swap_buffers_begin will target, see there
+static double gfx_glx_get_next_present_time(void) {
+    uint64_t wanted = (glx.wanted_ust + glx.frame_interval) / FRAME_INTERVAL_US_DENOMINATOR;
+    if (!glx.has_oml_sync_control && !glx.has_sgi_video_sync) {
+        return wanted / 1000000.0;
+    }
+    double vsyncs = round((int64_t)(wanted - glx.last_ust) / (double)glx.vsync_interval);
+    if (vsyncs < 1) {
+        vsyncs = 1;
+    }
+    return (glx.last_ust + vsyncs * glx.vsync_interval) / 1000000.0;
+}
+
+static double gfx_glx_get_last_present_time(void) {
+    return glx.last_ust / 1000000.0;
 }
 
 struct GfxWindowManagerAPI gfx_glx = {
@@ -614,7 +638,10 @@ struct GfxWindowManagerAPI gfx_glx = {
     gfx_glx_start_frame,
     gfx_glx_swap_buffers_begin,
     gfx_glx_swap_buffers_end,
-    gfx_glx_get_time
+    gfx_glx_get_time,
+    gfx_glx_set_target_fps,
+    gfx_glx_get_next_present_time,
+    gfx_glx_get_last_present_time
 };
 
 #endif
@@ -28,24 +28,142 @@
 #include "gfx_cc.h"
 #include "gfx_rendering_api.h"
 
+// Size of the streaming vertex buffer. Each flush is written to the next free range
+// of this ring instead of reallocating the buffer with glBufferData.
+#define VBO_RING_SIZE (4 * 1024 * 1024)
+#define VBO_RING_SEGMENTS 4
+#define VBO_RING_SEGMENT_SIZE (VBO_RING_SIZE / VBO_RING_SEGMENTS)
+
+#define MAX_STATIC_MESHES 1024
+
+// Tokens and entry points for GL_ARB_buffer_storage and GL_ARB_sync,
+// which the GL 2.1 / GLES2 headers don't declare.
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#define GFX_GL_MAP_WRITE_BIT 0x0002
+#define GFX_GL_MAP_PERSISTENT_BIT 0x0040
+#define GFX_GL_MAP_COHERENT_BIT 0x0080
+#define GFX_GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GFX_GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GFX_GL_TIMEOUT_EXPIRED 0x911B
+#define GFX_GL_PIXEL_PACK_BUFFER 0x88EB
+#define GFX_GL_STREAM_READ 0x88E1
+#define GFX_GL_READ_ONLY 0x88B8
+#define GFX_GL_DEPTH_COMPONENT24 0x81A6
+#define GFX_GL_TIME_ELAPSED 0x88BF
+#define GFX_GL_QUERY_RESULT 0x8866
+#define GFX_GL_QUERY_RESULT_AVAILABLE 0x8867
+#define GFX_GL_GPU_DISJOINT 0x8FBB
+
+#define GPU_TIMER_QUERIES 4
+
+typedef struct __GLsync *gfx_gl_sync_t;
+typedef void (APIENTRY *gfx_gl_buffer_storage_t)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void *(APIENTRY *gfx_gl_map_buffer_range_t)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef gfx_gl_sync_t (APIENTRY *gfx_gl_fence_sync_t)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY *gfx_gl_client_wait_sync_t)(gfx_gl_sync_t sync, GLbitfield flags, uint64_t timeout);
+typedef void (APIENTRY *gfx_gl_delete_sync_t)(gfx_gl_sync_t sync);
+typedef void *(APIENTRY *gfx_gl_map_buffer_t)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY *gfx_gl_unmap_buffer_t)(GLenum target);
+typedef void (APIENTRY *gfx_gl_gen_queries_t)(GLsizei n, GLuint *ids);
+typedef void (APIENTRY *gfx_gl_begin_query_t)(GLenum target, GLuint id);
+typedef void (APIENTRY *gfx_gl_end_query_t)(GLenum target);
+typedef void (APIENTRY *gfx_gl_get_query_objectiv_t)(GLuint id, GLenum pname, GLint *params);
+typedef void (APIENTRY *gfx_gl_get_query_objectui64v_t)(GLuint id, GLenum pname, uint64_t *params);
+
+#if !FOR_WINDOWS && (defined(__linux__) || defined(__BSD__))
+// The GLX window manager doesn't initialize SDL video, so query libGL directly
+extern void (*glXGetProcAddressARB(const GLubyte *proc_name))(void);
+#endif
+
 struct ShaderProgram {
     uint32_t shader_id;
     GLuint opengl_program_id;
     uint8_t num_inputs;
     bool used_textures[2];
     uint8_t num_floats;
-    GLint attrib_locations[7];
-    uint8_t attrib_sizes[7];
+    GLint attrib_locations[9];
+    uint8_t attrib_sizes[9];
     uint8_t num_attribs;
     bool used_noise;
     GLint frame_count_location;
     GLint window_height_location;
+    bool gpu_transform;
+    GLint transforms_location;
+    uint32_t transforms_generation;
 };
 
-static struct ShaderProgram shader_program_pool[64];
+static struct ShaderProgram shader_program_pool[128];
 static uint8_t shader_program_pool_size;
 static GLuint opengl_vbo;
 
+static struct {
+    bool persistent;
+    uint8_t *mapped;
+    size_t offset;
+    gfx_gl_sync_t fences[VBO_RING_SEGMENTS];
+
+    gfx_gl_buffer_storage_t glBufferStorage;
+    gfx_gl_map_buffer_range_t glMapBufferRange;
+    gfx_gl_fence_sync_t glFenceSync;
+    gfx_gl_client_wait_sync_t glClientWaitSync;
+    gfx_gl_delete_sync_t glDeleteSync;
+} vbo_ring;
+
+static struct {
+    GLuint vbo, ibo; // 0 for a free mesh
+} static_meshes[MAX_STATIC_MESHES];
+
+// Frame capture: each frame is read into one of two pixel pack buffers and mapped a frame
+// later, when the GPU is done with it. Without pixel buffer objects frames are read directly.
+static struct {
+    bool initialized;
+    GLuint pbos[2];
+    size_t pbo_sizes[2];
+    uint32_t widths[2], heights[2]; // size of the frame queued in each buffer, 0 if none
+    int next;
+    int mapped; // buffer to unmap, -1 if none
+    uint8_t *pixels;
+    size_t pixels_size;
+
+    gfx_gl_map_buffer_t glMapBuffer;
+    gfx_gl_unmap_buffer_t glUnmapBuffer;
+} readback;
+
+// Dynamic resolution: the scene is drawn into the lower left corner of an offscreen target,
+// which only grows, and stretched over the window by end_scene.
+static struct {
+    GLuint fbo, texture, depth;
+    uint32_t tex_width, tex_height;
+    uint32_t width, height; // part of the target the scene is drawn into
+    GLuint program, vbo;
+    GLint pos_location, tex_rect_location;
+} scene_target;
+
+// GPU frame timing. Each frame is timed with the next of a few queries, whose result is
+// collected when a later frame starts, so that waiting for it never stalls.
+static struct {
+    bool supported;
+    bool check_disjoint;
+    bool active;
+    GLuint queries[GPU_TIMER_QUERIES];
+    bool pending[GPU_TIMER_QUERIES];
+    int next;
+    uint32_t last_us;
+
+    gfx_gl_gen_queries_t glGenQueries;
+    gfx_gl_begin_query_t glBeginQuery;
+    gfx_gl_end_query_t glEndQuery;
+    gfx_gl_get_query_objectiv_t glGetQueryObjectiv;
+    gfx_gl_get_query_objectui64v_t glGetQueryObjectui64v;
+} gpu_timer;
+
+static float transform_slots[GFX_MAX_TRANSFORM_SLOTS * GFX_TRANSFORM_SLOT_VEC4S][4];
+static size_t transform_slots_count;
+static uint32_t transforms_generation = 1;
+static struct ShaderProgram *current_program;
+
 static uint32_t frame_count;
 static uint32_t current_height;
 
@@ -53,9 +171,9 @@ static bool gfx_opengl_z_is_from_0_to_1(void) {
     return false;
 }
 
-static void gfx_opengl_vertex_array_set_attribs(struct ShaderProgram *prg) {
+static void gfx_opengl_vertex_array_set_attribs(struct ShaderProgram *prg, size_t first_float) {
     size_t num_floats = prg->num_floats;
-    size_t pos = 0;
+    size_t pos = first_float;
 
     for (int i = 0; i < prg->num_attribs; i++) {
         glEnableVertexAttribArray(prg->attrib_locations[i]);
@@ -80,8 +198,9 @@ static void gfx_opengl_unload_shader(struct ShaderProgram *old_prg) {
 }
 
 static void gfx_opengl_load_shader(struct ShaderProgram *new_prg) {
+    current_program = new_prg;
     glUseProgram(new_prg->opengl_program_id);
-    gfx_opengl_vertex_array_set_attribs(new_prg);
+    gfx_opengl_vertex_array_set_attribs(new_prg, 0);
     gfx_opengl_set_uniforms(new_prg);
 }
 
@@ -168,19 +287,32 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     struct CCFeatures cc_features;
     gfx_cc_get_features(shader_id, &cc_features);
 
-    char vs_buf[1024];
+    char vs_buf[4096];
     char fs_buf[1024];
     size_t vs_len = 0;
     size_t fs_len = 0;
     size_t num_floats = 4;
+    bool use_textures = cc_features.used_textures[0] || cc_features.used_textures[1];
 
     // Vertex shader
     append_line(vs_buf, &vs_len, "#version 110");
-    append_line(vs_buf, &vs_len, "attribute vec4 aVtxPos;");
-    if (cc_features.used_textures[0] || cc_features.used_textures[1]) {
+    if (cc_features.opt_gpu_transform) {
+        // Raw Vtx data: object position and transform slot, color or normal, texture coordinates
+        append_line(vs_buf, &vs_len, "attribute vec4 aObPos;");
+        append_line(vs_buf, &vs_len, "attribute vec4 aVtxColor;");
+        vs_len += sprintf(vs_buf + vs_len, "uniform vec4 uTransforms[%d];\n", GFX_MAX_TRANSFORM_SLOTS * GFX_TRANSFORM_SLOT_VEC4S);
+        num_floats += 4;
+    } else {
+        append_line(vs_buf, &vs_len, "attribute vec4 aVtxPos;");
+    }
+    if (use_textures) {
         append_line(vs_buf, &vs_len, "attribute vec2 aTexCoord;");
         append_line(vs_buf, &vs_len, "varying vec2 vTexCoord;");
         num_floats += 2;
+        if (cc_features.opt_gpu_transform) {
+            append_line(vs_buf, &vs_len, "attribute vec4 aTexTile;");
+            num_floats += 4;
+        }
     }
     if (cc_features.opt_fog) {
         append_line(vs_buf, &vs_len, "attribute vec4 aFog;");
@@ -192,17 +324,71 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
         vs_len += sprintf(vs_buf + vs_len, "varying vec%d vInput%d;\n", cc_features.opt_alpha ? 4 : 3, i + 1);
         num_floats += cc_features.opt_alpha ? 4 : 3;
     }
-    append_line(vs_buf, &vs_len, "void main() {");
-    if (cc_features.used_textures[0] || cc_features.used_textures[1]) {
-        append_line(vs_buf, &vs_len, "vTexCoord = aTexCoord;");
+    if (cc_features.opt_gpu_transform) {
+        // Input components of -1 select the shade color and -2 the LOD fraction
+        append_line(vs_buf, &vs_len, "vec4 resolve_input(vec4 a, vec4 shade, float lod) {");
+        append_line(vs_buf, &vs_len, "    vec4 is_shade = step(-1.5, a) - step(-0.5, a);");
+        append_line(vs_buf, &vs_len, "    vec4 is_lod = 1.0 - step(-1.5, a);");
+        append_line(vs_buf, &vs_len, "    return a * (1.0 - is_shade - is_lod) + shade * is_shade + lod * is_lod;");
+        append_line(vs_buf, &vs_len, "}");
     }
-    if (cc_features.opt_fog) {
-        append_line(vs_buf, &vs_len, "vFog = aFog;");
-    }
-    for (int i = 0; i < cc_features.num_inputs; i++) {
-        vs_len += sprintf(vs_buf + vs_len, "vInput%d = aInput%d;\n", i + 1, i + 1);
+    append_line(vs_buf, &vs_len, "void main() {");
+    if (cc_features.opt_gpu_transform) {
+        // Same computation as gfx_sp_vertex, see the slot layout in gfx_rendering_api.h
+        vs_len += sprintf(vs_buf + vs_len, "int base = int(aObPos.w) * %d;\n", GFX_TRANSFORM_SLOT_VEC4S);
+        append_line(vs_buf, &vs_len, "vec4 pos = mat4(uTransforms[base], uTransforms[base + 1], uTransforms[base + 2], uTransforms[base + 3]) * vec4(aObPos.xyz, 1.0);");
+        append_line(vs_buf, &vs_len, "pos.x *= uTransforms[base + 7].w;");
+        append_line(vs_buf, &vs_len, "float flags = uTransforms[base + 6].w;");
+        append_line(vs_buf, &vs_len, "vec4 shade = aVtxColor / 255.0;");
+        if (use_textures) {
+            append_line(vs_buf, &vs_len, "vec2 tex_scale = vec2(uTransforms[base + 8].w, uTransforms[base + 9].w);");
+            append_line(vs_buf, &vs_len, "vec2 uv = floor(aTexCoord * tex_scale / 65536.0);");
+        }
+        append_line(vs_buf, &vs_len, "if (mod(flags, 2.0) >= 1.0) {");
+        append_line(vs_buf, &vs_len, "    vec3 n = aVtxColor.rgb - 256.0 * step(127.5, aVtxColor.rgb);");
+        append_line(vs_buf, &vs_len, "    vec3 col = uTransforms[base + 10].rgb;");
+        append_line(vs_buf, &vs_len, "    col = floor(col + max(dot(n, uTransforms[base + 4].xyz) / 127.0, 0.0) * uTransforms[base + 8].rgb);");
+        append_line(vs_buf, &vs_len, "    col = floor(col + max(dot(n, uTransforms[base + 5].xyz) / 127.0, 0.0) * uTransforms[base + 9].rgb);");
+        append_line(vs_buf, &vs_len, "    shade.rgb = min(col, 255.0) / 255.0;");
+        if (use_textures) {
+            append_line(vs_buf, &vs_len, "    if (mod(flags, 4.0) >= 2.0) {");
+            append_line(vs_buf, &vs_len, "        vec2 dots = vec2(dot(n, uTransforms[base + 6].xyz), dot(n, uTransforms[base + 7].xyz));");
+            append_line(vs_buf, &vs_len, "        uv = floor((dots / 127.0 + 1.0) / 4.0 * tex_scale);");
+            append_line(vs_buf, &vs_len, "    }");
+        }
+        append_line(vs_buf, &vs_len, "}");
+        append_line(vs_buf, &vs_len, "if (flags >= 4.0) {");
+        append_line(vs_buf, &vs_len, "    float winv = 1.0 / (abs(pos.w) < 0.001 ? 0.001 : pos.w);");
+        append_line(vs_buf, &vs_len, "    if (winv < 0.0) winv = 32767.0;");
+        append_line(vs_buf, &vs_len, "    shade.a = floor(clamp(pos.z * winv * uTransforms[base + 4].w + uTransforms[base + 5].w, 0.0, 255.0)) / 255.0;");
+        append_line(vs_buf, &vs_len, "}");
+        append_line(vs_buf, &vs_len, "float lod = floor(clamp((pos.w - 3000.0) / 3000.0, 0.0, 1.0) * 255.0) / 255.0;");
+        if (use_textures) {
+            append_line(vs_buf, &vs_len, "vTexCoord = (uv - aTexTile.xy) * aTexTile.zw;");
+        }
+        if (cc_features.opt_fog) {
+            append_line(vs_buf, &vs_len, "vFog = vec4(aFog.rgb, shade.a);");
+        }
+        for (int i = 0; i < cc_features.num_inputs; i++) {
+            if (cc_features.opt_alpha) {
+                vs_len += sprintf(vs_buf + vs_len, "vInput%d = resolve_input(aInput%d, shade, lod);\n", i + 1, i + 1);
+            } else {
+                vs_len += sprintf(vs_buf + vs_len, "vInput%d = resolve_input(vec4(aInput%d, 0.0), shade, lod).rgb;\n", i + 1, i + 1);
+            }
+        }
+        append_line(vs_buf, &vs_len, "gl_Position = pos;");
+    } else {
+        if (use_textures) {
+            append_line(vs_buf, &vs_len, "vTexCoord = aTexCoord;");
+        }
+        if (cc_features.opt_fog) {
+            append_line(vs_buf, &vs_len, "vFog = aFog;");
+        }
+        for (int i = 0; i < cc_features.num_inputs; i++) {
+            vs_len += sprintf(vs_buf + vs_len, "vInput%d = aInput%d;\n", i + 1, i + 1);
+        }
+        append_line(vs_buf, &vs_len, "gl_Position = aVtxPos;");
     }
-    append_line(vs_buf, &vs_len, "gl_Position = aVtxPos;");
     append_line(vs_buf, &vs_len, "}");
 
     // Fragment shader
@@ -327,14 +513,28 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     size_t cnt = 0;
 
     struct ShaderProgram *prg = &shader_program_pool[shader_program_pool_size++];
-    prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aVtxPos");
-    prg->attrib_sizes[cnt] = 4;
-    ++cnt;
+    if (cc_features.opt_gpu_transform) {
+        prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aObPos");
+        prg->attrib_sizes[cnt] = 4;
+        ++cnt;
+        prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aVtxColor");
+        prg->attrib_sizes[cnt] = 4;
+        ++cnt;
+    } else {
+        prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aVtxPos");
+        prg->attrib_sizes[cnt] = 4;
+        ++cnt;
+    }
 
-    if (cc_features.used_textures[0] || cc_features.used_textures[1]) {
+    if (use_textures) {
         prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aTexCoord");
         prg->attrib_sizes[cnt] = 2;
         ++cnt;
+        if (cc_features.opt_gpu_transform) {
+            prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aTexTile");
+            prg->attrib_sizes[cnt] = 4;
+            ++cnt;
+        }
     }
 
     if (cc_features.opt_fog) {
@@ -358,6 +558,9 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     prg->used_textures[1] = cc_features.used_textures[1];
     prg->num_floats = num_floats;
     prg->num_attribs = cnt;
+    prg->gpu_transform = cc_features.opt_gpu_transform;
+    prg->transforms_location = cc_features.opt_gpu_transform ? glGetUniformLocation(shader_program, "uTransforms") : -1;
+    prg->transforms_generation = 0;
 
     gfx_opengl_load_shader(prg);
 
@@ -465,10 +668,454 @@ static void gfx_opengl_set_use_alpha(bool use_alpha) {
     }
 }
 
+static bool gfx_opengl_has_extension(const char *extensions, const char *extension) {
+    size_t len = strlen(extension);
+    const char *pos = extensions;
+    while ((pos = strstr(pos, extension)) != NULL) {
+        if ((pos[len] == ' ' || pos[len] == '\0') && (pos == extensions || pos[-1] == ' ')) {
+            return true;
+        }
+        if (pos[len] == '\0') {
+            break;
+        }
+        pos += len + 1;
+    }
+    return false;
+}
+
+static void *gfx_opengl_get_proc_address(const char *name) {
+#if !FOR_WINDOWS && (defined(__linux__) || defined(__BSD__))
+    return (void *)glXGetProcAddressARB((const GLubyte *)name);
+#else
+    return SDL_GL_GetProcAddress(name);
+#endif
+}
+
+static void gfx_opengl_vbo_ring_init(void) {
+    glGenBuffers(1, &opengl_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+
+#ifndef TARGET_WEB
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    if (extensions != NULL && gfx_opengl_has_extension(extensions, "GL_ARB_buffer_storage") && gfx_opengl_has_extension(extensions, "GL_ARB_sync")) {
+        vbo_ring.glBufferStorage = (gfx_gl_buffer_storage_t)gfx_opengl_get_proc_address("glBufferStorage");
+        vbo_ring.glMapBufferRange = (gfx_gl_map_buffer_range_t)gfx_opengl_get_proc_address("glMapBufferRange");
+        vbo_ring.glFenceSync = (gfx_gl_fence_sync_t)gfx_opengl_get_proc_address("glFenceSync");
+        vbo_ring.glClientWaitSync = (gfx_gl_client_wait_sync_t)gfx_opengl_get_proc_address("glClientWaitSync");
+        vbo_ring.glDeleteSync = (gfx_gl_delete_sync_t)gfx_opengl_get_proc_address("glDeleteSync");
+    }
+    if (vbo_ring.glBufferStorage != NULL && vbo_ring.glMapBufferRange != NULL && vbo_ring.glFenceSync != NULL
+        && vbo_ring.glClientWaitSync != NULL && vbo_ring.glDeleteSync != NULL) {
+        GLbitfield flags = GFX_GL_MAP_WRITE_BIT | GFX_GL_MAP_PERSISTENT_BIT | GFX_GL_MAP_COHERENT_BIT;
+        vbo_ring.glBufferStorage(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, flags);
+        vbo_ring.mapped = vbo_ring.glMapBufferRange(GL_ARRAY_BUFFER, 0, VBO_RING_SIZE, flags);
+        if (vbo_ring.mapped != NULL) {
+            vbo_ring.persistent = true;
+            return;
+        }
+        // Buffer storage is immutable, so the fallback path needs a new buffer object
+        glDeleteBuffers(1, &opengl_vbo);
+        glGenBuffers(1, &opengl_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    }
+#endif
+
+    glBufferData(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, GL_STREAM_DRAW);
+}
+
+static void gfx_opengl_vbo_ring_wait_segment(size_t segment) {
+    if (vbo_ring.fences[segment] != NULL) {
+        GLenum res;
+        do {
+            res = vbo_ring.glClientWaitSync(vbo_ring.fences[segment], GFX_GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (res == GFX_GL_TIMEOUT_EXPIRED);
+        vbo_ring.glDeleteSync(vbo_ring.fences[segment]);
+        vbo_ring.fences[segment] = NULL;
+    }
+}
+
+// Returns the byte offset of an unused range of the ring buffer, aligned to the vertex stride
+// so that it can be addressed with the first vertex argument of glDrawArrays.
+static size_t gfx_opengl_vbo_ring_alloc(size_t size, size_t stride) {
+    size_t offset = (vbo_ring.offset + stride - 1) / stride * stride;
+    if (offset + size > VBO_RING_SIZE) {
+        offset = 0;
+        if (!vbo_ring.persistent) {
+            // Orphan the old storage, the draws still reading from it keep it alive in the driver
+            glBufferData(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    if (vbo_ring.persistent) {
+        // Fence every segment we move out of, and wait for the GPU to be done with every segment we move into
+        size_t cur_segment = vbo_ring.offset == 0 ? 0 : (vbo_ring.offset - 1) / VBO_RING_SEGMENT_SIZE;
+        size_t last_segment = (offset + size - 1) / VBO_RING_SEGMENT_SIZE;
+        while (cur_segment != last_segment) {
+            vbo_ring.fences[cur_segment] = vbo_ring.glFenceSync(GFX_GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            cur_segment = (cur_segment + 1) % VBO_RING_SEGMENTS;
+            gfx_opengl_vbo_ring_wait_segment(cur_segment);
+        }
+    }
+
+    vbo_ring.offset = offset + size;
+    return offset;
+}
+
+static void gfx_opengl_upload_transforms(void) {
+    if (current_program != NULL && current_program->gpu_transform && current_program->transforms_generation != transforms_generation) {
+        glUniform4fv(current_program->transforms_location, transform_slots_count * GFX_TRANSFORM_SLOT_VEC4S, transform_slots[0]);
+        current_program->transforms_generation = transforms_generation;
+    }
+}
+
 static void gfx_opengl_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
     //printf("flushing %d tris\n", buf_vbo_num_tris);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * buf_vbo_len, buf_vbo, GL_STREAM_DRAW);
-    glDrawArrays(GL_TRIANGLES, 0, 3 * buf_vbo_num_tris);
+    size_t size = sizeof(float) * buf_vbo_len;
+    size_t stride = size / (3 * buf_vbo_num_tris);
+    size_t offset = gfx_opengl_vbo_ring_alloc(size, stride);
+    if (vbo_ring.persistent) {
+        memcpy(vbo_ring.mapped + offset, buf_vbo, size);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, buf_vbo);
+    }
+    gfx_opengl_upload_transforms();
+    glDrawArrays(GL_TRIANGLES, offset / stride, 3 * buf_vbo_num_tris);
+}
+
+static uint32_t gfx_opengl_new_static_mesh(const float vertices[], size_t num_floats, const uint16_t indices[], size_t num_indices) {
+    for (uint32_t i = 0; i < MAX_STATIC_MESHES; i++) {
+        if (static_meshes[i].vbo == 0) {
+            glGenBuffers(1, &static_meshes[i].vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, static_meshes[i].vbo);
+            glBufferData(GL_ARRAY_BUFFER, num_floats * sizeof(float), vertices, GL_STATIC_DRAW);
+            glGenBuffers(1, &static_meshes[i].ibo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_meshes[i].ibo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void gfx_opengl_draw_static_mesh(uint32_t mesh, size_t first_float, size_t first_index, size_t num_indices) {
+    glBindBuffer(GL_ARRAY_BUFFER, static_meshes[mesh - 1].vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_meshes[mesh - 1].ibo);
+    gfx_opengl_vertex_array_set_attribs(current_program, first_float);
+    gfx_opengl_upload_transforms();
+    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, (void *) (first_index * sizeof(uint16_t)));
+    
+    // Back to the ring buffer for the immediate draws
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    gfx_opengl_vertex_array_set_attribs(current_program, 0);
+}
+
+static void gfx_opengl_delete_static_mesh(uint32_t mesh) {
+    glDeleteBuffers(1, &static_meshes[mesh - 1].vbo);
+    glDeleteBuffers(1, &static_meshes[mesh - 1].ibo);
+    static_meshes[mesh - 1].vbo = 0;
+    static_meshes[mesh - 1].ibo = 0;
+}
+
+static void gfx_opengl_set_vertex_transforms(const float slots[][4], size_t num_slots) {
+    memcpy(transform_slots, slots, num_slots * GFX_TRANSFORM_SLOT_VEC4S * sizeof(transform_slots[0]));
+    transform_slots_count = num_slots;
+    transforms_generation++;
+}
+
+static void gfx_opengl_set_cull_face(int cull) {
+    if (cull == GFX_CULL_NONE) {
+        glDisable(GL_CULL_FACE);
+    } else {
+        glCullFace(cull == GFX_CULL_FRONT ? GL_FRONT : GL_BACK);
+        glEnable(GL_CULL_FACE);
+    }
+}
+
+static const uint8_t *gfx_opengl_read_frame(uint32_t *width, uint32_t *height) {
+    size_t size = (size_t)*width * *height * 4;
+
+    if (!readback.initialized) {
+        readback.initialized = true;
+        readback.mapped = -1;
+#ifndef TARGET_WEB
+        readback.glMapBuffer = (gfx_gl_map_buffer_t)gfx_opengl_get_proc_address("glMapBuffer");
+        readback.glUnmapBuffer = (gfx_gl_unmap_buffer_t)gfx_opengl_get_proc_address("glUnmapBuffer");
+        if (readback.glMapBuffer != NULL && readback.glUnmapBuffer != NULL) {
+            glGenBuffers(2, readback.pbos);
+        }
+#endif
+    }
+
+    if (readback.pbos[0] == 0) {
+        if (size == 0) {
+            return NULL; // frames are read directly, none is pending
+        }
+        if (readback.pixels_size < size) {
+            free(readback.pixels);
+            readback.pixels = malloc(size);
+            readback.pixels_size = readback.pixels != NULL ? size : 0;
+            if (readback.pixels == NULL) {
+                return NULL;
+            }
+        }
+        glReadPixels(0, 0, *width, *height, GL_RGBA, GL_UNSIGNED_BYTE, readback.pixels);
+        return readback.pixels;
+    }
+
+    if (readback.mapped >= 0) {
+        glBindBuffer(GFX_GL_PIXEL_PACK_BUFFER, readback.pbos[readback.mapped]);
+        readback.glUnmapBuffer(GFX_GL_PIXEL_PACK_BUFFER);
+        readback.mapped = -1;
+    }
+
+    int cur = readback.next;
+    int prev = cur ^ 1;
+    if (size != 0) {
+        glBindBuffer(GFX_GL_PIXEL_PACK_BUFFER, readback.pbos[cur]);
+        if (readback.pbo_sizes[cur] != size) {
+            glBufferData(GFX_GL_PIXEL_PACK_BUFFER, size, NULL, GFX_GL_STREAM_READ);
+            readback.pbo_sizes[cur] = size;
+        }
+        glReadPixels(0, 0, *width, *height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        readback.widths[cur] = *width;
+        readback.heights[cur] = *height;
+        readback.next = prev;
+    }
+
+    const uint8_t *pixels = NULL;
+    if (readback.widths[prev] != 0) {
+        glBindBuffer(GFX_GL_PIXEL_PACK_BUFFER, readback.pbos[prev]);
+        pixels = readback.glMapBuffer(GFX_GL_PIXEL_PACK_BUFFER, GFX_GL_READ_ONLY);
+        if (pixels != NULL) {
+            readback.mapped = prev;
+            *width = readback.widths[prev];
+            *height = readback.heights[prev];
+        }
+        readback.widths[prev] = 0;
+    }
+    glBindBuffer(GFX_GL_PIXEL_PACK_BUFFER, 0);
+    return pixels;
+}
+
+static GLuint gfx_opengl_compile_blit_shader(GLenum type, const char *source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLint max_length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_length);
+        char error_log[1024];
+        fprintf(stderr, "Scene scaling shader compilation failed\n");
+        glGetShaderInfoLog(shader, sizeof(error_log), &max_length, &error_log[0]);
+        fprintf(stderr, "%s\n", &error_log[0]);
+        abort();
+    }
+    return shader;
+}
+
+static void gfx_opengl_scene_target_init(void) {
+    static const char *vs =
+        "#version 110\n"
+        "attribute vec2 aPos;\n"
+        "uniform vec4 uTexRect;\n"
+        "varying vec2 vTexCoord;\n"
+        "void main() {\n"
+        "    vTexCoord = uTexRect.xy + (aPos * 0.5 + 0.5) * uTexRect.zw;\n"
+        "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
+        "}\n";
+    static const char *fs =
+        "#version 110\n"
+        "varying vec2 vTexCoord;\n"
+        "uniform sampler2D uTex;\n"
+        "void main() {\n"
+        "    gl_FragColor = texture2D(uTex, vTexCoord);\n"
+        "}\n";
+    static const float quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    scene_target.program = glCreateProgram();
+    glAttachShader(scene_target.program, gfx_opengl_compile_blit_shader(GL_VERTEX_SHADER, vs));
+    glAttachShader(scene_target.program, gfx_opengl_compile_blit_shader(GL_FRAGMENT_SHADER, fs));
+    glLinkProgram(scene_target.program);
+    scene_target.pos_location = glGetAttribLocation(scene_target.program, "aPos");
+    scene_target.tex_rect_location = glGetUniformLocation(scene_target.program, "uTexRect");
+    glUseProgram(scene_target.program);
+    glUniform1i(glGetUniformLocation(scene_target.program, "uTex"), 0);
+
+    glGenBuffers(1, &scene_target.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, scene_target.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+}
+
+static bool gfx_opengl_scene_target_resize(uint32_t width, uint32_t height) {
+    if (scene_target.program == 0) {
+        gfx_opengl_scene_target_init();
+        if (current_program != NULL) {
+            glUseProgram(current_program->opengl_program_id);
+        }
+    }
+    if (scene_target.fbo == 0) {
+        glGenFramebuffers(1, &scene_target.fbo);
+        glGenTextures(1, &scene_target.texture);
+        glGenRenderbuffers(1, &scene_target.depth);
+    }
+    scene_target.tex_width = width > scene_target.tex_width ? width : scene_target.tex_width;
+    scene_target.tex_height = height > scene_target.tex_height ? height : scene_target.tex_height;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, scene_target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scene_target.tex_width, scene_target.tex_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, scene_target.depth);
+#ifdef TARGET_WEB
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, scene_target.tex_width, scene_target.tex_height);
+#else
+    glRenderbufferStorage(GL_RENDERBUFFER, GFX_GL_DEPTH_COMPONENT24, scene_target.tex_width, scene_target.tex_height);
+#endif
+
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene_target.texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scene_target.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Could not create the scene render target\n");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &scene_target.fbo);
+        scene_target.fbo = 0;
+        scene_target.tex_width = scene_target.tex_height = 0;
+        return false;
+    }
+    return true;
+}
+
+static bool gfx_opengl_start_scene(uint32_t width, uint32_t height) {
+    if (scene_target.fbo == 0 || width > scene_target.tex_width || height > scene_target.tex_height) {
+        if (!gfx_opengl_scene_target_resize(width, height)) {
+            return false;
+        }
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, scene_target.fbo);
+    }
+    scene_target.width = width;
+    scene_target.height = height;
+
+    glDisable(GL_SCISSOR_TEST);
+    glDepthMask(GL_TRUE);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    return true;
+}
+
+static void gfx_opengl_end_scene(uint32_t window_width, uint32_t window_height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, window_width, window_height);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+
+    gfx_opengl_unload_shader(current_program);
+    current_program = NULL;
+    glUseProgram(scene_target.program);
+    // Inset by half a texel, so that filtering doesn't reach past the part that was drawn
+    glUniform4f(scene_target.tex_rect_location,
+                0.5f / scene_target.tex_width, 0.5f / scene_target.tex_height,
+                (scene_target.width - 1.0f) / scene_target.tex_width, (scene_target.height - 1.0f) / scene_target.tex_height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, scene_target.texture);
+    glBindBuffer(GL_ARRAY_BUFFER, scene_target.vbo);
+    glEnableVertexAttribArray(scene_target.pos_location);
+    glVertexAttribPointer(scene_target.pos_location, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *) 0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(scene_target.pos_location);
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+static void *gfx_opengl_get_proc_address_suffixed(const char *name, const char *suffix) {
+    char buf[64];
+    sprintf(buf, "%s%s", name, suffix);
+    return gfx_opengl_get_proc_address(buf);
+}
+
+static void gfx_opengl_gpu_timer_init(void) {
+#ifndef TARGET_WEB
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    const char *suffix;
+    if (extensions != NULL && gfx_opengl_has_extension(extensions, "GL_ARB_timer_query")) {
+        suffix = "";
+    } else if (extensions != NULL && gfx_opengl_has_extension(extensions, "GL_EXT_disjoint_timer_query")) {
+        suffix = "EXT";
+        gpu_timer.check_disjoint = true;
+    } else {
+        return;
+    }
+    gpu_timer.glGenQueries = (gfx_gl_gen_queries_t)gfx_opengl_get_proc_address_suffixed("glGenQueries", suffix);
+    gpu_timer.glBeginQuery = (gfx_gl_begin_query_t)gfx_opengl_get_proc_address_suffixed("glBeginQuery", suffix);
+    gpu_timer.glEndQuery = (gfx_gl_end_query_t)gfx_opengl_get_proc_address_suffixed("glEndQuery", suffix);
+    gpu_timer.glGetQueryObjectiv = (gfx_gl_get_query_objectiv_t)gfx_opengl_get_proc_address_suffixed("glGetQueryObjectiv", suffix);
+    gpu_timer.glGetQueryObjectui64v = (gfx_gl_get_query_objectui64v_t)gfx_opengl_get_proc_address_suffixed("glGetQueryObjectui64v", suffix);
+    if (gpu_timer.glGenQueries != NULL && gpu_timer.glBeginQuery != NULL && gpu_timer.glEndQuery != NULL
+        && gpu_timer.glGetQueryObjectiv != NULL && gpu_timer.glGetQueryObjectui64v != NULL) {
+        gpu_timer.glGenQueries(GPU_TIMER_QUERIES, gpu_timer.queries);
+        gpu_timer.supported = true;
+    }
+#endif
+}
+
+static void gfx_opengl_gpu_timer_begin(void) {
+    if (!gpu_timer.supported) {
+        return;
+    }
+    // Collect the finished queries, oldest first
+    GLint disjoint = 0;
+    if (gpu_timer.check_disjoint) {
+        glGetIntegerv(GFX_GL_GPU_DISJOINT, &disjoint);
+    }
+    for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        int q = (gpu_timer.next + i) % GPU_TIMER_QUERIES;
+        if (!gpu_timer.pending[q]) {
+            continue;
+        }
+        GLint available = 0;
+        gpu_timer.glGetQueryObjectiv(gpu_timer.queries[q], GFX_GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        uint64_t ns = 0;
+        gpu_timer.glGetQueryObjectui64v(gpu_timer.queries[q], GFX_GL_QUERY_RESULT, &ns);
+        gpu_timer.pending[q] = false;
+        if (!disjoint) {
+            // The results of a disjoint period, such as a GPU clock change, are meaningless
+            gpu_timer.last_us = ns / 1000 != 0 ? ns / 1000 : 1;
+        }
+    }
+
+    // If the GPU is that far behind, this frame goes untimed
+    gpu_timer.active = !gpu_timer.pending[gpu_timer.next];
+    if (gpu_timer.active) {
+        gpu_timer.glBeginQuery(GFX_GL_TIME_ELAPSED, gpu_timer.queries[gpu_timer.next]);
+    }
+}
+
+static void gfx_opengl_gpu_timer_end(void) {
+    if (gpu_timer.active) {
+        gpu_timer.glEndQuery(GFX_GL_TIME_ELAPSED);
+        gpu_timer.pending[gpu_timer.next] = true;
+        gpu_timer.next = (gpu_timer.next + 1) % GPU_TIMER_QUERIES;
+        gpu_timer.active = false;
+    }
+}
+
+static uint32_t gfx_opengl_get_gpu_frame_time(void) {
+    return gpu_timer.last_us;
 }
 
 static void gfx_opengl_init(void) {
@@ -476,9 +1123,8 @@ static void gfx_opengl_init(void) {
     glewInit();
 #endif
     
-    glGenBuffers(1, &opengl_vbo);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    gfx_opengl_vbo_ring_init();
+    gfx_opengl_gpu_timer_init();
     
     glDepthFunc(GL_LEQUAL);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -489,6 +1135,7 @@ static void gfx_opengl_on_resize(void) {
 
 static void gfx_opengl_start_frame(void) {
     frame_count++;
+    gfx_opengl_gpu_timer_begin();
 
     glDisable(GL_SCISSOR_TEST);
     glDepthMask(GL_TRUE); // Must be set to clear Z-buffer
@@ -498,6 +1145,7 @@ static void gfx_opengl_start_frame(void) {
 }
 
 static void gfx_opengl_end_frame(void) {
+    gfx_opengl_gpu_timer_end();
 }
 
 static void gfx_opengl_finish_render(void) {
@@ -525,7 +1173,16 @@ struct GfxRenderingAPI gfx_opengl_api = {
     gfx_opengl_on_resize,
     gfx_opengl_start_frame,
     gfx_opengl_end_frame,
-    gfx_opengl_finish_render
+    gfx_opengl_finish_render,
+    gfx_opengl_set_vertex_transforms,
+    gfx_opengl_set_cull_face,
+    gfx_opengl_new_static_mesh,
+    gfx_opengl_draw_static_mesh,
+    gfx_opengl_delete_static_mesh,
+    gfx_opengl_read_frame,
+    gfx_opengl_start_scene,
+    gfx_opengl_end_scene,
+    gfx_opengl_get_gpu_frame_time
 };
 
 #endif
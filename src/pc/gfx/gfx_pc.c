@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -15,6 +16,8 @@
 #include "gfx_window_manager_api.h"
 #include "gfx_rendering_api.h"
 #include "gfx_screen_config.h"
+#include "gfx_simd.h"
+#include "gfx_capture.h"
 
 #define SUPPORT_CHECK(x) assert(x)
 
@@ -35,8 +38,12 @@
 #define RATIO_Y (gfx_current_dimensions.height / (2.0f * HALF_SCREEN_HEIGHT))
 
 #define MAX_BUFFERED 256
+#define MAX_SORTED 8192
+#define MAX_SORTED_BATCHES 512
+#define SORTED_SEARCH_DEPTH 64
 #define MAX_LIGHTS 2
 #define MAX_VERTICES 64
+#define MAX_TRANSFORM_SNAPSHOTS 1024
 
 struct RGBA {
     uint8_t r, g, b, a;
@@ -51,6 +58,8 @@ struct LoadedVertex {
     float u, v;
     struct RGBA color;
     uint8_t clip_rej;
+    int16_t transform; // snapshot index when transformed on the GPU, -1 otherwise
+    Vtx_t raw;
 };
 
 struct TextureHashmapNode {
@@ -143,18 +152,260 @@ static struct RenderingState {
     bool decal_mode;
     bool alpha_blend;
     struct XYWidthHeight viewport, scissor;
+    int cull_face;
     struct ShaderProgram *shader_program;
     struct TextureHashmapNode *textures[2];
 } rendering_state;
 
+// Glyph atlases: the game registers its font textures, which are packed into one texture
+// per font. A glyph loaded into tile 0 then selects the atlas and offsets the texture
+// coordinates to its cell, so a run of text is drawn without a flush between glyphs.
+#define MAX_GLYPH_ATLASES 4
+#define MAX_ATLAS_GLYPHS 1024 // power of two
+#define ATLAS_COLUMNS 16
+
+struct GlyphAtlas {
+    struct TextureHashmapNode node; // sampler state and texture id, not part of the cache
+    uint32_t width, height;
+    uint8_t fmt, siz;
+};
+
+struct AtlasGlyph {
+    const uint8_t *addr; // NULL for a free entry
+    uint8_t atlas;
+    uint16_t x, y; // top left texel of the glyph in the atlas
+};
+
+static struct {
+    struct GlyphAtlas atlases[MAX_GLYPH_ATLASES];
+    uint32_t num_atlases;
+    struct AtlasGlyph glyphs[MAX_ATLAS_GLYPHS];
+    const struct AtlasGlyph *selected; // glyph whose cell tile 0 samples, NULL if none
+} glyph_atlas;
+
+// GPU vertex transform mode: gfx_sp_vertex keeps the raw vertices and records the
+// transform state they were loaded with. Triangles reference those snapshots through
+// a small table of slots that is uploaded to the backend with each batch.
+static bool gpu_vertex_transform;
+static struct {
+    bool active;
+    float snapshots[MAX_TRANSFORM_SNAPSHOTS][GFX_TRANSFORM_SLOT_VEC4S][4];
+    uint16_t num_snapshots;
+    float slots[GFX_MAX_TRANSFORM_SLOTS * GFX_TRANSFORM_SLOT_VEC4S][4];
+    int16_t slot_snapshots[GFX_MAX_TRANSFORM_SLOTS];
+    uint8_t num_slots;
+    bool slots_changed;
+} gpu_xf;
+
+// Static geometry cache: display lists that are called with the same state and contents
+// frame after frame are recorded once in GPU transform mode, where the emitted vertices
+// are still in object space, and then redrawn from retained vertex and index buffers
+// with one draw call per state group instead of being walked again.
+#define MAX_STATIC_DLS 1024 // power of two
+#define STATIC_DL_MIN_FRAMES 2
+#define STATIC_DL_MAX_COMMANDS 16384
+
+enum {
+    STATIC_DL_CANDIDATE,
+    STATIC_DL_CACHED,
+    STATIC_DL_UNCACHEABLE
+};
+
+// The RSP state that decides the transform snapshot of a vertex, apart from the matrices
+struct StaticRspState {
+    uint32_t geometry_mode;
+    int16_t fog_mul, fog_offset;
+    uint16_t texture_scale_s, texture_scale_t;
+    Light_t lights[MAX_LIGHTS + 1];
+    uint8_t num_lights;
+};
+
+struct StaticDrawGroup {
+    struct ShaderProgram *prg;
+    struct TextureHashmapNode *textures[2];
+    bool linear_filter[2];
+    uint8_t cms[2], cmt[2];
+    bool depth_test, depth_mask, decal_mode, alpha_blend;
+    int cull_face;
+    uint32_t floats_per_vertex;
+    uint32_t first_float; // start of the group's vertices
+    uint32_t first_index;
+    uint32_t num_indices; // number of emitted vertices while recording
+};
+
+// What a cached display list leaves behind for the commands that follow it
+struct StaticDisplayListExit {
+    struct RDP rdp;
+    struct StaticRspState rsp;
+    struct TextureHashmapNode *textures[2]; // imported by the display list, NULL otherwise
+    uint64_t loaded_mask;
+    Vtx_t vertices[MAX_VERTICES];
+};
+
+struct StaticDisplayList {
+    const Gfx *dl; // NULL for a free entry
+    uint64_t key;  // display list address and the state it is called with
+    uint64_t content_hash;
+    uint8_t status;
+    uint8_t frames_seen;
+    uint32_t last_frame;
+    uint32_t mesh;
+    struct StaticDrawGroup *groups;
+    uint32_t num_groups;
+    bool has_vertex_state;
+    struct StaticRspState vertex_state;
+    struct StaticDisplayListExit *exit;
+};
+
+static bool static_geometry_cache = true;
+static struct {
+    struct StaticDisplayList entries[MAX_STATIC_DLS];
+    uint32_t count;
+    uint32_t frame;
+    bool clear_pending;
+
+    // Display list being recorded
+    struct StaticDisplayList *recording;
+    bool record_failed;
+    float *vbo;
+    size_t vbo_len, vbo_cap;
+    struct StaticDrawGroup *groups;
+    size_t num_groups, groups_cap;
+    bool has_snapshot;
+    float snapshot[GFX_TRANSFORM_SLOT_VEC4S][4];
+    struct StaticRspState vertex_state;
+    uint64_t loaded_mask;
+    bool imported[2];
+} static_dls;
+
+// Geometry chunks: the static display lists of an area are scanned when it is loaded, and
+// every vertex load in them, along with the triangles drawn from it, becomes a chunk with
+// a bounding box. A chunk whose box is outside the view frustum is skipped before its
+// vertices are transformed. Its triangles would all have been clip rejected anyway.
+#define MAX_GEOMETRY_CHUNKS 4096 // power of two
+#define MAX_PENDING_GEOMETRY 64  // power of two
+
+struct GeometryChunk {
+    const Gfx *cmd; // the G_VTX command, NULL for a free entry
+    float center[3];
+    float extent[3];
+    bool cullable; // false when triangles mix its vertices with those of other loads
+};
+
+static bool chunk_culling = true;
+static struct {
+    struct GeometryChunk entries[MAX_GEOMETRY_CHUNKS];
+    uint32_t count;
+    // Display lists registered by the game, possibly from another thread. A NULL entry
+    // clears the chunks and the static display lists of the previous area. overflowed is
+    // set when an entry didn't fit, and clears them as well.
+    const Gfx *pending[MAX_PENDING_GEOMETRY];
+    uint32_t pending_head, pending_tail;
+    bool overflowed;
+} chunks;
+
+// Render-rate interpolation: the display list of a logic tick is drawn several times, with
+// every matrix it loads blended towards the same matrix in the previous tick. A matrix is
+// identified by the object that loads it, set by a GFX_NOOP_INTERP_ID no-op, its G_MTX
+// command, the display list called right after it and how many times that has occurred
+// before in the frame. Matrices loaded without an object identity are drawn as they are.
+#define MAX_INTERP_MATRICES 4096 // power of two
+
+struct InterpMatrix {
+    uint64_t key; // 0 for a free entry
+    float matrix[4][4];
+};
+
+static struct {
+    bool active;
+    bool record;
+    bool record_pending;
+    float alpha;
+    uintptr_t id;
+    uint64_t key; // 0 when the matrix isn't interpolated
+    struct InterpMatrix tables[2][MAX_INTERP_MATRICES];
+    struct InterpMatrix *prev, *cur;
+    uint32_t num_cur;
+    struct {
+        uint64_t base;
+        uint32_t count;
+    } occurrences[MAX_INTERP_MATRICES];
+} interp;
+
+// Dynamic resolution: the 3D scene is drawn into an offscreen target sized from the GPU frame
+// time the rendering API measures, and scaled up to the window at the end of scene marker,
+// so the HUD and text after it are drawn at the window resolution. While the scene is drawn,
+// gfx_current_dimensions holds the size of the target, with the aspect ratio of the window.
+#define DYNRES_HEADROOM 0.9f    // part of the budget the GPU time is steered to
+#define DYNRES_RAISE_BELOW 0.8f // part of the budget below which the scale may rise
+#define DYNRES_SMOOTHING 0.1f
+#define DYNRES_MAX_DROP 0.9f
+#define DYNRES_MAX_RISE 1.02f
+
+static struct {
+    bool enabled;
+    float min_scale, max_scale;
+    float budget_us;
+    float scale;
+    float gpu_time_us; // smoothed
+    bool in_scene;
+    struct GfxDimensions window;
+} dynres;
+
 struct GfxDimensions gfx_current_dimensions;
 
 static bool dropped_frame;
 
-static float buf_vbo[MAX_BUFFERED * (26 * 3)]; // 3 vertices in a triangle and 26 floats per vtx
+static float buf_vbo[MAX_BUFFERED * (34 * 3)]; // 3 vertices in a triangle and up to 34 floats per vtx
 static size_t buf_vbo_len;
 static size_t buf_vbo_num_tris;
 
+// Opaque triangles are recorded here instead of being drawn in display list order.
+// A triangle joins an earlier batch with the same shader and texture state only if
+// its screen bounds do not overlap any batch it would be drawn ahead of, so every
+// pixel still receives its depth tested writes in display list order.
+struct SortedDraw {
+    struct ShaderProgram *prg;
+    struct TextureHashmapNode *textures[2];
+    bool linear_filter;
+    uint8_t cms, cmt;
+    float min_x, min_y, max_x, max_y; // bounds in normalized device coordinates
+    uint32_t first_tri;
+    uint32_t last_tri;
+    uint32_t num_tris;
+};
+
+struct SortedTri {
+    uint32_t vbo_start;
+    uint32_t vbo_len;
+    uint32_t next;
+};
+
+static bool sort_opaque_draws;
+static bool simd_vertex_transform = true;
+static bool submitting_sorted;
+// Allocated when the option is enabled
+static struct SortedDraw *sorted_draws;
+static size_t sorted_draws_count;
+static struct SortedTri *sorted_tris;
+static size_t sorted_num_tris;
+static float *sorted_vbo;
+static size_t sorted_vbo_len;
+static struct SortedDraw sorted_last_key;
+
+struct GfxStats gfx_stats;
+struct GfxStats gfx_frame_stats;
+static uint32_t frame_number;
+
+#define FRAME_TIME_SAMPLES 64
+
+static struct {
+    unsigned long last;
+    int64_t samples[FRAME_TIME_SAMPLES];
+    int64_t sum, sum_sq;
+    int pos, count;
+} frame_times;
+
 static struct GfxWindowManagerAPI *gfx_wapi;
 static struct GfxRenderingAPI *gfx_rapi;
 
@@ -165,18 +416,175 @@ static unsigned long get_time(void) {
     return (unsigned long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
+static void gfx_static_dl_capture(void);
+static void gfx_static_dl_textures_reset(void);
+
 static void gfx_flush(void) {
     if (buf_vbo_len > 0) {
-        int num = buf_vbo_num_tris;
         unsigned long t0 = get_time();
+        if (static_dls.recording != NULL) {
+            gfx_static_dl_capture();
+        }
+        if (gpu_xf.slots_changed) {
+            gfx_rapi->set_vertex_transforms(gpu_xf.slots, gpu_xf.num_slots);
+            gpu_xf.slots_changed = false;
+        }
         gfx_rapi->draw_triangles(buf_vbo, buf_vbo_len, buf_vbo_num_tris);
+        gfx_stats.triangles += buf_vbo_num_tris;
         buf_vbo_len = 0;
         buf_vbo_num_tris = 0;
-        unsigned long t1 = get_time();
-        /*if (t1 - t0 > 1000) {
-            printf("f: %d %d\n", num, (int)(t1 - t0));
-        }*/
+        gfx_stats.flushes++;
+        if (!submitting_sorted) {
+            gfx_stats.flushes_unsorted++;
+        }
+        gfx_stats.backend_us += get_time() - t0;
+    }
+}
+
+static bool gfx_sorted_draw_same_state(const struct SortedDraw *a, const struct SortedDraw *b) {
+    return a->prg == b->prg && a->textures[0] == b->textures[0] && a->textures[1] == b->textures[1] &&
+           a->linear_filter == b->linear_filter && a->cms == b->cms && a->cmt == b->cmt;
+}
+
+static void gfx_flush_sorted(void) {
+    if (sorted_draws_count == 0) {
+        return;
+    }
+    
+    struct TextureHashmapNode *saved_textures[2] = { rendering_state.textures[0], rendering_state.textures[1] };
+    
+    gfx_flush();
+    submitting_sorted = true;
+    for (size_t i = 0; i < sorted_draws_count; i++) {
+        struct SortedDraw *d = &sorted_draws[i];
+        gfx_flush();
+        if (d->prg != rendering_state.shader_program) {
+            gfx_rapi->unload_shader(rendering_state.shader_program);
+            gfx_rapi->load_shader(d->prg);
+            gfx_stats.shader_switches++;
+            rendering_state.shader_program = d->prg;
+        }
+        for (int j = 0; j < 2; j++) {
+            struct TextureHashmapNode *node = d->textures[j];
+            if (node != NULL) {
+                gfx_rapi->select_texture(j, node->texture_id);
+                if (node->linear_filter != d->linear_filter || node->cms != d->cms || node->cmt != d->cmt) {
+                    gfx_rapi->set_sampler_parameters(j, d->linear_filter, d->cms, d->cmt);
+                    node->linear_filter = d->linear_filter;
+                    node->cms = d->cms;
+                    node->cmt = d->cmt;
+                }
+            }
+        }
+        
+        for (uint32_t t = d->first_tri, n = 0; n < d->num_tris; t = sorted_tris[t].next, n++) {
+            memcpy(buf_vbo + buf_vbo_len, sorted_vbo + sorted_tris[t].vbo_start, sorted_tris[t].vbo_len * sizeof(float));
+            buf_vbo_len += sorted_tris[t].vbo_len;
+            if (++buf_vbo_num_tris == MAX_BUFFERED) {
+                gfx_flush();
+            }
+        }
+    }
+    gfx_flush();
+    submitting_sorted = false;
+    
+    // Restore the bindings the display list state expects
+    for (int j = 0; j < 2; j++) {
+        if (saved_textures[j] != NULL) {
+            gfx_rapi->select_texture(j, saved_textures[j]->texture_id);
+        }
+    }
+    
+    sorted_draws_count = 0;
+    sorted_vbo_len = 0;
+    sorted_num_tris = 0;
+    sorted_last_key.prg = NULL;
+}
+
+static bool gfx_sorted_draw_overlaps(const struct SortedDraw *d, const struct SortedDraw *b) {
+    return d->min_x <= b->max_x && b->min_x <= d->max_x && d->min_y <= b->max_y && b->min_y <= d->max_y;
+}
+
+// Moves the triangle just written to buf_vbo into the sorted draw list
+static void gfx_record_sorted_triangle(struct ShaderProgram *prg, const bool used_textures[2], bool linear_filter) {
+    struct SortedDraw key;
+    key.prg = prg;
+    key.textures[0] = used_textures[0] ? rendering_state.textures[0] : NULL;
+    key.textures[1] = used_textures[1] ? rendering_state.textures[1] : NULL;
+    key.linear_filter = linear_filter;
+    key.cms = rdp.texture_tile.cms;
+    key.cmt = rdp.texture_tile.cmt;
+    if (!used_textures[0] && !used_textures[1]) {
+        key.linear_filter = false;
+        key.cms = 0;
+        key.cmt = 0;
     }
+    
+    // Screen bounds of the triangle, with a margin for rasterization rounding.
+    // A vertex at or behind the eye makes the bounds the whole screen.
+    size_t stride = buf_vbo_len / 3;
+    key.min_x = key.min_y = -1.0f;
+    key.max_x = key.max_y = 1.0f;
+    if (buf_vbo[3] > 0.0f && buf_vbo[stride + 3] > 0.0f && buf_vbo[2 * stride + 3] > 0.0f) {
+        key.min_x = key.min_y = INFINITY;
+        key.max_x = key.max_y = -INFINITY;
+        for (int i = 0; i < 3; i++) {
+            const float *v = &buf_vbo[i * stride];
+            float x = v[0] / v[3], y = v[1] / v[3];
+            key.min_x = fminf(key.min_x, x);
+            key.max_x = fmaxf(key.max_x, x);
+            key.min_y = fminf(key.min_y, y);
+            key.max_y = fmaxf(key.max_y, y);
+        }
+        key.min_x -= 0.01f;
+        key.min_y -= 0.01f;
+        key.max_x += 0.01f;
+        key.max_y += 0.01f;
+    }
+    
+    if (sorted_last_key.prg == NULL || !gfx_sorted_draw_same_state(&sorted_last_key, &key)) {
+        // Display list order would have needed a flush here
+        gfx_stats.flushes_unsorted++;
+        sorted_last_key = key;
+    }
+    
+    // Find the latest batch with the same state that the triangle can be moved back to
+    struct SortedDraw *batch = NULL;
+    size_t depth = sorted_draws_count < SORTED_SEARCH_DEPTH ? sorted_draws_count : SORTED_SEARCH_DEPTH;
+    for (size_t i = sorted_draws_count; i > sorted_draws_count - depth; i--) {
+        struct SortedDraw *d = &sorted_draws[i - 1];
+        if (gfx_sorted_draw_same_state(d, &key)) {
+            batch = d;
+            break;
+        }
+        if (gfx_sorted_draw_overlaps(d, &key)) {
+            break;
+        }
+    }
+    
+    uint32_t tri = sorted_num_tris++;
+    sorted_tris[tri].vbo_start = sorted_vbo_len;
+    sorted_tris[tri].vbo_len = buf_vbo_len;
+    sorted_tris[tri].next = 0;
+    memcpy(sorted_vbo + sorted_vbo_len, buf_vbo, buf_vbo_len * sizeof(float));
+    sorted_vbo_len += buf_vbo_len;
+    buf_vbo_len = 0;
+    buf_vbo_num_tris = 0;
+    
+    if (batch == NULL) {
+        batch = &sorted_draws[sorted_draws_count++];
+        *batch = key;
+        batch->first_tri = tri;
+        batch->num_tris = 0;
+    } else {
+        sorted_tris[batch->last_tri].next = tri;
+        batch->min_x = fminf(batch->min_x, key.min_x);
+        batch->min_y = fminf(batch->min_y, key.min_y);
+        batch->max_x = fmaxf(batch->max_x, key.max_x);
+        batch->max_y = fmaxf(batch->max_y, key.max_y);
+    }
+    batch->last_tri = tri;
+    batch->num_tris++;
 }
 
 static struct ShaderProgram *gfx_lookup_or_create_shader_program(uint32_t shader_id) {
@@ -185,6 +593,7 @@ static struct ShaderProgram *gfx_lookup_or_create_shader_program(uint32_t shader
         gfx_rapi->unload_shader(rendering_state.shader_program);
         prg = gfx_rapi->create_and_load_new_shader(shader_id);
         rendering_state.shader_program = prg;
+        gfx_stats.shader_switches++;
     }
     return prg;
 }
@@ -261,16 +670,22 @@ static bool gfx_texture_cache_lookup(int tile, struct TextureHashmapNode **n, co
         if ((*node)->texture_addr == orig_addr && (*node)->fmt == fmt && (*node)->siz == siz) {
             gfx_rapi->select_texture(tile, (*node)->texture_id);
             *n = *node;
+            gfx_stats.texture_hits++;
             return true;
         }
         node = &(*node)->next;
     }
     if (gfx_texture_cache.pool_pos == sizeof(gfx_texture_cache.pool) / sizeof(struct TextureHashmapNode)) {
         // Pool is full. We just invalidate everything and start over.
+        // Sorted draws still refer to the old textures, so submit them first,
+        // and drop the cached display lists that were recorded with them.
+        gfx_flush_sorted();
+        gfx_static_dl_textures_reset();
         gfx_texture_cache.pool_pos = 0;
         node = &gfx_texture_cache.hashmap[hash];
         //puts("Clearing texture cache");
     }
+    gfx_stats.texture_misses++;
     *node = &gfx_texture_cache.pool[gfx_texture_cache.pool_pos++];
     if ((*node)->texture_addr == NULL) {
         (*node)->texture_id = gfx_rapi->new_texture();
@@ -288,6 +703,12 @@ static bool gfx_texture_cache_lookup(int tile, struct TextureHashmapNode **n, co
     return false;
 }
 
+static void gfx_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_stats.texture_uploads++;
+    gfx_stats.texture_upload_bytes += width * height * 4;
+}
+
 static void import_texture_rgba16(int tile) {
     uint8_t rgba32_buf[8192];
     
@@ -306,13 +727,13 @@ static void import_texture_rgba16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_rgba32(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = (rdp.loaded_texture[tile].size_bytes / 2) / rdp.texture_tile.line_size_bytes;
-    gfx_rapi->upload_texture(rdp.loaded_texture[tile].addr, width, height);
+    gfx_upload_texture(rdp.loaded_texture[tile].addr, width, height);
 }
 
 static void import_texture_ia4(int tile) {
@@ -335,7 +756,7 @@ static void import_texture_ia4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia8(int tile) {
@@ -356,7 +777,7 @@ static void import_texture_ia8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia16(int tile) {
@@ -377,7 +798,7 @@ static void import_texture_ia16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i4(int tile) {
@@ -399,7 +820,7 @@ static void import_texture_i4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
 
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i8(int tile) {
@@ -419,7 +840,7 @@ static void import_texture_i8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
 
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 
@@ -443,7 +864,7 @@ static void import_texture_ci4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ci8(int tile) {
@@ -465,7 +886,7 @@ static void import_texture_ci8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture(int tile) {
@@ -518,6 +939,79 @@ static void import_texture(int tile) {
     //printf("Time diff: %d\n", t1 - t0);
 }
 
+static struct AtlasGlyph *gfx_atlas_find(const uint8_t *addr) {
+    uint32_t i = (uint32_t)(((uintptr_t)addr >> 3) * 0x9E3779B1u) & (MAX_ATLAS_GLYPHS - 1);
+    while (glyph_atlas.glyphs[i].addr != NULL && glyph_atlas.glyphs[i].addr != addr) {
+        i = (i + 1) & (MAX_ATLAS_GLYPHS - 1);
+    }
+    return &glyph_atlas.glyphs[i];
+}
+
+// Selects the atlas if the texture loaded into tile 0 is one of its glyphs. The cells repeat
+// the glyph's edge texels, which is what clamping or mirroring samples past its edges, so a
+// linear filter that wraps and would blend in the opposite edge draws the glyph's own texture.
+// The tile's filter and clamp mode are then applied to the atlas like to any other texture.
+static bool gfx_atlas_select(bool linear_filter) {
+    if (glyph_atlas.num_atlases == 0) {
+        return false;
+    }
+    if (linear_filter && (!(rdp.texture_tile.cms & (G_TX_CLAMP | G_TX_MIRROR)) ||
+                          !(rdp.texture_tile.cmt & (G_TX_CLAMP | G_TX_MIRROR)))) {
+        return false;
+    }
+    const struct AtlasGlyph *glyph = gfx_atlas_find(rdp.loaded_texture[0].addr);
+    if (glyph->addr == NULL) {
+        return false;
+    }
+    struct GlyphAtlas *atlas = &glyph_atlas.atlases[glyph->atlas];
+    if (atlas->fmt != rdp.texture_tile.fmt || atlas->siz != rdp.texture_tile.siz) {
+        return false;
+    }
+    if (rendering_state.textures[0] != &atlas->node) {
+        gfx_flush();
+        gfx_rapi->select_texture(0, atlas->node.texture_id);
+        rendering_state.textures[0] = &atlas->node;
+    }
+    if (static_dls.recording != NULL) {
+        // Cached copies bake in the texture coordinates of one glyph
+        static_dls.record_failed = true;
+    }
+    gfx_stats.texture_hits++;
+    glyph_atlas.selected = glyph;
+    return true;
+}
+
+static bool gfx_decode_glyph(const uint8_t *src, uint8_t fmt, uint8_t siz, uint32_t num_texels, uint8_t *rgba32) {
+    for (uint32_t i = 0; i < num_texels; i++) {
+        uint8_t *d = &rgba32[4 * i];
+        if (fmt == G_IM_FMT_RGBA && siz == G_IM_SIZ_16b) {
+            uint16_t col16 = (src[2 * i] << 8) | src[2 * i + 1];
+            d[0] = SCALE_5_8(col16 >> 11);
+            d[1] = SCALE_5_8((col16 >> 6) & 0x1f);
+            d[2] = SCALE_5_8((col16 >> 1) & 0x1f);
+            d[3] = (col16 & 1) ? 255 : 0;
+        } else if (fmt == G_IM_FMT_IA && siz == G_IM_SIZ_4b) {
+            uint8_t part = (src[i / 2] >> (4 - (i % 2) * 4)) & 0xf;
+            d[0] = d[1] = d[2] = SCALE_3_8(part >> 1);
+            d[3] = (part & 1) ? 255 : 0;
+        } else if (fmt == G_IM_FMT_IA && siz == G_IM_SIZ_8b) {
+            d[0] = d[1] = d[2] = SCALE_4_8(src[i] >> 4);
+            d[3] = SCALE_4_8(src[i] & 0xf);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t gfx_next_power_of_two(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v) {
+        p <<= 1;
+    }
+    return p;
+}
+
 static void gfx_normalize_vector(float v[3]) {
     float s = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
     v[0] /= s;
@@ -554,6 +1048,84 @@ static void gfx_matrix_mul(float res[4][4], const float a[4][4], const float b[4
     memcpy(res, tmp, sizeof(tmp));
 }
 
+static uint64_t gfx_interp_mix(uint64_t hash, uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static size_t gfx_interp_index(uint64_t key) {
+    return (size_t)(key ^ (key >> 32)) & (MAX_INTERP_MATRICES - 1);
+}
+
+static struct InterpMatrix *gfx_interp_find(struct InterpMatrix *table, uint64_t key) {
+    size_t i = gfx_interp_index(key);
+    while (table[i].key != 0 && table[i].key != key) {
+        i = (i + 1) & (MAX_INTERP_MATRICES - 1);
+    }
+    return &table[i];
+}
+
+// Computes the key of the matrix loaded by a G_MTX command
+static void gfx_interp_set_key(const Gfx *cmd) {
+    if (interp.id == 0) {
+        interp.key = 0;
+        return;
+    }
+    uint64_t base = gfx_interp_mix(gfx_interp_mix(0, interp.id), cmd->words.w0);
+    if ((cmd[1].words.w0 >> 24) == G_DL) {
+        base = gfx_interp_mix(base, cmd[1].words.w1);
+    }
+    base |= 1;
+    
+    size_t i = gfx_interp_index(base);
+    while (interp.occurrences[i].base != 0 && interp.occurrences[i].base != base) {
+        i = (i + 1) & (MAX_INTERP_MATRICES - 1);
+    }
+    if (interp.occurrences[i].base == 0) {
+        interp.occurrences[i].base = base;
+    }
+    interp.key = gfx_interp_mix(base, interp.occurrences[i].count++) | 1;
+}
+
+// Camera cuts, warps and objects that were matched with the wrong one snap instead of sliding
+static bool gfx_interp_close(const float a[4][4], const float b[4][4]) {
+    float rotation = 0.0f, norm = 0.0f, distance = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            float d = a[i][j] - b[i][j];
+            rotation += d * d;
+            norm += b[i][j] * b[i][j];
+        }
+        float d = a[3][i] - b[3][i];
+        distance += d * d;
+    }
+    return rotation <= 0.25f * norm && distance <= 1000.0f * 1000.0f;
+}
+
+static void gfx_interp_matrix(float matrix[4][4]) {
+    if (interp.key == 0) {
+        return;
+    }
+    if (interp.record && interp.num_cur < MAX_INTERP_MATRICES / 2) {
+        struct InterpMatrix *e = gfx_interp_find(interp.cur, interp.key);
+        if (e->key == 0) {
+            e->key = interp.key;
+            memcpy(e->matrix, matrix, sizeof(e->matrix));
+            interp.num_cur++;
+        }
+    }
+    if (interp.alpha < 1.0f) {
+        const struct InterpMatrix *e = gfx_interp_find(interp.prev, interp.key);
+        if (e->key == interp.key && gfx_interp_close(e->matrix, matrix)) {
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    matrix[i][j] = e->matrix[i][j] + (matrix[i][j] - e->matrix[i][j]) * interp.alpha;
+                }
+            }
+        }
+    }
+}
+
 static void gfx_sp_matrix(uint8_t parameters, const int32_t *addr) {
     float matrix[4][4];
 #ifndef GBI_FLOATS
@@ -571,6 +1143,10 @@ static void gfx_sp_matrix(uint8_t parameters, const int32_t *addr) {
     memcpy(matrix, addr, sizeof(matrix));
 #endif
     
+    if (interp.active) {
+        gfx_interp_matrix(matrix);
+    }
+    
     if (parameters & G_MTX_PROJECTION) {
         if (parameters & G_MTX_LOAD) {
             memcpy(rsp.P_matrix, matrix, sizeof(matrix));
@@ -604,14 +1180,25 @@ static void gfx_sp_pop_matrix(uint32_t count) {
 }
 
 static float gfx_adjust_x_for_aspect_ratio(float x) {
-    return x * (4.0f / 3.0f) / ((float)gfx_current_dimensions.width / (float)gfx_current_dimensions.height);
+    return x * (4.0f / 3.0f) / gfx_current_dimensions.aspect_ratio;
 }
 
-static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *vertices) {
-    for (size_t i = 0; i < n_vertices; i++, dest_index++) {
+static void gfx_update_light_coeffs(void) {
+    for (int i = 0; i < rsp.current_num_lights - 1; i++) {
+        calculate_normal_dir(&rsp.current_lights[i], rsp.current_lights_coeffs[i]);
+    }
+    static const Light_t lookat_x = {{0, 0, 0}, 0, {0, 0, 0}, 0, {127, 0, 0}, 0};
+    static const Light_t lookat_y = {{0, 0, 0}, 0, {0, 0, 0}, 0, {0, 127, 0}, 0};
+    calculate_normal_dir(&lookat_x, rsp.current_lookat_coeffs[0]);
+    calculate_normal_dir(&lookat_y, rsp.current_lookat_coeffs[1]);
+    rsp.lights_changed = false;
+}
+
+static void gfx_sp_vertex_scalar(size_t n_vertices, const Vtx *vertices, struct LoadedVertex *dest) {
+    for (size_t i = 0; i < n_vertices; i++) {
         const Vtx_t *v = &vertices[i].v;
         const Vtx_tn *vn = &vertices[i].n;
-        struct LoadedVertex *d = &rsp.loaded_vertices[dest_index];
+        struct LoadedVertex *d = &dest[i];
         
         float x = v->ob[0] * rsp.MP_matrix[0][0] + v->ob[1] * rsp.MP_matrix[1][0] + v->ob[2] * rsp.MP_matrix[2][0] + rsp.MP_matrix[3][0];
         float y = v->ob[0] * rsp.MP_matrix[0][1] + v->ob[1] * rsp.MP_matrix[1][1] + v->ob[2] * rsp.MP_matrix[2][1] + rsp.MP_matrix[3][1];
@@ -624,17 +1211,6 @@ static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *verti
         short V = v->tc[1] * rsp.texture_scaling_factor.t >> 16;
         
         if (rsp.geometry_mode & G_LIGHTING) {
-            if (rsp.lights_changed) {
-                for (int i = 0; i < rsp.current_num_lights - 1; i++) {
-                    calculate_normal_dir(&rsp.current_lights[i], rsp.current_lights_coeffs[i]);
-                }
-                static const Light_t lookat_x = {{0, 0, 0}, 0, {0, 0, 0}, 0, {127, 0, 0}, 0};
-                static const Light_t lookat_y = {{0, 0, 0}, 0, {0, 0, 0}, 0, {0, 127, 0}, 0};
-                calculate_normal_dir(&lookat_x, rsp.current_lookat_coeffs[0]);
-                calculate_normal_dir(&lookat_y, rsp.current_lookat_coeffs[1]);
-                rsp.lights_changed = false;
-            }
-            
             int r = rsp.current_lights[rsp.current_num_lights - 1].col[0];
             int g = rsp.current_lights[rsp.current_num_lights - 1].col[1];
             int b = rsp.current_lights[rsp.current_num_lights - 1].col[2];
@@ -712,80 +1288,434 @@ static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *verti
     }
 }
 
-static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
-    struct LoadedVertex *v1 = &rsp.loaded_vertices[vtx1_idx];
-    struct LoadedVertex *v2 = &rsp.loaded_vertices[vtx2_idx];
-    struct LoadedVertex *v3 = &rsp.loaded_vertices[vtx3_idx];
-    struct LoadedVertex *v_arr[3] = {v1, v2, v3};
-    
-    //if (rand()%2) return;
-    
-    if (v1->clip_rej & v2->clip_rej & v3->clip_rej) {
-        // The whole triangle lies outside the visible area
-        return;
+#ifdef GFX_SIMD_WIDTH
+// Same computation as gfx_sp_vertex_scalar, GFX_SIMD_WIDTH vertices at a time
+// in SoA form. Every multiply, add and divide happens in the same order as in
+// the scalar loop, so the output is bit-identical to it. That relies on the
+// compiler not contracting the scalar expressions into fused multiply-adds,
+// which is why this file is built with -ffp-contract=off. tools/vertex_bench
+// compares both paths, or build with GFX_VERIFY_SIMD_VERTEX to do it at runtime.
+static void gfx_sp_vertex_simd(size_t n_vertices, const Vtx *vertices, struct LoadedVertex *dest) {
+    enum { W = GFX_SIMD_WIDTH };
+    const bool lighting = (rsp.geometry_mode & G_LIGHTING) != 0;
+    const bool texgen = lighting && (rsp.geometry_mode & G_TEXTURE_GEN) != 0;
+    const bool fog = (rsp.geometry_mode & G_FOG) != 0;
+    const int num_lights = rsp.current_num_lights - 1;
+    const Light_t *ambient = &rsp.current_lights[num_lights];
+    
+    gfx_simd_t m[4][4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = gfx_simd_set1(rsp.MP_matrix[i][j]);
+        }
     }
+    const gfx_simd_t zero = gfx_simd_set1(0.0f);
+    const gfx_simd_t aspect = gfx_simd_set1(gfx_current_dimensions.aspect_ratio);
     
-    if ((rsp.geometry_mode & G_CULL_BOTH) != 0) {
-        float dx1 = v1->x / (v1->w) - v2->x / (v2->w);
-        float dy1 = v1->y / (v1->w) - v2->y / (v2->w);
-        float dx2 = v3->x / (v3->w) - v2->x / (v2->w);
-        float dy2 = v3->y / (v3->w) - v2->y / (v2->w);
-        float cross = dx1 * dy2 - dy1 * dx2;
+    float ob[3][W], nrm[3][W];
+    float out_x[W], out_y[W], out_z[W], out_w[W], out_clip[W], out_fog[W];
+    float out_rgb[3][W], out_uv[2][W];
+    
+    for (size_t base = 0; base < n_vertices; base += W) {
+        size_t count = n_vertices - base < W ? n_vertices - base : W;
         
-        if ((v1->w < 0) ^ (v2->w < 0) ^ (v3->w < 0)) {
-            // If one vertex lies behind the eye, negating cross will give the correct result.
-            // If all vertices lie behind the eye, the triangle will be rejected anyway.
-            cross = -cross;
+        // Transpose into SoA; unused lanes repeat the last vertex
+        for (size_t lane = 0; lane < W; lane++) {
+            const Vtx *src = &vertices[base + (lane < count ? lane : count - 1)];
+            for (int k = 0; k < 3; k++) {
+                ob[k][lane] = src->v.ob[k];
+                nrm[k][lane] = src->n.n[k];
+            }
         }
         
-        switch (rsp.geometry_mode & G_CULL_BOTH) {
-            case G_CULL_FRONT:
-                if (cross <= 0) return;
-                break;
-            case G_CULL_BACK:
-                if (cross >= 0) return;
-                break;
-            case G_CULL_BOTH:
-                // Why is this even an option?
-                return;
+        gfx_simd_t ox = gfx_simd_load(ob[0]), oy = gfx_simd_load(ob[1]), oz = gfx_simd_load(ob[2]);
+        gfx_simd_t pos[4];
+        for (int j = 0; j < 4; j++) {
+            gfx_simd_t p = gfx_simd_mul(ox, m[0][j]);
+            p = gfx_simd_add(p, gfx_simd_mul(oy, m[1][j]));
+            p = gfx_simd_add(p, gfx_simd_mul(oz, m[2][j]));
+            pos[j] = gfx_simd_add(p, m[3][j]);
+        }
+        gfx_simd_t x = gfx_simd_div(gfx_simd_mul(pos[0], gfx_simd_set1(4.0f / 3.0f)), aspect);
+        gfx_simd_t y = pos[1], z = pos[2], w = pos[3];
+        
+        // trivial clip rejection
+        gfx_simd_t neg_w = gfx_simd_sub(zero, w);
+        gfx_simd_t clip = gfx_simd_select(gfx_simd_cmplt(x, neg_w), gfx_simd_set1(1.0f), zero);
+        clip = gfx_simd_add(clip, gfx_simd_select(gfx_simd_cmpgt(x, w), gfx_simd_set1(2.0f), zero));
+        clip = gfx_simd_add(clip, gfx_simd_select(gfx_simd_cmplt(y, neg_w), gfx_simd_set1(4.0f), zero));
+        clip = gfx_simd_add(clip, gfx_simd_select(gfx_simd_cmpgt(y, w), gfx_simd_set1(8.0f), zero));
+        clip = gfx_simd_add(clip, gfx_simd_select(gfx_simd_cmplt(z, neg_w), gfx_simd_set1(16.0f), zero));
+        clip = gfx_simd_add(clip, gfx_simd_select(gfx_simd_cmpgt(z, w), gfx_simd_set1(32.0f), zero));
+        
+        gfx_simd_store(out_x, x);
+        gfx_simd_store(out_y, y);
+        gfx_simd_store(out_z, z);
+        gfx_simd_store(out_w, w);
+        gfx_simd_store(out_clip, clip);
+        
+        if (fog) {
+            gfx_simd_t abs_w = gfx_simd_max(w, neg_w);
+            gfx_simd_t fw = gfx_simd_select(gfx_simd_cmplt(abs_w, gfx_simd_set1(0.001f)), gfx_simd_set1(0.001f), w);
+            gfx_simd_t winv = gfx_simd_div(gfx_simd_set1(1.0f), fw);
+            winv = gfx_simd_select(gfx_simd_cmplt(winv, zero), gfx_simd_set1(32767.0f), winv);
+            gfx_simd_t fog_z = gfx_simd_mul(gfx_simd_mul(z, winv), gfx_simd_set1(rsp.fog_mul));
+            fog_z = gfx_simd_add(fog_z, gfx_simd_set1(rsp.fog_offset));
+            fog_z = gfx_simd_min(gfx_simd_max(fog_z, zero), gfx_simd_set1(255.0f));
+            gfx_simd_store(out_fog, fog_z);
+        }
+        
+        if (lighting) {
+            gfx_simd_t nx = gfx_simd_load(nrm[0]), ny = gfx_simd_load(nrm[1]), nz = gfx_simd_load(nrm[2]);
+            gfx_simd_t rgb[3];
+            for (int c = 0; c < 3; c++) {
+                rgb[c] = gfx_simd_set1(ambient->col[c]);
+            }
+            for (int i = 0; i < num_lights; i++) {
+                gfx_simd_t intensity = gfx_simd_mul(nx, gfx_simd_set1(rsp.current_lights_coeffs[i][0]));
+                intensity = gfx_simd_add(intensity, gfx_simd_mul(ny, gfx_simd_set1(rsp.current_lights_coeffs[i][1])));
+                intensity = gfx_simd_add(intensity, gfx_simd_mul(nz, gfx_simd_set1(rsp.current_lights_coeffs[i][2])));
+                intensity = gfx_simd_div(intensity, gfx_simd_set1(127.0f));
+                intensity = gfx_simd_max(intensity, zero);
+                for (int c = 0; c < 3; c++) {
+                    // The scalar path accumulates into an int, truncating after every light
+                    gfx_simd_t lit = gfx_simd_mul(intensity, gfx_simd_set1(rsp.current_lights[i].col[c]));
+                    rgb[c] = gfx_simd_trunc(gfx_simd_add(rgb[c], lit));
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                gfx_simd_store(out_rgb[c], gfx_simd_min(rgb[c], gfx_simd_set1(255.0f)));
+            }
+            
+            if (texgen) {
+                const float scale[2] = {rsp.texture_scaling_factor.s, rsp.texture_scaling_factor.t};
+                for (int k = 0; k < 2; k++) {
+                    gfx_simd_t dot = gfx_simd_mul(nx, gfx_simd_set1(rsp.current_lookat_coeffs[k][0]));
+                    dot = gfx_simd_add(dot, gfx_simd_mul(ny, gfx_simd_set1(rsp.current_lookat_coeffs[k][1])));
+                    dot = gfx_simd_add(dot, gfx_simd_mul(nz, gfx_simd_set1(rsp.current_lookat_coeffs[k][2])));
+                    dot = gfx_simd_add(gfx_simd_div(dot, gfx_simd_set1(127.0f)), gfx_simd_set1(1.0f));
+                    dot = gfx_simd_mul(gfx_simd_div(dot, gfx_simd_set1(4.0f)), gfx_simd_set1(scale[k]));
+                    gfx_simd_store(out_uv[k], gfx_simd_trunc(dot));
+                }
+            }
+        }
+        
+        for (size_t lane = 0; lane < count; lane++) {
+            const Vtx_t *v = &vertices[base + lane].v;
+            struct LoadedVertex *d = &dest[base + lane];
+            
+            d->x = out_x[lane];
+            d->y = out_y[lane];
+            d->z = out_z[lane];
+            d->w = out_w[lane];
+            d->clip_rej = (uint8_t)out_clip[lane];
+            
+            if (texgen) {
+                d->u = (short)(int32_t)out_uv[0][lane];
+                d->v = (short)(int32_t)out_uv[1][lane];
+            } else {
+                d->u = (short)(v->tc[0] * rsp.texture_scaling_factor.s >> 16);
+                d->v = (short)(v->tc[1] * rsp.texture_scaling_factor.t >> 16);
+            }
+            
+            if (lighting) {
+                d->color.r = out_rgb[0][lane];
+                d->color.g = out_rgb[1][lane];
+                d->color.b = out_rgb[2][lane];
+            } else {
+                d->color.r = v->cn[0];
+                d->color.g = v->cn[1];
+                d->color.b = v->cn[2];
+            }
+            d->color.a = fog ? out_fog[lane] : v->cn[3];
         }
     }
-    
-    bool depth_test = (rsp.geometry_mode & G_ZBUFFER) == G_ZBUFFER;
-    if (depth_test != rendering_state.depth_test) {
-        gfx_flush();
-        gfx_rapi->set_depth_test(depth_test);
-        rendering_state.depth_test = depth_test;
-    }
-    
-    bool z_upd = (rdp.other_mode_l & Z_UPD) == Z_UPD;
-    if (z_upd != rendering_state.depth_mask) {
-        gfx_flush();
-        gfx_rapi->set_depth_mask(z_upd);
-        rendering_state.depth_mask = z_upd;
+}
+#endif
+
+#ifdef GFX_VERIFY_SIMD_VERTEX
+static void gfx_verify_simd_vertex(size_t n_vertices, const Vtx *vertices, const struct LoadedVertex *simd) {
+    struct LoadedVertex ref[MAX_VERTICES];
+    gfx_sp_vertex_scalar(n_vertices, vertices, ref);
+    for (size_t i = 0; i < n_vertices; i++) {
+        const struct LoadedVertex *a = &ref[i], *b = &simd[i];
+        if (memcmp(&a->color, &b->color, sizeof(a->color)) != 0 || a->clip_rej != b->clip_rej || a->u != b->u || a->v != b->v ||
+            a->x != b->x || a->y != b->y || a->z != b->z || a->w != b->w) {
+            fprintf(stderr, "gfx_sp_vertex: simd mismatch at %u: pos %g %g %g %g / %g %g %g %g, clip %u/%u, rgba %08x/%08x\n",
+                    (unsigned)i, a->x, a->y, a->z, a->w, b->x, b->y, b->z, b->w, a->clip_rej, b->clip_rej,
+                    (unsigned)(a->color.r << 24 | a->color.g << 16 | a->color.b << 8 | a->color.a),
+                    (unsigned)(b->color.r << 24 | b->color.g << 16 | b->color.b << 8 | b->color.a));
+        }
     }
+}
+#endif
+
+// Drops the snapshots that no loaded vertex refers to anymore
+static void gfx_xf_compact_snapshots(void) {
+    static float live[MAX_VERTICES][GFX_TRANSFORM_SLOT_VEC4S][4];
+    int16_t remap[MAX_TRANSFORM_SNAPSHOTS];
+    uint16_t num_live = 0;
     
-    bool zmode_decal = (rdp.other_mode_l & ZMODE_DEC) == ZMODE_DEC;
-    if (zmode_decal != rendering_state.decal_mode) {
-        gfx_flush();
-        gfx_rapi->set_zmode_decal(zmode_decal);
-        rendering_state.decal_mode = zmode_decal;
-    }
+    // The slot table refers to snapshots by index
+    gfx_flush();
+    gpu_xf.num_slots = 0;
     
-    if (rdp.viewport_or_scissor_changed) {
-        if (memcmp(&rdp.viewport, &rendering_state.viewport, sizeof(rdp.viewport)) != 0) {
-            gfx_flush();
-            gfx_rapi->set_viewport(rdp.viewport.x, rdp.viewport.y, rdp.viewport.width, rdp.viewport.height);
-            rendering_state.viewport = rdp.viewport;
+    memset(remap, 0xff, sizeof(remap));
+    for (int i = 0; i < MAX_VERTICES; i++) {
+        int16_t t = rsp.loaded_vertices[i].transform;
+        if (t < 0) {
+            continue;
         }
-        if (memcmp(&rdp.scissor, &rendering_state.scissor, sizeof(rdp.scissor)) != 0) {
-            gfx_flush();
-            gfx_rapi->set_scissor(rdp.scissor.x, rdp.scissor.y, rdp.scissor.width, rdp.scissor.height);
-            rendering_state.scissor = rdp.scissor;
+        if (remap[t] < 0) {
+            memcpy(live[num_live], gpu_xf.snapshots[t], sizeof(live[0]));
+            remap[t] = num_live++;
         }
-        rdp.viewport_or_scissor_changed = false;
+        rsp.loaded_vertices[i].transform = remap[t];
     }
-    
+    memcpy(gpu_xf.snapshots, live, num_live * sizeof(live[0]));
+    gpu_xf.num_snapshots = num_live;
+}
+
+static int16_t gfx_xf_snapshot(void) {
+    float s[GFX_TRANSFORM_SLOT_VEC4S][4];
+    bool lighting = (rsp.geometry_mode & G_LIGHTING) != 0;
+    
+    memset(s, 0, sizeof(s));
+    memcpy(s, rsp.MP_matrix, sizeof(rsp.MP_matrix));
+    if (lighting) {
+        const Light_t *ambient = &rsp.current_lights[rsp.current_num_lights - 1];
+        for (int i = 0; i < rsp.current_num_lights - 1; i++) {
+            for (int j = 0; j < 3; j++) {
+                s[4 + i][j] = rsp.current_lights_coeffs[i][j];
+                s[8 + i][j] = rsp.current_lights[i].col[j];
+            }
+        }
+        for (int j = 0; j < 3; j++) {
+            s[6][j] = rsp.current_lookat_coeffs[0][j];
+            s[7][j] = rsp.current_lookat_coeffs[1][j];
+            s[10][j] = ambient->col[j];
+        }
+    }
+    s[4][3] = rsp.fog_mul;
+    s[5][3] = rsp.fog_offset;
+    s[6][3] = (lighting ? 1 : 0) | ((rsp.geometry_mode & G_TEXTURE_GEN) ? 2 : 0) | ((rsp.geometry_mode & G_FOG) ? 4 : 0);
+    s[7][3] = (4.0f / 3.0f) / gfx_current_dimensions.aspect_ratio;
+    s[8][3] = rsp.texture_scaling_factor.s;
+    s[9][3] = rsp.texture_scaling_factor.t;
+    
+    if (gpu_xf.num_snapshots > 0 && memcmp(gpu_xf.snapshots[gpu_xf.num_snapshots - 1], s, sizeof(s)) == 0) {
+        return gpu_xf.num_snapshots - 1;
+    }
+    if (gpu_xf.num_snapshots == MAX_TRANSFORM_SNAPSHOTS) {
+        gfx_xf_compact_snapshots();
+    }
+    memcpy(gpu_xf.snapshots[gpu_xf.num_snapshots], s, sizeof(s));
+    return gpu_xf.num_snapshots++;
+}
+
+// Finds or allocates the slots for the snapshots of a triangle, submitting the current batch if the table is full
+static void gfx_xf_assign_slots(struct LoadedVertex *v_arr[3], float slots[3]) {
+    int found[3];
+    int missing = 0;
+    
+    for (int i = 0; i < 3; i++) {
+        found[i] = -1;
+        for (int j = 0; j < gpu_xf.num_slots; j++) {
+            if (gpu_xf.slot_snapshots[j] == v_arr[i]->transform) {
+                found[i] = j;
+                break;
+            }
+        }
+        missing += found[i] < 0;
+    }
+    if (gpu_xf.num_slots + missing > GFX_MAX_TRANSFORM_SLOTS) {
+        gfx_flush();
+        gpu_xf.num_slots = 0;
+        found[0] = found[1] = found[2] = -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (found[i] < 0) {
+            for (int j = 0; j < gpu_xf.num_slots; j++) {
+                if (gpu_xf.slot_snapshots[j] == v_arr[i]->transform) {
+                    found[i] = j;
+                    break;
+                }
+            }
+        }
+        if (found[i] < 0) {
+            found[i] = gpu_xf.num_slots++;
+            gpu_xf.slot_snapshots[found[i]] = v_arr[i]->transform;
+            memcpy(gpu_xf.slots[found[i] * GFX_TRANSFORM_SLOT_VEC4S], gpu_xf.snapshots[v_arr[i]->transform], sizeof(gpu_xf.snapshots[0]));
+            gpu_xf.slots_changed = true;
+        }
+        slots[i] = found[i];
+    }
+}
+
+static void gfx_static_save_rsp(struct StaticRspState *s) {
+    memset(s, 0, sizeof(*s));
+    s->geometry_mode = rsp.geometry_mode;
+    s->fog_mul = rsp.fog_mul;
+    s->fog_offset = rsp.fog_offset;
+    s->texture_scale_s = rsp.texture_scaling_factor.s;
+    s->texture_scale_t = rsp.texture_scaling_factor.t;
+    memcpy(s->lights, rsp.current_lights, sizeof(s->lights));
+    s->num_lights = rsp.current_num_lights;
+}
+
+static void gfx_static_load_rsp(const struct StaticRspState *s) {
+    rsp.geometry_mode = s->geometry_mode;
+    rsp.fog_mul = s->fog_mul;
+    rsp.fog_offset = s->fog_offset;
+    rsp.texture_scaling_factor.s = s->texture_scale_s;
+    rsp.texture_scaling_factor.t = s->texture_scale_t;
+    memcpy(rsp.current_lights, s->lights, sizeof(s->lights));
+    rsp.current_num_lights = s->num_lights;
+    rsp.lights_changed = true;
+}
+
+// A cached display list is redrawn with a single transform slot, so all of its
+// vertices must have been loaded with the same transform state.
+static void gfx_static_dl_record_vertices(size_t n_vertices, size_t dest_index, int16_t transform) {
+    if (!static_dls.has_snapshot) {
+        memcpy(static_dls.snapshot, gpu_xf.snapshots[transform], sizeof(static_dls.snapshot));
+        gfx_static_save_rsp(&static_dls.vertex_state);
+        static_dls.has_snapshot = true;
+    } else if (memcmp(static_dls.snapshot, gpu_xf.snapshots[transform], sizeof(static_dls.snapshot)) != 0) {
+        static_dls.record_failed = true;
+    }
+    for (size_t i = dest_index; i < dest_index + n_vertices && i < MAX_VERTICES; i++) {
+        static_dls.loaded_mask |= (uint64_t)1 << i;
+    }
+}
+
+static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *vertices) {
+    gfx_stats.vertices += n_vertices;
+    if ((rsp.geometry_mode & G_LIGHTING) && rsp.lights_changed) {
+        gfx_update_light_coeffs();
+    }
+    
+    struct LoadedVertex *dest = &rsp.loaded_vertices[dest_index];
+    if (gpu_xf.active) {
+        int16_t transform = gfx_xf_snapshot();
+        for (size_t i = 0; i < n_vertices; i++) {
+            dest[i].raw = vertices[i].v;
+            dest[i].transform = transform;
+            dest[i].clip_rej = 0;
+        }
+        if (static_dls.recording != NULL) {
+            gfx_static_dl_record_vertices(n_vertices, dest_index, transform);
+        }
+        return;
+    }
+#ifdef GFX_SIMD_WIDTH
+    if (simd_vertex_transform) {
+        gfx_sp_vertex_simd(n_vertices, vertices, dest);
+#ifdef GFX_VERIFY_SIMD_VERTEX
+        gfx_verify_simd_vertex(n_vertices, vertices, dest);
+#endif
+        return;
+    }
+#endif
+    gfx_sp_vertex_scalar(n_vertices, vertices, dest);
+}
+
+static void gfx_update_viewport_and_scissor(void) {
+    if (rdp.viewport_or_scissor_changed) {
+        if (memcmp(&rdp.viewport, &rendering_state.viewport, sizeof(rdp.viewport)) != 0) {
+            gfx_flush_sorted();
+            gfx_flush();
+            gfx_rapi->set_viewport(rdp.viewport.x, rdp.viewport.y, rdp.viewport.width, rdp.viewport.height);
+            rendering_state.viewport = rdp.viewport;
+        }
+        if (memcmp(&rdp.scissor, &rendering_state.scissor, sizeof(rdp.scissor)) != 0) {
+            gfx_flush_sorted();
+            gfx_flush();
+            gfx_rapi->set_scissor(rdp.scissor.x, rdp.scissor.y, rdp.scissor.width, rdp.scissor.height);
+            rendering_state.scissor = rdp.scissor;
+        }
+        rdp.viewport_or_scissor_changed = false;
+    }
+}
+
+static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
+    struct LoadedVertex *v1 = &rsp.loaded_vertices[vtx1_idx];
+    struct LoadedVertex *v2 = &rsp.loaded_vertices[vtx2_idx];
+    struct LoadedVertex *v3 = &rsp.loaded_vertices[vtx3_idx];
+    struct LoadedVertex *v_arr[3] = {v1, v2, v3};
+    
+    //if (rand()%2) return;
+    
+    // Raw vertices are transformed, clipped and culled by the backend
+    bool gpu_transform = gpu_xf.active && v1->transform >= 0 && v2->transform >= 0 && v3->transform >= 0;
+    int cull_face = GFX_CULL_NONE;
+
+    if (static_dls.recording != NULL) {
+        // Vertices loaded before the display list was called are not part of its cached copy
+        uint8_t idx[3] = { vtx1_idx, vtx2_idx, vtx3_idx };
+        for (int i = 0; i < 3; i++) {
+            if (idx[i] >= MAX_VERTICES || !(static_dls.loaded_mask & ((uint64_t)1 << idx[i]))) {
+                static_dls.record_failed = true;
+            }
+        }
+        if (!gpu_transform) {
+            static_dls.record_failed = true;
+        }
+    }
+
+    if (gpu_transform) {
+        switch (rsp.geometry_mode & G_CULL_BOTH) {
+            case G_CULL_FRONT:
+                cull_face = GFX_CULL_FRONT;
+                break;
+            case G_CULL_BACK:
+                cull_face = GFX_CULL_BACK;
+                break;
+            case G_CULL_BOTH:
+                gfx_stats.triangles_culled++;
+                return;
+        }
+    } else if (v1->clip_rej & v2->clip_rej & v3->clip_rej) {
+        // The whole triangle lies outside the visible area
+        gfx_stats.triangles_clip_rejected++;
+        return;
+    } else if ((rsp.geometry_mode & G_CULL_BOTH) != 0) {
+        float dx1 = v1->x / (v1->w) - v2->x / (v2->w);
+        float dy1 = v1->y / (v1->w) - v2->y / (v2->w);
+        float dx2 = v3->x / (v3->w) - v2->x / (v2->w);
+        float dy2 = v3->y / (v3->w) - v2->y / (v2->w);
+        float cross = dx1 * dy2 - dy1 * dx2;
+        
+        if ((v1->w < 0) ^ (v2->w < 0) ^ (v3->w < 0)) {
+            // If one vertex lies behind the eye, negating cross will give the correct result.
+            // If all vertices lie behind the eye, the triangle will be rejected anyway.
+            cross = -cross;
+        }
+        
+        switch (rsp.geometry_mode & G_CULL_BOTH) {
+            case G_CULL_FRONT:
+                if (cross <= 0) {
+                    gfx_stats.triangles_culled++;
+                    return;
+                }
+                break;
+            case G_CULL_BACK:
+                if (cross >= 0) {
+                    gfx_stats.triangles_culled++;
+                    return;
+                }
+                break;
+            case G_CULL_BOTH:
+                // Why is this even an option?
+                gfx_stats.triangles_culled++;
+                return;
+        }
+    }
+    
+    bool depth_test = (rsp.geometry_mode & G_ZBUFFER) == G_ZBUFFER;
+    bool z_upd = (rdp.other_mode_l & Z_UPD) == Z_UPD;
+    bool zmode_decal = (rdp.other_mode_l & ZMODE_DEC) == ZMODE_DEC;
+    
     uint32_t cc_id = rdp.combine_mode;
     
     bool use_alpha = (rdp.other_mode_l & (G_BL_A_MEM << 18)) == 0;
@@ -797,10 +1727,50 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
         use_alpha = true;
     }
     
+    // Depth tested and written opaque surfaces are recorded and drawn grouped by
+    // shader and texture, but only moved past draws they cannot share a pixel with,
+    // so coplanar surfaces still resolve the LEQUAL depth test in display list order.
+    bool sorted = sort_opaque_draws && !gpu_transform && depth_test && z_upd && !zmode_decal && !use_alpha;
+    if (sorted) {
+        gfx_flush();
+        if (sorted_num_tris == MAX_SORTED || sorted_draws_count == MAX_SORTED_BATCHES) {
+            gfx_flush_sorted();
+        }
+    } else {
+        gfx_flush_sorted();
+    }
+    
+    if (depth_test != rendering_state.depth_test) {
+        gfx_flush();
+        gfx_rapi->set_depth_test(depth_test);
+        rendering_state.depth_test = depth_test;
+    }
+    
+    if (z_upd != rendering_state.depth_mask) {
+        gfx_flush();
+        gfx_rapi->set_depth_mask(z_upd);
+        rendering_state.depth_mask = z_upd;
+    }
+    
+    if (zmode_decal != rendering_state.decal_mode) {
+        gfx_flush();
+        gfx_rapi->set_zmode_decal(zmode_decal);
+        rendering_state.decal_mode = zmode_decal;
+    }
+    
+    if (cull_face != rendering_state.cull_face) {
+        gfx_flush();
+        gfx_rapi->set_cull_face(cull_face);
+        rendering_state.cull_face = cull_face;
+    }
+    
+    gfx_update_viewport_and_scissor();
+    
     if (use_alpha) cc_id |= SHADER_OPT_ALPHA;
     if (use_fog) cc_id |= SHADER_OPT_FOG;
     if (texture_edge) cc_id |= SHADER_OPT_TEXTURE_EDGE;
     if (use_noise) cc_id |= SHADER_OPT_NOISE;
+    if (gpu_transform) cc_id |= SHADER_OPT_GPU_TRANSFORM;
     
     if (!use_alpha) {
         cc_id &= ~0xfff000;
@@ -808,10 +1778,11 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     
     struct ColorCombiner *comb = gfx_lookup_or_create_color_combiner(cc_id);
     struct ShaderProgram *prg = comb->prg;
-    if (prg != rendering_state.shader_program) {
+    if (!sorted && prg != rendering_state.shader_program) {
         gfx_flush();
         gfx_rapi->unload_shader(rendering_state.shader_program);
         gfx_rapi->load_shader(prg);
+        gfx_stats.shader_switches++;
         rendering_state.shader_program = prg;
     }
     if (use_alpha != rendering_state.alpha_blend) {
@@ -823,14 +1794,26 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     bool used_textures[2];
     gfx_rapi->shader_get_info(prg, &num_inputs, used_textures);
     
+    bool linear_filter = (rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT;
     for (int i = 0; i < 2; i++) {
         if (used_textures[i]) {
             if (rdp.textures_changed[i]) {
-                gfx_flush();
-                import_texture(i);
+                if (i != 0 || !gfx_atlas_select(linear_filter)) {
+                    gfx_flush();
+                    import_texture(i);
+                    if (i == 0) {
+                        glyph_atlas.selected = NULL;
+                    }
+                }
                 rdp.textures_changed[i] = false;
+                if (static_dls.recording != NULL) {
+                    static_dls.imported[i] = true;
+                }
+            }
+            if (sorted) {
+                // Sampler state is applied when the sorted draws are submitted
+                continue;
             }
-            bool linear_filter = (rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT;
             if (linear_filter != rendering_state.textures[i]->linear_filter || rdp.texture_tile.cms != rendering_state.textures[i]->cms || rdp.texture_tile.cmt != rendering_state.textures[i]->cmt) {
                 gfx_flush();
                 gfx_rapi->set_sampler_parameters(i, linear_filter, rdp.texture_tile.cms, rdp.texture_tile.cmt);
@@ -844,20 +1827,62 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     bool use_texture = used_textures[0] || used_textures[1];
     uint32_t tex_width = (rdp.texture_tile.lrs - rdp.texture_tile.uls + 4) / 4;
     uint32_t tex_height = (rdp.texture_tile.lrt - rdp.texture_tile.ult + 4) / 4;
+    const struct AtlasGlyph *glyph = used_textures[0] ? glyph_atlas.selected : NULL;
+    const struct GlyphAtlas *atlas = glyph != NULL ? &glyph_atlas.atlases[glyph->atlas] : NULL;
+    if (atlas != NULL && rendering_state.textures[0] != &atlas->node) {
+        // Another texture was bound since, by a cached display list for instance
+        glyph = NULL;
+        atlas = NULL;
+    }
     
     bool z_is_from_0_to_1 = gfx_rapi->z_is_from_0_to_1();
     
+    float slots[3];
+    if (gpu_transform) {
+        gfx_xf_assign_slots(v_arr, slots);
+    }
+    
     for (int i = 0; i < 3; i++) {
-        float z = v_arr[i]->z, w = v_arr[i]->w;
-        if (z_is_from_0_to_1) {
-            z = (z + w) / 2.0f;
-        }
-        buf_vbo[buf_vbo_len++] = v_arr[i]->x;
-        buf_vbo[buf_vbo_len++] = v_arr[i]->y;
-        buf_vbo[buf_vbo_len++] = z;
-        buf_vbo[buf_vbo_len++] = w;
+        if (gpu_transform) {
+            const Vtx_t *raw = &v_arr[i]->raw;
+            buf_vbo[buf_vbo_len++] = raw->ob[0];
+            buf_vbo[buf_vbo_len++] = raw->ob[1];
+            buf_vbo[buf_vbo_len++] = raw->ob[2];
+            buf_vbo[buf_vbo_len++] = slots[i];
+            buf_vbo[buf_vbo_len++] = raw->cn[0];
+            buf_vbo[buf_vbo_len++] = raw->cn[1];
+            buf_vbo[buf_vbo_len++] = raw->cn[2];
+            buf_vbo[buf_vbo_len++] = raw->cn[3];
+            if (use_texture) {
+                // Texture coordinates are scaled on the GPU, then offset and scaled to the tile
+                float half = linear_filter ? 16.0f : 0.0f;
+                buf_vbo[buf_vbo_len++] = raw->tc[0];
+                buf_vbo[buf_vbo_len++] = raw->tc[1];
+                if (glyph != NULL) {
+                    // Offset to the glyph's cell and scale to the atlas
+                    buf_vbo[buf_vbo_len++] = rdp.texture_tile.uls * 8 - half - 32.0f * glyph->x;
+                    buf_vbo[buf_vbo_len++] = rdp.texture_tile.ult * 8 - half - 32.0f * glyph->y;
+                    buf_vbo[buf_vbo_len++] = 1.0f / (32.0f * atlas->width);
+                    buf_vbo[buf_vbo_len++] = 1.0f / (32.0f * atlas->height);
+                } else {
+                    buf_vbo[buf_vbo_len++] = rdp.texture_tile.uls * 8 - half;
+                    buf_vbo[buf_vbo_len++] = rdp.texture_tile.ult * 8 - half;
+                    buf_vbo[buf_vbo_len++] = 1.0f / (32.0f * tex_width);
+                    buf_vbo[buf_vbo_len++] = 1.0f / (32.0f * tex_height);
+                }
+            }
+        } else {
+            float z = v_arr[i]->z, w = v_arr[i]->w;
+            if (z_is_from_0_to_1) {
+                z = (z + w) / 2.0f;
+            }
+            buf_vbo[buf_vbo_len++] = v_arr[i]->x;
+            buf_vbo[buf_vbo_len++] = v_arr[i]->y;
+            buf_vbo[buf_vbo_len++] = z;
+            buf_vbo[buf_vbo_len++] = w;
+        }
         
-        if (use_texture) {
+        if (use_texture && !gpu_transform) {
             float u = (v_arr[i]->u - rdp.texture_tile.uls * 8) / 32.0f;
             float v = (v_arr[i]->v - rdp.texture_tile.ult * 8) / 32.0f;
             if ((rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT) {
@@ -865,33 +1890,42 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
                 u += 0.5f;
                 v += 0.5f;
             }
-            buf_vbo[buf_vbo_len++] = u / tex_width;
-            buf_vbo[buf_vbo_len++] = v / tex_height;
+            if (glyph != NULL) {
+                buf_vbo[buf_vbo_len++] = (glyph->x + u) / atlas->width;
+                buf_vbo[buf_vbo_len++] = (glyph->y + v) / atlas->height;
+            } else {
+                buf_vbo[buf_vbo_len++] = u / tex_width;
+                buf_vbo[buf_vbo_len++] = v / tex_height;
+            }
         }
         
         if (use_fog) {
             buf_vbo[buf_vbo_len++] = rdp.fog_color.r / 255.0f;
             buf_vbo[buf_vbo_len++] = rdp.fog_color.g / 255.0f;
             buf_vbo[buf_vbo_len++] = rdp.fog_color.b / 255.0f;
-            buf_vbo[buf_vbo_len++] = v_arr[i]->color.a / 255.0f; // fog factor (not alpha)
+            buf_vbo[buf_vbo_len++] = gpu_transform ? 0.0f : v_arr[i]->color.a / 255.0f; // fog factor (not alpha)
         }
         
         for (int j = 0; j < num_inputs; j++) {
             struct RGBA *color;
             struct RGBA tmp;
             for (int k = 0; k < 1 + (use_alpha ? 1 : 0); k++) {
+                // The GPU path computes shade and LOD itself, marked with -1 and -2
+                float gpu_source = 0.0f;
                 switch (comb->shader_input_mapping[k][j]) {
                     case CC_PRIM:
                         color = &rdp.prim_color;
                         break;
                     case CC_SHADE:
                         color = &v_arr[i]->color;
+                        gpu_source = -1.0f;
                         break;
                     case CC_ENV:
                         color = &rdp.env_color;
                         break;
                     case CC_LOD:
                     {
+                        gpu_source = -2.0f;
                         float distance_frac = (v1->w - 3000.0f) / 3000.0f;
                         if (distance_frac < 0.0f) distance_frac = 0.0f;
                         if (distance_frac > 1.0f) distance_frac = 1.0f;
@@ -905,13 +1939,21 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
                         break;
                 }
                 if (k == 0) {
-                    buf_vbo[buf_vbo_len++] = color->r / 255.0f;
-                    buf_vbo[buf_vbo_len++] = color->g / 255.0f;
-                    buf_vbo[buf_vbo_len++] = color->b / 255.0f;
+                    if (gpu_transform && gpu_source != 0.0f) {
+                        buf_vbo[buf_vbo_len++] = gpu_source;
+                        buf_vbo[buf_vbo_len++] = gpu_source;
+                        buf_vbo[buf_vbo_len++] = gpu_source;
+                    } else {
+                        buf_vbo[buf_vbo_len++] = color->r / 255.0f;
+                        buf_vbo[buf_vbo_len++] = color->g / 255.0f;
+                        buf_vbo[buf_vbo_len++] = color->b / 255.0f;
+                    }
                 } else {
                     if (use_fog && color == &v_arr[i]->color) {
                         // Shade alpha is 100% for fog
                         buf_vbo[buf_vbo_len++] = 1.0f;
+                    } else if (gpu_transform && gpu_source != 0.0f) {
+                        buf_vbo[buf_vbo_len++] = gpu_source;
                     } else {
                         buf_vbo[buf_vbo_len++] = color->a / 255.0f;
                     }
@@ -924,6 +1966,10 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
         buf_vbo[buf_vbo_len++] = color->b / 255.0f;
         buf_vbo[buf_vbo_len++] = color->a / 255.0f;*/
     }
+    if (sorted) {
+        gfx_record_sorted_triangle(prg, used_textures, linear_filter);
+        return;
+    }
     if (++buf_vbo_num_tris == MAX_BUFFERED) {
         gfx_flush();
     }
@@ -1221,6 +2267,8 @@ static void gfx_draw_rectangle(int32_t ulx, int32_t uly, int32_t lrx, int32_t lr
     struct LoadedVertex* lr = &rsp.loaded_vertices[MAX_VERTICES + 2];
     struct LoadedVertex* ur = &rsp.loaded_vertices[MAX_VERTICES + 3];
     
+    ul->transform = ll->transform = lr->transform = ur->transform = -1;
+    
     ul->x = ulxf;
     ul->y = ulyf;
     ul->z = -1.0f;
@@ -1361,14 +2409,751 @@ static inline void *seg_addr(uintptr_t w1) {
 #define C0(pos, width) ((cmd->words.w0 >> (pos)) & ((1U << width) - 1))
 #define C1(pos, width) ((cmd->words.w1 >> (pos)) & ((1U << width) - 1))
 
+static void gfx_run_dl(Gfx* cmd);
+
+static uint64_t gfx_hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (size >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        hash = (hash ^ w) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        hash = (hash ^ *p++) * 0x100000001b3ULL;
+        size--;
+    }
+    return hash;
+}
+
+// Hashes a display list together with the vertices and lights it reads. Returns false if it contains
+// commands that a cached copy can't reproduce: matrices, viewport and scissor changes, and rectangles.
+static bool gfx_static_dl_hash(Gfx *cmd, uint64_t *hash, int depth, uint32_t *num_commands) {
+    if (depth > 16) {
+        return false;
+    }
+    for (;;) {
+        uint32_t opcode = cmd->words.w0 >> 24;
+        
+        if (++*num_commands > STATIC_DL_MAX_COMMANDS) {
+            return false;
+        }
+        *hash = gfx_hash_bytes(*hash, &cmd->words, sizeof(cmd->words));
+        switch (opcode) {
+            case G_MTX:
+            case (uint8_t)G_POPMTX:
+            case (uint8_t)G_RDPHALF_1:
+            case (uint8_t)G_RDPHALF_2:
+            case G_TEXRECT:
+            case G_TEXRECTFLIP:
+            case G_FILLRECT:
+            case G_SETSCISSOR:
+            case G_SETZIMG:
+            case G_SETCIMG:
+                return false;
+            case G_MOVEMEM:
+#ifdef F3DEX_GBI_2
+                if (C0(0, 8) == G_MV_VIEWPORT) {
+                    return false;
+                }
+                if (C0(0, 8) == G_MV_LIGHT) {
+                    *hash = gfx_hash_bytes(*hash, seg_addr(cmd->words.w1), sizeof(Light_t));
+                }
+#else
+                if (C0(16, 8) == G_MV_VIEWPORT) {
+                    return false;
+                }
+                if (C0(16, 8) == G_MV_L0 || C0(16, 8) == G_MV_L1 || C0(16, 8) == G_MV_L2) {
+                    *hash = gfx_hash_bytes(*hash, seg_addr(cmd->words.w1), sizeof(Light_t));
+                }
+#endif
+                break;
+            case G_VTX:
+#ifdef F3DEX_GBI_2
+                *hash = gfx_hash_bytes(*hash, seg_addr(cmd->words.w1), C0(12, 8) * sizeof(Vtx));
+#elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
+                *hash = gfx_hash_bytes(*hash, seg_addr(cmd->words.w1), C0(10, 6) * sizeof(Vtx));
+#else
+                *hash = gfx_hash_bytes(*hash, seg_addr(cmd->words.w1), C0(0, 16));
+#endif
+                break;
+            case G_DL:
+                if (C0(16, 1) == 0) {
+                    if (!gfx_static_dl_hash((Gfx *)seg_addr(cmd->words.w1), hash, depth + 1, num_commands)) {
+                        return false;
+                    }
+                } else {
+                    cmd = (Gfx *)seg_addr(cmd->words.w1);
+                    --cmd; // increase after break
+                }
+                break;
+            case (uint8_t)G_ENDDL:
+                return true;
+        }
+        ++cmd;
+    }
+}
+
+static uint64_t gfx_static_dl_key(const Gfx *dl) {
+    struct StaticRspState s;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    
+    gfx_static_save_rsp(&s);
+    hash = gfx_hash_bytes(hash, &dl, sizeof(dl));
+    hash = gfx_hash_bytes(hash, &rdp, sizeof(rdp));
+    hash = gfx_hash_bytes(hash, &s, sizeof(s));
+    return hash;
+}
+
+static void gfx_static_dl_release(struct StaticDisplayList *e) {
+    if (e->mesh != 0) {
+        gfx_rapi->delete_static_mesh(e->mesh);
+        e->mesh = 0;
+    }
+    free(e->groups);
+    free(e->exit);
+    e->groups = NULL;
+    e->num_groups = 0;
+    e->exit = NULL;
+}
+
+static void gfx_static_dl_cache_clear(void) {
+    if (static_dls.recording != NULL) {
+        // The entry is still in use, clear once it has been recorded
+        static_dls.record_failed = true;
+        static_dls.clear_pending = true;
+        return;
+    }
+    for (size_t i = 0; i < MAX_STATIC_DLS; i++) {
+        if (static_dls.entries[i].dl != NULL) {
+            gfx_static_dl_release(&static_dls.entries[i]);
+        }
+    }
+    memset(static_dls.entries, 0, sizeof(static_dls.entries));
+    static_dls.count = 0;
+    static_dls.clear_pending = false;
+}
+
+static void gfx_static_dl_textures_reset(void) {
+    if (static_dls.count > 0) {
+        gfx_static_dl_cache_clear();
+    }
+}
+
+static struct StaticDisplayList *gfx_static_dl_lookup(const Gfx *dl, uint64_t key) {
+    size_t i = (size_t)(key ^ (key >> 32)) & (MAX_STATIC_DLS - 1);
+    while (static_dls.entries[i].dl != NULL) {
+        if (static_dls.entries[i].dl == dl && static_dls.entries[i].key == key) {
+            return &static_dls.entries[i];
+        }
+        i = (i + 1) & (MAX_STATIC_DLS - 1);
+    }
+    if (static_dls.count >= MAX_STATIC_DLS * 3 / 4) {
+        // Table is getting full. Like the texture cache, start over.
+        gfx_static_dl_cache_clear();
+        i = (size_t)(key ^ (key >> 32)) & (MAX_STATIC_DLS - 1);
+    }
+    struct StaticDisplayList *e = &static_dls.entries[i];
+    memset(e, 0, sizeof(*e));
+    e->dl = dl;
+    e->key = key;
+    e->status = STATIC_DL_CANDIDATE;
+    static_dls.count++;
+    return e;
+}
+
+static bool gfx_static_draw_group_same_state(const struct StaticDrawGroup *a, const struct StaticDrawGroup *b) {
+    return a->prg == b->prg && a->textures[0] == b->textures[0] && a->textures[1] == b->textures[1] &&
+           memcmp(a->linear_filter, b->linear_filter, sizeof(a->linear_filter)) == 0 &&
+           memcmp(a->cms, b->cms, sizeof(a->cms)) == 0 && memcmp(a->cmt, b->cmt, sizeof(a->cmt)) == 0 &&
+           a->depth_test == b->depth_test && a->depth_mask == b->depth_mask && a->decal_mode == b->decal_mode &&
+           a->alpha_blend == b->alpha_blend && a->cull_face == b->cull_face;
+}
+
+// Copies the batch about to be drawn into the display list being recorded
+static void gfx_static_dl_capture(void) {
+    struct StaticDrawGroup g;
+    uint8_t num_inputs;
+    bool used_textures[2];
+    
+    if (static_dls.record_failed) {
+        return;
+    }
+    memset(&g, 0, sizeof(g));
+    g.prg = rendering_state.shader_program;
+    gfx_rapi->shader_get_info(g.prg, &num_inputs, used_textures);
+    for (int i = 0; i < 2; i++) {
+        if (used_textures[i]) {
+            g.textures[i] = rendering_state.textures[i];
+            g.linear_filter[i] = g.textures[i]->linear_filter;
+            g.cms[i] = g.textures[i]->cms;
+            g.cmt[i] = g.textures[i]->cmt;
+        }
+    }
+    g.depth_test = rendering_state.depth_test;
+    g.depth_mask = rendering_state.depth_mask;
+    g.decal_mode = rendering_state.decal_mode;
+    g.alpha_blend = rendering_state.alpha_blend;
+    g.cull_face = rendering_state.cull_face;
+    g.floats_per_vertex = buf_vbo_len / (3 * buf_vbo_num_tris);
+    g.first_float = static_dls.vbo_len;
+    g.num_indices = 3 * buf_vbo_num_tris;
+    
+    if (static_dls.vbo_len + buf_vbo_len > static_dls.vbo_cap) {
+        static_dls.vbo_cap = (static_dls.vbo_len + buf_vbo_len) * 2;
+        static_dls.vbo = realloc(static_dls.vbo, static_dls.vbo_cap * sizeof(float));
+    }
+    memcpy(static_dls.vbo + static_dls.vbo_len, buf_vbo, buf_vbo_len * sizeof(float));
+    // The cached copy is drawn with its transform in slot 0
+    for (size_t i = 0; i < g.num_indices; i++) {
+        static_dls.vbo[static_dls.vbo_len + i * g.floats_per_vertex + 3] = 0.0f;
+    }
+    static_dls.vbo_len += buf_vbo_len;
+    
+    if (static_dls.num_groups > 0 && gfx_static_draw_group_same_state(&static_dls.groups[static_dls.num_groups - 1], &g)) {
+        static_dls.groups[static_dls.num_groups - 1].num_indices += g.num_indices;
+        return;
+    }
+    if (static_dls.num_groups == static_dls.groups_cap) {
+        static_dls.groups_cap = static_dls.groups_cap == 0 ? 16 : static_dls.groups_cap * 2;
+        static_dls.groups = realloc(static_dls.groups, static_dls.groups_cap * sizeof(struct StaticDrawGroup));
+    }
+    static_dls.groups[static_dls.num_groups++] = g;
+}
+
+// Turns the recorded batches into an indexed mesh with identical vertices merged
+static void gfx_static_dl_build(struct StaticDisplayList *e) {
+    struct StaticDisplayListExit *x = malloc(sizeof(struct StaticDisplayListExit));
+    
+    x->rdp = rdp;
+    gfx_static_save_rsp(&x->rsp);
+    for (int i = 0; i < 2; i++) {
+        x->textures[i] = static_dls.imported[i] ? rendering_state.textures[i] : NULL;
+    }
+    x->loaded_mask = static_dls.loaded_mask;
+    for (int i = 0; i < MAX_VERTICES; i++) {
+        x->vertices[i] = rsp.loaded_vertices[i].raw;
+    }
+    e->exit = x;
+    e->has_vertex_state = static_dls.has_snapshot;
+    e->vertex_state = static_dls.vertex_state;
+    e->status = STATIC_DL_CACHED;
+    if (static_dls.num_groups == 0) {
+        return;
+    }
+    
+    size_t max_group_vertices = 0;
+    size_t total_vertices = 0;
+    for (size_t i = 0; i < static_dls.num_groups; i++) {
+        if (static_dls.groups[i].num_indices > max_group_vertices) {
+            max_group_vertices = static_dls.groups[i].num_indices;
+        }
+        total_vertices += static_dls.groups[i].num_indices;
+    }
+    size_t table_size = 64;
+    while (table_size < 2 * max_group_vertices) {
+        table_size *= 2;
+    }
+    uint32_t *table = malloc(table_size * sizeof(uint32_t));
+    float *vertices = malloc(static_dls.vbo_len * sizeof(float));
+    uint16_t *indices = malloc(total_vertices * sizeof(uint16_t));
+    // A group is split when it runs out of 16-bit indices, at most once per 65535 vertices
+    struct StaticDrawGroup *groups = malloc((static_dls.num_groups + total_vertices / 65535 + 1) * sizeof(struct StaticDrawGroup));
+    size_t num_floats = 0, num_indices = 0, num_groups = 0;
+    
+    for (size_t i = 0; i < static_dls.num_groups; i++) {
+        const struct StaticDrawGroup *src = &static_dls.groups[i];
+        size_t fpv = src->floats_per_vertex;
+        size_t num_unique = 0;
+        struct StaticDrawGroup *dst = NULL;
+        
+        for (size_t v = 0; v < src->num_indices; v++) {
+            if (dst == NULL || (v % 3 == 0 && num_unique + 3 > 65535)) {
+                dst = &groups[num_groups++];
+                *dst = *src;
+                dst->first_float = num_floats;
+                dst->first_index = num_indices;
+                dst->num_indices = 0;
+                num_unique = 0;
+                memset(table, 0xff, table_size * sizeof(uint32_t));
+            }
+            const float *vtx = static_dls.vbo + src->first_float + v * fpv;
+            size_t h = (size_t)gfx_hash_bytes(0xcbf29ce484222325ULL, vtx, fpv * sizeof(float)) & (table_size - 1);
+            while (table[h] != 0xffffffffU && memcmp(vertices + dst->first_float + table[h] * fpv, vtx, fpv * sizeof(float)) != 0) {
+                h = (h + 1) & (table_size - 1);
+            }
+            if (table[h] == 0xffffffffU) {
+                table[h] = num_unique++;
+                memcpy(vertices + num_floats, vtx, fpv * sizeof(float));
+                num_floats += fpv;
+            }
+            indices[num_indices++] = table[h];
+            dst->num_indices++;
+        }
+    }
+    
+    e->mesh = gfx_rapi->new_static_mesh(vertices, num_floats, indices, num_indices);
+    if (e->mesh != 0) {
+        e->groups = realloc(groups, num_groups * sizeof(struct StaticDrawGroup));
+        e->num_groups = num_groups;
+    } else {
+        // The backend is out of buffers
+        free(groups);
+        e->status = STATIC_DL_UNCACHEABLE;
+    }
+    free(table);
+    free(vertices);
+    free(indices);
+}
+
+// Runs the display list normally while keeping a copy of everything it draws
+static void gfx_static_dl_record(struct StaticDisplayList *e, Gfx *dl) {
+    gfx_flush_sorted();
+    gfx_flush();
+    static_dls.recording = e;
+    static_dls.record_failed = false;
+    static_dls.vbo_len = 0;
+    static_dls.num_groups = 0;
+    static_dls.has_snapshot = false;
+    static_dls.loaded_mask = 0;
+    static_dls.imported[0] = static_dls.imported[1] = false;
+    
+    gfx_run_dl(dl);
+    gfx_flush_sorted();
+    gfx_flush();
+    
+    static_dls.recording = NULL;
+    if (static_dls.record_failed) {
+        e->status = STATIC_DL_UNCACHEABLE;
+    } else {
+        gfx_static_dl_build(e);
+    }
+    if (static_dls.clear_pending) {
+        gfx_static_dl_cache_clear();
+    }
+}
+
+static void gfx_static_dl_apply_state(const struct StaticDrawGroup *g) {
+    if (g->depth_test != rendering_state.depth_test) {
+        gfx_rapi->set_depth_test(g->depth_test);
+        rendering_state.depth_test = g->depth_test;
+    }
+    if (g->depth_mask != rendering_state.depth_mask) {
+        gfx_rapi->set_depth_mask(g->depth_mask);
+        rendering_state.depth_mask = g->depth_mask;
+    }
+    if (g->decal_mode != rendering_state.decal_mode) {
+        gfx_rapi->set_zmode_decal(g->decal_mode);
+        rendering_state.decal_mode = g->decal_mode;
+    }
+    if (g->cull_face != rendering_state.cull_face) {
+        gfx_rapi->set_cull_face(g->cull_face);
+        rendering_state.cull_face = g->cull_face;
+    }
+    if (g->alpha_blend != rendering_state.alpha_blend) {
+        gfx_rapi->set_use_alpha(g->alpha_blend);
+        rendering_state.alpha_blend = g->alpha_blend;
+    }
+    if (g->prg != rendering_state.shader_program) {
+        gfx_rapi->unload_shader(rendering_state.shader_program);
+        gfx_rapi->load_shader(g->prg);
+        gfx_stats.shader_switches++;
+        rendering_state.shader_program = g->prg;
+    }
+    for (int i = 0; i < 2; i++) {
+        struct TextureHashmapNode *node = g->textures[i];
+        if (node != NULL) {
+            gfx_rapi->select_texture(i, node->texture_id);
+            if (node->linear_filter != g->linear_filter[i] || node->cms != g->cms[i] || node->cmt != g->cmt[i]) {
+                gfx_rapi->set_sampler_parameters(i, g->linear_filter[i], g->cms[i], g->cmt[i]);
+                node->linear_filter = g->linear_filter[i];
+                node->cms = g->cms[i];
+                node->cmt = g->cmt[i];
+            }
+        }
+    }
+}
+
+// Draws a cached display list and leaves the state behind as running it would have
+static void gfx_static_dl_replay(struct StaticDisplayList *e) {
+    const struct StaticDisplayListExit *x = e->exit;
+    int16_t transform = -1;
+    
+    gfx_flush_sorted();
+    gfx_flush();
+    if (e->has_vertex_state) {
+        // The lights are transformed with the current modelview matrix, as when the vertices were loaded
+        gfx_static_load_rsp(&e->vertex_state);
+        if (rsp.geometry_mode & G_LIGHTING) {
+            gfx_update_light_coeffs();
+        }
+        transform = gfx_xf_snapshot();
+    }
+    if (e->num_groups > 0) {
+        gpu_xf.num_slots = 1;
+        gpu_xf.slot_snapshots[0] = transform;
+        memcpy(gpu_xf.slots, gpu_xf.snapshots[transform], sizeof(gpu_xf.snapshots[0]));
+        gpu_xf.slots_changed = false;
+        gfx_rapi->set_vertex_transforms(gpu_xf.slots, 1);
+        gfx_update_viewport_and_scissor();
+        for (uint32_t i = 0; i < e->num_groups; i++) {
+            const struct StaticDrawGroup *g = &e->groups[i];
+            gfx_static_dl_apply_state(g);
+            unsigned long t0 = get_time();
+            gfx_rapi->draw_static_mesh(e->mesh, g->first_float, g->first_index, g->num_indices);
+            gfx_stats.backend_us += get_time() - t0;
+            gfx_stats.triangles += g->num_indices / 3;
+            gfx_stats.flushes++;
+            gfx_stats.flushes_unsorted++;
+        }
+    }
+    
+    rdp = x->rdp;
+    gfx_static_load_rsp(&x->rsp);
+    for (int i = 0; i < 2; i++) {
+        if (x->textures[i] != NULL) {
+            rendering_state.textures[i] = x->textures[i];
+        }
+        // Restore the bindings the display list state expects
+        if (rendering_state.textures[i] != NULL) {
+            gfx_rapi->select_texture(i, rendering_state.textures[i]->texture_id);
+        }
+    }
+    for (int i = 0; i < MAX_VERTICES; i++) {
+        if (x->loaded_mask & ((uint64_t)1 << i)) {
+            rsp.loaded_vertices[i].raw = x->vertices[i];
+            rsp.loaded_vertices[i].transform = transform;
+            rsp.loaded_vertices[i].clip_rej = 0;
+        }
+    }
+    gfx_stats.static_dls_drawn++;
+}
+
+// Handles a display list call from the static geometry cache. Returns false if it has to be run normally.
+static bool gfx_static_dl_run(Gfx *dl) {
+    if (!static_geometry_cache || !gpu_xf.active || static_dls.recording != NULL || gfx_rapi->new_static_mesh == NULL) {
+        return false;
+    }
+    
+    struct StaticDisplayList *e = gfx_static_dl_lookup(dl, gfx_static_dl_key(dl));
+    if (e->status == STATIC_DL_UNCACHEABLE) {
+        return false;
+    }
+    uint64_t content_hash = 0xcbf29ce484222325ULL;
+    uint32_t num_commands = 0;
+    if (!gfx_static_dl_hash(dl, &content_hash, 0, &num_commands)) {
+        gfx_static_dl_release(e);
+        e->status = STATIC_DL_UNCACHEABLE;
+        return false;
+    }
+    if (e->status == STATIC_DL_CACHED) {
+        if (e->content_hash == content_hash) {
+            gfx_static_dl_replay(e);
+            return true;
+        }
+        gfx_static_dl_release(e);
+        e->status = STATIC_DL_CANDIDATE;
+        e->frames_seen = 0;
+    }
+    
+    if (e->frames_seen == 0 || e->content_hash != content_hash) {
+        e->content_hash = content_hash;
+        e->frames_seen = 1;
+        e->last_frame = static_dls.frame;
+        return false;
+    }
+    if (e->last_frame != static_dls.frame) {
+        e->frames_seen++;
+        e->last_frame = static_dls.frame;
+    }
+    if (e->frames_seen < STATIC_DL_MIN_FRAMES) {
+        return false;
+    }
+    gfx_static_dl_record(e, dl);
+    return true;
+}
+
+static void gfx_dynres_update(void) {
+    uint32_t gpu_us = gfx_rapi->get_gpu_frame_time != NULL ? gfx_rapi->get_gpu_frame_time() : 0;
+    if (gpu_us == 0) {
+        return;
+    }
+    if (dynres.gpu_time_us == 0.0f) {
+        dynres.gpu_time_us = gpu_us;
+    } else {
+        dynres.gpu_time_us += (gpu_us - dynres.gpu_time_us) * DYNRES_SMOOTHING;
+    }
+    
+    // The GPU time of the scene goes with its pixel count, the square of the scale. Dropping is
+    // quick and rising slow, and the measurements lag a few frames, so that it doesn't oscillate.
+    float target = dynres.scale * sqrtf(DYNRES_HEADROOM * dynres.budget_us / dynres.gpu_time_us);
+    if (target < dynres.scale) {
+        dynres.scale = fmaxf(target, dynres.scale * DYNRES_MAX_DROP);
+    } else if (dynres.gpu_time_us < DYNRES_RAISE_BELOW * dynres.budget_us) {
+        dynres.scale = fminf(target, dynres.scale * DYNRES_MAX_RISE);
+    }
+    dynres.scale = fminf(fmaxf(dynres.scale, dynres.min_scale), dynres.max_scale);
+}
+
+// Converts the viewport and scissor, which are in pixels, to a target of another size
+static void gfx_rescale_viewport_and_scissor(const struct GfxDimensions *from, const struct GfxDimensions *to) {
+    struct XYWidthHeight *rects[2] = { &rdp.viewport, &rdp.scissor };
+    for (int i = 0; i < 2; i++) {
+        rects[i]->x = rects[i]->x * to->width / from->width;
+        rects[i]->width = rects[i]->width * to->width / from->width;
+        rects[i]->y = rects[i]->y * to->height / from->height;
+        rects[i]->height = rects[i]->height * to->height / from->height;
+    }
+    rdp.viewport_or_scissor_changed = true;
+}
+
+// Sets all of the backend state again, after start_scene or end_scene left it undefined
+static void gfx_reapply_rendering_state(void) {
+    gfx_rapi->set_depth_test(rendering_state.depth_test);
+    gfx_rapi->set_depth_mask(rendering_state.depth_mask);
+    gfx_rapi->set_zmode_decal(rendering_state.decal_mode);
+    gfx_rapi->set_use_alpha(rendering_state.alpha_blend);
+    if (gfx_rapi->set_cull_face != NULL) {
+        gfx_rapi->set_cull_face(rendering_state.cull_face);
+    }
+    if (rendering_state.shader_program != NULL) {
+        gfx_rapi->load_shader(rendering_state.shader_program);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (rendering_state.textures[i] != NULL) {
+            gfx_rapi->select_texture(i, rendering_state.textures[i]->texture_id);
+        }
+    }
+    memset(&rendering_state.viewport, 0, sizeof(rendering_state.viewport));
+    memset(&rendering_state.scissor, 0, sizeof(rendering_state.scissor));
+    rdp.viewport_or_scissor_changed = true;
+}
+
+static void gfx_start_scene(void) {
+    gfx_dynres_update();
+    if (dynres.scale >= 1.0f) {
+        // Drawn straight into the window
+        return;
+    }
+    
+    struct GfxDimensions target = gfx_current_dimensions;
+    target.width = gfx_current_dimensions.width * dynres.scale + 0.5f;
+    target.height = gfx_current_dimensions.height * dynres.scale + 0.5f;
+    if (target.width == 0 || target.height == 0 || !gfx_rapi->start_scene(target.width, target.height)) {
+        return;
+    }
+    dynres.window = gfx_current_dimensions;
+    dynres.in_scene = true;
+    gfx_stats.scene_scale_pct = dynres.scale * 100.0f + 0.5f;
+    gfx_current_dimensions = target;
+    gfx_rescale_viewport_and_scissor(&dynres.window, &gfx_current_dimensions);
+    gfx_reapply_rendering_state();
+}
+
+static void gfx_end_scene(void) {
+    if (!dynres.in_scene) {
+        return;
+    }
+    gfx_flush_sorted();
+    gfx_flush();
+    struct GfxDimensions target = gfx_current_dimensions;
+    gfx_current_dimensions = dynres.window;
+    dynres.in_scene = false;
+    gfx_rapi->end_scene(gfx_current_dimensions.width, gfx_current_dimensions.height);
+    gfx_rescale_viewport_and_scissor(&target, &gfx_current_dimensions);
+    gfx_reapply_rendering_state();
+}
+
+static struct GeometryChunk *gfx_chunk_find(const Gfx *cmd, bool insert) {
+    uint32_t i = (uint32_t)(((uintptr_t)cmd >> 3) * 0x9E3779B1u) & (MAX_GEOMETRY_CHUNKS - 1);
+    while (chunks.entries[i].cmd != cmd) {
+        if (chunks.entries[i].cmd == NULL) {
+            // Keep a quarter free so that lookups of unknown commands stay short
+            if (!insert || chunks.count >= MAX_GEOMETRY_CHUNKS * 3 / 4) {
+                return NULL;
+            }
+            chunks.entries[i].cmd = cmd;
+            chunks.count++;
+            return &chunks.entries[i];
+        }
+        i = (i + 1) & (MAX_GEOMETRY_CHUNKS - 1);
+    }
+    return &chunks.entries[i];
+}
+
+static void gfx_chunk_scan_tri(struct GeometryChunk **owners, uint32_t v1, uint32_t v2, uint32_t v3) {
+    uint32_t idx[3] = { v1, v2, v3 };
+    struct GeometryChunk *owner = idx[0] < MAX_VERTICES ? owners[idx[0]] : NULL;
+    bool mixed = owner == NULL;
+    for (int i = 1; i < 3; i++) {
+        if (idx[i] >= MAX_VERTICES || owners[idx[i]] != owner) {
+            mixed = true;
+        }
+    }
+    if (mixed) {
+        for (int i = 0; i < 3; i++) {
+            if (idx[i] < MAX_VERTICES && owners[idx[i]] != NULL) {
+                owners[idx[i]]->cullable = false;
+            }
+        }
+    }
+}
+
+// Follows the display list like gfx_run_dl would, with owners[] telling which vertex
+// load filled each vertex slot
+static void gfx_chunk_scan(const Gfx *cmd, struct GeometryChunk **owners, int depth) {
+    if (depth > 8) {
+        return;
+    }
+    for (;;) {
+        uint32_t opcode = cmd->words.w0 >> 24;
+        switch (opcode) {
+            case G_VTX: {
+#ifdef F3DEX_GBI_2
+                uint32_t n = C0(12, 8), dest = C0(1, 7) - C0(12, 8);
+#elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
+                uint32_t n = C0(10, 6), dest = C0(16, 8) / 2;
+#else
+                uint32_t n = C0(0, 16) / sizeof(Vtx), dest = C0(16, 4);
+#endif
+                const Vtx *vertices = seg_addr(cmd->words.w1);
+                struct GeometryChunk *chunk = gfx_chunk_find(cmd, false);
+                if (chunk == NULL && n > 0 && dest + n <= MAX_VERTICES) {
+                    chunk = gfx_chunk_find(cmd, true);
+                    if (chunk != NULL) {
+                        float lo[3], hi[3];
+                        for (int j = 0; j < 3; j++) {
+                            lo[j] = hi[j] = vertices[0].v.ob[j];
+                        }
+                        for (uint32_t i = 1; i < n; i++) {
+                            for (int j = 0; j < 3; j++) {
+                                lo[j] = fminf(lo[j], vertices[i].v.ob[j]);
+                                hi[j] = fmaxf(hi[j], vertices[i].v.ob[j]);
+                            }
+                        }
+                        for (int j = 0; j < 3; j++) {
+                            chunk->center[j] = (lo[j] + hi[j]) * 0.5f;
+                            chunk->extent[j] = (hi[j] - lo[j]) * 0.5f;
+                        }
+                        chunk->cullable = true;
+                    }
+                }
+                for (uint32_t i = dest; i < dest + n && i < MAX_VERTICES; i++) {
+                    owners[i] = chunk;
+                }
+                break;
+            }
+            case (uint8_t)G_TRI1:
+#ifdef F3DEX_GBI_2
+                gfx_chunk_scan_tri(owners, C0(16, 8) / 2, C0(8, 8) / 2, C0(0, 8) / 2);
+#elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
+                gfx_chunk_scan_tri(owners, C1(16, 8) / 2, C1(8, 8) / 2, C1(0, 8) / 2);
+#else
+                gfx_chunk_scan_tri(owners, C1(16, 8) / 10, C1(8, 8) / 10, C1(0, 8) / 10);
+#endif
+                break;
+#if defined(F3DEX_GBI) || defined(F3DLP_GBI)
+            case (uint8_t)G_TRI2:
+                gfx_chunk_scan_tri(owners, C0(16, 8) / 2, C0(8, 8) / 2, C0(0, 8) / 2);
+                gfx_chunk_scan_tri(owners, C1(16, 8) / 2, C1(8, 8) / 2, C1(0, 8) / 2);
+                break;
+#endif
+            case G_DL:
+                if (C0(16, 1) == 0) {
+                    gfx_chunk_scan((const Gfx *)seg_addr(cmd->words.w1), owners, depth + 1);
+                } else {
+                    cmd = (const Gfx *)seg_addr(cmd->words.w1);
+                    --cmd; // increase after break
+                }
+                break;
+            case (uint8_t)G_ENDDL:
+                return;
+        }
+        ++cmd;
+    }
+}
+
+// Takes in the display lists the game registered since the last frame. Returns true if
+// the game unloaded an area since then.
+static bool gfx_chunks_update(void) {
+    bool unloaded = false;
+    uint32_t head = __atomic_load_n(&chunks.pending_head, __ATOMIC_ACQUIRE);
+    while (chunks.pending_tail != head) {
+        const Gfx *dl = chunks.pending[chunks.pending_tail & (MAX_PENDING_GEOMETRY - 1)];
+        if (dl == NULL) {
+            memset(chunks.entries, 0, sizeof(chunks.entries));
+            chunks.count = 0;
+            unloaded = true;
+        } else {
+            // Vertices loaded before the display list is called belong to no chunk
+            struct GeometryChunk *owners[MAX_VERTICES] = { NULL };
+            gfx_chunk_scan(dl, owners, 0);
+        }
+        __atomic_store_n(&chunks.pending_tail, chunks.pending_tail + 1, __ATOMIC_RELEASE);
+    }
+    if (__atomic_exchange_n(&chunks.overflowed, false, __ATOMIC_ACQ_REL)) {
+        // A lost entry may have been an unload, so nothing registered so far is kept
+        memset(chunks.entries, 0, sizeof(chunks.entries));
+        chunks.count = 0;
+        unloaded = true;
+    }
+    return unloaded;
+}
+
+// Whether the box of the chunk lies entirely outside one of the planes that vertices are
+// clip rejected against in gfx_sp_vertex
+static bool gfx_chunk_outside_view(const struct GeometryChunk *chunk) {
+    float k = (4.0f / 3.0f) / gfx_current_dimensions.aspect_ratio; // as gfx_adjust_x_for_aspect_ratio
+    for (int axis = 0; axis < 3; axis++) {
+        float scale = axis == 0 ? k : 1.0f;
+        for (int sign = -1; sign <= 1; sign += 2) {
+            // Distance of the center from the plane w + sign * axis = 0, and the box's reach
+            float dist = rsp.MP_matrix[3][3] + sign * scale * rsp.MP_matrix[3][axis];
+            float reach = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                float a = rsp.MP_matrix[i][3] + sign * scale * rsp.MP_matrix[i][axis];
+                dist += a * chunk->center[i];
+                reach += fabsf(a) * chunk->extent[i];
+            }
+            if (dist + reach < 0.0f) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Loads a vertex range as out of view, so that every triangle drawn from it is rejected
+static bool gfx_chunk_cull(const Gfx *cmd, size_t n_vertices, size_t dest_index) {
+    if (!chunk_culling || chunks.count == 0 || static_dls.recording != NULL) {
+        return false;
+    }
+    const struct GeometryChunk *chunk = gfx_chunk_find(cmd, false);
+    if (chunk == NULL || !chunk->cullable || !gfx_chunk_outside_view(chunk)) {
+        return false;
+    }
+    for (size_t i = dest_index; i < dest_index + n_vertices && i < MAX_VERTICES; i++) {
+        rsp.loaded_vertices[i].transform = -1;
+        rsp.loaded_vertices[i].clip_rej = 0x3f;
+    }
+    gfx_stats.chunks_culled++;
+    return true;
+}
+
 static void gfx_run_dl(Gfx* cmd) {
     int dummy = 0;
     for (;;) {
         uint32_t opcode = cmd->words.w0 >> 24;
+        gfx_stats.dl_commands++;
         
         switch (opcode) {
             // RSP commands:
             case G_MTX:
+                if (interp.active) {
+                    gfx_interp_set_key(cmd);
+                }
 #ifdef F3DEX_GBI_2
                 gfx_sp_matrix(C0(0, 8) ^ G_MTX_PUSH, (const int32_t *) seg_addr(cmd->words.w1));
 #else
@@ -1405,17 +3190,25 @@ static void gfx_run_dl(Gfx* cmd) {
                 break;
             case G_VTX:
 #ifdef F3DEX_GBI_2
-                gfx_sp_vertex(C0(12, 8), C0(1, 7) - C0(12, 8), seg_addr(cmd->words.w1));
+                if (!gfx_chunk_cull(cmd, C0(12, 8), C0(1, 7) - C0(12, 8))) {
+                    gfx_sp_vertex(C0(12, 8), C0(1, 7) - C0(12, 8), seg_addr(cmd->words.w1));
+                }
 #elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
-                gfx_sp_vertex(C0(10, 6), C0(16, 8) / 2, seg_addr(cmd->words.w1));
+                if (!gfx_chunk_cull(cmd, C0(10, 6), C0(16, 8) / 2)) {
+                    gfx_sp_vertex(C0(10, 6), C0(16, 8) / 2, seg_addr(cmd->words.w1));
+                }
 #else
-                gfx_sp_vertex((C0(0, 16)) / sizeof(Vtx), C0(16, 4), seg_addr(cmd->words.w1));
+                if (!gfx_chunk_cull(cmd, (C0(0, 16)) / sizeof(Vtx), C0(16, 4))) {
+                    gfx_sp_vertex((C0(0, 16)) / sizeof(Vtx), C0(16, 4), seg_addr(cmd->words.w1));
+                }
 #endif
                 break;
             case G_DL:
                 if (C0(16, 1) == 0) {
                     // Push return address
-                    gfx_run_dl((Gfx *)seg_addr(cmd->words.w1));
+                    if (!gfx_static_dl_run((Gfx *)seg_addr(cmd->words.w1))) {
+                        gfx_run_dl((Gfx *)seg_addr(cmd->words.w1));
+                    }
                 } else {
                     cmd = (Gfx *)seg_addr(cmd->words.w1);
                     --cmd; // increase after break
@@ -1593,6 +3386,13 @@ static void gfx_run_dl(Gfx* cmd) {
             case G_SETCIMG:
                 gfx_dp_set_color_image(C0(21, 3), C0(19, 2), C0(0, 11), seg_addr(cmd->words.w1));
                 break;
+            case G_NOOP:
+                if ((cmd->words.w0 & 0xffffff) == GFX_NOOP_INTERP_ID) {
+                    interp.id = cmd->words.w1;
+                } else if (cmd->words.w1 == GFX_NOOP_TAG_SCENE_END) {
+                    gfx_end_scene();
+                }
+                break;
         }
         ++cmd;
     }
@@ -1652,6 +3452,133 @@ struct GfxRenderingAPI *gfx_get_current_rendering_api(void) {
     return gfx_rapi;
 }
 
+void gfx_set_sort_opaque_draws(bool enable) {
+    if (enable && sorted_draws == NULL) {
+        sorted_draws = malloc(MAX_SORTED_BATCHES * sizeof(struct SortedDraw));
+        sorted_tris = malloc(MAX_SORTED * sizeof(struct SortedTri));
+        sorted_vbo = malloc(MAX_SORTED * (26 * 3) * sizeof(float));
+        if (sorted_draws == NULL || sorted_tris == NULL || sorted_vbo == NULL) {
+            return;
+        }
+    }
+    sort_opaque_draws = enable;
+}
+
+void gfx_set_simd_vertex_transform(bool enable) {
+    simd_vertex_transform = enable;
+}
+
+void gfx_set_gpu_vertex_transform(bool enable) {
+    gpu_vertex_transform = enable;
+}
+
+void gfx_set_static_geometry_cache(bool enable) {
+    static_geometry_cache = enable;
+}
+
+// Called by the game before the display lists of an area are released. Goes through the same
+// queue as the registrations, so the render thread sees it before the next frame it draws.
+void gfx_invalidate_static_geometry(void) {
+    gfx_register_static_geometry(NULL);
+}
+
+// Packs a font into an atlas. The glyphs are width x height textures of the given format,
+// NULL entries are skipped. Each cell repeats the glyph's edge texels around it, so that
+// filtering doesn't pick up the neighbouring glyphs.
+void gfx_register_glyph_atlas(const void *const *glyphs, uint32_t count, uint8_t fmt, uint8_t siz, uint32_t width, uint32_t height) {
+    if (glyph_atlas.num_atlases == MAX_GLYPH_ATLASES || width == 0 || height == 0) {
+        return;
+    }
+    uint32_t cell_w = width + 2, cell_h = height + 2;
+    uint32_t rows = (count + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    uint32_t atlas_w = gfx_next_power_of_two(ATLAS_COLUMNS * cell_w);
+    uint32_t atlas_h = gfx_next_power_of_two(rows * cell_h);
+    uint8_t *pixels = calloc((size_t)atlas_w * atlas_h, 4);
+    uint8_t *glyph = malloc((size_t)width * height * 4);
+    if (pixels == NULL || glyph == NULL) {
+        free(pixels);
+        free(glyph);
+        return;
+    }
+
+    uint8_t index = glyph_atlas.num_atlases;
+    uint32_t num_glyphs = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        struct AtlasGlyph *e = gfx_atlas_find(glyphs[i]);
+        if (glyphs[i] == NULL || e->addr != NULL) {
+            continue;
+        }
+        if (!gfx_decode_glyph(glyphs[i], fmt, siz, width * height, glyph)) {
+            break;
+        }
+        uint32_t cx = i % ATLAS_COLUMNS * cell_w, cy = i / ATLAS_COLUMNS * cell_h;
+        for (uint32_t y = 0; y < cell_h; y++) {
+            uint32_t sy = y == 0 ? 0 : (y > height ? height - 1 : y - 1);
+            for (uint32_t x = 0; x < cell_w; x++) {
+                uint32_t sx = x == 0 ? 0 : (x > width ? width - 1 : x - 1);
+                memcpy(&pixels[((size_t)(cy + y) * atlas_w + cx + x) * 4], &glyph[(sy * width + sx) * 4], 4);
+            }
+        }
+        if (num_glyphs + 1 >= MAX_ATLAS_GLYPHS * 3 / 4) {
+            break;
+        }
+        e->addr = glyphs[i];
+        e->atlas = index;
+        e->x = cx + 1;
+        e->y = cy + 1;
+        num_glyphs++;
+    }
+
+    if (num_glyphs > 0) {
+        struct GlyphAtlas *atlas = &glyph_atlas.atlases[index];
+        atlas->width = atlas_w;
+        atlas->height = atlas_h;
+        atlas->fmt = fmt;
+        atlas->siz = siz;
+        atlas->node.texture_id = gfx_rapi->new_texture();
+        atlas->node.linear_filter = false;
+        atlas->node.cms = G_TX_CLAMP;
+        atlas->node.cmt = G_TX_CLAMP;
+        gfx_flush();
+        gfx_rapi->select_texture(0, atlas->node.texture_id);
+        gfx_rapi->set_sampler_parameters(0, atlas->node.linear_filter, atlas->node.cms, atlas->node.cmt);
+        gfx_upload_texture(pixels, atlas_w, atlas_h);
+        rendering_state.textures[0] = &atlas->node;
+        glyph_atlas.num_atlases++;
+    }
+    free(pixels);
+    free(glyph);
+}
+
+void gfx_set_chunk_culling(bool enable) {
+    chunk_culling = enable;
+}
+
+// Called by the game when an area is loaded, the scan happens before the next frame is drawn
+void gfx_register_static_geometry(const Gfx *dl) {
+    uint32_t head = chunks.pending_head;
+    if (head - __atomic_load_n(&chunks.pending_tail, __ATOMIC_ACQUIRE) >= MAX_PENDING_GEOMETRY) {
+        // The display list is drawn without chunks
+        __atomic_store_n(&chunks.overflowed, true, __ATOMIC_RELEASE);
+        return;
+    }
+    chunks.pending[head & (MAX_PENDING_GEOMETRY - 1)] = dl;
+    __atomic_store_n(&chunks.pending_head, head + 1, __ATOMIC_RELEASE);
+}
+
+void gfx_set_dynamic_resolution(bool enable, float min_scale, float max_scale, float budget_us) {
+    dynres.enabled = enable;
+    dynres.min_scale = fminf(fmaxf(min_scale, 0.1f), 1.0f);
+    dynres.max_scale = fminf(fmaxf(max_scale, dynres.min_scale), 1.0f);
+    dynres.budget_us = budget_us;
+    dynres.scale = dynres.max_scale;
+    dynres.gpu_time_us = 0.0f;
+}
+
+float gfx_get_dynamic_resolution_scale(void) {
+    return dynres.enabled ? dynres.scale : 1.0f;
+}
+
 void gfx_start_frame(void) {
     gfx_wapi->handle_events();
     gfx_wapi->get_dimensions(&gfx_current_dimensions.width, &gfx_current_dimensions.height);
@@ -1662,7 +3589,7 @@ void gfx_start_frame(void) {
     gfx_current_dimensions.aspect_ratio = (float)gfx_current_dimensions.width / (float)gfx_current_dimensions.height;
 }
 
-void gfx_run(Gfx *commands) {
+static void gfx_run_frame(Gfx *commands) {
     gfx_sp_reset();
     
     //puts("New frame");
@@ -1673,19 +3600,95 @@ void gfx_run(Gfx *commands) {
     }
     dropped_frame = false;
     
-    double t0 = gfx_wapi->get_time();
+    if (interp.active) {
+        // The matrices of a tick are recorded by the first of its frames that is drawn
+        interp.record = interp.record_pending;
+        interp.record_pending = false;
+        interp.id = 0;
+        memset(interp.occurrences, 0, sizeof(interp.occurrences));
+    }
+    memset(&gfx_stats, 0, sizeof(gfx_stats));
+    unsigned long t0 = get_time();
+    gpu_xf.active = gpu_vertex_transform && gfx_rapi->set_vertex_transforms != NULL && gfx_rapi->set_cull_face != NULL;
+    gpu_xf.num_snapshots = 0;
+    gpu_xf.num_slots = 0;
+    gpu_xf.slots_changed = false;
+    for (int i = 0; i < MAX_VERTICES + 4; i++) {
+        rsp.loaded_vertices[i].transform = -1;
+    }
+    static_dls.frame++;
+    bool area_unloaded = gfx_chunks_update();
+    if (area_unloaded || (static_dls.count > 0 && (!static_geometry_cache || !gpu_xf.active))) {
+        gfx_static_dl_cache_clear();
+    }
     gfx_rapi->start_frame();
+    gfx_stats.scene_scale_pct = 100;
+    if (dynres.enabled && gfx_rapi->start_scene != NULL) {
+        gfx_start_scene();
+    }
     gfx_run_dl(commands);
+    gfx_flush_sorted();
     gfx_flush();
-    double t1 = gfx_wapi->get_time();
-    //printf("Process %f %f\n", t1, t1 - t0);
+    gfx_end_scene(); // when the display list has no end of scene marker
+    unsigned long t1 = get_time();
     gfx_rapi->end_frame();
+    gfx_stats.run_dl_us = t1 - t0;
+    gfx_stats.backend_us += get_time() - t1;
+    gfx_stats.frame = ++frame_number;
+    gfx_frame_stats = gfx_stats;
+    gfx_capture_frame(gfx_rapi, gfx_current_dimensions.width, gfx_current_dimensions.height);
     gfx_wapi->swap_buffers_begin();
 }
 
+void gfx_run(Gfx *commands) {
+    interp.active = false;
+    gfx_run_frame(commands);
+}
+
+void gfx_run_interpolated(Gfx *commands, bool new_tick, float alpha) {
+    if (interp.prev == NULL) {
+        interp.prev = interp.tables[0];
+        interp.cur = interp.tables[1];
+    }
+    if (new_tick) {
+        struct InterpMatrix *t = interp.prev;
+        interp.prev = interp.cur;
+        interp.cur = t;
+        memset(interp.cur, 0, sizeof(interp.tables[0]));
+        interp.num_cur = 0;
+        interp.record_pending = true;
+    }
+    interp.alpha = alpha;
+    interp.active = true;
+    gfx_run_frame(commands);
+    interp.active = false;
+}
+
+// Time between presented frames, and its standard deviation over the last frames
+static void gfx_measure_frame_time(void) {
+    unsigned long now = get_time();
+    if (frame_times.last != 0) {
+        int64_t t = now - frame_times.last;
+        int64_t old = frame_times.samples[frame_times.pos];
+        frame_times.samples[frame_times.pos] = t;
+        frame_times.pos = (frame_times.pos + 1) % FRAME_TIME_SAMPLES;
+        frame_times.sum += t - old;
+        frame_times.sum_sq += t * t - old * old;
+        if (frame_times.count < FRAME_TIME_SAMPLES) {
+            frame_times.count++;
+        }
+        double mean = (double)frame_times.sum / frame_times.count;
+        double variance = (double)frame_times.sum_sq / frame_times.count - mean * mean;
+        gfx_frame_stats.frame_time_us = t;
+        gfx_frame_stats.frame_time_dev_us = variance > 0 ? (uint32_t)sqrt(variance) : 0;
+    }
+    frame_times.last = now;
+}
+
 void gfx_end_frame(void) {
     if (!dropped_frame) {
         gfx_rapi->finish_render();
         gfx_wapi->swap_buffers_end();
+        gfx_measure_frame_time();
     }
 }
@@ -11,7 +11,47 @@ struct GfxDimensions {
     float aspect_ratio;
 };
 
+struct GfxStats {
+    uint32_t frame;                   // number of the frame, counting from 1
+    uint32_t dl_commands;             // display list commands executed
+    uint32_t vertices;                // vertices loaded, transformed on the CPU or the GPU
+    uint32_t triangles;               // triangles submitted to the rendering API
+    uint32_t triangles_clip_rejected; // triangles entirely outside the view
+    uint32_t triangles_culled;        // back or front facing triangles that were culled
+    uint32_t chunks_culled;           // vertex loads of static geometry skipped as out of view
+    uint32_t flushes;                 // batches submitted to the rendering API
+    uint32_t flushes_unsorted;        // batches that display list order would have needed
+    uint32_t static_dls_drawn;        // display lists redrawn from the static geometry cache
+    uint32_t texture_hits;            // texture cache lookups that found the texture
+    uint32_t texture_misses;          // texture cache lookups that had to import the texture
+    uint32_t texture_uploads;         // textures uploaded to the rendering API
+    uint32_t texture_upload_bytes;
+    uint32_t shader_switches;         // shaders loaded or created
+    uint32_t run_dl_us;               // CPU time running the display list, draw calls included
+    uint32_t backend_us;              // CPU time in rendering API draw calls and end_frame
+    uint32_t scene_scale_pct;         // resolution of the 3D scene, in percent of the window's
+    uint32_t input_latency_us;        // input read to present, filled in by the main loop
+    uint32_t frame_time_us;           // time since the previous frame was presented
+    uint32_t frame_time_dev_us;       // standard deviation of the frame time over 64 frames
+};
+
+// Tag of a gDPNoOpTag that ends the 3D scene of a frame. With dynamic resolution, what the
+// display list draws after it, the HUD and text, is drawn at the window resolution.
+#define GFX_NOOP_TAG_SCENE_END 0x5343454E
+
+// No-op that identifies the object loading the matrices after it, for render-rate
+// interpolation. Matrices loaded under a NULL identity are never interpolated.
+#define GFX_NOOP_INTERP_ID 0x4F424A
+#define gDPNoOpInterpId(pkt, id)                                 \
+    {                                                            \
+        Gfx *_g = (Gfx *)(pkt);                                  \
+        _g->words.w0 = _SHIFTL(G_NOOP, 24, 8) | GFX_NOOP_INTERP_ID; \
+        _g->words.w1 = (uintptr_t)(id);                          \
+    }
+
 extern struct GfxDimensions gfx_current_dimensions;
+extern struct GfxStats gfx_stats;       // counters of the frame being drawn
+extern struct GfxStats gfx_frame_stats; // counters of the last finished frame
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,8 +59,19 @@ extern "C" {
 
 void gfx_init(struct GfxWindowManagerAPI *wapi, struct GfxRenderingAPI *rapi, const char *game_name, bool start_in_fullscreen);
 struct GfxRenderingAPI *gfx_get_current_rendering_api(void);
+void gfx_set_sort_opaque_draws(bool enable);
+void gfx_set_simd_vertex_transform(bool enable);
+void gfx_set_gpu_vertex_transform(bool enable);
+void gfx_set_static_geometry_cache(bool enable);
+void gfx_invalidate_static_geometry(void);
+void gfx_set_chunk_culling(bool enable);
+void gfx_register_glyph_atlas(const void *const *glyphs, uint32_t count, uint8_t fmt, uint8_t siz, uint32_t width, uint32_t height);
+void gfx_register_static_geometry(const Gfx *dl);
+void gfx_set_dynamic_resolution(bool enable, float min_scale, float max_scale, float budget_us);
+float gfx_get_dynamic_resolution_scale(void);
 void gfx_start_frame(void);
 void gfx_run(Gfx *commands);
+void gfx_run_interpolated(Gfx *commands, bool new_tick, float alpha);
 void gfx_end_frame(void);
 
 #ifdef __cplusplus
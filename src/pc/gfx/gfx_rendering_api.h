@@ -7,6 +7,25 @@
 
 struct ShaderProgram;
 
+// GPU vertex transform: each vertex carries a slot index into an array of transform
+// states, each GFX_TRANSFORM_SLOT_VEC4S vec4s long:
+//   0-3: MP matrix rows
+//   4: light 0 direction, fog multiplier
+//   5: light 1 direction, fog offset
+//   6: lookat x direction, flags (1 = lighting, 2 = texgen, 4 = fog)
+//   7: lookat y direction, x scale for the aspect ratio
+//   8: light 0 color, texture scale s
+//   9: light 1 color, texture scale t
+//   10: ambient color, unused
+#define GFX_MAX_TRANSFORM_SLOTS 8
+#define GFX_TRANSFORM_SLOT_VEC4S 11
+
+enum {
+    GFX_CULL_NONE,
+    GFX_CULL_FRONT,
+    GFX_CULL_BACK
+};
+
 struct GfxRenderingAPI {
     bool (*z_is_from_0_to_1)(void);
     void (*unload_shader)(struct ShaderProgram *old_prg);
@@ -30,6 +49,29 @@ struct GfxRenderingAPI {
     void (*start_frame)(void);
     void (*end_frame)(void);
     void (*finish_render)(void);
+    // Optional, left NULL by backends that only draw pre-transformed vertices
+    void (*set_vertex_transforms)(const float slots[][4], size_t num_slots);
+    void (*set_cull_face)(int cull);
+    // Optional, retained meshes for the static geometry cache. The vertices use the layout of the
+    // current shader, and the indices of a draw are relative to the vertex at first_float.
+    // new_static_mesh returns 0 when it can't create one.
+    uint32_t (*new_static_mesh)(const float vertices[], size_t num_floats, const uint16_t indices[], size_t num_indices);
+    void (*draw_static_mesh)(uint32_t mesh, size_t first_float, size_t first_index, size_t num_indices);
+    void (*delete_static_mesh)(uint32_t mesh);
+    // Optional, frame capture. Queues a copy of the frame just drawn, width x height pixels, and
+    // returns a finished earlier copy as RGBA8 rows from bottom to top, or NULL if none is ready.
+    // width and height are set to the size of the returned frame, whose pixels stay valid until
+    // the next frame starts. With a width and height of 0, nothing is queued and the last copy
+    // still pending is returned, so that capture can drain the queue when it stops.
+    const uint8_t *(*read_frame)(uint32_t *width, uint32_t *height);
+    // Optional, dynamic resolution. start_scene redirects drawing to a cleared offscreen target of
+    // width x height pixels, or returns false if it can't. end_scene scales the target up to the
+    // window and draws to the window again. Both leave the state set by the other calls undefined.
+    bool (*start_scene)(uint32_t width, uint32_t height);
+    void (*end_scene)(uint32_t window_width, uint32_t window_height);
+    // Optional, GPU time in microseconds from start_frame to end_frame of a recent frame, 0 while
+    // none has been measured.
+    uint32_t (*get_gpu_frame_time)(void);
 };
 
 #endif
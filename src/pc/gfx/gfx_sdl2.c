@@ -8,6 +8,8 @@
 #define FOR_WINDOWS 0
 #endif
 
+#include <math.h>
+
 #if FOR_WINDOWS
 #include <GL/glew.h>
 #include "SDL.h"
@@ -21,12 +23,15 @@
 
 #include "gfx_window_manager_api.h"
 #include "gfx_screen_config.h"
+#include "gfx_frame_limiter.h"
 
 #define GFX_API_NAME "SDL2 - OpenGL"
 
 static SDL_Window *wnd;
 static int inverted_scancode_table[512];
 static int vsync_enabled = 0;
+static float refresh_rate; // measured by test_vsync
+static unsigned int target_fps = 30;
 static unsigned int window_width = DESIRED_SCREEN_WIDTH;
 static unsigned int window_height = DESIRED_SCREEN_HEIGHT;
 static bool fullscreen_state;
@@ -137,6 +142,7 @@ int test_vsync(void) {
     end = SDL_GetTicks();
 
     float average = 4.0 * 1000.0 / (end - start);
+    refresh_rate = average;
 
     vsync_enabled = 1;
     if (average > 27 && average < 33) {
@@ -272,15 +278,24 @@ static bool gfx_sdl_start_frame(void) {
     return true;
 }
 
+#ifdef TARGET_WEB
+static Uint64 last_frame_time; // milliseconds multiplied by target_fps
+#endif
+
 static void sync_framerate_with_timer(void) {
-    // Number of milliseconds a frame should take (30 fps)
-    const Uint32 FRAME_TIME = 1000 / 30;
-    static Uint32 last_time;
-    Uint32 elapsed = SDL_GetTicks() - last_time;
+#ifdef TARGET_WEB
+    // A frame takes 1000 / target_fps milliseconds, counted in units of 1 / target_fps
+    // milliseconds so that rates that don't divide 1000 don't drift. The browser would
+    // stall if we spun, so this sleeps only.
+    const Uint64 FRAME_TIME = 1000;
+    Uint64 elapsed = (Uint64)SDL_GetTicks() * target_fps - last_frame_time;
 
     if (elapsed < FRAME_TIME)
-        SDL_Delay(FRAME_TIME - elapsed);
-    last_time += FRAME_TIME;
+        SDL_Delay((FRAME_TIME - elapsed) / target_fps);
+    last_frame_time += FRAME_TIME;
+#else
+    gfx_frame_limiter_wait();
+#endif
 }
 
 static void gfx_sdl_swap_buffers_begin(void) {
@@ -295,7 +310,26 @@ static void gfx_sdl_swap_buffers_end(void) {
 }
 
 static double gfx_sdl_get_time(void) {
-    return 0.0;
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static void gfx_sdl_set_target_fps(uint32_t fps) {
+    target_fps = fps;
+#ifdef TARGET_WEB
+    last_frame_time = (Uint64)SDL_GetTicks() * target_fps;
+#else
+    gfx_frame_limiter_set_fps(fps);
+#endif
+
+    // Use vsync if the refresh rate is a multiple of the frame rate, otherwise the timer
+    int interval = (int)(refresh_rate / fps + 0.5f);
+    if (interval >= 1 && interval <= 4 && fabsf(refresh_rate / interval - fps) < fps * 0.05f) {
+        SDL_GL_SetSwapInterval(interval);
+        vsync_enabled = 1;
+    } else {
+        SDL_GL_SetSwapInterval(0);
+        vsync_enabled = 0;
+    }
 }
 
 struct GfxWindowManagerAPI gfx_sdl = {
@@ -309,7 +343,8 @@ struct GfxWindowManagerAPI gfx_sdl = {
     gfx_sdl_start_frame,
     gfx_sdl_swap_buffers_begin,
     gfx_sdl_swap_buffers_end,
-    gfx_sdl_get_time
+    gfx_sdl_get_time,
+    gfx_sdl_set_target_fps
 };
 
 #endif
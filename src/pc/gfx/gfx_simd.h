@@ -0,0 +1,81 @@
+#ifndef GFX_SIMD_H
+#define GFX_SIMD_H
+
+// Minimal float vector layer for the vertex pipeline. Every operation maps to
+// a single IEEE-exact instruction (no fused multiply-add, no reciprocal
+// estimates), so a kernel written with it performs the same roundings as the
+// equivalent scalar C code. GFX_SIMD_WIDTH is left undefined when no supported
+// instruction set is available and callers fall back to their scalar loops.
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#define GFX_SIMD_WIDTH 8
+
+typedef __m256 gfx_simd_t;
+typedef __m256 gfx_simd_mask_t;
+
+#define gfx_simd_set1(f) _mm256_set1_ps(f)
+#define gfx_simd_load(p) _mm256_loadu_ps(p)
+#define gfx_simd_store(p, a) _mm256_storeu_ps(p, a)
+#define gfx_simd_add(a, b) _mm256_add_ps(a, b)
+#define gfx_simd_sub(a, b) _mm256_sub_ps(a, b)
+#define gfx_simd_mul(a, b) _mm256_mul_ps(a, b)
+#define gfx_simd_div(a, b) _mm256_div_ps(a, b)
+#define gfx_simd_min(a, b) _mm256_min_ps(a, b)
+#define gfx_simd_max(a, b) _mm256_max_ps(a, b)
+#define gfx_simd_trunc(a) _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a))
+#define gfx_simd_cmplt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define gfx_simd_cmpgt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define gfx_simd_select(m, a, b) _mm256_blendv_ps(b, a, m)
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define GFX_SIMD_WIDTH 4
+
+typedef __m128 gfx_simd_t;
+typedef __m128 gfx_simd_mask_t;
+
+#define gfx_simd_set1(f) _mm_set1_ps(f)
+#define gfx_simd_load(p) _mm_loadu_ps(p)
+#define gfx_simd_store(p, a) _mm_storeu_ps(p, a)
+#define gfx_simd_add(a, b) _mm_add_ps(a, b)
+#define gfx_simd_sub(a, b) _mm_sub_ps(a, b)
+#define gfx_simd_mul(a, b) _mm_mul_ps(a, b)
+#define gfx_simd_div(a, b) _mm_div_ps(a, b)
+#define gfx_simd_min(a, b) _mm_min_ps(a, b)
+#define gfx_simd_max(a, b) _mm_max_ps(a, b)
+#define gfx_simd_trunc(a) _mm_cvtepi32_ps(_mm_cvttps_epi32(a))
+#define gfx_simd_cmplt(a, b) _mm_cmplt_ps(a, b)
+#define gfx_simd_cmpgt(a, b) _mm_cmpgt_ps(a, b)
+#define gfx_simd_select(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define GFX_SIMD_WIDTH 4
+
+typedef float32x4_t gfx_simd_t;
+typedef uint32x4_t gfx_simd_mask_t;
+
+#define gfx_simd_set1(f) vdupq_n_f32(f)
+#define gfx_simd_load(p) vld1q_f32(p)
+#define gfx_simd_store(p, a) vst1q_f32(p, a)
+#define gfx_simd_add(a, b) vaddq_f32(a, b)
+#define gfx_simd_sub(a, b) vsubq_f32(a, b)
+#define gfx_simd_mul(a, b) vmulq_f32(a, b)
+#define gfx_simd_div(a, b) vdivq_f32(a, b)
+#define gfx_simd_min(a, b) vminq_f32(a, b)
+#define gfx_simd_max(a, b) vmaxq_f32(a, b)
+#define gfx_simd_trunc(a) vcvtq_f32_s32(vcvtq_s32_f32(a))
+#define gfx_simd_cmplt(a, b) vcltq_f32(a, b)
+#define gfx_simd_cmpgt(a, b) vcgtq_f32(a, b)
+#define gfx_simd_select(m, a, b) vbslq_f32(m, a, b)
+
+#endif
+
+#endif
@@ -0,0 +1,839 @@
+#ifdef ENABLE_SOFTWARE_RENDERER
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if !defined(_WIN32) && !defined(TARGET_WEB)
+#define SOFT_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifndef _LANGUAGE_C
+#define _LANGUAGE_C
+#endif
+#include <PR/gbi.h>
+
+#include "gfx_cc.h"
+#include "gfx_rendering_api.h"
+#include "gfx_pc.h"
+#include "gfx_soft.h"
+
+// Software renderer for machines without a GPU. Triangles are clipped and set up when they
+// are submitted and binned into square tiles of the framebuffer. The tiles are rasterized in
+// parallel when the frame ends, or earlier when a texture still needed by a binned triangle
+// is replaced. Conventions follow gfx_opengl.c (clip space z from -w to w, window origin at
+// the bottom left, LEQUAL depth test, SRC_ALPHA blending), so frames match the OpenGL backend.
+
+#define TILE_SIZE 64
+#define MAX_THREADS 16
+#define MAX_VARYINGS (2 + 4 + 4 * 4)
+#define MAX_VERTEX_FLOATS (4 + MAX_VARYINGS)
+#define NUM_CLIP_PLANES 7
+#define MAX_CLIP_VERTICES (3 + NUM_CLIP_PLANES)
+#define GUARD_BAND 2.0f // x and y are clipped at this multiple of w, keeping edge setup precise
+#define MIN_W (1.0f / 65536.0f)
+#define DEPTH_UNIT (1.0f / 16777216.0f) // smallest depth step of a 24-bit depth buffer
+
+struct ShaderProgram {
+    uint32_t shader_id;
+    struct CCFeatures cc;
+    uint8_t num_floats;
+    uint8_t num_varyings; // floats after the position
+    int8_t tex_offset; // offsets into the varyings, -1 when unused
+    int8_t fog_offset;
+    int8_t inputs_offset;
+    uint8_t input_size;
+};
+
+struct Texture {
+    uint8_t *data; // RGBA8, NULL until uploaded
+    int width, height;
+    bool linear_filter;
+    uint32_t cms, cmt;
+    uint32_t used_in_batch; // batch with binned triangles sampling this texture
+};
+
+struct Sampler {
+    uint32_t texture_id;
+    bool linear_filter;
+    uint32_t cms, cmt;
+};
+
+struct RenderState {
+    struct ShaderProgram *prg;
+    struct Sampler samplers[2];
+    bool depth_test;
+    bool depth_mask;
+    bool use_alpha;
+    uint32_t window_height; // noise is in N64 pixels of the window, like gfx_opengl.c's
+    uint32_t frame_count;
+};
+
+struct Triangle {
+    float edges[3][3]; // barycentric weight of each vertex as a * x + b * y + c
+    float z[3]; // window depth of each vertex, decal offset included
+    float inv_w[3];
+    uint8_t top_left; // bit per edge, pixels exactly on the edge belong to the triangle
+    int x0, y0, x1, y1; // pixel bounds, upper bounds exclusive
+    uint32_t state;
+    uint32_t varyings; // 3 * num_varyings floats in varying_pool, already divided by w
+};
+
+struct Tile {
+    uint32_t *tris;
+    uint32_t count, capacity;
+};
+
+struct Rect {
+    int x, y, width, height;
+};
+
+static struct ShaderProgram shader_program_pool[128];
+static uint8_t shader_program_pool_size;
+static struct ShaderProgram *current_program;
+
+static struct Texture *textures;
+static uint32_t textures_count, textures_capacity;
+static uint32_t bound_textures[2];
+static int active_tile;
+
+static struct RenderState current_state;
+static bool state_dirty = true;
+static bool zmode_decal;
+static struct Rect viewport, scissor;
+static uint32_t frame_count;
+
+static struct {
+    uint32_t width, height;
+    uint8_t *color;
+    float *depth;
+    struct Tile *tiles;
+    uint32_t tiles_x, tiles_y;
+} fb;
+
+// Triangles binned since the last rasterization
+static struct {
+    uint32_t id;
+    struct RenderState *states;
+    uint32_t states_count, states_capacity;
+    struct Triangle *tris;
+    uint32_t tris_count, tris_capacity;
+    float *varying_pool;
+    uint32_t varying_pool_len, varying_pool_capacity;
+} batch = { 1 };
+
+#ifdef SOFT_THREADS
+static struct {
+    pthread_t threads[MAX_THREADS - 1];
+    int num_threads; // besides the main thread, which rasterizes as well
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond, done_cond;
+    uint32_t generation;
+    int busy;
+    uint32_t next_tile;
+} workers;
+#endif
+
+static void *gfx_soft_grow(void *ptr, uint32_t *capacity, size_t needed, size_t elem_size) {
+    if (needed <= *capacity) {
+        return ptr;
+    }
+    size_t new_capacity = *capacity < 64 ? 64 : *capacity;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    ptr = realloc(ptr, new_capacity * elem_size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Software renderer out of memory\n");
+        abort();
+    }
+    *capacity = new_capacity;
+    return ptr;
+}
+
+static bool gfx_soft_z_is_from_0_to_1(void) {
+    return false;
+}
+
+static void gfx_soft_unload_shader(struct ShaderProgram *old_prg) {
+}
+
+static void gfx_soft_load_shader(struct ShaderProgram *new_prg) {
+    current_program = new_prg;
+    state_dirty = true;
+}
+
+static struct ShaderProgram *gfx_soft_create_and_load_new_shader(uint32_t shader_id) {
+    struct ShaderProgram *prg = &shader_program_pool[shader_program_pool_size++];
+    gfx_cc_get_features(shader_id, &prg->cc);
+
+    // Same vertex layout as the OpenGL backend without GPU transform
+    int num_varyings = 0;
+    prg->tex_offset = -1;
+    prg->fog_offset = -1;
+    if (prg->cc.used_textures[0] || prg->cc.used_textures[1]) {
+        prg->tex_offset = num_varyings;
+        num_varyings += 2;
+    }
+    if (prg->cc.opt_fog) {
+        prg->fog_offset = num_varyings;
+        num_varyings += 4;
+    }
+    prg->inputs_offset = num_varyings;
+    prg->input_size = prg->cc.opt_alpha ? 4 : 3;
+    num_varyings += prg->cc.num_inputs * prg->input_size;
+
+    prg->shader_id = shader_id;
+    prg->num_varyings = num_varyings;
+    prg->num_floats = 4 + num_varyings;
+
+    gfx_soft_load_shader(prg);
+    return prg;
+}
+
+static struct ShaderProgram *gfx_soft_lookup_shader(uint32_t shader_id) {
+    for (size_t i = 0; i < shader_program_pool_size; i++) {
+        if (shader_program_pool[i].shader_id == shader_id) {
+            return &shader_program_pool[i];
+        }
+    }
+    return NULL;
+}
+
+static void gfx_soft_shader_get_info(struct ShaderProgram *prg, uint8_t *num_inputs, bool used_textures[2]) {
+    *num_inputs = prg->cc.num_inputs;
+    used_textures[0] = prg->cc.used_textures[0];
+    used_textures[1] = prg->cc.used_textures[1];
+}
+
+static uint32_t gfx_soft_new_texture(void) {
+    textures = gfx_soft_grow(textures, &textures_capacity, textures_count + 1, sizeof(struct Texture));
+    memset(&textures[textures_count], 0, sizeof(struct Texture));
+    return ++textures_count; // 0 is no texture, like in OpenGL
+}
+
+static void gfx_soft_select_texture(int tile, uint32_t texture_id) {
+    active_tile = tile;
+    bound_textures[tile] = texture_id;
+    state_dirty = true;
+}
+
+static void gfx_soft_rasterize(void);
+
+static void gfx_soft_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+    if (bound_textures[active_tile] == 0) {
+        return;
+    }
+    struct Texture *tex = &textures[bound_textures[active_tile] - 1];
+    if (tex->used_in_batch == batch.id) {
+        // Binned triangles still sample the old contents
+        gfx_soft_rasterize();
+    }
+    tex->data = realloc(tex->data, (size_t)width * height * 4);
+    if (tex->data == NULL) {
+        fprintf(stderr, "Software renderer out of memory\n");
+        abort();
+    }
+    memcpy(tex->data, rgba32_buf, (size_t)width * height * 4);
+    tex->width = width;
+    tex->height = height;
+}
+
+static void gfx_soft_set_sampler_parameters(int tile, bool linear_filter, uint32_t cms, uint32_t cmt) {
+    // Like OpenGL, these belong to the texture bound to the tile
+    active_tile = tile;
+    if (bound_textures[tile] != 0) {
+        struct Texture *tex = &textures[bound_textures[tile] - 1];
+        tex->linear_filter = linear_filter;
+        tex->cms = cms;
+        tex->cmt = cmt;
+    }
+    state_dirty = true;
+}
+
+static void gfx_soft_set_depth_test(bool depth_test) {
+    current_state.depth_test = depth_test;
+    state_dirty = true;
+}
+
+static void gfx_soft_set_depth_mask(bool z_upd) {
+    current_state.depth_mask = z_upd;
+    state_dirty = true;
+}
+
+static void gfx_soft_set_zmode_decal(bool decal) {
+    zmode_decal = decal;
+}
+
+static void gfx_soft_set_viewport(int x, int y, int width, int height) {
+    viewport.x = x;
+    viewport.y = y;
+    viewport.width = width;
+    viewport.height = height;
+    state_dirty = true;
+}
+
+static void gfx_soft_set_scissor(int x, int y, int width, int height) {
+    scissor.x = x;
+    scissor.y = y;
+    scissor.width = width;
+    scissor.height = height;
+}
+
+static void gfx_soft_set_use_alpha(bool use_alpha) {
+    current_state.use_alpha = use_alpha;
+    state_dirty = true;
+}
+
+static uint32_t gfx_soft_current_state(void) {
+    if (state_dirty) {
+        current_state.prg = current_program;
+        current_state.window_height = fb.height;
+        current_state.frame_count = frame_count;
+        for (int i = 0; i < 2; i++) {
+            struct Sampler *s = &current_state.samplers[i];
+            s->texture_id = current_program->cc.used_textures[i] ? bound_textures[i] : 0;
+            if (s->texture_id != 0) {
+                struct Texture *tex = &textures[s->texture_id - 1];
+                s->linear_filter = tex->linear_filter;
+                s->cms = tex->cms;
+                s->cmt = tex->cmt;
+                tex->used_in_batch = batch.id;
+            }
+        }
+        batch.states = gfx_soft_grow(batch.states, &batch.states_capacity, batch.states_count + 1, sizeof(struct RenderState));
+        batch.states[batch.states_count++] = current_state;
+        state_dirty = false;
+    }
+    return batch.states_count - 1;
+}
+
+// Clips a polygon against the guard band, the near and far planes, and w > 0
+static int gfx_soft_clip(float poly[MAX_CLIP_VERTICES][MAX_VERTEX_FLOATS], int n, int num_floats) {
+    static const float planes[NUM_CLIP_PLANES][5] = {
+        // x, y, z, w, constant: the kept side is where the sum is positive
+        { 0, 0, 0, 1, -MIN_W },
+        { 0, 0, 1, 1, 0 },
+        { 0, 0, -1, 1, 0 },
+        { 1, 0, 0, GUARD_BAND, 0 },
+        { -1, 0, 0, GUARD_BAND, 0 },
+        { 0, 1, 0, GUARD_BAND, 0 },
+        { 0, -1, 0, GUARD_BAND, 0 },
+    };
+    float tmp[MAX_CLIP_VERTICES][MAX_VERTEX_FLOATS];
+
+    for (int p = 0; p < NUM_CLIP_PLANES && n > 0; p++) {
+        const float *pl = planes[p];
+        float dist[MAX_CLIP_VERTICES];
+        bool all_inside = true;
+        for (int i = 0; i < n; i++) {
+            dist[i] = pl[0] * poly[i][0] + pl[1] * poly[i][1] + pl[2] * poly[i][2] + pl[3] * poly[i][3] + pl[4];
+            all_inside &= dist[i] >= 0.0f;
+        }
+        if (all_inside) {
+            continue;
+        }
+        int out = 0;
+        for (int i = 0; i < n; i++) {
+            int j = i + 1 == n ? 0 : i + 1;
+            if (dist[i] >= 0.0f) {
+                memcpy(tmp[out++], poly[i], num_floats * sizeof(float));
+            }
+            if ((dist[i] >= 0.0f) != (dist[j] >= 0.0f)) {
+                float t = dist[i] / (dist[i] - dist[j]);
+                for (int k = 0; k < num_floats; k++) {
+                    tmp[out][k] = poly[i][k] + (poly[j][k] - poly[i][k]) * t;
+                }
+                out++;
+            }
+        }
+        memcpy(poly, tmp, out * sizeof(tmp[0]));
+        n = out;
+    }
+    return n < 3 ? 0 : n;
+}
+
+static void gfx_soft_bin_triangle(float *v[3], int num_varyings) {
+    float sx[3], sy[3], sz[3], inv_w[3];
+    for (int i = 0; i < 3; i++) {
+        inv_w[i] = 1.0f / v[i][3];
+        sx[i] = viewport.x + (v[i][0] * inv_w[i] + 1.0f) * 0.5f * viewport.width;
+        sy[i] = viewport.y + (v[i][1] * inv_w[i] + 1.0f) * 0.5f * viewport.height;
+        sz[i] = v[i][2] * inv_w[i] * 0.5f + 0.5f;
+    }
+
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+    if (!(area != 0.0f) || !isfinite(area)) {
+        return;
+    }
+
+    // Pixel bounds, limited to the scissor rectangle and the framebuffer
+    int x0 = floorf(fminf(sx[0], fminf(sx[1], sx[2])));
+    int y0 = floorf(fminf(sy[0], fminf(sy[1], sy[2])));
+    int x1 = ceilf(fmaxf(sx[0], fmaxf(sx[1], sx[2])));
+    int y1 = ceilf(fmaxf(sy[0], fmaxf(sy[1], sy[2])));
+    if (x0 < scissor.x) x0 = scissor.x;
+    if (y0 < scissor.y) y0 = scissor.y;
+    if (x1 > scissor.x + scissor.width) x1 = scissor.x + scissor.width;
+    if (y1 > scissor.y + scissor.height) y1 = scissor.y + scissor.height;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > (int)fb.width) x1 = fb.width;
+    if (y1 > (int)fb.height) y1 = fb.height;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    batch.tris = gfx_soft_grow(batch.tris, &batch.tris_capacity, batch.tris_count + 1, sizeof(struct Triangle));
+    struct Triangle *tri = &batch.tris[batch.tris_count];
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    tri->top_left = 0;
+    for (int i = 0; i < 3; i++) {
+        int j = i == 2 ? 0 : i + 1;
+        int k = j == 2 ? 0 : j + 1;
+        float dx = sx[k] - sx[j];
+        float dy = sy[k] - sy[j];
+        tri->edges[i][0] = -dy / area;
+        tri->edges[i][1] = dx / area;
+        tri->edges[i][2] = (dy * sx[j] - dx * sy[j]) / area;
+        // Of two triangles sharing an edge, exactly one sees it pointing this way
+        if (dy * sign > 0.0f || (dy == 0.0f && dx * sign < 0.0f)) {
+            tri->top_left |= 1 << i;
+        }
+    }
+
+    float offset = 0.0f;
+    if (zmode_decal) {
+        // glPolygonOffset(-2, -2)
+        float dzdx = tri->edges[0][0] * sz[0] + tri->edges[1][0] * sz[1] + tri->edges[2][0] * sz[2];
+        float dzdy = tri->edges[0][1] * sz[0] + tri->edges[1][1] * sz[1] + tri->edges[2][1] * sz[2];
+        offset = -2.0f * fmaxf(fabsf(dzdx), fabsf(dzdy)) - 2.0f * DEPTH_UNIT;
+    }
+    for (int i = 0; i < 3; i++) {
+        tri->z[i] = sz[i] + offset;
+        tri->inv_w[i] = inv_w[i];
+    }
+    tri->x0 = x0;
+    tri->y0 = y0;
+    tri->x1 = x1;
+    tri->y1 = y1;
+    tri->state = gfx_soft_current_state();
+
+    batch.varying_pool = gfx_soft_grow(batch.varying_pool, &batch.varying_pool_capacity, batch.varying_pool_len + 3 * num_varyings, sizeof(float));
+    tri->varyings = batch.varying_pool_len;
+    float *dst = batch.varying_pool + batch.varying_pool_len;
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < num_varyings; k++) {
+            *dst++ = v[i][4 + k] * inv_w[i];
+        }
+    }
+    batch.varying_pool_len += 3 * num_varyings;
+
+    for (uint32_t ty = y0 / TILE_SIZE; ty <= (uint32_t)(y1 - 1) / TILE_SIZE; ty++) {
+        for (uint32_t tx = x0 / TILE_SIZE; tx <= (uint32_t)(x1 - 1) / TILE_SIZE; tx++) {
+            struct Tile *tile = &fb.tiles[ty * fb.tiles_x + tx];
+            tile->tris = gfx_soft_grow(tile->tris, &tile->capacity, tile->count + 1, sizeof(uint32_t));
+            tile->tris[tile->count++] = batch.tris_count;
+        }
+    }
+    batch.tris_count++;
+}
+
+static void gfx_soft_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
+    int num_floats = current_program->num_floats;
+    float poly[MAX_CLIP_VERTICES][MAX_VERTEX_FLOATS];
+
+    for (size_t t = 0; t < buf_vbo_num_tris; t++) {
+        float *src = &buf_vbo[t * 3 * num_floats];
+        for (int i = 0; i < 3; i++) {
+            memcpy(poly[i], src + i * num_floats, num_floats * sizeof(float));
+        }
+        int n = gfx_soft_clip(poly, 3, num_floats);
+        for (int i = 2; i < n; i++) {
+            float *v[3] = { poly[0], poly[i - 1], poly[i] };
+            gfx_soft_bin_triangle(v, current_program->num_varyings);
+        }
+    }
+}
+
+static int gfx_soft_wrap(int i, int size, uint32_t mode) {
+    if (mode & G_TX_CLAMP) {
+        return i < 0 ? 0 : (i >= size ? size - 1 : i);
+    }
+    if (mode & G_TX_MIRROR) {
+        i %= 2 * size;
+        if (i < 0) {
+            i += 2 * size;
+        }
+        return i < size ? i : 2 * size - 1 - i;
+    }
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+static void gfx_soft_sample(const struct Sampler *s, float u, float v, float out[4]) {
+    const struct Texture *tex = s->texture_id != 0 ? &textures[s->texture_id - 1] : NULL;
+    if (tex == NULL || tex->data == NULL) {
+        // OpenGL's result for an incomplete texture
+        out[0] = out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+        return;
+    }
+
+    float fu = u * tex->width;
+    float fv = v * tex->height;
+    if (!(fabsf(fu) < 1e6f && fabsf(fv) < 1e6f)) {
+        fu = fv = 0.0f;
+    }
+    if (!s->linear_filter) {
+        int x = gfx_soft_wrap(floorf(fu), tex->width, s->cms);
+        int y = gfx_soft_wrap(floorf(fv), tex->height, s->cmt);
+        const uint8_t *p = &tex->data[(y * tex->width + x) * 4];
+        for (int c = 0; c < 4; c++) {
+            out[c] = p[c] * (1.0f / 255.0f);
+        }
+        return;
+    }
+
+    fu -= 0.5f;
+    fv -= 0.5f;
+    float ix = floorf(fu);
+    float iy = floorf(fv);
+    float fx = fu - ix;
+    float fy = fv - iy;
+    int x0 = gfx_soft_wrap(ix, tex->width, s->cms);
+    int x1 = gfx_soft_wrap(ix + 1, tex->width, s->cms);
+    int y0 = gfx_soft_wrap(iy, tex->height, s->cmt);
+    int y1 = gfx_soft_wrap(iy + 1, tex->height, s->cmt);
+    const uint8_t *p00 = &tex->data[(y0 * tex->width + x0) * 4];
+    const uint8_t *p10 = &tex->data[(y0 * tex->width + x1) * 4];
+    const uint8_t *p01 = &tex->data[(y1 * tex->width + x0) * 4];
+    const uint8_t *p11 = &tex->data[(y1 * tex->width + x1) * 4];
+    for (int c = 0; c < 4; c++) {
+        float top = p00[c] + (p10[c] - p00[c]) * fx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+        out[c] = (top + (bottom - top) * fy) * (1.0f / 255.0f);
+    }
+}
+
+// Same function as the OpenGL fragment shader's random(), used for the noise alpha
+static float gfx_soft_random(float x, float y, float z) {
+    float r = sinf(x) * 12.9898f + sinf(y) * 78.233f + sinf(z) * 37.719f;
+    r = sinf(r) * 143758.5453f;
+    return r - floorf(r);
+}
+
+// Color combiner, fog and noise of the fragment shader gfx_opengl.c generates for the
+// program. Returns false if the fragment is discarded.
+static bool gfx_soft_shade(const struct RenderState *st, const float *vary, int x, int y, float out[4]) {
+    const struct CCFeatures *cc = &st->prg->cc;
+    float src[8][4];
+
+    // Indexed by SHADER_*, the color pass reads components 0-2 and the alpha pass component 3
+    memset(src[SHADER_0], 0, sizeof(src[0]));
+    for (int i = 0; i < cc->num_inputs; i++) {
+        const float *in = vary + st->prg->inputs_offset + i * st->prg->input_size;
+        src[SHADER_INPUT_1 + i][0] = in[0];
+        src[SHADER_INPUT_1 + i][1] = in[1];
+        src[SHADER_INPUT_1 + i][2] = in[2];
+        src[SHADER_INPUT_1 + i][3] = cc->opt_alpha ? in[3] : 1.0f;
+    }
+    if (cc->used_textures[0]) {
+        gfx_soft_sample(&st->samplers[0], vary[st->prg->tex_offset], vary[st->prg->tex_offset + 1], src[SHADER_TEXEL0]);
+        src[SHADER_TEXEL0A][0] = src[SHADER_TEXEL0A][1] = src[SHADER_TEXEL0A][2] = src[SHADER_TEXEL0A][3] = src[SHADER_TEXEL0][3];
+    }
+    if (cc->used_textures[1]) {
+        gfx_soft_sample(&st->samplers[1], vary[st->prg->tex_offset], vary[st->prg->tex_offset + 1], src[SHADER_TEXEL1]);
+    }
+
+    // (a - b) * c + d covers the single, multiply and mix forms of the generated shaders
+    const uint8_t *c = cc->c[0];
+    for (int ch = 0; ch < 3; ch++) {
+        out[ch] = (src[c[0]][ch] - src[c[1]][ch]) * src[c[2]][ch] + src[c[3]][ch];
+    }
+    if (cc->opt_alpha) {
+        c = cc->c[1];
+        out[3] = (src[c[0]][3] - src[c[1]][3]) * src[c[2]][3] + src[c[3]][3];
+    } else {
+        out[3] = 1.0f;
+    }
+
+    if (cc->opt_texture_edge && cc->opt_alpha) {
+        if (!(out[3] > 0.3f)) {
+            return false;
+        }
+        out[3] = 1.0f;
+    }
+    if (cc->opt_fog) {
+        const float *fog = vary + st->prg->fog_offset;
+        for (int ch = 0; ch < 3; ch++) {
+            out[ch] += (fog[ch] - out[ch]) * fog[3];
+        }
+    }
+    if (cc->opt_alpha && cc->opt_noise) {
+        float scale = 240.0f / st->window_height;
+        out[3] *= floorf(gfx_soft_random(floorf((x + 0.5f) * scale), floorf((y + 0.5f) * scale), st->frame_count) + 0.5f);
+    }
+
+    for (int ch = 0; ch < 4; ch++) {
+        out[ch] = out[ch] < 0.0f ? 0.0f : (out[ch] > 1.0f ? 1.0f : out[ch]);
+    }
+    return true;
+}
+
+static void gfx_soft_rasterize_tile(struct Tile *tile, int tx0, int ty0) {
+    int tx1 = tx0 + TILE_SIZE < (int)fb.width ? tx0 + TILE_SIZE : (int)fb.width;
+    int ty1 = ty0 + TILE_SIZE < (int)fb.height ? ty0 + TILE_SIZE : (int)fb.height;
+    float vary[MAX_VARYINGS];
+
+    for (uint32_t t = 0; t < tile->count; t++) {
+        const struct Triangle *tri = &batch.tris[tile->tris[t]];
+        const struct RenderState *st = &batch.states[tri->state];
+        int num_varyings = st->prg->num_varyings;
+        const float *v0 = &batch.varying_pool[tri->varyings];
+        const float *v1 = v0 + num_varyings;
+        const float *v2 = v1 + num_varyings;
+        int x0 = tri->x0 > tx0 ? tri->x0 : tx0;
+        int y0 = tri->y0 > ty0 ? tri->y0 : ty0;
+        int x1 = tri->x1 < tx1 ? tri->x1 : tx1;
+        int y1 = tri->y1 < ty1 ? tri->y1 : ty1;
+
+        for (int y = y0; y < y1; y++) {
+            float cy = y + 0.5f;
+            for (int x = x0; x < x1; x++) {
+                float cx = x + 0.5f;
+                float w[3];
+                bool inside = true;
+                for (int i = 0; i < 3; i++) {
+                    w[i] = tri->edges[i][0] * cx + tri->edges[i][1] * cy + tri->edges[i][2];
+                    inside &= w[i] > 0.0f || (w[i] == 0.0f && (tri->top_left & (1 << i)));
+                }
+                if (!inside) {
+                    continue;
+                }
+
+                size_t index = (size_t)y * fb.width + x;
+                float z = w[0] * tri->z[0] + w[1] * tri->z[1] + w[2] * tri->z[2];
+                if (st->depth_test && !(z <= fb.depth[index])) {
+                    continue;
+                }
+
+                // Perspective correct varyings
+                float pw = 1.0f / (w[0] * tri->inv_w[0] + w[1] * tri->inv_w[1] + w[2] * tri->inv_w[2]);
+                for (int k = 0; k < num_varyings; k++) {
+                    vary[k] = (w[0] * v0[k] + w[1] * v1[k] + w[2] * v2[k]) * pw;
+                }
+                float color[4];
+                if (!gfx_soft_shade(st, vary, x, y, color)) {
+                    continue;
+                }
+
+                uint8_t *dst = &fb.color[index * 4];
+                if (st->use_alpha) {
+                    float a = color[3];
+                    for (int ch = 0; ch < 4; ch++) {
+                        color[ch] = color[ch] * a + dst[ch] * (1.0f / 255.0f) * (1.0f - a);
+                    }
+                }
+                for (int ch = 0; ch < 4; ch++) {
+                    dst[ch] = color[ch] * 255.0f + 0.5f;
+                }
+                if (st->depth_test && st->depth_mask) {
+                    fb.depth[index] = z;
+                }
+            }
+        }
+    }
+    tile->count = 0;
+}
+
+// Each tile is rasterized by a single thread, so the triangles in it keep their order
+static void gfx_soft_rasterize_tiles(void) {
+    uint32_t num_tiles = fb.tiles_x * fb.tiles_y;
+    for (;;) {
+#ifdef SOFT_THREADS
+        uint32_t i = __atomic_fetch_add(&workers.next_tile, 1, __ATOMIC_RELAXED);
+#else
+        static uint32_t next_tile;
+        uint32_t i = next_tile++;
+        if (i >= num_tiles) {
+            next_tile = 0;
+        }
+#endif
+        if (i >= num_tiles) {
+            break;
+        }
+        if (fb.tiles[i].count != 0) {
+            gfx_soft_rasterize_tile(&fb.tiles[i], (i % fb.tiles_x) * TILE_SIZE, (i / fb.tiles_x) * TILE_SIZE);
+        }
+    }
+}
+
+#ifdef SOFT_THREADS
+static void *gfx_soft_worker_main(void *arg) {
+    uint32_t generation = 0;
+    for (;;) {
+        pthread_mutex_lock(&workers.lock);
+        while (workers.generation == generation) {
+            pthread_cond_wait(&workers.start_cond, &workers.lock);
+        }
+        generation = workers.generation;
+        pthread_mutex_unlock(&workers.lock);
+
+        gfx_soft_rasterize_tiles();
+
+        pthread_mutex_lock(&workers.lock);
+        if (--workers.busy == 0) {
+            pthread_cond_signal(&workers.done_cond);
+        }
+        pthread_mutex_unlock(&workers.lock);
+    }
+    return NULL;
+}
+#endif
+
+static void gfx_soft_rasterize(void) {
+    if (batch.tris_count == 0) {
+        return;
+    }
+#ifdef SOFT_THREADS
+    pthread_mutex_lock(&workers.lock);
+    workers.next_tile = 0;
+    workers.busy = workers.num_threads;
+    workers.generation++;
+    pthread_cond_broadcast(&workers.start_cond);
+    pthread_mutex_unlock(&workers.lock);
+
+    gfx_soft_rasterize_tiles();
+
+    pthread_mutex_lock(&workers.lock);
+    while (workers.busy > 0) {
+        pthread_cond_wait(&workers.done_cond, &workers.lock);
+    }
+    pthread_mutex_unlock(&workers.lock);
+#else
+    gfx_soft_rasterize_tiles();
+#endif
+
+    batch.id++;
+    batch.states_count = 0;
+    batch.tris_count = 0;
+    batch.varying_pool_len = 0;
+    state_dirty = true;
+}
+
+static void gfx_soft_resize(uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i < fb.tiles_x * fb.tiles_y; i++) {
+        free(fb.tiles[i].tris);
+    }
+    free(fb.tiles);
+    free(fb.color);
+    free(fb.depth);
+
+    fb.width = width;
+    fb.height = height;
+    fb.tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    fb.tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    fb.color = malloc((size_t)width * height * 4);
+    fb.depth = malloc((size_t)width * height * sizeof(float));
+    fb.tiles = calloc(fb.tiles_x * fb.tiles_y, sizeof(struct Tile));
+    if (fb.color == NULL || fb.depth == NULL || fb.tiles == NULL) {
+        fprintf(stderr, "Software renderer out of memory\n");
+        abort();
+    }
+}
+
+static void gfx_soft_init(void) {
+#ifdef SOFT_THREADS
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers.num_threads = cpus < 1 ? 0 : (cpus > MAX_THREADS ? MAX_THREADS : cpus) - 1;
+    pthread_mutex_init(&workers.lock, NULL);
+    pthread_cond_init(&workers.start_cond, NULL);
+    pthread_cond_init(&workers.done_cond, NULL);
+    for (int i = 0; i < workers.num_threads; i++) {
+        if (pthread_create(&workers.threads[i], NULL, gfx_soft_worker_main, NULL) != 0) {
+            workers.num_threads = i;
+            break;
+        }
+    }
+#endif
+}
+
+static void gfx_soft_on_resize(void) {
+}
+
+static void gfx_soft_start_frame(void) {
+    frame_count++;
+    state_dirty = true;
+
+    if (fb.width != gfx_current_dimensions.width || fb.height != gfx_current_dimensions.height) {
+        gfx_soft_resize(gfx_current_dimensions.width, gfx_current_dimensions.height);
+    }
+    size_t num_pixels = (size_t)fb.width * fb.height;
+    for (size_t i = 0; i < num_pixels; i++) {
+        fb.color[i * 4 + 0] = 0;
+        fb.color[i * 4 + 1] = 0;
+        fb.color[i * 4 + 2] = 0;
+        fb.color[i * 4 + 3] = 255;
+        fb.depth[i] = 1.0f;
+    }
+}
+
+static void gfx_soft_end_frame(void) {
+    gfx_soft_rasterize();
+}
+
+static void gfx_soft_finish_render(void) {
+}
+
+const uint8_t *gfx_soft_get_framebuffer(uint32_t *width, uint32_t *height) {
+    *width = fb.width;
+    *height = fb.height;
+    return fb.color;
+}
+
+static const uint8_t *gfx_soft_read_frame(uint32_t *width, uint32_t *height) {
+    // The frame is complete once end_frame returns, so there is nothing to wait for
+    if (*width == 0 || *height == 0) {
+        return NULL;
+    }
+    return gfx_soft_get_framebuffer(width, height);
+}
+
+struct GfxRenderingAPI gfx_soft_api = {
+    gfx_soft_z_is_from_0_to_1,
+    gfx_soft_unload_shader,
+    gfx_soft_load_shader,
+    gfx_soft_create_and_load_new_shader,
+    gfx_soft_lookup_shader,
+    gfx_soft_shader_get_info,
+    gfx_soft_new_texture,
+    gfx_soft_select_texture,
+    gfx_soft_upload_texture,
+    gfx_soft_set_sampler_parameters,
+    gfx_soft_set_depth_test,
+    gfx_soft_set_depth_mask,
+    gfx_soft_set_zmode_decal,
+    gfx_soft_set_viewport,
+    gfx_soft_set_scissor,
+    gfx_soft_set_use_alpha,
+    gfx_soft_draw_triangles,
+    gfx_soft_init,
+    gfx_soft_on_resize,
+    gfx_soft_start_frame,
+    gfx_soft_end_frame,
+    gfx_soft_finish_render,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    gfx_soft_read_frame
+};
+
+#endif
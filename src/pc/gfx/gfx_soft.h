@@ -0,0 +1,17 @@
+#ifdef ENABLE_SOFTWARE_RENDERER
+
+#ifndef GFX_SOFT_H
+#define GFX_SOFT_H
+
+#include <stdint.h>
+
+#include "gfx_rendering_api.h"
+
+extern struct GfxRenderingAPI gfx_soft_api;
+
+// Last finished frame as RGBA8, rows from bottom to top like glReadPixels
+const uint8_t *gfx_soft_get_framebuffer(uint32_t *width, uint32_t *height);
+
+#endif
+
+#endif
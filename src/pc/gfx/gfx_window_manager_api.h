@@ -15,7 +15,13 @@ struct GfxWindowManagerAPI {
     bool (*start_frame)(void);
     void (*swap_buffers_begin)(void);
     void (*swap_buffers_end)(void);
-    double (*get_time)(void); // For debug
+    double (*get_time)(void); // In seconds, from a monotonic clock
+    // Optional, paces swap_buffers_begin to fps instead of the game's frame rate
+    void (*set_target_fps)(uint32_t fps);
+    // Optional, low latency pacing. In seconds on the clock of get_time, when the next frame will
+    // be presented if it's submitted in time, and when the last one was, after swap_buffers_end.
+    double (*get_next_present_time)(void);
+    double (*get_last_present_time)(void);
 };
 
 #endif
@@ -1,16 +1,28 @@
 #include <stdlib.h>
+#include <stdio.h>
 
 #ifdef TARGET_WEB
 #include <emscripten.h>
 #include <emscripten/html5.h>
 #endif
 
+#if !defined(TARGET_WEB) && !defined(_WIN32)
+#define RENDER_PIPELINE 1
+#define LOW_LATENCY_PACING 1
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#endif
+
 #include "sm64.h"
 
 #include "game/memory.h"
+#include "buffers/buffers.h"
 #include "audio/external.h"
 
 #include "gfx/gfx_pc.h"
+#include "gfx/gfx_capture.h"
 #include "gfx/gfx_opengl.h"
 #include "gfx/gfx_direct3d11.h"
 #include "gfx/gfx_direct3d12.h"
@@ -18,6 +30,7 @@
 #include "gfx/gfx_glx.h"
 #include "gfx/gfx_sdl.h"
 #include "gfx/gfx_dummy.h"
+#include "gfx/gfx_soft.h"
 
 #include "audio/audio_api.h"
 #include "audio/audio_wasapi.h"
@@ -26,6 +39,7 @@
 #include "audio/audio_sdl.h"
 #include "audio/audio_null.h"
 
+#include "controller/controller_api.h"
 #include "controller/controller_keyboard.h"
 
 #include "configfile.h"
@@ -60,14 +74,143 @@ void set_vblank_handler(UNUSED s32 index, UNUSED struct VblankHandler *handler,
 
 static uint8_t inited = 0;
 
+#ifdef RENDER_PIPELINE
+// Pipelined mode: game logic and audio for the next frame run on a separate thread while
+// the main thread, which owns the window and the graphics context, renders the previous
+// frame's display list. Both sides alternate between the two gfx pools.
+//
+// Window events, and with them the keyboard state, are handled on the main thread, so the
+// controllers are read there too, while the game thread waits for run_frame, and handed
+// over through controller_latch_input.
+//
+// The held display list may point into:
+// - the gfx pool and alloc-only gfx pool of its frame, which the game thread only reuses
+//   two frames later, after the main thread has taken the next display list
+// - level, actor and menu data compiled into the game, which the game thread does not write
+// - main pool blocks, such as object and level buffers, released by main_pool_free and
+//   main_pool_pop_state
+// - the Goddard heap of the Mario head, released by its free function in level_script.c
+// Everything that releases or rewrites the last two calls wait_for_display_list first.
+static struct {
+    bool enabled;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool run_frame; // main thread asks for the next frame
+    bool frame_done; // game thread has finished a frame
+    bool rendering; // main thread is running a display list
+    Gfx *display_list; // display list of the finished frame, NULL if there was none
+    Gfx *held; // display list the main thread draws, owned by the main thread
+    bool release_held; // game thread is about to free memory, don't draw the held display list again
+} pipeline;
+#endif
+
+#ifdef VERSION_EU
+#define GAME_FPS 25
+#else
+#define GAME_FPS 30
+#endif
+
+// Interpolated mode: frames are drawn at configRenderFps, each one drawing the display list
+// of the latest game frame with its matrices blended towards those of the previous game
+// frame. Game logic, input and audio still run once per game frame, exactly as before.
+static struct {
+    bool enabled;
+    uint32_t fps;
+    uint32_t phase; // time since the latest game frame, in 1 / (GAME_FPS * fps) seconds
+    bool new_tick; // display list hasn't been drawn yet
+    Gfx *display_list; // display list of the latest game frame
+} interpolation;
+
+#ifdef LOW_LATENCY_PACING
+// Low latency pacing: rather than starting on the next frame as soon as the last one is
+// presented, sleep until just enough time is left to run and render it before its present,
+// so that input is read as late as possible. The time needed is estimated from the CPU time
+// of recent frames and the GPU time measured by the rendering API.
+#define LATE_LATCH_MIN_MARGIN 0.001
+#define LATE_LATCH_MAX_MARGIN 0.008
+static struct {
+    bool enabled;
+    double deadline; // present time the frame is aimed at
+    double work; // logic and render CPU time, rises at once and falls slowly
+    double margin; // grows when a present is missed
+} late_latch;
+#endif
+
+static double input_time; // when the input of the frame being drawn was read, 0 if unknown
+
+static FILE *gfx_stats_csv;
+
 #include "game/game_init.h" // for gGlobalTimer
+#include "game/area.h" // for gCurrLevelNum and gCurrAreaIndex
+#include "game/segment2.h" // for the font tables
+#include "engine/collision_trace.h" // for the collision trace
+#include "engine/surface_collision.h" // for the collision query cache
+#include "engine/surface_load.h" // for the surface pool stats
+#include "engine/behavior_script.h" // for the pre-decoded behavior scripts
+#include "engine/math_util.h" // for the SIMD matrix kernels
+#include "game/rendering_graph_node.h" // for the matrix stack kernels and animation cache
+
+static void open_gfx_stats_csv(void) {
+    gfx_stats_csv = fopen("gfx_stats.csv", "w");
+    if (gfx_stats_csv == NULL) {
+        fprintf(stderr, "Could not open gfx_stats.csv\n");
+        return;
+    }
+    fputs("frame,time_ms,level,area,dl_commands,vertices,triangles,triangles_clip_rejected,triangles_culled,chunks_culled,"
+          "flushes,static_dls_drawn,texture_hits,texture_misses,texture_uploads,texture_upload_bytes,"
+          "shader_switches,run_dl_us,backend_us,scene_scale_pct,input_latency_us,frame_time_us,frame_time_dev_us\n", gfx_stats_csv);
+}
+
+// Writes a row for the last drawn frame, along with the scene it showed
+static void log_gfx_stats(void) {
+    static uint32_t last_frame;
+    const struct GfxStats *s = &gfx_frame_stats;
+    
+    if (gfx_stats_csv == NULL || s->frame == last_frame) {
+        return; // not logging, or the frame was dropped
+    }
+    last_frame = s->frame;
+    fprintf(gfx_stats_csv, "%u,%.3f,%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+            s->frame, wm_api->get_time() * 1000.0, gCurrLevelNum, gCurrAreaIndex, s->dl_commands, s->vertices,
+            s->triangles, s->triangles_clip_rejected, s->triangles_culled, s->chunks_culled, s->flushes, s->static_dls_drawn,
+            s->texture_hits, s->texture_misses, s->texture_uploads, s->texture_upload_bytes,
+            s->shader_switches, s->run_dl_us, s->backend_us, s->scene_scale_pct,
+            s->input_latency_us, s->frame_time_us, s->frame_time_dev_us);
+}
 void exec_display_list(struct SPTask *spTask) {
     if (!inited) {
         return;
     }
+#ifdef RENDER_PIPELINE
+    if (pipeline.enabled) {
+        // Picked up by the main thread once the frame is done
+        pipeline.display_list = (Gfx *)spTask->task.t.data_ptr;
+        return;
+    }
+#endif
+    if (interpolation.enabled) {
+        // Drawn by produce_one_frame, as many times as the frame rate requires
+        interpolation.display_list = (Gfx *)spTask->task.t.data_ptr;
+        return;
+    }
     gfx_run((Gfx *)spTask->task.t.data_ptr);
 }
 
+// Blocks until no display list is being rendered, so memory it uses can be released
+void wait_for_display_list(void) {
+#ifdef RENDER_PIPELINE
+    if (pipeline.enabled) {
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.release_held = true;
+        while (pipeline.rendering) {
+            pthread_cond_wait(&pipeline.cond, &pipeline.lock);
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+#endif
+}
+
 #define printf
 
 #ifdef VERSION_EU
@@ -78,10 +221,7 @@ void exec_display_list(struct SPTask *spTask) {
 #define SAMPLES_LOW 528
 #endif
 
-void produce_one_frame(void) {
-    gfx_start_frame();
-    game_loop_one_iteration();
-    
+static void produce_audio(void) {
     int samples_left = audio_api->buffered();
     u32 num_audio_samples = samples_left < audio_api->get_desired_buffered() ? SAMPLES_HIGH : SAMPLES_LOW;
     //printf("Audio samples: %d %u\n", samples_left, num_audio_samples);
@@ -95,8 +235,241 @@ void produce_one_frame(void) {
     }
     //printf("Audio samples before submitting: %d\n", audio_api->buffered());
     audio_api->play((u8 *)audio_buffer, 2 * num_audio_samples * 4);
+}
+
+// Advances the render clock by one frame, returns whether a new game frame is due
+static bool interpolation_advance(void) {
+    interpolation.phase += GAME_FPS;
+    if (interpolation.phase > interpolation.fps) {
+        interpolation.phase -= interpolation.fps;
+        return true;
+    }
+    return false;
+}
+
+static void interpolation_render(Gfx *display_list, float alpha) {
+    gfx_run_interpolated(display_list, interpolation.new_tick, alpha);
+    interpolation.new_tick = false;
+}
+
+static bool start_interpolation(void) {
+    if (configRenderFps <= GAME_FPS || wm_api->set_target_fps == NULL) {
+        return false;
+    }
+    interpolation.fps = configRenderFps;
+    interpolation.phase = interpolation.fps;
+    interpolation.enabled = true;
+    wm_api->set_target_fps(interpolation.fps);
+    return true;
+}
+
+// Packs the HUD and dialog fonts into atlases, so that text is drawn in one batch
+static void register_glyph_atlases(void) {
+    gfx_register_glyph_atlas((const void *const *) main_hud_lut, ARRAY_COUNT(main_hud_lut), G_IM_FMT_RGBA,
+                             G_IM_SIZ_16b, 16, 16);
+#if defined(VERSION_US) || defined(VERSION_EU)
+    // JP and SH unpack their 1 bit glyphs into the display list every frame
+    gfx_register_glyph_atlas((const void *const *) main_font_lut, 256, G_IM_FMT_IA, G_IM_SIZ_4b, 16, 8);
+#endif
+}
+
+static void start_dynamic_resolution(void) {
+    if (!configDynamicResolution) {
+        return;
+    }
+    float budget_ms = configDynResBudgetMs;
+    if (budget_ms <= 0.0f) {
+        // The browser decides the frame rate, so interpolated web frames assume 60 FPS
+        budget_ms = 1000.0f / (interpolation.enabled ? (interpolation.fps != 0 ? interpolation.fps : 60) : GAME_FPS);
+    }
+    gfx_set_dynamic_resolution(true, configDynResMinScale, configDynResMaxScale, budget_ms * 1000.0f);
+}
+
+#ifdef LOW_LATENCY_PACING
+static void start_late_latch(void) {
+    if (!configLowLatency) {
+        return;
+    }
+    if (wm_api->get_next_present_time == NULL || wm_api->get_last_present_time == NULL) {
+        fprintf(stderr, "Low latency pacing is not supported by this window manager\n");
+        return;
+    }
+    if (configPipelinedRender || interpolation.enabled) {
+        // Both draw frames that were computed from earlier input
+        fprintf(stderr, "Low latency pacing is off with pipelined or interpolated rendering\n");
+        return;
+    }
+    late_latch.enabled = true;
+    late_latch.margin = LATE_LATCH_MIN_MARGIN;
+}
+
+static void late_latch_wait(void) {
+    struct GfxRenderingAPI *rapi = gfx_get_current_rendering_api();
+    double gpu_time = rapi->get_gpu_frame_time != NULL ? rapi->get_gpu_frame_time() / 1000000.0 : 0.0;
+    
+    late_latch.deadline = wm_api->get_next_present_time();
+    double wake = late_latch.deadline - late_latch.work - gpu_time - late_latch.margin;
+    double now = wm_api->get_time();
+    if (wake > now) {
+        double left = wake - now;
+        struct timespec ts = {(time_t)left, (long)((left - floor(left)) * 1000000000.0)};
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+        }
+    }
+}
+
+static void late_latch_update(double start, double submitted) {
+    double work = submitted - start;
+    if (work > late_latch.work) {
+        late_latch.work = work;
+    } else {
+        late_latch.work += (work - late_latch.work) * 0.05;
+    }
+    
+    if (wm_api->get_last_present_time() > late_latch.deadline + 0.001) {
+        late_latch.margin = fmin(late_latch.margin + 0.001, LATE_LATCH_MAX_MARGIN);
+    } else {
+        late_latch.margin = fmax(late_latch.margin - 0.00002, LATE_LATCH_MIN_MARGIN);
+    }
+}
+#endif
+
+// Reports the time from reading the input to presenting the first frame that shows it
+static void report_input_latency(void) {
+    if (input_time == 0.0 || wm_api->get_last_present_time == NULL) {
+        return;
+    }
+    double latency = wm_api->get_last_present_time() - input_time;
+    if (latency > 0.0) {
+        gfx_frame_stats.input_latency_us = latency * 1000000.0;
+    }
+    input_time = 0.0;
+}
+
+#ifdef RENDER_PIPELINE
+static void *game_thread_main(UNUSED void *arg) {
+    pthread_mutex_lock(&pipeline.lock);
+    for (;;) {
+        while (!pipeline.run_frame) {
+            pthread_cond_wait(&pipeline.cond, &pipeline.lock);
+        }
+        pipeline.run_frame = false;
+        pthread_mutex_unlock(&pipeline.lock);
+        
+        game_loop_one_iteration();
+        produce_audio();
+        
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.frame_done = true;
+        pthread_cond_broadcast(&pipeline.cond);
+    }
+    return NULL;
+}
+
+static bool start_render_pipeline(void) {
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.cond, NULL);
+    pipeline.enabled = true;
+    pipeline.run_frame = true;
+    controller_latch_input();
+    if (pthread_create(&pipeline.thread, NULL, game_thread_main, NULL) != 0) {
+        pipeline.enabled = false;
+        pipeline.run_frame = false;
+        return false;
+    }
+    return true;
+}
+
+static void produce_one_frame_pipelined(void) {
+    gfx_start_frame();
+    
+    if (!interpolation.enabled || interpolation_advance()) {
+        // Take the finished frame and let the game thread start on the next one
+        pthread_mutex_lock(&pipeline.lock);
+        while (!pipeline.frame_done) {
+            pthread_cond_wait(&pipeline.cond, &pipeline.lock);
+        }
+        pipeline.held = pipeline.display_list;
+        pipeline.display_list = NULL;
+        pipeline.frame_done = false;
+        pipeline.release_held = false;
+        pipeline.rendering = pipeline.held != NULL;
+        // The game thread is idle until run_frame is set, hand it the input of this frame
+        controller_latch_input();
+        pipeline.run_frame = true;
+        pthread_cond_broadcast(&pipeline.cond);
+        pthread_mutex_unlock(&pipeline.lock);
+        interpolation.new_tick = true;
+    } else {
+        // Draw the held frame again, unless memory it uses is about to be freed
+        pthread_mutex_lock(&pipeline.lock);
+        if (pipeline.release_held) {
+            pipeline.held = NULL;
+        }
+        pipeline.rendering = pipeline.held != NULL;
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+    
+    if (pipeline.held != NULL) {
+        if (interpolation.enabled) {
+            interpolation_render(pipeline.held, (float)interpolation.phase / interpolation.fps);
+        } else {
+            gfx_run(pipeline.held);
+        }
+        
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.rendering = false;
+        pthread_cond_broadcast(&pipeline.cond);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
     
     gfx_end_frame();
+    log_gfx_stats();
+}
+#endif
+
+void produce_one_frame(void) {
+#ifdef RENDER_PIPELINE
+    if (pipeline.enabled) {
+        produce_one_frame_pipelined();
+        return;
+    }
+#endif
+#ifdef LOW_LATENCY_PACING
+    if (late_latch.enabled) {
+        late_latch_wait();
+    }
+#endif
+    // Keyboard input is read by gfx_start_frame, controllers by the game loop
+    double start = wm_api->get_time();
+    gfx_start_frame();
+    if (!interpolation.enabled) {
+        game_loop_one_iteration();
+        produce_audio();
+        input_time = start;
+    } else {
+        if (interpolation_advance()) {
+            interpolation.display_list = NULL;
+            game_loop_one_iteration();
+            produce_audio();
+            interpolation.new_tick = true;
+            input_time = start;
+        }
+        if (interpolation.display_list != NULL) {
+            interpolation_render(interpolation.display_list, (float)interpolation.phase / interpolation.fps);
+        }
+    }
+#ifdef LOW_LATENCY_PACING
+    double submitted = wm_api->get_time();
+#endif
+    gfx_end_frame();
+#ifdef LOW_LATENCY_PACING
+    if (late_latch.enabled) {
+        late_latch_update(start, submitted);
+    }
+#endif
+    report_input_latency();
+    log_gfx_stats();
 }
 
 #ifdef TARGET_WEB
@@ -111,6 +484,7 @@ static void request_anim_frame(void (*func)(double time)) {
 
 static void on_anim_frame(double time) {
     static double target_time;
+    static double prev_time;
 
     time *= 0.03; // milliseconds to frame count (33.333 ms -> 1)
 
@@ -120,6 +494,33 @@ static void on_anim_frame(double time) {
         target_time = time - 0.010;
     }
 
+    if (interpolation.enabled) {
+        // Draw on every animation frame, the browser paces them at the display's refresh rate
+        gfx_start_frame();
+        for (int i = 0; i < 2; i++) {
+            if (time >= target_time) {
+                interpolation.display_list = NULL;
+                game_loop_one_iteration();
+                produce_audio();
+                interpolation.new_tick = true;
+                target_time = target_time + 1.0;
+            }
+        }
+        // Show the state due when this frame is displayed, one animation frame from now
+        float alpha = time - (target_time - 1.0) + (time - prev_time);
+        if (alpha > 1.0f || alpha <= 0.0f) {
+            alpha = 1.0f;
+        }
+        if (interpolation.display_list != NULL) {
+            interpolation_render(interpolation.display_list, alpha);
+        }
+        gfx_end_frame();
+        log_gfx_stats();
+        prev_time = time;
+        request_anim_frame(on_anim_frame);
+        return;
+    }
+
     for (int i = 0; i < 2; i++) {
         // If refresh rate is 15 Hz or something we might need to generate two frames
         if (time >= target_time) {
@@ -136,6 +537,40 @@ static void save_config(void) {
     configfile_save(CONFIG_FILE);
 }
 
+static int compare_collision_query_sites(const void *a, const void *b) {
+    const struct CollisionQuerySite *sa = a, *sb = b;
+    return sa->calls < sb->calls ? 1 : sa->calls > sb->calls ? -1 : 0;
+}
+
+// Prints how often the floor and ceiling queries of each call site were found in the cache
+static void print_collision_query_stats(void) {
+    const struct CollisionQuerySite *table;
+    int size = get_collision_query_sites(&table);
+    struct CollisionQuerySite *sites = malloc(size * sizeof(struct CollisionQuerySite));
+    int count = 0;
+    unsigned long long calls = 0, hits = 0;
+
+    if (sites == NULL) {
+        return;
+    }
+    for (int i = 0; i < size; i++) {
+        if (table[i].file != NULL) {
+            sites[count++] = table[i];
+            calls += table[i].calls;
+            hits += table[i].hits;
+        }
+    }
+    qsort(sites, count, sizeof(sites[0]), compare_collision_query_sites);
+
+    fprintf(stderr, "Collision query cache: %llu of %llu queries hit (%.1f%%)\n", hits, calls,
+            calls != 0 ? 100.0 * hits / calls : 0.0);
+    for (int i = 0; i < count; i++) {
+        fprintf(stderr, "%10u %5.1f%%  %s:%d\n", sites[i].calls,
+                sites[i].calls != 0 ? 100.0 * sites[i].hits / sites[i].calls : 0.0, sites[i].file, sites[i].line);
+    }
+    free(sites);
+}
+
 static void on_fullscreen_changed(bool is_now_fullscreen) {
     configFullscreen = is_now_fullscreen;
 }
@@ -143,7 +578,10 @@ static void on_fullscreen_changed(bool is_now_fullscreen) {
 void main_func(void) {
 #ifdef USE_SYSTEM_MALLOC
     main_pool_init();
-    gGfxAllocOnlyPool = alloc_only_pool_init();
+    for (int i = 0; i < GFX_NUM_POOLS; i++) {
+        gGfxAllocOnlyPools[i] = alloc_only_pool_init();
+    }
+    gGfxAllocOnlyPool = gGfxAllocOnlyPools[0];
 #else
     static u64 pool[0x165000/8 / 4 * sizeof(void *)];
     main_pool_init(pool, pool + sizeof(pool) / sizeof(pool[0]));
@@ -153,6 +591,28 @@ void main_func(void) {
     configfile_load(CONFIG_FILE);
     atexit(save_config);
 
+    if (configCollisionCache) {
+        set_collision_query_cache(TRUE);
+        atexit(print_collision_query_stats);
+    }
+    if (configCollisionTrace && open_collision_trace("collision_trace.bin")) {
+        atexit(close_collision_trace);
+    }
+    if (configSurfacePoolStats) {
+        set_surface_pool_stats(TRUE);
+    }
+    if (configDecodedBehaviors) {
+        set_behavior_script_decoding(TRUE);
+    }
+    if (configSimdMatrices) {
+        // The held object position is read back from the matrix stack, only
+        // give up the scalar results when asked to
+        set_matrix_stack_kernels(configStrictMatrices ? &gMtxfStrictSimdKernels : &gMtxfFastSimdKernels);
+    }
+    if (configAnimationCache) {
+        set_animation_cache(TRUE);
+    }
+
 #ifdef TARGET_WEB
     emscripten_set_main_loop(em_main_loop, 0, 0);
     request_anim_frame(on_anim_frame);
@@ -171,12 +631,26 @@ void main_func(void) {
     #else
         wm_api = &gfx_sdl;
     #endif
+#elif defined(ENABLE_SOFTWARE_RENDERER)
+    rendering_api = &gfx_soft_api;
+    wm_api = &gfx_dummy_wm_api;
 #elif defined(ENABLE_GFX_DUMMY)
     rendering_api = &gfx_dummy_renderer_api;
     wm_api = &gfx_dummy_wm_api;
 #endif
 
     gfx_init(wm_api, rendering_api, "Super Mario 64 PC-Port", configFullscreen);
+    gfx_set_sort_opaque_draws(configSortOpaqueDraws);
+    gfx_set_simd_vertex_transform(configSimdVertexTransform);
+    gfx_set_gpu_vertex_transform(configGpuVertexTransform);
+    gfx_set_static_geometry_cache(configStaticGeometryCache);
+    register_glyph_atlases();
+    if (configGfxStatsCsv) {
+        open_gfx_stats_csv();
+    }
+    if (configCaptureMode != GFX_CAPTURE_OFF) {
+        gfx_capture_start(rendering_api, configCaptureMode);
+    }
     
     wm_api->set_fullscreen_changed_callback(on_fullscreen_changed);
     wm_api->set_keyboard_callbacks(keyboard_on_key_down, keyboard_on_key_up, keyboard_on_all_keys_up);
@@ -213,9 +687,22 @@ void main_func(void) {
     /*for (int i = 0; i < atoi(argv[1]); i++) {
         game_loop_one_iteration();
     }*/
+    // The browser decides the frame rate, any value enables interpolation
+    interpolation.enabled = configRenderFps != 0;
+    start_dynamic_resolution();
     inited = 1;
 #else
     inited = 1;
+    start_interpolation();
+    start_dynamic_resolution();
+#ifdef LOW_LATENCY_PACING
+    start_late_latch();
+#endif
+#ifdef RENDER_PIPELINE
+    if (configPipelinedRender) {
+        start_render_pipeline();
+    }
+#endif
     while (1) {
         wm_api->main_loop(produce_one_frame);
     }
@@ -8,6 +8,9 @@
 #include <stdio.h>
 #include "../../include/sm64.h"
 #include "../game/object_list_processor.h"
+#ifndef TARGET_N64
+#include "../pc/gfx/gfx_pc.h"
+#endif
 
 extern struct UsamuneState gUsamuneState;
 
@@ -17,6 +20,7 @@ static struct UsamuneInputDisplay sInputDisplay;
 static struct UsamuneWallkickDisplay sWallkickDisplay;
 static struct UsamuneMemoryViewer sMemoryViewer;
 static struct UsamuneDebugDisplay sDebugDisplay;
+static struct UsamuneGfxStatsDisplay sGfxStatsDisplay;
 
 void usamune_hud_extensions_init(void) {
     usamune_speed_display_init();
@@ -24,6 +28,7 @@ void usamune_hud_extensions_init(void) {
     usamune_wallkick_display_init();
     usamune_memory_viewer_init();
     usamune_debug_display_init();
+    usamune_gfx_stats_display_init();
 }
 
 void usamune_hud_extensions_update(void) {
@@ -54,6 +59,10 @@ void usamune_hud_extensions_render(void) {
     if (sDebugDisplay.enabled) {
         usamune_render_debug_display();
     }
+    
+    if (sGfxStatsDisplay.enabled) {
+        usamune_render_gfx_stats_display();
+    }
 }
 
 // ============================================================================
@@ -532,6 +541,57 @@ void usamune_debug_display_toggle_advanced(void) {
     sDebugDisplay.showAdvanced = !sDebugDisplay.showAdvanced;
 }
 
+// ============================================================================
+// RENDERER STATISTICS IMPLEMENTATION
+// ============================================================================
+
+void usamune_gfx_stats_display_init(void) {
+    sGfxStatsDisplay.enabled = FALSE;
+    sGfxStatsDisplay.posX = GFX_STATS_DISPLAY_X;
+    sGfxStatsDisplay.posY = GFX_STATS_DISPLAY_Y;
+    sGfxStatsDisplay.color = HUD_COLOR_CYAN;
+}
+
+void usamune_render_gfx_stats_display(void) {
+#ifndef TARGET_N64
+    // Counters of the last frame the renderer finished, not of the one being built
+    const struct GfxStats *stats = &gfx_frame_stats;
+    char buffer[64];
+    s16 x = sGfxStatsDisplay.posX;
+    s16 y = sGfxStatsDisplay.posY;
+    
+    sprintf(buffer, "DL %u VTX %u CHUNK %u", stats->dl_commands, stats->vertices, stats->chunks_culled);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    y -= 12;
+    sprintf(buffer, "TRI %u REJ %u CULL %u", stats->triangles, stats->triangles_clip_rejected,
+            stats->triangles_culled);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    y -= 12;
+    sprintf(buffer, "FLUSH %u SHADER %u", stats->flushes, stats->shader_switches);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    y -= 12;
+    sprintf(buffer, "HIT %u MISS %u UP %u", stats->texture_hits, stats->texture_misses,
+            stats->texture_uploads);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    y -= 12;
+    sprintf(buffer, "DL %u BACKEND %u US", stats->run_dl_us, stats->backend_us);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    y -= 12;
+    sprintf(buffer, "FRAME %u.%u MS DEV %u.%u", stats->frame_time_us / 1000, stats->frame_time_us / 100 % 10,
+            stats->frame_time_dev_us / 1000, stats->frame_time_dev_us / 100 % 10);
+    usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    if (stats->input_latency_us != 0) {
+        y -= 12;
+        sprintf(buffer, "LATENCY %u.%u MS", stats->input_latency_us / 1000, stats->input_latency_us / 100 % 10);
+        usamune_render_text_with_color(x, y, buffer, sGfxStatsDisplay.color);
+    }
+#endif
+}
+
+void usamune_gfx_stats_display_toggle(void) {
+    sGfxStatsDisplay.enabled = !sGfxStatsDisplay.enabled;
+}
+
 // ============================================================================
 // UTILITY FUNCTIONS
 // ============================================================================
@@ -612,6 +672,7 @@ void usamune_hud_toggle_all(void) {
     sWallkickDisplay.enabled = !sWallkickDisplay.enabled;
     sMemoryViewer.enabled = !sMemoryViewer.enabled;
     sDebugDisplay.enabled = !sDebugDisplay.enabled;
+    sGfxStatsDisplay.enabled = !sGfxStatsDisplay.enabled;
 }
 
 void usamune_hud_reset_to_defaults(void) {
@@ -627,6 +688,7 @@ void usamune_hud_save_config(void) {
     config->showInputDisplay = sInputDisplay.enabled;
     config->showWallkickTimer = sWallkickDisplay.enabled;
     config->showMemoryViewer = sMemoryViewer.enabled;
+    config->showGfxStats = sGfxStatsDisplay.enabled;
     config->speedDisplayFormat = sSpeedDisplay.format;
 }
 
@@ -638,5 +700,6 @@ void usamune_hud_load_config(void) {
     sInputDisplay.enabled = config->showInputDisplay;
     sWallkickDisplay.enabled = config->showWallkickTimer;
     sMemoryViewer.enabled = config->showMemoryViewer;
+    sGfxStatsDisplay.enabled = config->showGfxStats;
     sSpeedDisplay.format = config->speedDisplayFormat;
 }
\ No newline at end of file
@@ -13,6 +13,8 @@
 #define WALLKICK_DISPLAY_Y      180
 #define MEMORY_VIEWER_X         200
 #define MEMORY_VIEWER_Y         32
+#define GFX_STATS_DISPLAY_X     16
+#define GFX_STATS_DISPLAY_Y     160
 
 // Speed display formats
 #define SPEED_FORMAT_XZ         0   // Horizontal speed only
@@ -105,6 +107,12 @@ struct UsamuneDebugDisplay {
     u32 color;                  // Display color
 };
 
+struct UsamuneGfxStatsDisplay {
+    u8 enabled;
+    s16 posX, posY;             // Screen position
+    u32 color;                  // Display color
+};
+
 // Function prototypes
 void usamune_hud_extensions_init(void);
 void usamune_hud_extensions_update(void);
@@ -150,6 +158,11 @@ void usamune_render_debug_display(void);
 void usamune_debug_display_toggle_classic(void);
 void usamune_debug_display_toggle_advanced(void);
 
+// Renderer statistics functions (PC port only)
+void usamune_gfx_stats_display_init(void);
+void usamune_render_gfx_stats_display(void);
+void usamune_gfx_stats_display_toggle(void);
+
 // Utility functions
 void usamune_render_text_with_color(s16 x, s16 y, const char *text, u32 color);
 void usamune_render_button_state(s16 x, s16 y, u16 buttonMask, u16 currentButtons, const char *label);
@@ -26,6 +26,7 @@
 // HUD toggle combinations
 #define USAMUNE_SPEED_TOGGLE_DEFAULT    (L_TRIG | R_TRIG | START_BUTTON)
 #define USAMUNE_INPUT_TOGGLE_DEFAULT    (Z_TRIG | START_BUTTON)
+#define USAMUNE_GFX_STATS_TOGGLE_DEFAULT (R_TRIG | D_JPAD)
 
 // Menu combinations
 #define USAMUNE_MENU_OPEN_DEFAULT       (L_TRIG | R_TRIG | Z_TRIG)
@@ -7,6 +7,7 @@
 #include "../game/ingame_menu.h"
 #include "../game/interaction.h"
 #include "../engine/math_util.h"
+#include "hud_extensions.h"
 
 struct UsamuneState gUsamuneState;
 
@@ -48,6 +49,7 @@ void usamune_init(void) {
     config->showInputDisplay = FALSE;
     config->showWallkickTimer = FALSE;
     config->showMemoryViewer = FALSE;
+    config->showGfxStats = FALSE;
     config->speedDisplayFormat = 0; // XZ speed
     
     // Practice defaults
@@ -177,6 +179,11 @@ void usamune_process_inputs(struct Controller *controller) {
             usamune_toggle_ddd_sub();
         }
     }
+    
+    // Renderer statistics page
+    if ((controller->buttonDown & R_TRIG) && (controller->buttonPressed & D_JPAD)) {
+        usamune_gfx_stats_display_toggle();
+    }
 }
 
 void usamune_soft_reset(void) {
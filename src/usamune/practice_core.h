@@ -77,6 +77,7 @@ struct UsamuneConfig {
     u8 showInputDisplay;
     u8 showWallkickTimer;
     u8 showMemoryViewer;
+    u8 showGfxStats;            // Renderer statistics (PC port only)
     u8 speedDisplayFormat;      // 0 = XZ speed, 1 = total speed
     
     // Practice settings
@@ -0,0 +1,397 @@
+/**
+ * Standalone check of the cache of animated part rotations in
+ * rendering_graph_node.c. Every animation of a few actors is played by a group
+ * of objects that share a skeleton, spread over a few frames so that some of
+ * them are on the same frame and some are past the end of the animation. One
+ * of the objects holds another one from its second part, so the held object's
+ * animation runs in the middle of the holder's. The held object plays the
+ * same animation and then the actor's next one, going through HELD_FRAMES
+ * frames of each, which makes it take over the holder's cache entry on some
+ * of them. Each group is
+ * drawn through geo_process_root with the cache off and with it on, and every
+ * matrix written for the display lists has to have the same bits both times.
+ * Both ways are also timed.
+ *
+ * Build with `make anim-cache-check` and run
+ *   build/<version>_pc/anim_cache_check [rounds] [frames] [seed]
+ * where the objects of a group are spread over 'frames' frames, 4 by default.
+ * It exits with status 1 if a matrix differs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ultra64.h>
+#include "sm64.h"
+#include "types.h"
+#include "engine/geo_layout.h"
+#include "engine/graph_node.h"
+#include "engine/math_util.h"
+#include "engine/surface_collision.h"
+#include "game/game_init.h"
+#include "game/memory.h"
+#include "game/rendering_graph_node.h"
+#include "game/shadow.h"
+#include "pc/gfx/gfx_pc.h"
+
+#include "make_const_nonconst.h"
+#include "actors/goomba/anims/data.inc.c"
+#include "actors/goomba/anims/table.inc.c"
+#include "actors/bobomb/anims/data.inc.c"
+#include "actors/bobomb/anims/table.inc.c"
+#include "actors/koopa/anims/data.inc.c"
+#include "actors/koopa/anims/table.inc.c"
+#include "actors/bowser/anims/data.inc.c"
+#include "actors/bowser/anims/table.inc.c"
+#include "actors/king_bobomb/anims/data.inc.c"
+#include "actors/king_bobomb/anims/table.inc.c"
+#include "actors/penguin/anims/data.inc.c"
+#include "actors/penguin/anims/table.inc.c"
+
+#define DEFAULT_ROUNDS 300
+#define DEFAULT_FRAMES 4
+
+// Objects in a group, not counting the held one
+#define NUM_OBJECTS 40
+
+#define MAX_PARTS 64
+
+// Frames the held object goes through, enough for it to land on every entry of the cache
+#define HELD_FRAMES 128
+
+// Matrices a pass can write: the root, and each object with its parts
+#define MAX_MATRICES (1 + (NUM_OBJECTS + 1) * (MAX_PARTS + 1))
+
+struct AnimCheckActor {
+    const char *name;
+    const struct Animation *const *anims;
+    s32 numAnims;
+};
+
+#define ANIM_CHECK_ACTOR(name, anims) { name, anims, ARRAY_COUNT(anims) }
+
+static const struct AnimCheckActor sActors[] = {
+    ANIM_CHECK_ACTOR("goomba", goomba_seg8_anims_0801DA4C),
+    ANIM_CHECK_ACTOR("bobomb", bobomb_seg8_anims_0802396C),
+    ANIM_CHECK_ACTOR("koopa", koopa_seg6_anims_06011364),
+    ANIM_CHECK_ACTOR("bowser", bowser_seg6_anims_06057690),
+    ANIM_CHECK_ACTOR("king_bobomb", king_bobomb_seg5_anims_0500FE30),
+    ANIM_CHECK_ACTOR("penguin", penguin_seg5_anims_05008B74),
+};
+
+struct AnimCheckOutput {
+    Mtx matrices[MAX_MATRICES];
+    s32 numMatrices;
+};
+
+// The functions and data the scene graph code calls that drawing animated parts doesn't need
+Gfx *gDisplayListHeadInChunk;
+Gfx *gDisplayListEndInChunk;
+s8 gShadowAboveWaterOrLava;
+s8 gMarioOnIceOrCarpet;
+struct GfxDimensions gfx_current_dimensions = { 320, 240, 4.0f / 3.0f };
+struct GraphNode gObjParentGraphNode;
+u8 gCollisionQueryCacheEnabled;
+const char *gCollisionQueryFile;
+s32 gCollisionQueryLine;
+
+// The display list commands and the allocations that aren't matrices, overwritten every pass
+static Gfx sDisplayList[64];
+static u64 sScratch[64];
+
+static struct AnimCheckOutput *sOutput;
+
+static struct GraphNodeRoot sRoot;
+static struct GraphNodePerspective sFrustum;
+static struct GraphNodeAnimatedPart sParts[MAX_PARTS];
+static struct GraphNodeAnimatedPart sHolderParts[MAX_PARTS];
+static struct GraphNodeAnimatedPart sHeldParts[MAX_PARTS];
+static struct GraphNodeHeldObject sHeldObjectNode;
+static struct Object sObjects[NUM_OBJECTS];
+static struct Object sHeldObject;
+
+static struct AnimCheckOutput sOutputs[2];
+
+static u32 sRandomState;
+
+void *alloc_display_list(u32 size) {
+    if (size != sizeof(Mtx)) {
+        return size <= sizeof(sScratch) ? (void *) sScratch : NULL;
+    }
+    if (sOutput->numMatrices == MAX_MATRICES) {
+        fprintf(stderr, "More than %d matrices in a pass\n", MAX_MATRICES);
+        exit(2);
+    }
+    return &sOutput->matrices[sOutput->numMatrices++];
+}
+
+Gfx **alloc_next_dl(void) {
+    gDisplayListHeadInChunk = sDisplayList;
+    gDisplayListEndInChunk = sDisplayList + ARRAY_COUNT(sDisplayList);
+    return &gDisplayListHeadInChunk;
+}
+
+struct AllocOnlyPool *alloc_only_pool_init(void) {
+    return NULL;
+}
+
+void *alloc_only_pool_alloc(UNUSED struct AllocOnlyPool *pool, UNUSED s32 size) {
+    return NULL;
+}
+
+u32 main_pool_free(UNUSED void *addr) {
+    return 0;
+}
+
+void *segmented_to_virtual(const void *addr) {
+    return (void *) addr;
+}
+
+void clear_frame_buffer(UNUSED s32 color) {
+}
+
+void make_viewport_clip_rect(UNUSED Vp *viewport) {
+}
+
+Gfx *create_shadow_below_xyz(UNUSED f32 xPos, UNUSED f32 yPos, UNUSED f32 zPos, UNUSED s16 shadowScale,
+                             UNUSED u8 shadowSolidity, UNUSED s8 shadowType) {
+    return NULL;
+}
+
+void gfx_register_static_geometry(UNUSED const Gfx *dl) {
+}
+
+void guPerspective(UNUSED Mtx *m, UNUSED u16 *perspNorm, UNUSED float fovy, UNUSED float aspect,
+                   UNUSED float near, UNUSED float far, UNUSED float scale) {
+}
+
+void guOrtho(UNUSED Mtx *m, UNUSED float left, UNUSED float right, UNUSED float bottom, UNUSED float top,
+             UNUSED float near, UNUSED float far, UNUSED float scale) {
+}
+
+void guLookAtReflect(UNUSED Mtx *m, UNUSED LookAt *l, UNUSED float xEye, UNUSED float yEye,
+                     UNUSED float zEye, UNUSED float xAt, UNUSED float yAt, UNUSED float zAt,
+                     UNUSED float xUp, UNUSED float yUp, UNUSED float zUp) {
+}
+
+#undef find_floor
+f32 find_floor(UNUSED f32 xPos, UNUSED f32 yPos, UNUSED f32 zPos, struct Surface **pfloor) {
+    *pfloor = NULL;
+    return -11000.0f;
+}
+
+static u32 check_random(void) {
+    sRandomState ^= sRandomState << 13;
+    sRandomState ^= sRandomState >> 17;
+    sRandomState ^= sRandomState << 5;
+    return sRandomState;
+}
+
+/**
+ * Build a skeleton of animated parts, each part the child of the one at half
+ * its index. The held object node, if any, is the first child of the second
+ * part, so the holder has parts left to draw after it.
+ */
+static void build_skeleton(struct GraphNodeAnimatedPart *parts, s32 numParts,
+                           struct GraphNodeHeldObject *heldObjectNode) {
+    Vec3s translation;
+    s32 i;
+
+    for (i = 0; i < numParts; i++) {
+        vec3s_set(translation, i * 13 % 97 - 48, i * 7 % 61, -(i * 5 % 43));
+        init_graph_node_animated_part(NULL, &parts[i], LAYER_OPAQUE, NULL, translation);
+        if (i > 0) {
+            geo_add_child(&parts[(i - 1) / 2].node, &parts[i].node);
+        }
+        if (heldObjectNode != NULL && i == MIN(1, numParts - 1)) {
+            geo_add_child(&parts[i].node, &heldObjectNode->fnNode.node);
+        }
+    }
+}
+
+static void init_object(struct Object *obj, struct GraphNode *skeleton, struct Animation *anim, s16 frame) {
+    Vec3f pos;
+    Vec3s angle;
+    Vec3f scale;
+
+    vec3f_set(pos, (f32)(check_random() % 1000) - 500.0f, (f32)(check_random() % 400) - 200.0f, -3000.0f);
+    vec3s_set(angle, 0, (s16) check_random(), 0);
+    vec3f_set(scale, 1.0f, 1.0f, 1.0f);
+
+    memset(obj, 0, sizeof(*obj));
+    init_graph_node_object(NULL, &obj->header.gfx, skeleton, pos, angle, scale);
+    // The frames are set here, not advanced while drawing
+    obj->header.gfx.node.flags &= ~GRAPH_RENDER_HAS_ANIMATION;
+    obj->header.gfx.animInfo.curAnim = anim;
+    obj->header.gfx.animInfo.animFrame = frame;
+    obj->header.gfx.animInfo.animYTrans = check_random() % 200;
+}
+
+/**
+ * Return an animation of an actor, or NULL if the check can't play it.
+ */
+static struct Animation *get_actor_anim(const struct AnimCheckActor *actor, s32 index) {
+    struct Animation *anim = (struct Animation *) actor->anims[index];
+
+    if (anim == NULL || anim->unusedBoneCount <= 0 || anim->unusedBoneCount > MAX_PARTS) {
+        return NULL;
+    }
+    return anim;
+}
+
+static void set_held_object(struct Animation *heldAnim) {
+    build_skeleton(sHeldParts, heldAnim->unusedBoneCount, NULL);
+    init_object(&sHeldObject, &sHeldParts[0].node, heldAnim, 0);
+}
+
+/**
+ * Set up the group of objects playing an animation. The object one of them
+ * holds is set up by count_differences.
+ */
+static void init_group(struct Animation *anim, s32 frames) {
+    Vec3s translation;
+    s16 frame;
+    s32 i;
+
+    init_graph_node_root(NULL, &sRoot, 0, 0, 0, 320, 240);
+    vec3s_set(translation, 40, 0, 0);
+    init_graph_node_held_object(NULL, &sHeldObjectNode, &sHeldObject, translation, NULL, 0);
+    build_skeleton(sParts, anim->unusedBoneCount, NULL);
+    build_skeleton(sHolderParts, anim->unusedBoneCount, &sHeldObjectNode);
+
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        // One in three is past the end, where every part holds its last value
+        frame = check_random() % frames + (check_random() % 3 == 0 ? anim->loopEnd + 5 : 0);
+        init_object(&sObjects[i], i == 0 ? &sHolderParts[0].node : &sParts[0].node, anim, frame);
+        geo_add_child(&sRoot.node, &sObjects[i].header.gfx.node);
+    }
+}
+
+static void draw_group(struct AnimCheckOutput *out) {
+    sOutput = out;
+    out->numMatrices = 0;
+    alloc_next_dl();
+    gCurGraphNodeCamFrustum = &sFrustum;
+    geo_process_root(&sRoot, NULL, NULL, 0);
+}
+
+/**
+ * Time drawing the group, returning the seconds it took.
+ */
+static f64 time_group(s32 cache, s32 rounds) {
+    clock_t start;
+    s32 i;
+
+    set_animation_cache(cache);
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        draw_group(&sOutputs[cache]);
+    }
+
+    return (f64)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static f64 objects_per_second(s32 numAnims, s32 rounds, f64 seconds) {
+    return seconds > 0.0 ? (f64) numAnims * (NUM_OBJECTS + 1) * rounds / seconds : 0.0;
+}
+
+/**
+ * Draw the group with the cache off and on, with the held object playing
+ * 'heldAnim' on each of HELD_FRAMES frames. Returns the matrices that differ,
+ * adding the ones compared to 'numMatrices'.
+ */
+static s32 count_differences(struct Animation *heldAnim, s32 *numMatrices) {
+    s32 differences = 0;
+    s32 frame;
+    s32 i;
+
+    set_held_object(heldAnim);
+    for (frame = 0; frame < HELD_FRAMES; frame++) {
+        sHeldObject.header.gfx.animInfo.animFrame = frame;
+        set_animation_cache(FALSE);
+        draw_group(&sOutputs[0]);
+        set_animation_cache(TRUE);
+        draw_group(&sOutputs[1]);
+
+        *numMatrices += sOutputs[0].numMatrices;
+        if (sOutputs[0].numMatrices != sOutputs[1].numMatrices) {
+            differences += MAX(sOutputs[0].numMatrices, sOutputs[1].numMatrices);
+            continue;
+        }
+        for (i = 0; i < sOutputs[0].numMatrices; i++) {
+            differences += memcmp(&sOutputs[0].matrices[i], &sOutputs[1].matrices[i], sizeof(Mtx)) != 0;
+        }
+    }
+
+    return differences;
+}
+
+int main(int argc, char *argv[]) {
+    s32 rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    s32 frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+    u32 seed = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+    s32 totalAnims = 0;
+    s32 totalMatrices = 0;
+    s32 totalDifferences = 0;
+    s32 numAnims, numMatrices, differences;
+    f64 seconds[2];
+    f64 totalSeconds[2] = { 0.0, 0.0 };
+    struct Animation *anim;
+    struct Animation *heldAnim;
+    s32 actor, i, j;
+
+    if (rounds <= 0 || frames <= 0) {
+        fprintf(stderr, "usage: %s [rounds] [frames] [seed]\n", argv[0]);
+        return 2;
+    }
+    sRandomState = seed != 0 ? seed : 1;
+    sFrustum.fov = 45.0f;
+
+    printf("%-12s %6s %10s %14s %14s %8s\n", "actor", "anims", "matrices", "off objs/s", "on objs/s",
+           "diffs");
+
+    for (actor = 0; actor < (s32) ARRAY_COUNT(sActors); actor++) {
+        numAnims = 0;
+        numMatrices = 0;
+        differences = 0;
+        seconds[0] = 0.0;
+        seconds[1] = 0.0;
+
+        for (i = 0; i < sActors[actor].numAnims; i++) {
+            anim = get_actor_anim(&sActors[actor], i);
+            if (anim == NULL) {
+                continue;
+            }
+            // The next animation the check can play, this one if there is no other
+            heldAnim = NULL;
+            for (j = 1; heldAnim == NULL; j++) {
+                heldAnim = get_actor_anim(&sActors[actor], (i + j) % sActors[actor].numAnims);
+            }
+
+            init_group(anim, frames);
+            differences += count_differences(anim, &numMatrices);
+            differences += count_differences(heldAnim, &numMatrices);
+            numAnims++;
+
+            seconds[0] += time_group(FALSE, rounds);
+            seconds[1] += time_group(TRUE, rounds);
+        }
+        set_animation_cache(FALSE);
+
+        printf("%-12s %6d %10d %14.0f %14.0f %8d\n", sActors[actor].name, numAnims, numMatrices,
+               objects_per_second(numAnims, rounds, seconds[0]), objects_per_second(numAnims, rounds, seconds[1]),
+               differences);
+        totalAnims += numAnims;
+        totalMatrices += numMatrices;
+        totalDifferences += differences;
+        totalSeconds[0] += seconds[0];
+        totalSeconds[1] += seconds[1];
+    }
+
+    printf("%d animations, %d matrices, %d differ, %d rounds over %d frames: cache off %.3fs, on %.3fs\n",
+           totalAnims, totalMatrices, totalDifferences, rounds, frames, totalSeconds[0], totalSeconds[1]);
+
+    return totalDifferences != 0;
+}
@@ -0,0 +1,350 @@
+/**
+ * Standalone benchmark for the behavior script interpreter. The objects each
+ * level places through its level script and macro object lists are run
+ * through cur_obj_update for a number of frames, once with the command table
+ * and once with the pre-decoded scripts, and timed. A third pass runs both
+ * side by side and compares every byte of every object after each frame.
+ *
+ * The native functions the scripts call are empty, so the time is spent in
+ * the interpreter itself. Each frame a few objects are sent back to the start
+ * of their script and deactivated objects are respawned, which keeps the
+ * commands that only run once per object in the mix.
+ *
+ * Build with `make behavior-bench` and run
+ *   build/<version>_pc/behavior_bench [frames per level] [seed]
+ * It exits with status 1 if the two ways of running a script disagree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Included rather than linked, to reset its random seed between passes
+#include "engine/behavior_script.c"
+
+#include "macro_presets.h"
+
+#define DEFAULT_FRAMES_PER_LEVEL 10000
+
+// One in this many objects goes back to the start of its script each frame
+#define RESTART_CHANCE 64
+
+// Each way of running the scripts is timed this many times, taking the fastest
+#define TIMED_PASSES 3
+
+struct BenchObject {
+    const char *level;
+    const BehaviorScript *behavior;
+    s32 macroPreset;
+};
+
+#define BENCH_OBJECT(level, behavior) { #level, behavior, -1 },
+#define BENCH_MACRO_OBJECT(level, preset) { #level, NULL, preset },
+
+static const struct BenchObject sBenchObjects[] = {
+#include "behavior_bench_objects.inc.c"
+};
+
+/**************************************************
+ *                 GAME STATE STUBS               *
+ **************************************************/
+
+// The decoded scripts run the objects from the pool, like the game does
+struct Object gObjectPool[OBJECT_POOL_CAPACITY];
+
+const BehaviorScript *gCurBhvCommand;
+struct Object *gCurrentObject;
+struct Object *gMarioObject;
+u32 gGlobalTimer;
+u8 gCollisionQueryCacheEnabled;
+const char *gCollisionQueryFile;
+s32 gCollisionQueryLine;
+
+static struct GraphNode *sBenchGraphNodes[0x100];
+struct GraphNode **gLoadedGraphNodes = sBenchGraphNodes;
+
+static struct Object sBenchMario;
+static struct Object sBenchParent;
+
+// Where spawned objects go, they aren't run
+static struct Object sBenchSpawned;
+
+void *segmented_to_virtual(const void *addr) {
+    return (void *) addr;
+}
+
+void cur_obj_hide(void) {
+    gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_INVISIBLE;
+}
+
+void cur_obj_scale(f32 scale) {
+    gCurrentObject->header.gfx.scale[0] = scale;
+    gCurrentObject->header.gfx.scale[1] = scale;
+    gCurrentObject->header.gfx.scale[2] = scale;
+}
+
+s32 cur_obj_has_behavior(const BehaviorScript *behavior) {
+    return gCurrentObject->behavior == behavior;
+}
+
+f32 dist_between_objects(struct Object *obj1, struct Object *obj2) {
+    f32 dx = obj1->oPosX - obj2->oPosX;
+    f32 dy = obj1->oPosY - obj2->oPosY;
+    f32 dz = obj1->oPosZ - obj2->oPosZ;
+
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+s16 obj_angle_to_object(UNUSED struct Object *obj1, UNUSED struct Object *obj2) {
+    return 0;
+}
+
+void obj_copy_pos_and_angle(struct Object *dst, struct Object *src) {
+    dst->oPosX = src->oPosX;
+    dst->oPosY = src->oPosY;
+    dst->oPosZ = src->oPosZ;
+    dst->oFaceAnglePitch = src->oFaceAnglePitch;
+    dst->oFaceAngleYaw = src->oFaceAngleYaw;
+    dst->oFaceAngleRoll = src->oFaceAngleRoll;
+}
+
+struct Object *spawn_object_at_origin(UNUSED struct Object *parent, UNUSED s32 unusedArg, UNUSED u32 model,
+                                      UNUSED const BehaviorScript *behavior) {
+    return &sBenchSpawned;
+}
+
+struct Object *spawn_water_droplet(UNUSED struct Object *parent, UNUSED struct WaterDropletParams *params) {
+    return &sBenchSpawned;
+}
+
+f32 (find_floor_height)(UNUSED f32 x, UNUSED f32 y, UNUSED f32 z) {
+    return 0.0f;
+}
+
+void geo_obj_init_animation(UNUSED struct GraphNodeObject *graphNode, UNUSED struct Animation **animPtrAddr) {
+}
+
+void obj_set_face_angle_to_move_angle(UNUSED struct Object *obj) {
+}
+
+void cur_obj_move_xz_using_fvel_and_yaw(void) {
+}
+
+void cur_obj_move_y_with_terminal_vel(void) {
+}
+
+void obj_build_transform_relative_to_parent(UNUSED struct Object *obj) {
+}
+
+void obj_set_throw_matrix_from_transform(UNUSED struct Object *obj) {
+}
+
+void cur_obj_enable_rendering_if_mario_in_room(void) {
+}
+
+/**************************************************
+ *                    BENCHMARK                   *
+ **************************************************/
+
+static u32 sRandomState;
+
+static u32 bench_random(void) {
+    // xorshift32, so the restarts are the same on every platform
+    sRandomState ^= sRandomState << 13;
+    sRandomState ^= sRandomState >> 17;
+    sRandomState ^= sRandomState << 5;
+    return sRandomState;
+}
+
+static const BehaviorScript *get_bench_object_behavior(const struct BenchObject *benchObj) {
+    if (benchObj->behavior != NULL) {
+        return benchObj->behavior;
+    }
+    return MacroObjectPresets[benchObj->macroPreset].behavior;
+}
+
+/**
+ * Set up an object the way spawning it would, spread around the level so the
+ * distance to Mario varies.
+ */
+static void init_bench_object(struct Object *obj, const BehaviorScript *behavior, s32 index) {
+    memset(obj, 0, sizeof(struct Object));
+    obj->activeFlags = ACTIVE_FLAG_ACTIVE;
+    obj->parentObj = &sBenchParent;
+    obj->behavior = behavior;
+    obj->curBhvCommand = behavior;
+    obj->hitboxRadius = 50.0f;
+    obj->hitboxHeight = 100.0f;
+    obj->oRoom = -1;
+    obj->oPosX = (f32)((index * 733) % 8000 - 4000);
+    obj->oPosZ = (f32)((index * 1471) % 8000 - 4000);
+    obj->oDrawingDistance = 4000.0f;
+}
+
+/**
+ * Run one frame of the objects' scripts, after restarting some of them.
+ */
+static void run_bench_frame(struct Object *objects, const BehaviorScript **behaviors, s32 numObjects) {
+    s32 i;
+
+    for (i = 0; i < numObjects; i++) {
+        if (objects[i].activeFlags == ACTIVE_FLAG_DEACTIVATED) {
+            init_bench_object(&objects[i], behaviors[i], i);
+        } else if (bench_random() % RESTART_CHANCE == 0) {
+            objects[i].curBhvCommand = behaviors[i];
+            objects[i].bhvStackIndex = 0;
+        }
+    }
+
+    for (i = 0; i < numObjects; i++) {
+        gCurrentObject = &objects[i];
+        cur_obj_update();
+    }
+    gGlobalTimer++;
+}
+
+static void reset_bench_state(struct Object *objects, const BehaviorScript **behaviors, s32 numObjects, u32 seed) {
+    s32 i;
+
+    for (i = 0; i < numObjects; i++) {
+        init_bench_object(&objects[i], behaviors[i], i);
+    }
+    sRandomState = seed;
+    gRandomSeed16 = 0;
+    gGlobalTimer = 0;
+}
+
+/**
+ * Time the frames with one way of running the scripts, returning the object
+ * updates per second.
+ */
+static f64 time_frames(struct Object *objects, const BehaviorScript **behaviors, s32 numObjects,
+                       s32 numFrames, u32 seed, s32 decoded) {
+    clock_t start;
+    f64 seconds;
+    s32 i;
+
+    set_behavior_script_decoding(decoded);
+    reset_bench_state(objects, behaviors, numObjects, seed);
+
+    start = clock();
+    for (i = 0; i < numFrames; i++) {
+        run_bench_frame(objects, behaviors, numObjects);
+    }
+    seconds = (f64)(clock() - start) / CLOCKS_PER_SEC;
+
+    return seconds > 0.0 ? (f64) numObjects * numFrames / seconds : 0.0;
+}
+
+/**
+ * Run the frames both ways side by side and count the frames after which an
+ * object or the random seed differs.
+ */
+static s32 verify_frames(const char *level, struct Object *expected, struct Object *actual,
+                         const BehaviorScript **behaviors, s32 numObjects, s32 numFrames, u32 seed) {
+    u16 randomSeed;
+    u16 expectedSeed;
+    u32 restartState;
+    s32 mismatches = 0;
+    s32 i, j;
+
+    reset_bench_state(expected, behaviors, numObjects, seed);
+    reset_bench_state(actual, behaviors, numObjects, seed);
+
+    for (i = 0; i < numFrames; i++) {
+        restartState = sRandomState;
+        randomSeed = gRandomSeed16;
+        set_behavior_script_decoding(FALSE);
+        run_bench_frame(expected, behaviors, numObjects);
+        expectedSeed = gRandomSeed16;
+
+        sRandomState = restartState;
+        gRandomSeed16 = randomSeed;
+        gGlobalTimer--;
+        set_behavior_script_decoding(TRUE);
+        run_bench_frame(actual, behaviors, numObjects);
+
+        if (gRandomSeed16 != expectedSeed || memcmp(expected, actual, numObjects * sizeof(struct Object)) != 0) {
+            for (j = 0; j < numObjects; j++) {
+                if (memcmp(&expected[j], &actual[j], sizeof(struct Object)) != 0) {
+                    break;
+                }
+            }
+            if (mismatches++ < 10) {
+                fprintf(stderr, "%s: frame %d differs from the command table (object %d)\n", level, i, j);
+            }
+            // Carry on from the same state
+            memcpy(actual, expected, numObjects * sizeof(struct Object));
+            gRandomSeed16 = expectedSeed;
+        }
+    }
+
+    set_behavior_script_decoding(FALSE);
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    static struct Object expected[OBJECT_POOL_CAPACITY];
+    struct Object *actual = gObjectPool;
+    static const BehaviorScript *behaviors[OBJECT_POOL_CAPACITY];
+    s32 framesPerLevel = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES_PER_LEVEL;
+    u32 seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    f64 totalUps[2] = { 0.0, 0.0 };
+    s32 totalMismatches = 0;
+    s32 numLevels = 0;
+    s32 numObjects;
+    s32 mismatches;
+    f64 ups[2];
+    f64 passUps;
+    s32 pass;
+    s32 i, j;
+
+    if (framesPerLevel <= 0) {
+        fprintf(stderr, "usage: %s [frames per level] [seed]\n", argv[0]);
+        return 2;
+    }
+    if (seed == 0) {
+        seed = 1;
+    }
+
+    gMarioObject = &sBenchMario;
+
+    printf("%-18s %8s %16s %16s %10s\n", "level", "objects", "table updates/s", "decoded updates/s",
+           "mismatches");
+
+    for (i = 0; i < ARRAY_COUNT(sBenchObjects); i = j) {
+        numObjects = 0;
+        for (j = i; j < ARRAY_COUNT(sBenchObjects) && !strcmp(sBenchObjects[j].level, sBenchObjects[i].level);
+             j++) {
+            if (numObjects < OBJECT_POOL_CAPACITY) {
+                behaviors[numObjects++] = get_bench_object_behavior(&sBenchObjects[j]);
+            }
+        }
+
+        ups[0] = ups[1] = 0.0;
+        for (pass = 0; pass < TIMED_PASSES; pass++) {
+            passUps = time_frames(expected, behaviors, numObjects, framesPerLevel, seed, FALSE);
+            ups[0] = MAX(ups[0], passUps);
+            passUps = time_frames(actual, behaviors, numObjects, framesPerLevel, seed, TRUE);
+            ups[1] = MAX(ups[1], passUps);
+        }
+        mismatches = verify_frames(sBenchObjects[i].level, expected, actual, behaviors, numObjects,
+                                   framesPerLevel, seed);
+
+        printf("%-18s %8d %16.0f %16.0f %10d\n", sBenchObjects[i].level, numObjects, ups[0], ups[1],
+               mismatches);
+
+        totalUps[0] += ups[0];
+        totalUps[1] += ups[1];
+        totalMismatches += mismatches;
+        numLevels++;
+    }
+
+    printf("%-18s %8s %16.0f %16.0f %10d\n", "mean", "", totalUps[0] / numLevels, totalUps[1] / numLevels,
+           totalMismatches);
+    printf("%d frames per level, %u commands decoded\n", framesPerLevel, sBhvDecodedCount);
+
+    return totalMismatches != 0;
+}
@@ -0,0 +1,1240 @@
+/**
+ * Standalone benchmark for the collision queries. Every area's collision data
+ * is loaded through load_area_terrain without the rest of the game, then a
+ * stream of randomized and replayed find_floor, find_ceil,
+ * find_wall_collisions and find_water_level queries is timed with the query
+ * cache off and on. Each result is also checked, down to the bits of every
+ * float, against the game's own queries built without the SIMD surface lists
+ * in collision_bench_reference.c.
+ *
+ * Each area also gets platform objects that load their collision through
+ * load_object_collision_model every frame, some moving and most standing
+ * still. Their loads are timed with the object surface cache off and on, and
+ * the queries must find the same surfaces either way.
+ *
+ * Instead of the random stream, the bench can replay a collision trace the
+ * game writes with collision_trace = true in its config, made of the areas,
+ * object loads and queries of a play session (see collision_trace.h). It can
+ * also write its own stream as a trace, which replays to the same checksum.
+ *
+ * Build with `make collision-bench` and run
+ *   build/<version>_pc/collision_bench [-r trace] [queries per area] [seed]
+ *   build/<version>_pc/collision_bench -t trace
+ * It exits with status 1 if any query disagrees with the reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ultra64.h>
+#include "sm64.h"
+#include "types.h"
+#include "surface_terrains.h"
+#include "level_table.h"
+#include "level_misc_macros.h"
+#include "special_preset_names.h"
+#include "special_presets.h"
+#include "engine/collision_trace.h"
+#include "engine/surface_collision.h"
+#include "engine/surface_load.h"
+#include "game/macro_special_objects.h"
+#include "game/memory.h"
+#include "game/object_list_processor.h"
+
+#include "levels/bbh/areas/1/collision.inc.c"
+#include "levels/bitdw/areas/1/collision.inc.c"
+#include "levels/bitfs/areas/1/collision.inc.c"
+#include "levels/bits/areas/1/collision.inc.c"
+#include "levels/bob/areas/1/collision.inc.c"
+#include "levels/bowser_1/areas/1/collision.inc.c"
+#include "levels/bowser_2/areas/1/collision.inc.c"
+#include "levels/bowser_3/areas/1/collision.inc.c"
+#include "levels/castle_courtyard/areas/1/collision.inc.c"
+#include "levels/castle_grounds/areas/1/collision.inc.c"
+#include "levels/castle_inside/areas/1/collision.inc.c"
+#include "levels/castle_inside/areas/2/collision.inc.c"
+#include "levels/castle_inside/areas/3/collision.inc.c"
+#include "levels/ccm/areas/1/collision.inc.c"
+#include "levels/ccm/areas/2/collision.inc.c"
+#include "levels/cotmc/areas/1/collision.inc.c"
+#include "levels/ddd/areas/1/collision.inc.c"
+#include "levels/ddd/areas/2/collision.inc.c"
+#include "levels/hmc/areas/1/collision.inc.c"
+#include "levels/jrb/areas/1/collision.inc.c"
+#include "levels/jrb/areas/2/collision.inc.c"
+#include "levels/lll/areas/1/collision.inc.c"
+#include "levels/lll/areas/2/collision.inc.c"
+#include "levels/pss/areas/1/collision.inc.c"
+#include "levels/rr/areas/1/collision.inc.c"
+#include "levels/sa/areas/1/collision.inc.c"
+#include "levels/sl/areas/1/collision.inc.c"
+#include "levels/sl/areas/2/collision.inc.c"
+#include "levels/ssl/areas/1/collision.inc.c"
+#include "levels/ssl/areas/2/collision.inc.c"
+#include "levels/ssl/areas/3/collision.inc.c"
+#include "levels/thi/areas/1/collision.inc.c"
+#include "levels/thi/areas/2/collision.inc.c"
+#include "levels/thi/areas/3/collision.inc.c"
+#include "levels/totwc/areas/1/collision.inc.c"
+#include "levels/ttc/areas/1/collision.inc.c"
+#include "levels/ttm/areas/1/collision.inc.c"
+#include "levels/ttm/areas/2/collision.inc.c"
+#include "levels/ttm/areas/3/collision.inc.c"
+#include "levels/ttm/areas/4/collision.inc.c"
+#include "levels/vcutm/areas/1/collision.inc.c"
+#include "levels/wdw/areas/1/collision.inc.c"
+#include "levels/wdw/areas/2/collision.inc.c"
+#include "levels/wf/areas/1/collision.inc.c"
+#include "levels/wmotr/areas/1/collision.inc.c"
+
+#include "actors/breakable_box/collision.inc.c"
+#include "actors/checkerboard_platform/collision.inc.c"
+#include "actors/exclamation_box_outline/collision.inc.c"
+#include "levels/bitfs/elevator/collision.inc.c"
+#include "levels/bitfs/sinking_platforms/collision.inc.c"
+#include "levels/bitfs/tilting_square_platform/collision.inc.c"
+#include "levels/rr/flying_carpet/collision.inc.c"
+#include "levels/rr/octagonal_platform/collision.inc.c"
+#include "levels/rr/sliding_platform/collision.inc.c"
+#include "levels/ttc/elevator_platform/collision.inc.c"
+#include "levels/ttc/large_treadmill/collision.inc.c"
+#include "levels/ttc/rotating_cube/collision.inc.c"
+
+// Behaviors referenced by SpecialObjectPresets, generated by the Makefile
+#include "collision_bench_behaviors.inc.c"
+
+#define DEFAULT_QUERIES_PER_AREA 200000
+
+// The game clears the dynamic partition once per frame, which also
+// invalidates the query cache. Do the same every this many queries.
+#define QUERIES_PER_FRAME 96
+
+// Platform objects per area, loading their collision between the queries of
+// a frame. QUERIES_PER_FRAME is a multiple of it.
+#define NUM_BENCH_OBJECTS 16
+
+// One in four objects moves every frame and one in four every this many frames
+#define OBJECT_MOVE_PERIOD 8
+
+struct BenchArea {
+    const char *name;
+    s16 level;
+    s16 area;
+    const Collision *data;
+};
+
+static const struct BenchArea sBenchAreas[] = {
+    { "bbh", LEVEL_BBH, 1, bbh_seg7_collision_level },
+    { "bitdw", LEVEL_BITDW, 1, bitdw_seg7_collision_level },
+    { "bitfs", LEVEL_BITFS, 1, bitfs_seg7_collision_level },
+    { "bits", LEVEL_BITS, 1, bits_seg7_collision_level },
+    { "bob", LEVEL_BOB, 1, bob_seg7_collision_level },
+    { "bowser_1", LEVEL_BOWSER_1, 1, bowser_1_seg7_collision_level },
+    { "bowser_2", LEVEL_BOWSER_2, 1, bowser_2_seg7_collision_lava },
+    { "bowser_3", LEVEL_BOWSER_3, 1, bowser_3_seg7_collision_level },
+    { "castle_courtyard", LEVEL_CASTLE_COURTYARD, 1, castle_courtyard_seg7_collision },
+    { "castle_grounds", LEVEL_CASTLE_GROUNDS, 1, castle_grounds_seg7_collision_level },
+    { "castle_inside 1", LEVEL_CASTLE, 1, inside_castle_seg7_area_1_collision },
+    { "castle_inside 2", LEVEL_CASTLE, 2, inside_castle_seg7_area_2_collision },
+    { "castle_inside 3", LEVEL_CASTLE, 3, inside_castle_seg7_area_3_collision },
+    { "ccm 1", LEVEL_CCM, 1, ccm_seg7_area_1_collision },
+    { "ccm 2", LEVEL_CCM, 2, ccm_seg7_area_2_collision },
+    { "cotmc", LEVEL_COTMC, 1, cotmc_seg7_collision_level },
+    { "ddd 1", LEVEL_DDD, 1, ddd_seg7_area_1_collision },
+    { "ddd 2", LEVEL_DDD, 2, ddd_seg7_area_2_collision },
+    { "hmc", LEVEL_HMC, 1, hmc_seg7_collision_level },
+    { "jrb 1", LEVEL_JRB, 1, jrb_seg7_area_1_collision },
+    { "jrb 2", LEVEL_JRB, 2, jrb_seg7_area_2_collision },
+    { "lll 1", LEVEL_LLL, 1, lll_seg7_area_1_collision },
+    { "lll 2", LEVEL_LLL, 2, lll_seg7_area_2_collision },
+    { "pss", LEVEL_PSS, 1, pss_seg7_collision },
+    { "rr", LEVEL_RR, 1, rr_seg7_collision_level },
+    { "sa", LEVEL_SA, 1, sa_seg7_collision },
+    { "sl 1", LEVEL_SL, 1, sl_seg7_area_1_collision },
+    { "sl 2", LEVEL_SL, 2, sl_seg7_area_2_collision },
+    { "ssl 1", LEVEL_SSL, 1, ssl_seg7_area_1_collision },
+    { "ssl 2", LEVEL_SSL, 2, ssl_seg7_area_2_collision },
+    { "ssl 3", LEVEL_SSL, 3, ssl_seg7_area_3_collision },
+    { "thi 1", LEVEL_THI, 1, thi_seg7_area_1_collision },
+    { "thi 2", LEVEL_THI, 2, thi_seg7_area_2_collision },
+    { "thi 3", LEVEL_THI, 3, thi_seg7_area_3_collision },
+    { "totwc", LEVEL_TOTWC, 1, totwc_seg7_collision },
+    { "ttc", LEVEL_TTC, 1, ttc_seg7_collision_level },
+    { "ttm 1", LEVEL_TTM, 1, ttm_seg7_area_1_collision },
+    { "ttm 2", LEVEL_TTM, 2, ttm_seg7_area_2_collision },
+    { "ttm 3", LEVEL_TTM, 3, ttm_seg7_area_3_collision },
+    { "ttm 4", LEVEL_TTM, 4, ttm_seg7_area_4_collision },
+    { "vcutm", LEVEL_VCUTM, 1, vcutm_seg7_collision },
+    { "wdw 1", LEVEL_WDW, 1, wdw_seg7_area_1_collision },
+    { "wdw 2", LEVEL_WDW, 2, wdw_seg7_area_2_collision },
+    { "wf", LEVEL_WF, 1, wf_seg7_collision_070102D8 },
+    { "wmotr", LEVEL_WMOTR, 1, wmotr_seg7_collision },
+};
+
+static const Collision *const sBenchObjectModels[] = {
+    breakable_box_seg8_collision_08012D70,
+    checkerboard_platform_seg8_collision_0800D710,
+    exclamation_box_outline_seg8_collision_08025F78,
+    bitfs_seg7_collision_07015124,
+    bitfs_seg7_collision_sinking_platform,
+    bitfs_seg7_collision_inverted_pyramid,
+    rr_seg7_collision_07029038,
+    rr_seg7_collision_07029508,
+    rr_seg7_collision_070295F8,
+    ttc_seg7_collision_clock_platform,
+    ttc_seg7_collision_070152B4,
+    ttc_seg7_collision_07014F70,
+};
+
+/**************************************************
+ *                 GAME STATE STUBS               *
+ **************************************************/
+
+struct Object gObjectPool[OBJECT_POOL_CAPACITY];
+struct Object *gCurrentObject;
+struct Object *gMarioObject;
+struct MarioState *gMarioState;
+struct NumTimesCalled gNumCalls;
+s32 gNumFindFloorMisses;
+s32 gSurfaceNodesAllocated;
+s32 gSurfacesAllocated;
+s32 gNumStaticSurfaceNodes;
+s32 gNumStaticSurfaces;
+s16 gCheckingSurfaceCollisionsForCamera;
+s16 gFindFloorIncludeSurfaceIntangible;
+s16 *gEnvironmentRegions;
+s32 gEnvironmentLevels[20];
+u32 gTimeStopState;
+s16 gCCMEnteredSlide;
+s16 gCurrLevelNum;
+struct AllocOnlyPool *gGfxAllocOnlyPool;
+
+void wait_for_display_list(void) {
+}
+
+void reset_red_coins_collected(void) {
+}
+
+void set_text_array_x_y(UNUSED s32 xOffset, UNUSED s32 yOffset) {
+}
+
+void print_debug_top_down_mapinfo(UNUSED const char *str, UNUSED s32 number) {
+}
+
+f32 dist_between_objects(UNUSED struct Object *obj1, UNUSED struct Object *obj2) {
+    return 0.0f;
+}
+
+void obj_apply_scale_to_matrix(struct Object *obj, Mat4 dst, Mat4 src) {
+    s32 i;
+
+    for (i = 0; i < 3; i++) {
+        dst[0][i] = src[0][i] * obj->header.gfx.scale[0];
+        dst[1][i] = src[1][i] * obj->header.gfx.scale[1];
+        dst[2][i] = src[2][i] * obj->header.gfx.scale[2];
+        dst[3][i] = src[3][i];
+    }
+    for (i = 0; i < 4; i++) {
+        dst[i][3] = src[i][3];
+    }
+}
+
+void obj_build_transform_from_pos_and_angle(UNUSED struct Object *obj, UNUSED s16 posIndex,
+                                            UNUSED s16 angleIndex) {
+}
+
+void spawn_macro_objects(UNUSED s16 areaIndex, UNUSED s16 *macroObjList) {
+}
+
+void spawn_macro_objects_hardcoded(UNUSED s16 areaIndex, UNUSED s16 *macroObjList) {
+}
+
+/**
+ * Skip over the special objects without spawning them.
+ */
+void spawn_special_objects(UNUSED s16 areaIndex, s16 **specialObjList) {
+    *specialObjList += get_special_objects_size(*specialObjList);
+}
+
+u32 get_special_objects_size(s16 *data) {
+    s16 *startPos = data;
+    s32 numOfSpecialObjects = *data++;
+    s32 i;
+    s32 offset;
+    u8 presetID;
+
+    for (i = 0; i < numOfSpecialObjects; i++) {
+        presetID = (u8) *data++;
+        data += 3;
+
+        for (offset = 0; SpecialObjectPresets[offset].preset_id != presetID; offset++) {
+        }
+
+        switch (SpecialObjectPresets[offset].type) {
+            case SPTYPE_YROT_NO_PARAMS:
+            case SPTYPE_DEF_PARAM_AND_YROT:
+                data++;
+                break;
+            case SPTYPE_PARAMS_AND_YROT:
+                data += 2;
+                break;
+            case SPTYPE_UNKNOWN:
+                data += 3;
+                break;
+        }
+    }
+
+    return data - startPos;
+}
+
+/**************************************************
+ *                    REFERENCE                   *
+ **************************************************/
+
+// The game's queries without the SIMD surface lists, from collision_bench_reference.c
+f32 ref_find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor);
+f32 ref_find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil);
+s32 ref_find_wall_collisions(struct WallCollisionData *colData);
+f32 ref_find_water_level(f32 x, f32 z);
+
+/**************************************************
+ *                     QUERIES                    *
+ **************************************************/
+
+enum BenchQueryType {
+    BENCH_FLOOR,
+    BENCH_CEIL,
+    BENCH_WALLS,
+    BENCH_WATER
+};
+
+struct BenchQuery {
+    u8 type;
+    u8 camera;
+    u8 intangible;
+    f32 x, y, z;
+    f32 offsetY;
+    f32 radius;
+};
+
+enum BenchEventType {
+    EVENT_FRAME,
+    EVENT_OBJECT,
+    EVENT_QUERY
+};
+
+/**
+ * One step of a stream: a frame starting, an object loading its collision
+ * with a transform, or a query.
+ */
+struct BenchEvent {
+    u8 type;
+    s16 slot; // the object's index in gObjectPool, -1 if it isn't in it
+    s16 *model;
+    Mat4 transform;
+    struct BenchQuery query;
+};
+
+/**
+ * The stream of one area, made up by the bench or read from a trace.
+ */
+struct BenchSegment {
+    const struct BenchArea *area;
+    struct BenchEvent *events;
+    s32 numEvents;
+    s32 capacity;
+    s32 numQueries;
+    s32 numFrames;
+};
+
+struct BenchResult {
+    f32 height;
+    struct Surface *surface;
+    struct WallCollisionData walls;
+    s32 numCollisions;
+};
+
+static u32 sRandomState;
+
+static u32 bench_random(void) {
+    // xorshift32, so the query stream is the same on every platform
+    sRandomState ^= sRandomState << 13;
+    sRandomState ^= sRandomState >> 17;
+    sRandomState ^= sRandomState << 5;
+    return sRandomState;
+}
+
+static f32 bench_random_range(f32 lo, f32 hi) {
+    return lo + (hi - lo) * ((bench_random() & 0xFFFFFF) / (f32) 0x1000000);
+}
+
+/**
+ * Collect the loaded static surfaces, to place queries next to them.
+ */
+static s32 collect_static_surfaces(struct Surface **surfaces, s32 maxSurfaces) {
+    s32 count = 0;
+    s32 cellX, cellZ, listIndex;
+    struct SurfaceNode *node;
+
+    for (cellZ = 0; cellZ < NUM_CELLS; cellZ++) {
+        for (cellX = 0; cellX < NUM_CELLS; cellX++) {
+            for (listIndex = 0; listIndex < 3; listIndex++) {
+                node = gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+                for (; node != NULL && count < maxSurfaces; node = node->next) {
+                    surfaces[count++] = node->surface;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/**************************************************
+ *                     OBJECTS                    *
+ **************************************************/
+
+enum BenchObjectMotion {
+    MOTION_EVERY_FRAME,
+    MOTION_PERIODIC,
+    MOTION_NONE
+};
+
+struct BenchObject {
+    const Collision *model;
+    f32 x, y, z;
+    s16 yaw;
+    u8 motion;
+};
+
+static const BehaviorScript sBenchPlatformBehavior[1];
+static struct BenchObject sBenchObjects[NUM_BENCH_OBJECTS];
+
+// Loads the collision of traced objects that weren't in the object pool
+static struct Object sUnpooledObject;
+
+/**
+ * Place the area's platforms above random static surfaces, with random models.
+ */
+static void place_objects(struct Surface **surfaces, s32 numSurfaces) {
+    struct BenchObject *b;
+    struct Surface *surf;
+    s32 i;
+
+    for (i = 0; i < NUM_BENCH_OBJECTS; i++) {
+        b = &sBenchObjects[i];
+        b->model = sBenchObjectModels[bench_random() % ARRAY_COUNT(sBenchObjectModels)];
+        if (numSurfaces == 0) {
+            b->x = bench_random_range(-6000.0f, 6000.0f);
+            b->y = bench_random_range(-2000.0f, 2000.0f);
+            b->z = bench_random_range(-6000.0f, 6000.0f);
+        } else {
+            surf = surfaces[bench_random() % numSurfaces];
+            b->x = surf->vertex1[0];
+            b->y = surf->vertex1[1] + bench_random_range(50.0f, 400.0f);
+            b->z = surf->vertex1[2];
+        }
+        b->yaw = bench_random();
+        b->motion = i % 4 == 0 ? MOTION_EVERY_FRAME : i % 4 == 1 ? MOTION_PERIODIC : MOTION_NONE;
+    }
+}
+
+/**
+ * Make the event of a platform loading its collision on a frame. Moving
+ * objects turn and bob up and down.
+ */
+static void make_object_event(struct BenchEvent *e, s32 index, s32 frame) {
+    struct BenchObject *b = &sBenchObjects[index];
+    s32 step = b->motion == MOTION_EVERY_FRAME ? frame
+             : b->motion == MOTION_PERIODIC    ? frame / OBJECT_MOVE_PERIOD
+                                               : 0;
+    f32 angle = (s16)(b->yaw + step * 0x200) * (3.14159265f / 0x8000);
+    f32 c = cosf(angle), s = sinf(angle);
+
+    e->type = EVENT_OBJECT;
+    e->slot = index;
+    e->model = (s16 *) b->model;
+
+    memset(e->transform, 0, sizeof(Mat4));
+    e->transform[0][0] = c;
+    e->transform[0][2] = -s;
+    e->transform[1][1] = 1.0f;
+    e->transform[2][0] = s;
+    e->transform[2][2] = c;
+    e->transform[3][0] = b->x;
+    e->transform[3][1] = b->y + (step % 32) * 8.0f;
+    e->transform[3][2] = b->z;
+    e->transform[3][3] = 1.0f;
+}
+
+/**
+ * Load an object's collision through load_object_collision_model the way an
+ * event has it. The scale is 1, so the vertices are transformed by exactly the
+ * event's matrix.
+ */
+static void load_event_object(const struct BenchEvent *e) {
+    struct Object *obj = e->slot >= 0 && e->slot < OBJECT_POOL_CAPACITY ? &gObjectPool[e->slot]
+                                                                         : &sUnpooledObject;
+
+    obj->activeFlags = ACTIVE_FLAG_ACTIVE;
+    obj->behavior = sBenchPlatformBehavior;
+    obj->collisionData = e->model;
+    obj->oDistanceToMario = 0.0f;
+    obj->oCollisionDistance = 20000.0f;
+    obj->header.gfx.scale[0] = obj->header.gfx.scale[1] = obj->header.gfx.scale[2] = 1.0f;
+    obj->header.gfx.throwMatrix = &obj->transform;
+    memcpy(obj->transform, e->transform, sizeof(Mat4));
+
+    gCurrentObject = obj;
+    load_object_collision_model();
+    gCurrentObject = NULL;
+}
+
+/**
+ * Time loading the objects of a stream alone, returning the microseconds per frame.
+ */
+static f64 time_object_loads(const struct BenchSegment *segment) {
+    clock_t start;
+    s32 i;
+
+    start = clock();
+    for (i = 0; i < segment->numEvents; i++) {
+        if (segment->events[i].type == EVENT_FRAME) {
+            clear_dynamic_surfaces();
+        } else if (segment->events[i].type == EVENT_OBJECT) {
+            load_event_object(&segment->events[i]);
+        }
+    }
+
+    return segment->numFrames > 0
+               ? (f64)(clock() - start) / CLOCKS_PER_SEC * 1000000.0 / segment->numFrames
+               : 0.0;
+}
+
+/**************************************************
+ *                     STREAMS                    *
+ **************************************************/
+
+/**
+ * Make a stream of queries that looks like a frame of gameplay: points on and
+ * around the level geometry and the platforms, some anywhere in or just out
+ * of the level, and about half of them repeating one of the last few queries
+ * the way several objects and the camera ask about the same position.
+ */
+static void generate_queries(struct BenchQuery *queries, s32 numQueries,
+                             struct Surface **surfaces, s32 numSurfaces) {
+    static const f32 wallRadii[] = { 5.0f, 24.0f, 50.0f, 80.0f, 250.0f };
+    static const f32 wallOffsets[] = { 0.0f, 30.0f, 60.0f, 150.0f };
+    struct BenchQuery *q;
+    struct Surface *surf;
+    f32 a, b;
+    u32 r;
+    s32 i;
+
+    for (i = 0; i < numQueries; i++) {
+        q = &queries[i];
+
+        if (i > 0 && (bench_random() & 1)) {
+            *q = queries[i - 1 - bench_random() % (i < 8 ? i : 8)];
+            continue;
+        }
+
+        r = bench_random() & 7;
+        if (numSurfaces == 0 || r == 0) {
+            q->x = bench_random_range(-8300.0f, 8300.0f);
+            q->y = bench_random_range(-8000.0f, 8000.0f);
+            q->z = bench_random_range(-8300.0f, 8300.0f);
+        } else if (r <= 2) {
+            struct BenchObject *b = &sBenchObjects[bench_random() % NUM_BENCH_OBJECTS];
+
+            q->x = b->x + bench_random_range(-400.0f, 400.0f);
+            q->y = b->y + bench_random_range(-300.0f, 600.0f);
+            q->z = b->z + bench_random_range(-400.0f, 400.0f);
+        } else {
+            surf = surfaces[bench_random() % numSurfaces];
+            a = bench_random_range(0.0f, 1.0f);
+            b = bench_random_range(0.0f, 1.0f);
+            if (a + b > 1.0f) {
+                a = 1.0f - a;
+                b = 1.0f - b;
+            }
+            q->x = surf->vertex1[0] + a * (surf->vertex2[0] - surf->vertex1[0])
+                   + b * (surf->vertex3[0] - surf->vertex1[0]) + bench_random_range(-30.0f, 30.0f);
+            q->y = surf->vertex1[1] + a * (surf->vertex2[1] - surf->vertex1[1])
+                   + b * (surf->vertex3[1] - surf->vertex1[1]) + bench_random_range(-300.0f, 300.0f);
+            q->z = surf->vertex1[2] + a * (surf->vertex2[2] - surf->vertex1[2])
+                   + b * (surf->vertex3[2] - surf->vertex1[2]) + bench_random_range(-30.0f, 30.0f);
+        }
+
+        r = bench_random() % 10;
+        q->type = r < 4 ? BENCH_FLOOR : r < 7 ? BENCH_WALLS : r < 9 ? BENCH_CEIL : BENCH_WATER;
+        q->camera = (bench_random() & 7) == 0;
+        q->intangible = q->type == BENCH_FLOOR && (bench_random() & 15) == 0;
+        q->offsetY = wallOffsets[bench_random() % ARRAY_COUNT(wallOffsets)];
+        q->radius = wallRadii[bench_random() % ARRAY_COUNT(wallRadii)];
+    }
+}
+
+/**
+ * Make sure a stream has room for more events.
+ */
+static void reserve_events(struct BenchSegment *segment, s32 numEvents) {
+    s32 capacity = segment->capacity > 0 ? segment->capacity : 1024;
+
+    while (capacity < segment->numEvents + numEvents) {
+        capacity *= 2;
+    }
+    if (capacity != segment->capacity) {
+        segment->events = realloc(segment->events, capacity * sizeof(struct BenchEvent));
+        segment->capacity = capacity;
+        if (segment->events == NULL) {
+            fprintf(stderr, "Could not allocate %d events\n", capacity);
+            exit(2);
+        }
+    }
+}
+
+/**
+ * Make an area's stream from the random queries. A frame starts every
+ * QUERIES_PER_FRAME queries by clearing the dynamic partition, and the
+ * platforms load their collision spread between its queries, the way they
+ * update between the other objects in the game.
+ */
+static void make_random_segment(struct BenchSegment *segment, const struct BenchArea *area,
+                                const struct BenchQuery *queries, s32 numQueries) {
+    struct BenchEvent *e;
+    s32 queryInFrame;
+    s32 i;
+
+    segment->area = area;
+    segment->numEvents = 0;
+    segment->numFrames = 0;
+    segment->numQueries = numQueries;
+    reserve_events(segment, numQueries + numQueries / QUERIES_PER_FRAME
+                                + numQueries / (QUERIES_PER_FRAME / NUM_BENCH_OBJECTS) + 2);
+
+    e = segment->events;
+    for (i = 0; i < numQueries; i++) {
+        queryInFrame = i % QUERIES_PER_FRAME;
+
+        if (queryInFrame == 0) {
+            e->type = EVENT_FRAME;
+            e++;
+            segment->numFrames++;
+        }
+        if (queryInFrame % (QUERIES_PER_FRAME / NUM_BENCH_OBJECTS) == 0) {
+            make_object_event(e, queryInFrame / (QUERIES_PER_FRAME / NUM_BENCH_OBJECTS),
+                              i / QUERIES_PER_FRAME);
+            e++;
+        }
+
+        e->type = EVENT_QUERY;
+        e->query = queries[i];
+        e++;
+    }
+
+    segment->numEvents = e - segment->events;
+}
+
+static void run_query(const struct BenchQuery *q, struct BenchResult *result) {
+    gCheckingSurfaceCollisionsForCamera = q->camera;
+
+    switch (q->type) {
+        case BENCH_FLOOR:
+            gFindFloorIncludeSurfaceIntangible = q->intangible;
+            result->height = find_floor(q->x, q->y, q->z, &result->surface);
+            break;
+        case BENCH_CEIL:
+            result->height = find_ceil(q->x, q->y, q->z, &result->surface);
+            break;
+        case BENCH_WALLS:
+            result->walls.x = q->x;
+            result->walls.y = q->y;
+            result->walls.z = q->z;
+            result->walls.offsetY = q->offsetY;
+            result->walls.radius = q->radius;
+            result->numCollisions = find_wall_collisions(&result->walls);
+            break;
+        case BENCH_WATER:
+            result->height = find_water_level(q->x, q->z);
+            break;
+    }
+}
+
+static void run_reference_query(const struct BenchQuery *q, struct BenchResult *result) {
+    gCheckingSurfaceCollisionsForCamera = q->camera;
+
+    switch (q->type) {
+        case BENCH_FLOOR:
+            gFindFloorIncludeSurfaceIntangible = q->intangible;
+            result->height = ref_find_floor(q->x, q->y, q->z, &result->surface);
+            break;
+        case BENCH_CEIL:
+            result->height = ref_find_ceil(q->x, q->y, q->z, &result->surface);
+            break;
+        case BENCH_WALLS:
+            result->walls.x = q->x;
+            result->walls.y = q->y;
+            result->walls.z = q->z;
+            result->walls.offsetY = q->offsetY;
+            result->walls.radius = q->radius;
+            result->numCollisions = ref_find_wall_collisions(&result->walls);
+            break;
+        case BENCH_WATER:
+            result->height = ref_find_water_level(q->x, q->z);
+            break;
+    }
+}
+
+/**
+ * Compare two results bit for bit, including the wall push and wall list.
+ */
+static s32 results_match(const struct BenchQuery *q, const struct BenchResult *a,
+                         const struct BenchResult *b) {
+    s32 i;
+
+    if (q->type == BENCH_WALLS) {
+        if (a->numCollisions != b->numCollisions || a->walls.numWalls != b->walls.numWalls
+            || memcmp(&a->walls.x, &b->walls.x, sizeof(f32)) != 0
+            || memcmp(&a->walls.z, &b->walls.z, sizeof(f32)) != 0) {
+            return FALSE;
+        }
+        for (i = 0; i < a->walls.numWalls; i++) {
+            if (a->walls.walls[i] != b->walls.walls[i]) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+
+    if (q->type != BENCH_WATER && a->surface != b->surface) {
+        return FALSE;
+    }
+    return memcmp(&a->height, &b->height, sizeof(f32)) == 0;
+}
+
+static u32 hash_bytes(u32 hash, const void *data, size_t size) {
+    const u8 *bytes = data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Hash what a query found. Surfaces are hashed by their contents rather than
+ * their address, object surfaces live in a different place with the object
+ * surface cache on.
+ */
+static u32 hash_surface(u32 hash, const struct Surface *surf) {
+    if (surf == NULL) {
+        return hash_bytes(hash, "", 1);
+    }
+    hash = hash_bytes(hash, &surf->type, sizeof(surf->type));
+    hash = hash_bytes(hash, &surf->force, sizeof(surf->force));
+    hash = hash_bytes(hash, &surf->flags, sizeof(surf->flags));
+    hash = hash_bytes(hash, &surf->room, sizeof(surf->room));
+    hash = hash_bytes(hash, &surf->lowerY, sizeof(surf->lowerY));
+    hash = hash_bytes(hash, &surf->upperY, sizeof(surf->upperY));
+    hash = hash_bytes(hash, surf->vertex1, sizeof(surf->vertex1));
+    hash = hash_bytes(hash, surf->vertex2, sizeof(surf->vertex2));
+    hash = hash_bytes(hash, surf->vertex3, sizeof(surf->vertex3));
+    hash = hash_bytes(hash, &surf->normal, sizeof(surf->normal));
+    hash = hash_bytes(hash, &surf->originOffset, sizeof(surf->originOffset));
+    return hash_bytes(hash, &surf->object, sizeof(surf->object));
+}
+
+static u32 hash_result(const struct BenchQuery *q, const struct BenchResult *result) {
+    u32 hash = 2166136261u;
+    s32 i;
+
+    if (q->type == BENCH_WALLS) {
+        hash = hash_bytes(hash, &result->numCollisions, sizeof(result->numCollisions));
+        hash = hash_bytes(hash, &result->walls.x, sizeof(result->walls.x));
+        hash = hash_bytes(hash, &result->walls.z, sizeof(result->walls.z));
+        for (i = 0; i < result->walls.numWalls; i++) {
+            hash = hash_surface(hash, result->walls.walls[i]);
+        }
+        return hash;
+    }
+
+    hash = hash_bytes(hash, &result->height, sizeof(result->height));
+    return q->type != BENCH_WATER ? hash_surface(hash, result->surface) : hash;
+}
+
+/**
+ * Run the frame and object events of a stream, returning TRUE for a query the
+ * caller has to make.
+ */
+static s32 run_event(const struct BenchEvent *e) {
+    switch (e->type) {
+        case EVENT_FRAME:
+            clear_dynamic_surfaces();
+            return FALSE;
+        case EVENT_OBJECT:
+            load_event_object(e);
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Run a stream and keep a hash of each query's result.
+ */
+static void hash_results(const struct BenchSegment *segment, u32 *hashes) {
+    struct BenchResult result;
+    s32 query = 0;
+    s32 i;
+
+    for (i = 0; i < segment->numEvents; i++) {
+        if (run_event(&segment->events[i])) {
+            memset(&result, 0, sizeof(result));
+            run_query(&segment->events[i].query, &result);
+            hashes[query++] = hash_result(&segment->events[i].query, &result);
+        }
+    }
+}
+
+/**
+ * Compare the results with the object surface cache off and on.
+ */
+static s32 verify_object_surface_cache(const struct BenchSegment *segment, u32 *hashes[2]) {
+    s32 mismatches = 0;
+    s32 i;
+
+    set_object_surface_cache(FALSE);
+    hash_results(segment, hashes[0]);
+    set_object_surface_cache(TRUE);
+    hash_results(segment, hashes[1]);
+
+    for (i = 0; i < segment->numQueries; i++) {
+        if (hashes[0][i] != hashes[1][i] && mismatches++ < 10) {
+            fprintf(stderr, "%s: query %d finds something else with the object surface cache on\n",
+                    segment->area->name, i);
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ * Time one pass over a stream, returning the queries per second. The
+ * checksum keeps the compiler from dropping the work.
+ */
+static f64 time_queries(const struct BenchSegment *segment, s32 reference, u32 *checksum) {
+    const struct BenchEvent *e;
+    struct BenchResult result;
+    clock_t start;
+    f64 seconds;
+    s32 i;
+
+    memset(&result, 0, sizeof(result));
+    start = clock();
+    for (i = 0; i < segment->numEvents; i++) {
+        e = &segment->events[i];
+        if (!run_event(e)) {
+            continue;
+        }
+        if (reference) {
+            run_reference_query(&e->query, &result);
+        } else {
+            run_query(&e->query, &result);
+        }
+        *checksum = *checksum * 31 + (u32)(s32) result.height + (u32) result.walls.numWalls;
+    }
+    seconds = (f64)(clock() - start) / CLOCKS_PER_SEC;
+
+    return seconds > 0.0 ? segment->numQueries / seconds : 0.0;
+}
+
+/**
+ * Sum the floor and ceiling queries the query cache has seen, and the ones it answered.
+ */
+static void count_query_cache_hits(u32 *calls, u32 *hits) {
+    const struct CollisionQuerySite *sites;
+    s32 numSites = get_collision_query_sites(&sites);
+    s32 i;
+
+    *calls = 0;
+    *hits = 0;
+    for (i = 0; i < numSites; i++) {
+        *calls += sites[i].calls;
+        *hits += sites[i].hits;
+    }
+}
+
+/**
+ * Run a stream and count the queries that differ from the reference.
+ */
+static s32 verify_queries(const struct BenchSegment *segment) {
+    static const char *typeNames[] = { "find_floor", "find_ceil", "find_wall_collisions", "find_water_level" };
+    struct BenchResult expected, actual;
+    const struct BenchQuery *q;
+    s32 mismatches = 0;
+    s32 i;
+
+    for (i = 0; i < segment->numEvents; i++) {
+        if (!run_event(&segment->events[i])) {
+            continue;
+        }
+        q = &segment->events[i].query;
+        memset(&expected, 0, sizeof(expected));
+        memset(&actual, 0, sizeof(actual));
+        run_reference_query(q, &expected);
+        run_query(q, &actual);
+
+        if (!results_match(q, &expected, &actual)) {
+            if (mismatches++ < 10) {
+                fprintf(stderr, "%s: %s(%.3f, %.3f, %.3f) differs from the reference (%.3f vs %.3f)\n",
+                        segment->area->name, typeNames[q->type], q->x, q->y, q->z, actual.height,
+                        expected.height);
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+/**************************************************
+ *                     TRACES                     *
+ **************************************************/
+
+static s32 sRecordingTrace;
+
+/**
+ * Write what the collision code does to the trace being recorded, if there is one.
+ */
+static void record_trace(s32 enable) {
+    gCollisionTraceEnabled = sRecordingTrace && enable;
+}
+
+static s32 read_trace(FILE *file, void *data, size_t size) {
+    return fread(data, size, 1, file) == 1;
+}
+
+/**
+ * Find the area a trace loads, or NULL if the bench doesn't have it.
+ */
+static const struct BenchArea *find_bench_area(s16 level, s16 area) {
+    u32 i;
+
+    for (i = 0; i < ARRAY_COUNT(sBenchAreas); i++) {
+        if (sBenchAreas[i].level == level && sBenchAreas[i].area == area) {
+            return &sBenchAreas[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Read a collision trace into a stream per area it loads, skipping the areas
+ * the bench doesn't have. Returns the number of streams, or -1 if the file
+ * isn't a whole trace.
+ */
+static s32 load_trace(const char *filename, struct BenchSegment **segments) {
+    static s16 *models[0x10000];
+    const struct BenchArea *area;
+    struct BenchSegment *segment = NULL;
+    struct BenchEvent skippedObject;
+    struct BenchEvent *e;
+    FILE *file;
+    char magic[sizeof(COLLISION_TRACE_MAGIC) - 1];
+    u32 version;
+    s32 numSegments = 0;
+    s32 skippedQueries = 0;
+    s32 ok = TRUE;
+    s16 level, areaIndex;
+    u16 id;
+    u32 length;
+    u8 flags[2];
+    f32 values[5];
+    u8 type;
+
+    *segments = NULL;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s\n", filename);
+        return -1;
+    }
+    if (!read_trace(file, magic, sizeof(magic)) || memcmp(magic, COLLISION_TRACE_MAGIC, sizeof(magic)) != 0
+        || !read_trace(file, &version, sizeof(version)) || version != COLLISION_TRACE_VERSION) {
+        fprintf(stderr, "%s is not a version %d collision trace\n", filename, COLLISION_TRACE_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    while (ok && read_trace(file, &type, sizeof(type))) {
+        switch (type) {
+            case COLLISION_TRACE_AREA:
+                ok = read_trace(file, &level, sizeof(level)) && read_trace(file, &areaIndex, sizeof(areaIndex));
+                area = find_bench_area(level, areaIndex);
+                segment = NULL;
+                if (ok && area == NULL) {
+                    fprintf(stderr, "Skipping level %d area %d, the bench doesn't load it\n", level, areaIndex);
+                } else if (ok) {
+                    *segments = realloc(*segments, (numSegments + 1) * sizeof(struct BenchSegment));
+                    if (*segments == NULL) {
+                        fprintf(stderr, "Could not allocate %d streams\n", numSegments + 1);
+                        exit(2);
+                    }
+                    segment = &(*segments)[numSegments++];
+                    memset(segment, 0, sizeof(struct BenchSegment));
+                    segment->area = area;
+                }
+                break;
+
+            case COLLISION_TRACE_FRAME:
+                if (segment != NULL) {
+                    reserve_events(segment, 1);
+                    segment->events[segment->numEvents++].type = EVENT_FRAME;
+                    segment->numFrames++;
+                }
+                break;
+
+            case COLLISION_TRACE_MODEL:
+                ok = read_trace(file, &id, sizeof(id)) && read_trace(file, &length, sizeof(length))
+                     && length > 0 && length < 0x10000;
+                if (ok) {
+                    // The model starts after its TERRAIN_LOAD_VERTICES
+                    free(models[id]);
+                    models[id] = malloc((length + 1) * sizeof(s16));
+                    models[id][0] = TERRAIN_LOAD_VERTICES;
+                    ok = read_trace(file, &models[id][1], length * sizeof(s16));
+                }
+                break;
+
+            case COLLISION_TRACE_OBJECT:
+                if (segment == NULL) {
+                    e = &skippedObject;
+                } else {
+                    reserve_events(segment, 1);
+                    e = &segment->events[segment->numEvents];
+                }
+                e->type = EVENT_OBJECT;
+                ok = read_trace(file, &e->slot, sizeof(e->slot)) && read_trace(file, &id, sizeof(id))
+                     && read_trace(file, e->transform, sizeof(Mat4)) && models[id] != NULL;
+                e->model = models[id];
+                if (ok && segment != NULL) {
+                    segment->numEvents++;
+                }
+                break;
+
+            case COLLISION_TRACE_FLOOR:
+            case COLLISION_TRACE_CEIL:
+            case COLLISION_TRACE_WALLS:
+            case COLLISION_TRACE_WATER:
+                ok = read_trace(file, flags, sizeof(flags)) && read_trace(file, values, sizeof(values));
+                if (!ok) {
+                    break;
+                }
+                if (segment == NULL) {
+                    skippedQueries++;
+                    break;
+                }
+                reserve_events(segment, 1);
+                e = &segment->events[segment->numEvents++];
+                e->type = EVENT_QUERY;
+                e->query.type = BENCH_FLOOR + (type - COLLISION_TRACE_FLOOR);
+                e->query.camera = flags[0];
+                e->query.intangible = flags[1];
+                e->query.x = values[0];
+                e->query.y = values[1];
+                e->query.z = values[2];
+                e->query.offsetY = values[3];
+                e->query.radius = values[4];
+                segment->numQueries++;
+                break;
+
+            default:
+                ok = FALSE;
+                break;
+        }
+    }
+
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "%s has a bad or unfinished record\n", filename);
+        return -1;
+    }
+    if (skippedQueries != 0) {
+        fprintf(stderr, "Skipped %d queries outside the areas the bench loads\n", skippedQueries);
+    }
+    return numSegments;
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr, "usage: %s [-r trace] [queries per area] [seed]\n"
+                    "       %s -t trace\n", name, name);
+}
+
+int main(int argc, char *argv[]) {
+    static struct Surface *surfaces[0x10000];
+    struct BenchSegment randomSegment;
+    struct BenchSegment *segments = NULL;
+    struct BenchSegment *segment;
+    const struct BenchArea *area;
+    struct BenchQuery *queries = NULL;
+    const char *recordFile = NULL;
+    const char *traceFile = NULL;
+    u32 *hashes[2];
+    s32 queriesPerArea = DEFAULT_QUERIES_PER_AREA;
+    u32 seed = 1;
+    s32 numSegments;
+    s32 maxQueries;
+    f64 totalQps[3] = { 0.0, 0.0, 0.0 };
+    f64 totalLoadUs[2] = { 0.0, 0.0 };
+    u32 totalCalls = 0;
+    u32 totalHits = 0;
+    u32 totalQueries = 0;
+    u32 calls[2];
+    u32 hits[2];
+    s32 totalMismatches = 0;
+    u32 checksum = 0;
+    s32 numSurfaces;
+    s32 mismatches;
+    f64 qps[3];
+    f64 loadUs[2];
+    s32 arg = 1;
+    s32 i;
+
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-r") == 0) {
+            recordFile = argv[arg + 1];
+        } else if (strcmp(argv[arg], "-t") == 0) {
+            traceFile = argv[arg + 1];
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+        arg += 2;
+    }
+    if (arg < argc) {
+        queriesPerArea = atoi(argv[arg]);
+    }
+    if (arg + 1 < argc) {
+        seed = strtoul(argv[arg + 1], NULL, 0);
+    }
+    if (queriesPerArea <= 0 || arg + 2 < argc || (traceFile != NULL && (recordFile != NULL || arg < argc))) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    alloc_surface_pools();
+    sRandomState = seed != 0 ? seed : 1;
+    memset(&randomSegment, 0, sizeof(randomSegment));
+
+    if (traceFile != NULL) {
+        numSegments = load_trace(traceFile, &segments);
+        if (numSegments <= 0) {
+            if (numSegments == 0) {
+                fprintf(stderr, "%s loads none of the areas the bench has\n", traceFile);
+            }
+            return 2;
+        }
+        maxQueries = 0;
+        for (i = 0; i < numSegments; i++) {
+            if (segments[i].numQueries > maxQueries) {
+                maxQueries = segments[i].numQueries;
+            }
+        }
+    } else {
+        numSegments = ARRAY_COUNT(sBenchAreas);
+        maxQueries = queriesPerArea;
+        queries = malloc(queriesPerArea * sizeof(struct BenchQuery));
+        if (queries == NULL) {
+            fprintf(stderr, "Could not allocate %d queries\n", queriesPerArea);
+            return 2;
+        }
+    }
+
+    hashes[0] = malloc((maxQueries + 1) * sizeof(u32));
+    hashes[1] = malloc((maxQueries + 1) * sizeof(u32));
+    if (hashes[0] == NULL || hashes[1] == NULL) {
+        fprintf(stderr, "Could not allocate %d queries\n", maxQueries);
+        return 2;
+    }
+
+    if (recordFile != NULL) {
+        if (!open_collision_trace(recordFile)) {
+            return 2;
+        }
+        sRecordingTrace = TRUE;
+        record_trace(FALSE);
+    }
+
+    printf("%-18s %8s %14s %14s %14s %9s %12s %12s %10s\n", "area", "surfaces", "reference q/s",
+           "uncached q/s", "cached q/s", "hit rate", "objects us", "obj cache us", "mismatches");
+
+    for (i = 0; i < numSegments; i++) {
+        area = traceFile != NULL ? segments[i].area : &sBenchAreas[i];
+        gCurrLevelNum = area->level;
+
+        record_trace(TRUE);
+        load_area_terrain(area->area, (s16 *) area->data, NULL, NULL);
+        record_trace(FALSE);
+
+        if (traceFile != NULL) {
+            segment = &segments[i];
+        } else {
+            numSurfaces = collect_static_surfaces(surfaces, ARRAY_COUNT(surfaces));
+            place_objects(surfaces, numSurfaces);
+            generate_queries(queries, queriesPerArea, surfaces, numSurfaces);
+            segment = &randomSegment;
+            make_random_segment(segment, area, queries, queriesPerArea);
+        }
+
+        set_object_surface_cache(FALSE);
+        loadUs[0] = time_object_loads(segment);
+        set_object_surface_cache(TRUE);
+        loadUs[1] = time_object_loads(segment);
+        mismatches = verify_object_surface_cache(segment, hashes);
+
+        qps[0] = time_queries(segment, TRUE, &checksum);
+        set_collision_query_cache(FALSE);
+        record_trace(TRUE);
+        qps[1] = time_queries(segment, FALSE, &checksum);
+        record_trace(FALSE);
+        mismatches += verify_queries(segment);
+        set_collision_query_cache(TRUE);
+        count_query_cache_hits(&calls[0], &hits[0]);
+        qps[2] = time_queries(segment, FALSE, &checksum);
+        count_query_cache_hits(&calls[1], &hits[1]);
+        mismatches += verify_queries(segment);
+        set_collision_query_cache(FALSE);
+
+        printf("%-18s %8d %14.0f %14.0f %14.0f %8.1f%% %12.2f %12.2f %10d\n", area->name,
+               gNumStaticSurfaces, qps[0], qps[1], qps[2],
+               calls[1] != calls[0] ? 100.0 * (hits[1] - hits[0]) / (calls[1] - calls[0]) : 0.0, loadUs[0],
+               loadUs[1], mismatches);
+
+        totalQps[0] += qps[0];
+        totalQps[1] += qps[1];
+        totalQps[2] += qps[2];
+        totalLoadUs[0] += loadUs[0];
+        totalLoadUs[1] += loadUs[1];
+        totalCalls += calls[1] - calls[0];
+        totalHits += hits[1] - hits[0];
+        totalQueries += segment->numQueries;
+        totalMismatches += mismatches;
+    }
+
+    printf("%-18s %8s %14.0f %14.0f %14.0f %8.1f%% %12.2f %12.2f %10d\n", "mean", "",
+           totalQps[0] / numSegments, totalQps[1] / numSegments, totalQps[2] / numSegments,
+           totalCalls != 0 ? 100.0 * totalHits / totalCalls : 0.0, totalLoadUs[0] / numSegments,
+           totalLoadUs[1] / numSegments, totalMismatches);
+    printf("%u queries per mode, checksum %08x\n", totalQueries, checksum);
+
+    if (recordFile != NULL) {
+        close_collision_trace();
+    }
+
+    free(queries);
+    free(randomSegment.events);
+    free(hashes[0]);
+    free(hashes[1]);
+    return totalMismatches != 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * The collision queries collision_bench checks the real ones against: the
+ * game's own surface_collision.c built a second time without the SIMD surface
+ * lists, so every query walks the lists one node at a time. Its exported
+ * names get a ref_ prefix so both copies link into the bench, and nothing
+ * enables this copy's query cache.
+ */
+
+#define NO_SURFACE_SIMD
+
+#define debug_surface_list_info ref_debug_surface_list_info
+#define f32_find_wall_collision ref_f32_find_wall_collision
+#define find_ceil ref_find_ceil
+#define find_floor ref_find_floor
+#define find_floor_height ref_find_floor_height
+#define find_floor_height_and_data ref_find_floor_height_and_data
+#define find_poison_gas_level ref_find_poison_gas_level
+#define find_wall_collisions ref_find_wall_collisions
+#define find_water_level ref_find_water_level
+#define gCollisionQueryCacheEnabled ref_gCollisionQueryCacheEnabled
+#define gCollisionQueryFile ref_gCollisionQueryFile
+#define gCollisionQueryLine ref_gCollisionQueryLine
+#define get_collision_query_sites ref_get_collision_query_sites
+#define sFloorGeo ref_sFloorGeo
+#define set_collision_query_cache ref_set_collision_query_cache
+#define surface_list_changed ref_surface_list_changed
+#define surface_partition_changed ref_surface_partition_changed
+#define unused_find_dynamic_floor ref_unused_find_dynamic_floor
+#define unused_obj_find_floor_height ref_unused_obj_find_floor_height
+#define unused_resolve_floor_or_ceil_collisions ref_unused_resolve_floor_or_ceil_collisions
+
+#include "engine/surface_collision.c"
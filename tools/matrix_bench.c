@@ -0,0 +1,289 @@
+/**
+ * Standalone benchmark for the matrix kernels of the graph node matrix stack.
+ * Each kernel of the scalar, strict SIMD and fast SIMD tables is timed over
+ * the same randomized transforms, along with a "stack" pass that chains
+ * mtxf_rotate_zxy_and_translate, mtxf_mul and mtxf_to_mtx the way
+ * geo_process_translation_rotation does. Every result of the SIMD tables is
+ * also compared with the scalar one, down to the bits of every float.
+ *
+ * Build with `make matrix-bench` and run
+ *   build/<version>_pc/matrix_bench [rounds] [seed]
+ * It exits with status 1 if a strict kernel disagrees with the scalar one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ultra64.h>
+#include "sm64.h"
+#include "engine/graph_node.h"
+#include "engine/math_util.h"
+#include "engine/surface_collision.h"
+
+#define DEFAULT_ROUNDS 2000
+
+// Number of random inputs each round goes through
+#define NUM_INPUTS 4096
+
+// Depth the stack pass goes to before starting over from the camera matrix
+#define STACK_DEPTH 8
+
+// Each kernel is timed this many times, taking the fastest
+#define TIMED_PASSES 3
+
+enum MatrixBenchKernel {
+    BENCH_MUL,
+    BENCH_ROTATE_ZXY,
+    BENCH_BILLBOARD,
+    BENCH_TO_MTX,
+    BENCH_MUL_VEC3S,
+    BENCH_STACK,
+    BENCH_KERNEL_COUNT
+};
+
+static const char *sKernelNames[BENCH_KERNEL_COUNT] = {
+    "mul", "rotate_zxy", "billboard", "to_mtx", "mul_vec3s", "stack",
+};
+
+static const struct MtxfKernels *sKernelTables[] = {
+    &gMtxfScalarKernels,
+    &gMtxfStrictSimdKernels,
+    &gMtxfFastSimdKernels,
+};
+
+struct MatrixBenchInput {
+    Mat4 a;
+    Mat4 b;
+    Vec3f position;
+    Vec3s rotation;
+    Vec3s vec;
+    s16 angle;
+};
+
+struct MatrixBenchOutput {
+    Mat4 mtxf[NUM_INPUTS];
+    Mtx mtx[NUM_INPUTS];
+    Vec3s vec[NUM_INPUTS];
+};
+
+// The functions math_util.c calls that the kernels don't need
+Vec3f gVec3fZero = { 0.0f, 0.0f, 0.0f };
+u8 gCollisionQueryCacheEnabled;
+const char *gCollisionQueryFile;
+s32 gCollisionQueryLine;
+
+#undef find_floor
+f32 find_floor(UNUSED f32 xPos, UNUSED f32 yPos, UNUSED f32 zPos, struct Surface **pfloor) {
+    *pfloor = NULL;
+    return -11000.0f;
+}
+
+static struct MatrixBenchInput sInputs[NUM_INPUTS];
+static struct MatrixBenchOutput sOutputs[ARRAY_COUNT(sKernelTables)];
+static Mat4 sStack[STACK_DEPTH + 1];
+
+static u32 sRandomState;
+
+static u32 bench_random(void) {
+    sRandomState ^= sRandomState << 13;
+    sRandomState ^= sRandomState >> 17;
+    sRandomState ^= sRandomState << 5;
+    return sRandomState;
+}
+
+static f32 bench_random_float(f32 range) {
+    return ((f32)(bench_random() & 0xFFFFFF) / 0x800000 - 1.0f) * range;
+}
+
+/**
+ * Return a random angle. One in four is a multiple of a quarter turn, where
+ * the sines and cosines are exact zeros and the sign of a zero shows up in
+ * the results.
+ */
+static s16 bench_random_angle(void) {
+    u32 r = bench_random();
+
+    return (r & 3) == 0 ? (s16)(r & 0xC000) : (s16) r;
+}
+
+/**
+ * Fill 'mtx' with a random object transform, a rotation and translation with
+ * a scale, like the ones the matrix stack holds.
+ */
+static void bench_random_transform(Mat4 mtx) {
+    Vec3f translate;
+    Vec3s rotate;
+    Vec3f scale;
+    s32 i;
+
+    for (i = 0; i < 3; i++) {
+        translate[i] = bench_random_float(8192.0f);
+        rotate[i] = bench_random_angle();
+        scale[i] = (bench_random() & 1) ? 1.0f : 0.25f + bench_random_float(0.2f) + 0.2f;
+    }
+    mtxf_rotate_zxy_and_translate(mtx, translate, rotate);
+    mtxf_scale_vec3f(mtx, mtx, scale);
+}
+
+static void init_inputs(u32 seed) {
+    struct MatrixBenchInput *input;
+    s32 i, j;
+
+    sRandomState = seed;
+    for (i = 0; i < NUM_INPUTS; i++) {
+        input = &sInputs[i];
+        bench_random_transform(input->a);
+        bench_random_transform(input->b);
+        for (j = 0; j < 3; j++) {
+            input->position[j] = bench_random_float(8192.0f);
+            input->rotation[j] = bench_random_angle();
+            input->vec[j] = (s16) bench_random_float(2048.0f);
+        }
+        input->angle = bench_random_angle();
+    }
+}
+
+static void run_kernel(const struct MtxfKernels *kernels, s32 kernel, struct MatrixBenchOutput *out) {
+    struct MatrixBenchInput *input;
+    s32 depth = 0;
+    s32 i;
+
+    switch (kernel) {
+        case BENCH_MUL:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                kernels->mul(out->mtxf[i], sInputs[i].a, sInputs[i].b);
+            }
+            break;
+        case BENCH_ROTATE_ZXY:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                kernels->rotate_zxy_and_translate(out->mtxf[i], sInputs[i].position, sInputs[i].rotation);
+            }
+            break;
+        case BENCH_BILLBOARD:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                kernels->billboard(out->mtxf[i], sInputs[i].a, sInputs[i].position, sInputs[i].angle);
+            }
+            break;
+        case BENCH_TO_MTX:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                kernels->to_mtx(&out->mtx[i], sInputs[i].a);
+            }
+            break;
+        case BENCH_MUL_VEC3S:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                vec3s_copy(out->vec[i], sInputs[i].vec);
+                kernels->mul_vec3s(sInputs[i].a, out->vec[i]);
+            }
+            break;
+        case BENCH_STACK:
+            for (i = 0; i < NUM_INPUTS; i++) {
+                input = &sInputs[i];
+                if (depth == STACK_DEPTH) {
+                    depth = 0;
+                }
+                if (depth == 0) {
+                    mtxf_copy(sStack[0], input->b);
+                }
+                kernels->rotate_zxy_and_translate(out->mtxf[i], input->position, input->rotation);
+                kernels->mul(sStack[depth + 1], out->mtxf[i], sStack[depth]);
+                depth++;
+                kernels->to_mtx(&out->mtx[i], sStack[depth]);
+            }
+            break;
+    }
+}
+
+/**
+ * Time a kernel over the inputs, returning the calls per second.
+ */
+static f64 time_kernel(const struct MtxfKernels *kernels, s32 kernel, struct MatrixBenchOutput *out,
+                       s32 rounds) {
+    clock_t start;
+    f64 seconds;
+    s32 i;
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        run_kernel(kernels, kernel, out);
+    }
+    seconds = (f64)(clock() - start) / CLOCKS_PER_SEC;
+
+    return seconds > 0.0 ? (f64) NUM_INPUTS * rounds / seconds : 0.0;
+}
+
+/**
+ * Count the inputs for which the kernel's result differs from the scalar one.
+ */
+static s32 count_differences(s32 kernel, struct MatrixBenchOutput *expected, struct MatrixBenchOutput *actual) {
+    s32 differences = 0;
+    s32 i;
+
+    for (i = 0; i < NUM_INPUTS; i++) {
+        switch (kernel) {
+            case BENCH_MUL:
+            case BENCH_ROTATE_ZXY:
+            case BENCH_BILLBOARD:
+                differences += memcmp(expected->mtxf[i], actual->mtxf[i], sizeof(Mat4)) != 0;
+                break;
+            case BENCH_TO_MTX:
+            case BENCH_STACK:
+                differences += memcmp(&expected->mtx[i], &actual->mtx[i], sizeof(Mtx)) != 0;
+                break;
+            case BENCH_MUL_VEC3S:
+                differences += memcmp(expected->vec[i], actual->vec[i], sizeof(Vec3s)) != 0;
+                break;
+        }
+    }
+
+    return differences;
+}
+
+int main(int argc, char *argv[]) {
+    s32 rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    u32 seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    f64 callsPerSecond[ARRAY_COUNT(sKernelTables)];
+    s32 differences[ARRAY_COUNT(sKernelTables)];
+    s32 strictDifferences = 0;
+    f64 passCalls;
+    s32 kernel;
+    s32 pass;
+    s32 t;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds] [seed]\n", argv[0]);
+        return 2;
+    }
+    if (seed == 0) {
+        seed = 1;
+    }
+
+    init_inputs(seed);
+
+    printf("%-12s %12s %12s %12s %14s %12s\n", "kernel", "scalar M/s", "strict M/s", "fast M/s",
+           "strict diffs", "fast diffs");
+
+    for (kernel = 0; kernel < BENCH_KERNEL_COUNT; kernel++) {
+        for (t = 0; t < (s32) ARRAY_COUNT(sKernelTables); t++) {
+            callsPerSecond[t] = 0.0;
+            for (pass = 0; pass < TIMED_PASSES; pass++) {
+                passCalls = time_kernel(sKernelTables[t], kernel, &sOutputs[t], rounds);
+                callsPerSecond[t] = MAX(callsPerSecond[t], passCalls);
+            }
+        }
+        for (t = 0; t < (s32) ARRAY_COUNT(sKernelTables); t++) {
+            run_kernel(sKernelTables[t], kernel, &sOutputs[t]);
+            differences[t] = count_differences(kernel, &sOutputs[0], &sOutputs[t]);
+        }
+
+        printf("%-12s %12.1f %12.1f %12.1f %14d %12d\n", sKernelNames[kernel], callsPerSecond[0] / 1e6,
+               callsPerSecond[1] / 1e6, callsPerSecond[2] / 1e6, differences[1], differences[2]);
+        strictDifferences += differences[1];
+    }
+
+    printf("%d rounds of %d inputs, strict kernels are %s, fast kernels are %s\n", rounds, NUM_INPUTS,
+           gMtxfStrictSimdKernels.name, gMtxfFastSimdKernels.name);
+
+    return strictDifferences != 0;
+}
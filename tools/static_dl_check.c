@@ -0,0 +1,514 @@
+/**
+ * Standalone check of the static geometry cache of the PC renderer.
+ * A small scene, with plain, textured and lit display lists and one of them
+ * drawn again under an object matrix, is run through gfx_pc with the GPU
+ * vertex transform, once with the static geometry cache off and once with it
+ * on. A recording rendering API resolves every triangle it is given, from
+ * draw_triangles or from a retained mesh, to its vertices, transform slot and
+ * backend state, and both runs have to draw the same triangles in the same
+ * order on every frame. Partway through, the area is invalidated, which has to
+ * drop the cached display lists, and later the vertices of one of them change
+ * in place, which the cache has to notice by itself.
+ *
+ * Build with `make static-dl-check` and run
+ *   build/<version>_pc/static_dl_check
+ * It exits with status 1 if the runs differ, or if the cache is never used
+ * or is still used right after the invalidation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <ultra64.h>
+
+#include "pc/gfx/gfx_pc.h"
+#include "pc/gfx/gfx_cc.h"
+#include "pc/gfx/gfx_rendering_api.h"
+#include "pc/gfx/gfx_window_manager_api.h"
+
+#define NUM_FRAMES 14
+
+// Frame before which the area is invalidated, with the same vertices
+#define INVALIDATE_FRAME 5
+
+// Frame before which the terrain vertices change, without an invalidation
+#define CHANGE_FRAME 9
+
+#define MAX_TRIANGLES 256
+#define MAX_SHADERS 64
+#define MAX_TEXTURES 64
+#define MAX_MESHES 64
+
+struct ShaderProgram {
+    uint32_t shader_id;
+    uint8_t num_inputs;
+    bool used_textures[2];
+    size_t num_floats;
+};
+
+struct RecordedMesh {
+    float *vertices;
+    uint16_t *indices;
+};
+
+static struct {
+    struct ShaderProgram shaders[MAX_SHADERS];
+    size_t num_shaders;
+    struct ShaderProgram *shader;
+    uint32_t textures[2];
+    uint32_t num_textures;
+    uint32_t samplers[MAX_TEXTURES];
+    uint32_t state[5]; // depth test, depth mask, decal, alpha, cull
+    int viewport[4], scissor[4];
+    float slots[GFX_MAX_TRANSFORM_SLOTS * GFX_TRANSFORM_SLOT_VEC4S][4];
+    struct RecordedMesh meshes[MAX_MESHES];
+    uint64_t triangles[MAX_TRIANGLES];
+    size_t num_triangles;
+} rec;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size-- > 0) {
+        hash = (hash ^ *p++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hashes a vertex as the shader would see it, with the transform slot it refers to in place of the slot index
+static uint64_t hash_vertex(uint64_t hash, const float *v) {
+    size_t n = rec.shader->num_floats;
+    if (rec.shader->shader_id & SHADER_OPT_GPU_TRANSFORM) {
+        int slot = (int) v[3];
+        hash = hash_bytes(hash, v, 3 * sizeof(float));
+        hash = hash_bytes(hash, rec.slots[slot * GFX_TRANSFORM_SLOT_VEC4S], GFX_TRANSFORM_SLOT_VEC4S * sizeof(rec.slots[0]));
+        return hash_bytes(hash, v + 4, (n - 4) * sizeof(float));
+    }
+    return hash_bytes(hash, v, n * sizeof(float));
+}
+
+static uint64_t hash_state(void) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hash_bytes(hash, &rec.shader->shader_id, sizeof(rec.shader->shader_id));
+    for (int i = 0; i < 2; i++) {
+        if (rec.shader->used_textures[i]) {
+            hash = hash_bytes(hash, &rec.textures[i], sizeof(rec.textures[i]));
+            hash = hash_bytes(hash, &rec.samplers[rec.textures[i]], sizeof(rec.samplers[0]));
+        }
+    }
+    hash = hash_bytes(hash, rec.state, sizeof(rec.state));
+    hash = hash_bytes(hash, rec.viewport, sizeof(rec.viewport));
+    return hash_bytes(hash, rec.scissor, sizeof(rec.scissor));
+}
+
+static void record_triangle(const float *v0, const float *v1, const float *v2) {
+    uint64_t hash = hash_state();
+    hash = hash_vertex(hash, v0);
+    hash = hash_vertex(hash, v1);
+    hash = hash_vertex(hash, v2);
+    if (rec.num_triangles < MAX_TRIANGLES) {
+        rec.triangles[rec.num_triangles] = hash;
+    }
+    rec.num_triangles++;
+}
+
+static bool rec_z_is_from_0_to_1(void) {
+    return false;
+}
+
+static void rec_unload_shader(struct ShaderProgram *old_prg) {
+}
+
+static void rec_load_shader(struct ShaderProgram *new_prg) {
+    rec.shader = new_prg;
+}
+
+static struct ShaderProgram *rec_create_and_load_new_shader(uint32_t shader_id) {
+    struct CCFeatures cc_features;
+    struct ShaderProgram *prg = &rec.shaders[rec.num_shaders++];
+
+    // Same vertex layout as the OpenGL backend
+    gfx_cc_get_features(shader_id, &cc_features);
+    prg->shader_id = shader_id;
+    prg->num_inputs = cc_features.num_inputs;
+    prg->used_textures[0] = cc_features.used_textures[0];
+    prg->used_textures[1] = cc_features.used_textures[1];
+    prg->num_floats = 4;
+    if (cc_features.opt_gpu_transform) {
+        prg->num_floats += 4;
+    }
+    if (cc_features.used_textures[0] || cc_features.used_textures[1]) {
+        prg->num_floats += cc_features.opt_gpu_transform ? 6 : 2;
+    }
+    if (cc_features.opt_fog) {
+        prg->num_floats += 4;
+    }
+    prg->num_floats += cc_features.num_inputs * (cc_features.opt_alpha ? 4 : 3);
+    rec.shader = prg;
+    return prg;
+}
+
+static struct ShaderProgram *rec_lookup_shader(uint32_t shader_id) {
+    for (size_t i = 0; i < rec.num_shaders; i++) {
+        if (rec.shaders[i].shader_id == shader_id) {
+            return &rec.shaders[i];
+        }
+    }
+    return NULL;
+}
+
+static void rec_shader_get_info(struct ShaderProgram *prg, uint8_t *num_inputs, bool used_textures[2]) {
+    *num_inputs = prg->num_inputs;
+    used_textures[0] = prg->used_textures[0];
+    used_textures[1] = prg->used_textures[1];
+}
+
+static uint32_t rec_new_texture(void) {
+    return ++rec.num_textures;
+}
+
+static void rec_select_texture(int tile, uint32_t texture_id) {
+    rec.textures[tile] = texture_id;
+}
+
+static void rec_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+}
+
+static void rec_set_sampler_parameters(int tile, bool linear_filter, uint32_t cms, uint32_t cmt) {
+    rec.samplers[rec.textures[tile]] = linear_filter | cms << 1 | cmt << 16;
+}
+
+static void rec_set_depth_test(bool depth_test) {
+    rec.state[0] = depth_test;
+}
+
+static void rec_set_depth_mask(bool z_upd) {
+    rec.state[1] = z_upd;
+}
+
+static void rec_set_zmode_decal(bool zmode_decal) {
+    rec.state[2] = zmode_decal;
+}
+
+static void rec_set_viewport(int x, int y, int width, int height) {
+    rec.viewport[0] = x;
+    rec.viewport[1] = y;
+    rec.viewport[2] = width;
+    rec.viewport[3] = height;
+}
+
+static void rec_set_scissor(int x, int y, int width, int height) {
+    rec.scissor[0] = x;
+    rec.scissor[1] = y;
+    rec.scissor[2] = width;
+    rec.scissor[3] = height;
+}
+
+static void rec_set_use_alpha(bool use_alpha) {
+    rec.state[3] = use_alpha;
+}
+
+static void rec_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
+    size_t n = rec.shader->num_floats;
+    for (size_t i = 0; i < buf_vbo_num_tris; i++) {
+        const float *v = buf_vbo + i * 3 * n;
+        record_triangle(v, v + n, v + 2 * n);
+    }
+}
+
+static void rec_init(void) {
+}
+
+static void rec_on_resize(void) {
+}
+
+static void rec_start_frame(void) {
+    rec.num_triangles = 0;
+}
+
+static void rec_end_frame(void) {
+}
+
+static void rec_finish_render(void) {
+}
+
+static void rec_set_vertex_transforms(const float slots[][4], size_t num_slots) {
+    memcpy(rec.slots, slots, num_slots * GFX_TRANSFORM_SLOT_VEC4S * sizeof(rec.slots[0]));
+}
+
+static void rec_set_cull_face(int cull) {
+    rec.state[4] = cull;
+}
+
+static uint32_t rec_new_static_mesh(const float vertices[], size_t num_floats, const uint16_t indices[], size_t num_indices) {
+    for (uint32_t i = 0; i < MAX_MESHES; i++) {
+        struct RecordedMesh *m = &rec.meshes[i];
+        if (m->vertices == NULL) {
+            m->vertices = malloc(num_floats * sizeof(float));
+            m->indices = malloc(num_indices * sizeof(uint16_t));
+            memcpy(m->vertices, vertices, num_floats * sizeof(float));
+            memcpy(m->indices, indices, num_indices * sizeof(uint16_t));
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void rec_draw_static_mesh(uint32_t mesh, size_t first_float, size_t first_index, size_t num_indices) {
+    const struct RecordedMesh *m = &rec.meshes[mesh - 1];
+    const float *base = m->vertices + first_float;
+    size_t n = rec.shader->num_floats;
+    for (size_t i = 0; i < num_indices; i += 3) {
+        const uint16_t *idx = m->indices + first_index + i;
+        record_triangle(base + idx[0] * n, base + idx[1] * n, base + idx[2] * n);
+    }
+}
+
+static void rec_delete_static_mesh(uint32_t mesh) {
+    struct RecordedMesh *m = &rec.meshes[mesh - 1];
+    free(m->vertices);
+    free(m->indices);
+    m->vertices = NULL;
+    m->indices = NULL;
+}
+
+static struct GfxRenderingAPI rec_api = {
+    .z_is_from_0_to_1 = rec_z_is_from_0_to_1,
+    .unload_shader = rec_unload_shader,
+    .load_shader = rec_load_shader,
+    .create_and_load_new_shader = rec_create_and_load_new_shader,
+    .lookup_shader = rec_lookup_shader,
+    .shader_get_info = rec_shader_get_info,
+    .new_texture = rec_new_texture,
+    .select_texture = rec_select_texture,
+    .upload_texture = rec_upload_texture,
+    .set_sampler_parameters = rec_set_sampler_parameters,
+    .set_depth_test = rec_set_depth_test,
+    .set_depth_mask = rec_set_depth_mask,
+    .set_zmode_decal = rec_set_zmode_decal,
+    .set_viewport = rec_set_viewport,
+    .set_scissor = rec_set_scissor,
+    .set_use_alpha = rec_set_use_alpha,
+    .draw_triangles = rec_draw_triangles,
+    .init = rec_init,
+    .on_resize = rec_on_resize,
+    .start_frame = rec_start_frame,
+    .end_frame = rec_end_frame,
+    .finish_render = rec_finish_render,
+    .set_vertex_transforms = rec_set_vertex_transforms,
+    .set_cull_face = rec_set_cull_face,
+    .new_static_mesh = rec_new_static_mesh,
+    .draw_static_mesh = rec_draw_static_mesh,
+    .delete_static_mesh = rec_delete_static_mesh,
+};
+
+static void wm_init(const char *game_name, bool start_in_fullscreen) {
+}
+
+static void wm_get_dimensions(uint32_t *width, uint32_t *height) {
+    *width = 640;
+    *height = 480;
+}
+
+static void wm_handle_events(void) {
+}
+
+static bool wm_start_frame(void) {
+    return true;
+}
+
+static void wm_swap_buffers(void) {
+}
+
+static double wm_get_time(void) {
+    return 0.0;
+}
+
+static struct GfxWindowManagerAPI wm_api = {
+    .init = wm_init,
+    .get_dimensions = wm_get_dimensions,
+    .handle_events = wm_handle_events,
+    .start_frame = wm_start_frame,
+    .swap_buffers_begin = wm_swap_buffers,
+    .swap_buffers_end = wm_swap_buffers,
+    .get_time = wm_get_time,
+};
+
+/*
+ * The scene
+ */
+
+static Vp viewport = { { { 1280, 960, G_MAXZ / 2, 0 }, { 1280, 960, G_MAXZ / 2, 0 } } };
+
+static Mtx projection = { {
+    { 1.0f, 0.0f, 0.0f, 0.0f },
+    { 0.0f, 1.333f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, -1.01f, -1.0f },
+    { 0.0f, 0.0f, -20.0f, 0.0f },
+} };
+static Mtx view;
+static Mtx object;
+
+static Vtx terrain_vertices[8];
+
+static Vtx textured_vertices[4] = {
+    { { { -100.0f, 0.0f, -100.0f }, 0, { 0, 0 }, { 0xff, 0xff, 0xff, 0xff } } },
+    { { { 100.0f, 0.0f, -100.0f }, 0, { 128 << 5, 0 }, { 0xff, 0xff, 0xff, 0xff } } },
+    { { { 100.0f, 0.0f, 100.0f }, 0, { 128 << 5, 128 << 5 }, { 0xff, 0xff, 0xff, 0xff } } },
+    { { { -100.0f, 0.0f, 100.0f }, 0, { 0, 128 << 5 }, { 0xff, 0xff, 0xff, 0xff } } },
+};
+
+static Vtx lit_vertices[4] = {
+    { { { -50.0f, 50.0f, 0.0f }, 0, { 0, 0 }, { 0x00, 0x00, 0x7f, 0xff } } },
+    { { { 50.0f, 50.0f, 0.0f }, 0, { 0, 0 }, { 0x00, 0x00, 0x7f, 0xff } } },
+    { { { 50.0f, 150.0f, 0.0f }, 0, { 0, 0 }, { 0x40, 0x00, 0x70, 0xff } } },
+    { { { -50.0f, 150.0f, 0.0f }, 0, { 0, 0 }, { 0xc0, 0x00, 0x70, 0xff } } },
+};
+
+static u16 texture[4 * 4];
+
+static Lights1 lights = gdSPDefLights1(0x40, 0x40, 0x40, 0xff, 0xff, 0xff, 0x28, 0x28, 0x28);
+
+static Gfx terrain_dl[] = {
+    gsSPVertex(terrain_vertices, 8, 0),
+    gsSP2Triangles(0, 1, 2, 0x0, 0, 2, 3, 0x0),
+    gsSP2Triangles(4, 5, 6, 0x0, 4, 6, 7, 0x0),
+    gsSPEndDisplayList(),
+};
+
+static Gfx textured_dl[] = {
+    gsDPSetCombineMode(G_CC_MODULATERGB, G_CC_MODULATERGB),
+    gsSPTexture(0xffff, 0xffff, 0, G_TX_RENDERTILE, G_ON),
+    gsDPLoadTextureBlock(texture, G_IM_FMT_RGBA, G_IM_SIZ_16b, 4, 4, 0, G_TX_WRAP | G_TX_NOMIRROR,
+                         G_TX_WRAP | G_TX_NOMIRROR, 2, 2, G_TX_NOLOD, G_TX_NOLOD),
+    gsSPVertex(textured_vertices, 4, 0),
+    gsSP2Triangles(0, 1, 2, 0x0, 0, 2, 3, 0x0),
+    gsSPTexture(0xffff, 0xffff, 0, G_TX_RENDERTILE, G_OFF),
+    gsDPSetCombineMode(G_CC_SHADE, G_CC_SHADE),
+    gsSPEndDisplayList(),
+};
+
+static Gfx lit_dl[] = {
+    gsSPSetGeometryMode(G_LIGHTING),
+    gsSPSetLights1(lights),
+    gsSPVertex(lit_vertices, 4, 0),
+    gsSP2Triangles(0, 1, 2, 0x0, 0, 2, 3, 0x0),
+    gsSPClearGeometryMode(G_LIGHTING),
+    gsSPEndDisplayList(),
+};
+
+static Gfx frame_dl[] = {
+    gsDPPipeSync(),
+    gsSPViewport(&viewport),
+    gsDPSetScissor(G_SC_NON_INTERLACE, 0, 0, 320, 240),
+    gsSPMatrix(&projection, G_MTX_PROJECTION | G_MTX_LOAD | G_MTX_NOPUSH),
+    gsSPMatrix(&view, G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH),
+    gsSPClearGeometryMode(0xffffffff),
+    gsSPTexture(0xffff, 0xffff, 0, G_TX_RENDERTILE, G_OFF),
+    gsSPSetGeometryMode(G_ZBUFFER | G_SHADE | G_CULL_BACK | G_SHADING_SMOOTH),
+    gsDPSetRenderMode(G_RM_AA_ZB_OPA_SURF, G_RM_AA_ZB_OPA_SURF2),
+    gsDPSetCombineMode(G_CC_SHADE, G_CC_SHADE),
+    gsSPDisplayList(terrain_dl),
+    gsSPDisplayList(textured_dl),
+    gsSPDisplayList(lit_dl),
+    // The same model under an object's matrix
+    gsSPMatrix(&object, G_MTX_MODELVIEW | G_MTX_MUL | G_MTX_PUSH),
+    gsSPDisplayList(terrain_dl),
+    gsSPDisplayList(lit_dl),
+    gsSPPopMatrix(G_MTX_MODELVIEW),
+    gsDPSetRenderMode(G_RM_AA_ZB_XLU_SURF, G_RM_AA_ZB_XLU_SURF2),
+    gsDPSetCombineMode(G_CC_SHADE, G_CC_SHADE),
+    gsSPDisplayList(terrain_dl),
+    gsDPPipeSync(),
+    gsSPEndDisplayList(),
+};
+
+static void set_translation(Mtx *m, float x, float y, float z) {
+    memset(m, 0, sizeof(*m));
+    m->m[0][0] = m->m[1][1] = m->m[2][2] = m->m[3][3] = 1.0f;
+    m->m[3][0] = x;
+    m->m[3][1] = y;
+    m->m[3][2] = z;
+}
+
+static void set_yaw(Mtx *m, float angle, float x, float z) {
+    set_translation(m, x, 0.0f, z);
+    m->m[0][0] = m->m[2][2] = cosf(angle);
+    m->m[0][2] = -sinf(angle);
+    m->m[2][0] = sinf(angle);
+}
+
+// Two quads, with the colors of the given area
+static void load_area(int area) {
+    for (int i = 0; i < 8; i++) {
+        Vtx_t *v = &terrain_vertices[i].v;
+        v->ob[0] = (i & 1) == (i >> 1 & 1) ? -200.0f : 200.0f;
+        v->ob[1] = i < 4 ? -50.0f : 50.0f;
+        v->ob[2] = (i & 2) ? 200.0f : -200.0f;
+        v->cn[0] = 0x20 * i + 0x40 * area;
+        v->cn[1] = 0xff - 0x10 * i;
+        v->cn[2] = 0x80;
+        v->cn[3] = 0xc0;
+    }
+}
+
+// Draws the frames with the cache on or off, and saves the triangles of each one
+static void run_frames(bool cache, uint64_t *triangles, size_t *num_triangles, uint32_t *static_dls_drawn) {
+    gfx_set_static_geometry_cache(cache);
+    load_area(0);
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        if (frame == INVALIDATE_FRAME) {
+            gfx_invalidate_static_geometry();
+        }
+        if (frame == CHANGE_FRAME) {
+            load_area(1);
+        }
+        set_translation(&view, 10.0f * frame, -20.0f, -600.0f + 15.0f * frame);
+        set_yaw(&object, 0.3f * frame, 150.0f, -100.0f);
+        gfx_start_frame();
+        gfx_run(frame_dl);
+        gfx_end_frame();
+        memcpy(&triangles[frame * MAX_TRIANGLES], rec.triangles, sizeof(rec.triangles));
+        num_triangles[frame] = rec.num_triangles;
+        static_dls_drawn[frame] = gfx_frame_stats.static_dls_drawn;
+    }
+}
+
+int main(void) {
+    static uint64_t triangles[2][NUM_FRAMES * MAX_TRIANGLES];
+    size_t num_triangles[2][NUM_FRAMES];
+    uint32_t static_dls_drawn[2][NUM_FRAMES];
+    uint32_t total_drawn = 0;
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(texture) / sizeof(texture[0]); i++) {
+        texture[i] = (u16)(i * 0x1234 + 1);
+    }
+    gfx_init(&wm_api, &rec_api, "static_dl_check", false);
+    gfx_set_gpu_vertex_transform(true);
+    run_frames(false, triangles[0], num_triangles[0], static_dls_drawn[0]);
+    run_frames(true, triangles[1], num_triangles[1], static_dls_drawn[1]);
+
+    printf("frame  triangles  cached dls  result\n");
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        bool same = num_triangles[0][frame] == num_triangles[1][frame] && num_triangles[0][frame] <= MAX_TRIANGLES &&
+                    memcmp(&triangles[0][frame * MAX_TRIANGLES], &triangles[1][frame * MAX_TRIANGLES],
+                           num_triangles[0][frame] * sizeof(uint64_t)) == 0;
+        printf("%5d  %4zu %4zu  %10u  %s\n", frame, num_triangles[0][frame], num_triangles[1][frame],
+               static_dls_drawn[1][frame], same ? "same" : "DIFFERENT");
+        if (!same || static_dls_drawn[0][frame] != 0) {
+            failed = 1;
+        }
+        total_drawn += static_dls_drawn[1][frame];
+    }
+    if (static_dls_drawn[1][INVALIDATE_FRAME] != 0) {
+        printf("cached display lists were drawn right after the invalidation\n");
+        failed = 1;
+    }
+    if (total_drawn == 0) {
+        printf("the static geometry cache was never used\n");
+        failed = 1;
+    }
+    return failed;
+}
@@ -0,0 +1,468 @@
+/**
+ * Standalone benchmark for the vertex transform of the PC renderer.
+ * Frames of randomized vertex loads, each under its own object matrix, are
+ * run through gfx_pc with the scalar and with the SIMD vertex transform, for
+ * plain shaded, lit, texture generated, fogged and textured vertices. A
+ * recording rendering API keeps every triangle it is given, and the SIMD run
+ * has to give the same triangles as the scalar one down to the bits of every
+ * float, with the same ones trivially rejected by the clip test. Culling is
+ * off, so that every triangle that is not rejected reaches the backend.
+ *
+ * Build with `make vertex-bench` and run
+ *   build/<version>_pc/vertex_bench [rounds] [seed]
+ * It exits with status 1 if the two transforms disagree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <ultra64.h>
+
+#include "pc/gfx/gfx_pc.h"
+#include "pc/gfx/gfx_cc.h"
+#include "pc/gfx/gfx_rendering_api.h"
+#include "pc/gfx/gfx_window_manager_api.h"
+
+#define DEFAULT_ROUNDS 200
+
+// Vertex loads per frame, each with its own object matrix
+#define NUM_LOADS 64
+
+#define LOAD_VERTICES 32
+#define LOAD_TRIANGLES (LOAD_VERTICES - 2)
+#define MAX_TRIANGLES (NUM_LOADS * LOAD_TRIANGLES)
+
+#define MAX_SHADERS 64
+
+// Each mode is timed this many times, taking the fastest
+#define TIMED_PASSES 3
+
+enum VertexBenchMode {
+    BENCH_SHADE,
+    BENCH_LIT,
+    BENCH_TEXGEN,
+    BENCH_FOG,
+    BENCH_TEXTURED,
+    BENCH_MODE_COUNT
+};
+
+static const char *sModeNames[BENCH_MODE_COUNT] = {
+    "shade", "lit", "texgen", "fog", "textured",
+};
+
+struct ShaderProgram {
+    uint32_t shader_id;
+    uint8_t num_inputs;
+    bool used_textures[2];
+    size_t num_floats;
+};
+
+static struct {
+    struct ShaderProgram shaders[MAX_SHADERS];
+    size_t num_shaders;
+    struct ShaderProgram *shader;
+    uint32_t num_textures;
+    uint64_t *triangles;
+    size_t num_triangles;
+} rec;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size-- > 0) {
+        hash = (hash ^ *p++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool rec_z_is_from_0_to_1(void) {
+    return false;
+}
+
+static void rec_unload_shader(struct ShaderProgram *old_prg) {
+}
+
+static void rec_load_shader(struct ShaderProgram *new_prg) {
+    rec.shader = new_prg;
+}
+
+static struct ShaderProgram *rec_create_and_load_new_shader(uint32_t shader_id) {
+    struct CCFeatures cc_features;
+    struct ShaderProgram *prg = &rec.shaders[rec.num_shaders++];
+
+    // Same vertex layout as the OpenGL backend
+    gfx_cc_get_features(shader_id, &cc_features);
+    prg->shader_id = shader_id;
+    prg->num_inputs = cc_features.num_inputs;
+    prg->used_textures[0] = cc_features.used_textures[0];
+    prg->used_textures[1] = cc_features.used_textures[1];
+    prg->num_floats = 4;
+    if (cc_features.used_textures[0] || cc_features.used_textures[1]) {
+        prg->num_floats += 2;
+    }
+    if (cc_features.opt_fog) {
+        prg->num_floats += 4;
+    }
+    prg->num_floats += cc_features.num_inputs * (cc_features.opt_alpha ? 4 : 3);
+    rec.shader = prg;
+    return prg;
+}
+
+static struct ShaderProgram *rec_lookup_shader(uint32_t shader_id) {
+    for (size_t i = 0; i < rec.num_shaders; i++) {
+        if (rec.shaders[i].shader_id == shader_id) {
+            return &rec.shaders[i];
+        }
+    }
+    return NULL;
+}
+
+static void rec_shader_get_info(struct ShaderProgram *prg, uint8_t *num_inputs, bool used_textures[2]) {
+    *num_inputs = prg->num_inputs;
+    used_textures[0] = prg->used_textures[0];
+    used_textures[1] = prg->used_textures[1];
+}
+
+static uint32_t rec_new_texture(void) {
+    return ++rec.num_textures;
+}
+
+static void rec_select_texture(int tile, uint32_t texture_id) {
+}
+
+static void rec_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+}
+
+static void rec_set_sampler_parameters(int tile, bool linear_filter, uint32_t cms, uint32_t cmt) {
+}
+
+static void rec_set_depth_test(bool depth_test) {
+}
+
+static void rec_set_depth_mask(bool z_upd) {
+}
+
+static void rec_set_zmode_decal(bool zmode_decal) {
+}
+
+static void rec_set_viewport(int x, int y, int width, int height) {
+}
+
+static void rec_set_scissor(int x, int y, int width, int height) {
+}
+
+static void rec_set_use_alpha(bool use_alpha) {
+}
+
+// Keeps a hash of the vertices of every triangle, in the order they are drawn
+static void rec_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
+    size_t n = 3 * rec.shader->num_floats;
+    for (size_t i = 0; i < buf_vbo_num_tris; i++) {
+        if (rec.num_triangles < MAX_TRIANGLES) {
+            rec.triangles[rec.num_triangles] = hash_bytes(0xcbf29ce484222325ULL, buf_vbo + i * n, n * sizeof(float));
+        }
+        rec.num_triangles++;
+    }
+}
+
+static void rec_init(void) {
+}
+
+static void rec_on_resize(void) {
+}
+
+static void rec_start_frame(void) {
+    rec.num_triangles = 0;
+}
+
+static void rec_end_frame(void) {
+}
+
+static void rec_finish_render(void) {
+}
+
+static void rec_set_vertex_transforms(const float slots[][4], size_t num_slots) {
+}
+
+static void rec_set_cull_face(int cull) {
+}
+
+static struct GfxRenderingAPI rec_api = {
+    .z_is_from_0_to_1 = rec_z_is_from_0_to_1,
+    .unload_shader = rec_unload_shader,
+    .load_shader = rec_load_shader,
+    .create_and_load_new_shader = rec_create_and_load_new_shader,
+    .lookup_shader = rec_lookup_shader,
+    .shader_get_info = rec_shader_get_info,
+    .new_texture = rec_new_texture,
+    .select_texture = rec_select_texture,
+    .upload_texture = rec_upload_texture,
+    .set_sampler_parameters = rec_set_sampler_parameters,
+    .set_depth_test = rec_set_depth_test,
+    .set_depth_mask = rec_set_depth_mask,
+    .set_zmode_decal = rec_set_zmode_decal,
+    .set_viewport = rec_set_viewport,
+    .set_scissor = rec_set_scissor,
+    .set_use_alpha = rec_set_use_alpha,
+    .draw_triangles = rec_draw_triangles,
+    .init = rec_init,
+    .on_resize = rec_on_resize,
+    .start_frame = rec_start_frame,
+    .end_frame = rec_end_frame,
+    .finish_render = rec_finish_render,
+    .set_vertex_transforms = rec_set_vertex_transforms,
+    .set_cull_face = rec_set_cull_face,
+};
+
+static void wm_init(const char *game_name, bool start_in_fullscreen) {
+}
+
+static void wm_get_dimensions(uint32_t *width, uint32_t *height) {
+    *width = 640;
+    *height = 480;
+}
+
+static void wm_handle_events(void) {
+}
+
+static bool wm_start_frame(void) {
+    return true;
+}
+
+static void wm_swap_buffers(void) {
+}
+
+static double wm_get_time(void) {
+    return 0.0;
+}
+
+static struct GfxWindowManagerAPI wm_api = {
+    .init = wm_init,
+    .get_dimensions = wm_get_dimensions,
+    .handle_events = wm_handle_events,
+    .start_frame = wm_start_frame,
+    .swap_buffers_begin = wm_swap_buffers,
+    .swap_buffers_end = wm_swap_buffers,
+    .get_time = wm_get_time,
+};
+
+/*
+ * The frames
+ */
+
+static Vp viewport = { { { 1280, 960, G_MAXZ / 2, 0 }, { 1280, 960, G_MAXZ / 2, 0 } } };
+
+static Mtx projection = { {
+    { 1.0f, 0.0f, 0.0f, 0.0f },
+    { 0.0f, 1.333f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, -1.01f, -1.0f },
+    { 0.0f, 0.0f, -20.0f, 0.0f },
+} };
+
+static Mtx sObjects[NUM_LOADS];
+static Vtx sVertices[NUM_LOADS][LOAD_VERTICES];
+static Lights2 sLights[NUM_LOADS];
+static u16 sTexture[4 * 4];
+
+// Header, texture load and per load commands, with room to spare
+static Gfx sFrameDl[64 + NUM_LOADS * (4 + LOAD_TRIANGLES)];
+
+static uint64_t sTriangles[2][MAX_TRIANGLES];
+static size_t sNumTriangles[2];
+
+static uint32_t sRandomState;
+
+static uint32_t bench_random(void) {
+    sRandomState ^= sRandomState << 13;
+    sRandomState ^= sRandomState >> 17;
+    sRandomState ^= sRandomState << 5;
+    return sRandomState;
+}
+
+static float bench_random_float(float range) {
+    return ((float)(bench_random() & 0xFFFFFF) / 0x800000 - 1.0f) * range;
+}
+
+/**
+ * Fill 'm' with a random rotation about two axes and a translation in front
+ * of the camera. Some vertices end up outside the view or behind the eye.
+ */
+static void bench_random_object(Mtx *m) {
+    float yaw = bench_random_float(3.1416f), pitch = bench_random_float(3.1416f);
+    float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+
+    memset(m, 0, sizeof(*m));
+    m->m[0][0] = cy;
+    m->m[0][2] = -sy;
+    m->m[1][0] = sy * sp;
+    m->m[1][1] = cp;
+    m->m[1][2] = cy * sp;
+    m->m[2][0] = sy * cp;
+    m->m[2][1] = -sp;
+    m->m[2][2] = cy * cp;
+    m->m[3][0] = bench_random_float(800.0f);
+    m->m[3][1] = bench_random_float(600.0f);
+    m->m[3][2] = -700.0f + bench_random_float(650.0f);
+    m->m[3][3] = 1.0f;
+}
+
+static void init_inputs(uint32_t seed) {
+    sRandomState = seed;
+    for (size_t i = 0; i < sizeof(sTexture) / sizeof(sTexture[0]); i++) {
+        sTexture[i] = (u16) bench_random();
+    }
+    for (int i = 0; i < NUM_LOADS; i++) {
+        bench_random_object(&sObjects[i]);
+        for (int j = 0; j < LOAD_VERTICES; j++) {
+            Vtx *v = &sVertices[i][j];
+            float nx = bench_random_float(1.0f), ny = bench_random_float(1.0f), nz = bench_random_float(1.0f);
+            float len = sqrtf(nx * nx + ny * ny + nz * nz) + 1e-6f;
+            for (int k = 0; k < 3; k++) {
+                v->v.ob[k] = (s16) bench_random_float(400.0f);
+            }
+            v->v.tc[0] = (s16) bench_random_float(4096.0f);
+            v->v.tc[1] = (s16) bench_random_float(4096.0f);
+            // The normal overlaps the color of Vtx_t, so only the alpha is free
+            v->n.n[0] = (s8)(nx / len * 127.0f);
+            v->n.n[1] = (s8)(ny / len * 127.0f);
+            v->n.n[2] = (s8)(nz / len * 127.0f);
+            v->n.a = (u8) bench_random();
+        }
+        Lights2 *l = &sLights[i];
+        memset(l, 0, sizeof(*l));
+        for (int k = 0; k < 3; k++) {
+            l->a.l.col[k] = l->a.l.colc[k] = bench_random() & 0x7f;
+            l->l[0].l.col[k] = l->l[0].l.colc[k] = (u8) bench_random();
+            l->l[1].l.col[k] = l->l[1].l.colc[k] = (u8) bench_random();
+            l->l[0].l.dir[k] = (s8) bench_random_float(127.0f);
+            l->l[1].l.dir[k] = (s8) bench_random_float(127.0f);
+        }
+    }
+}
+
+static void build_frame(int mode) {
+    Gfx *p = sFrameDl;
+    bool lighting = mode == BENCH_LIT || mode == BENCH_TEXGEN;
+    bool textured = mode == BENCH_TEXGEN || mode == BENCH_TEXTURED;
+
+    gDPPipeSync(p++);
+    gSPViewport(p++, &viewport);
+    gDPSetScissor(p++, G_SC_NON_INTERLACE, 0, 0, 320, 240);
+    gSPMatrix(p++, &projection, G_MTX_PROJECTION | G_MTX_LOAD | G_MTX_NOPUSH);
+    gSPClearGeometryMode(p++, 0xffffffff);
+    gSPSetGeometryMode(p++, G_ZBUFFER | G_SHADE | G_SHADING_SMOOTH);
+    gDPSetRenderMode(p++, G_RM_AA_ZB_OPA_SURF, G_RM_AA_ZB_OPA_SURF2);
+    if (lighting) {
+        gSPSetGeometryMode(p++, mode == BENCH_TEXGEN ? G_LIGHTING | G_TEXTURE_GEN : G_LIGHTING);
+    }
+    if (mode == BENCH_FOG) {
+        gSPSetGeometryMode(p++, G_FOG);
+        gDPSetRenderMode(p++, G_RM_FOG_SHADE_A, G_RM_AA_ZB_OPA_SURF2);
+        gSPFogPosition(p++, 900, 1000);
+    }
+    if (textured) {
+        gDPSetCombineMode(p++, G_CC_MODULATERGB, G_CC_MODULATERGB);
+        gSPTexture(p++, mode == BENCH_TEXGEN ? 0x07c0 : 0xffff, mode == BENCH_TEXGEN ? 0x07c0 : 0xffff, 0,
+                   G_TX_RENDERTILE, G_ON);
+        gDPLoadTextureBlock(p++, sTexture, G_IM_FMT_RGBA, G_IM_SIZ_16b, 4, 4, 0, G_TX_WRAP | G_TX_NOMIRROR,
+                            G_TX_WRAP | G_TX_NOMIRROR, 2, 2, G_TX_NOLOD, G_TX_NOLOD);
+    } else {
+        gSPTexture(p++, 0xffff, 0xffff, 0, G_TX_RENDERTILE, G_OFF);
+        gDPSetCombineMode(p++, G_CC_SHADE, G_CC_SHADE);
+    }
+
+    for (int i = 0; i < NUM_LOADS; i++) {
+        gSPMatrix(p++, &sObjects[i], G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH);
+        if (lighting) {
+            gSPSetLights2(p++, sLights[i]);
+        }
+        gSPVertex(p++, sVertices[i], LOAD_VERTICES, 0);
+        for (int j = 0; j < LOAD_TRIANGLES; j++) {
+            gSP1Triangle(p++, j, j + 1, j + 2, 0);
+        }
+    }
+    gDPPipeSync(p++);
+    gSPEndDisplayList(p++);
+}
+
+static void run_frame(bool simd, uint64_t *triangles, size_t *num_triangles) {
+    gfx_set_simd_vertex_transform(simd);
+    rec.triangles = triangles;
+    gfx_start_frame();
+    gfx_run(sFrameDl);
+    gfx_end_frame();
+    *num_triangles = rec.num_triangles;
+}
+
+/**
+ * Time the frame with one of the transforms, returning the vertices per second.
+ */
+static double time_frame(bool simd, int rounds) {
+    size_t num_triangles;
+    clock_t start;
+    double seconds;
+
+    start = clock();
+    for (int i = 0; i < rounds; i++) {
+        run_frame(simd, sTriangles[simd], &num_triangles);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return seconds > 0.0 ? (double) NUM_LOADS * LOAD_VERTICES * rounds / seconds : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    int totalDifferences = 0;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds] [seed]\n", argv[0]);
+        return 2;
+    }
+    if (seed == 0) {
+        seed = 1;
+    }
+
+    init_inputs(seed);
+    gfx_init(&wm_api, &rec_api, "vertex_bench", false);
+    gfx_set_gpu_vertex_transform(false);
+    gfx_set_static_geometry_cache(false);
+
+    printf("%-10s %12s %12s %10s %10s %8s\n", "mode", "scalar Mv/s", "simd Mv/s", "triangles", "rejected", "diffs");
+
+    for (int mode = 0; mode < BENCH_MODE_COUNT; mode++) {
+        double verticesPerSecond[2] = { 0.0, 0.0 };
+        int differences = 0;
+
+        build_frame(mode);
+        for (int simd = 0; simd < 2; simd++) {
+            for (int pass = 0; pass < TIMED_PASSES; pass++) {
+                double passVertices = time_frame(simd, rounds);
+                if (passVertices > verticesPerSecond[simd]) {
+                    verticesPerSecond[simd] = passVertices;
+                }
+            }
+        }
+        for (int simd = 0; simd < 2; simd++) {
+            run_frame(simd, sTriangles[simd], &sNumTriangles[simd]);
+        }
+
+        if (sNumTriangles[0] != sNumTriangles[1]) {
+            differences = abs((int) sNumTriangles[0] - (int) sNumTriangles[1]);
+        }
+        for (size_t i = 0; i < sNumTriangles[0] && i < sNumTriangles[1] && i < MAX_TRIANGLES; i++) {
+            differences += sTriangles[0][i] != sTriangles[1][i];
+        }
+
+        printf("%-10s %12.2f %12.2f %10zu %10zu %8d\n", sModeNames[mode], verticesPerSecond[0] / 1e6,
+               verticesPerSecond[1] / 1e6, sNumTriangles[0], (size_t) MAX_TRIANGLES - sNumTriangles[0], differences);
+        totalDifferences += differences;
+    }
+
+    printf("%d rounds of %d vertices per mode\n", rounds, NUM_LOADS * LOAD_VERTICES);
+
+    return totalDifferences != 0;
+}